@@ -3,28 +3,108 @@
 #include "imc_includes.h"
 
 #define PRINT_ALGORITHM 1001    // Option ID for printing a summary of the algorithm used by this program
+#define EXPORT_KEY      1002    // Option ID for saving the secrets derived from the password to a key file
+#define KEY_FILE        1003    // Option ID for using a key file instead of a password
+#define GENERATE_KEYS   1004    // Option ID for generating a key pair for the recipient mode
+#define RECIPIENT       1005    // Option ID for hiding data to the owner of a public key
+#define SECRET_KEY      1006    // Option ID for extracting data with a secret key
+#define PASSWORD_LIST   1007    // Option ID for trying a list of passwords
+#define REKEY           1008    // Option ID for changing the password of the hidden data
+#define NEW_PASSWORD    1009    // Option ID for the new password when changing it
+#define TRANSPLANT      1010    // Option ID for copying the hidden data to another image
+#define REMOVE          1011    // Option ID for removing a hidden file from the image
+#define TAR             1012    // Option ID for extracting the hidden files as a tar archive
+#define SERVE           1013    // Option ID for running as a server on a Unix-domain socket
+#define WATCH           1014    // Option ID for watching a folder for new images
+#define COVER_CACHE     1015    // Option ID for caching the decoded cover images
+#define INDEX           1016    // Option ID for indexing a folder of cover images
+#define PICK_FROM       1017    // Option ID for choosing the cover image from an index
+#define PLAN            1018    // Option ID for distributing many files over the images of an index
+#define RUN_PLAN        1019    // Option ID for hiding the files as planned
+#define CAPACITY        1020    // Option ID for showing how much data an image can hide
+#define SHARD           1021    // Option ID for splitting a file over many images
+#define JOIN            1022    // Option ID for reassembling a file split over many images
+#define PARITY          1023    // Option ID for adding parity shards when splitting a file
+#define PROFILE         1024    // Option ID for choosing the settings of the encoder when saving images
+#define BENCHMARK       1025    // Option ID for measuring the time and size of saving an image with each profile
 
 // Command line options for imgconceal
 static const struct argp_option argp_options[] = {
-    {"check", 'c', "IMAGE", 0, "Check if a given JPEG, PNG or WebP image contains data hidden by this program, "\
+    {"capacity", CAPACITY, "IMAGE", 0, "Show how much data can be hidden on an image, without a password. "\
+        "The amount is read from the header of PNG and lossless WebP images without transparency, "\
+        "and counted without decoding the pixels of JPEG and lossy WebP images (the other images are opened).", 1},
+    {"benchmark", BENCHMARK, "IMAGE", 0, "Save IMAGE with each profile of the '--profile' option (without hiding anything, "\
+        "and without writing any file), then show how long it took and how big the image got with each of them. "\
+        "No password is needed.", 1},
+    {"check", 'c', "IMAGE", 0, "Check if a given image (JPEG, PNG, WebP, BMP, PNM or TIFF) contains data hidden by this program, "\
     "and estimate how much data can still be hidden on the image. "\
     "If a password was used to hide the data, you should also use the '--password' option. ", 1},
     {"extract", 'e', "IMAGE", 0, "Extracts from the cover image the files that were hidden on it by this program. "\
         "The extracted files will have the same names and timestamps as when they were hidden. "\
         "You can also use the '--output' option to specify the folder where the files are extracted into.", 1},
-    {"input", 'i', "IMAGE", 0, "Path to the cover image (the JPEG, PNG or WebP file where to hide another file). "\
-        "You can also use the '--output' option to specify the name in which to save the modified image.", 2},
+    {"rekey", REKEY, "IMAGE", 0, "Change the password of the files hidden on the image, without extracting them. "\
+        "The current password is given in the same way as when extracting, and the new one with the '--new-password' option "\
+        "(otherwise it is asked on a prompt). You can also use the '--output' option to specify the name in which to save the modified image.", 1},
+    {"transplant", TRANSPLANT, "SRC", 0, "Copy the files hidden on the SRC image to a DST image, without extracting them "\
+        "(usage: '--transplant SRC DST'). The password is the same for both images, and the files previously hidden on DST are overwritten. "\
+        "You can also use the '--output' option to specify the name in which to save the modified DST image.", 1},
+    {"join", JOIN, "IMAGE", 0, "Reassemble a file that was split with '--shard', from all of its images "\
+        "(or, if it has parity shards, from all but as many as its parity shards). "\
+        "The images can be given in any order, and this option accepts more than one image. The shards are read in parallel, "\
+        "and the file is saved to the folder of the '--output' option (or to the current working directory).", 1},
+    {"index", INDEX, "FOLDER", 0, "Open every image on FOLDER (without a password), and save to an index file how much data each image can hide. "\
+        "The index is saved to FOLDER/imgconceal.index, unless the '--output' option is used. "\
+        "Files that are not supported images are skipped.", 1},
+    {"input", 'i', "IMAGE", 0, "Path to the cover image (the JPEG, PNG, WebP, BMP, PNM or TIFF file where to hide another file). "\
+        "You can also use the '--output' option to specify the name in which to save the modified image. "\
+        "Use '-' to read the image from the standard input (then the modified image goes to the standard output, "\
+        "unless '--output' is used).", 2},
     {"output", 'o', "PATH", 0, "When hiding files in an image, this is the filename where "
         "to save the image with hidden data (if this option is not used, the new image is named automatically). "
         "When extracting files from an image, this option is the directory where to save the extracted files "
-        "(if not used, the files are extracted to the current working directory).", 2},
+        "(if not used, the files are extracted to the current working directory). "
+        "Use '-' for the standard output (when extracting, only the first hidden file is written, unless '--tar' is used).", 2},
     {"hide", 'h', "FILE", 0, "Path to the file being hidden in the cover image. "\
         "This option can be specified multiple times in order to hide more than one file. "\
         "You can also pass more than one path to this option in order to hide multiple files. "\
         "If there is no enough space in the cover image, some files may fail being hidden "\
         "(files specified first have priority when trying to hide). "\
         "The default behavior is to overwrite the existing previously hidden files, "\
-        "to avoid that add the '--append' option.", 2},
+        "to avoid that add the '--append' option. "\
+        "Use '-' to hide the data from the standard input (it is hidden with the name 'stdin').", 2},
+    {"pick-from", PICK_FROM, "INDEX", 0, "When hiding files, use as the cover image the smallest image on INDEX "\
+        "(created with '--index') where all the files fit, instead of the image of the '--input' option. "\
+        "The files are compressed first, so the choice is made by their final size and only the index is read. "\
+        "The modified image is saved to the current working directory, unless the '--output' option is used.", 2},
+    {"plan", PLAN, "INDEX", 0, "Distribute the files of the '--hide' option over the images on INDEX (created with '--index'), "\
+        "and save the result to a plan file (imgconceal.plan, unless the '--output' option is used). "\
+        "The files are compressed first, then the biggest ones are placed first, each on the first chosen image where it still fits "\
+        "(or on the smallest unused image where it fits). No password is needed.", 2},
+    {"run-plan", RUN_PLAN, "PLAN", 0, "Hide the files as planned by '--plan', processing the images in parallel. "\
+        "The password is hashed only once, and the modified images are saved to the folder of the '--output' option "\
+        "(or to the current working directory).", 2},
+    {"remove", REMOVE, "NAME", 0, "Name of a hidden file to be removed from the cover image given by '--input' "\
+        "(the other hidden files are kept, without being extracted). If more than one hidden file has the same name, "\
+        "only the first one is removed. You can also use the '--output' option to specify the name in which to save the modified image.", 2},
+    {"shard", SHARD, "IMAGE", 0, "Split the file of the '--hide' option into shards, one on each IMAGE "\
+        "(this option accepts more than one image), so the file can be bigger than what a single image can hide. "\
+        "The images are processed in parallel, and they are saved with the same names to the folder of the '--output' option "\
+        "(or to the current working directory). Use '--join' with all of the images to get the file back.", 2},
+    {"parity", PARITY, "NUM", 0, "When splitting a file with '--shard', use the last NUM images for parity shards "\
+        "(Reed-Solomon erasure code), so the file can still be joined if up to NUM of its images are lost. "\
+        "The file is split in equal parts over the other images, so it must fit on the smallest image "\
+        "times the amount of images that are not for parity.", 2},
+    {"tar", TAR, NULL, 0, "When extracting, write the hidden files as a tar archive to the standard output "\
+        "(or to the file given by '--output').", 2},
+    {"serve", SERVE, "SOCKET", 0, "Run as a server that hides, extracts and checks files for the programs connected to "\
+        "the Unix-domain socket created at SOCKET, until it receives Ctrl+C. Each request carries its own image and password "\
+        "(the protocol is described on the 'imc_server.h' file). The keys of the recent passwords are kept in memory, "\
+        "so the slow password hashing is done only once for each password. Not available on Windows.", 2},
+    {"watch", WATCH, "FOLDER", 0, "Keep watching FOLDER for new images (until Ctrl+C is pressed). "\
+        "Each image written to or moved into FOLDER gets the files of the '--hide' option hidden on it, "\
+        "or, if '--hide' is not used, gets its hidden files extracted to a new folder named after the image. "\
+        "The results go to the folder of the '--output' option (or to the current working directory), "\
+        "and they appear there only once complete. The password is hashed only once. Not available on Windows.", 2},
     {"append", 'a', NULL, 0, "When hiding a file with the '--hide' option, "\
         "append the new file instead of overwriting the existing hidden files. "\
         "For this option to work, the password must be the same as the one used for the previous files.", 3},
@@ -33,17 +113,47 @@ static const struct argp_option argp_options[] = {
         "The password may contain any character that your terminal allows you to input "\
         "(if it has spaces, please enclose the password between quotation marks). "\
         "If you do not want to have a password, please use '--no-password' instead of this option.", 3},
+    {"new-password", NEW_PASSWORD, "TEXT", 0, "New password for the hidden data, when using the '--rekey' option "\
+        "(an empty text means no password).", 3},
+    {"password-list", PASSWORD_LIST, "FILE", 0, "When extracting or checking, try each password on FILE "\
+        "(one password per line, encoded in UTF-8; an empty line means no password). "\
+        "A line longer than 4079 bytes is an error. "\
+        "The image is read only once, and the passwords are tried in parallel. "\
+        "The first password on the list that can decrypt the hidden data is used.", 3},
     {"no-password", 'n', NULL, 0, "Do not use a password for encrypting and scrambling the hidden data. "\
         "That means the data will be able to be extracted without needing a password. "
         "This option can be used with '--hide', '--extract', or '--check'." , 4},
+    {"key-file", KEY_FILE, "FILE", 0, "Use the secrets stored on a key file (created with '--export-key') "\
+        "instead of a password. This skips the password hashing, which is the slowest step when working with small images. "\
+        "This option can be used with '--hide', '--extract', or '--check'.", 4},
+    {"export-key", EXPORT_KEY, "FILE", 0, "Hash the password (from '--password', '--no-password', or the password prompt), "\
+        "then save the result to a key file that can be used later with the '--key-file' option. "\
+        "Anyone who has the key file can extract the data hidden with the same password, "\
+        "so keep it as protected as the password itself.", 4},
+    {"generate-keys", GENERATE_KEYS, "FILE", 0, "Generate a key pair for hiding files without a password. "\
+        "The secret key is saved to FILE, and the public key to FILE.pub. "\
+        "Files hidden with '--recipient FILE.pub' can only be extracted with '--secret-key FILE'.", 4},
+    {"recipient", RECIPIENT, "FILE", 0, "When hiding files, use the public key on FILE (created with '--generate-keys') "\
+        "instead of a password. No password hashing is done, and only the owner of the secret key can extract the files. "\
+        "This option cannot be used with '--append'.", 4},
+    {"secret-key", SECRET_KEY, "FILE", 0, "When extracting or checking, use the secret key on FILE "\
+        "(created with '--generate-keys') instead of a password.", 4},
+    {"threads", 't', "NUM", 0, "Maximum amount of threads used for processing the hidden files "\
+        "(if not specified, the amount of logical processors of the system is used).", 5},
     {"verbose", 'v', NULL, 0, "Print detailed progress information.", 5},
+    {"cover-cache", COVER_CACHE, "FOLDER", 0, "Keep the decoded PNG and WebP cover images on FOLDER, "\
+        "so the next operations on the same image skip decoding it. The images are identified by the hash of their contents. "\
+        "It is worth it for cover images that are used many times.", 5},
+    {"profile", PROFILE, "NAME", 0, "Settings of the encoder when saving the images: 'fast' (bigger images), "\
+        "'balanced' (the default), or 'small' (slower to save). It changes how PNG and lossless WebP images are compressed "\
+        "(the other images are saved the same way with every profile). Use '--benchmark' to compare them on an image.", 5},
     {"silent", 's', NULL, 0, "Do not print any progress information (errors are still shown).", 5},
     {"algorithm", PRINT_ALGORITHM, NULL, 0, "Print a summary of the algorithm used by imgconceal, then exit.", 6},
     {0}
 };
 
 // Help text to be shown above the options (when running with '--help')
-static const char help_text[] = "\nSteganography tool for hiding and extracting files on JPEG, PNG and WebP images. "\
+static const char help_text[] = "\nSteganography tool for hiding and extracting files on JPEG, PNG, WebP, BMP, PNM and TIFF images. "\
     "Multiple files can be hidden in a single cover image, "\
     "and the hidden data can be (optionally) protected with a password.\n\n"\
     "Hiding a file on an image:\n"\
@@ -52,6 +162,39 @@ static const char help_text[] = "\nSteganography tool for hiding and extracting
     "  imgconceal --extract=IMAGE [--output=FOLDER] [--password=TEXT | --no-password]\n\n"\
     "Check if an image has data hidden by this program:\n"\
     "  imgconceal --check=IMAGE [--password=TEXT | --no-password]\n\n"\
+    "Show how much data an image can hide (no password needed):\n"\
+    "  imgconceal --capacity=IMAGE\n\n"\
+    "Compare how fast and how small an image is saved with each profile, then hide a file with one of them:\n"\
+    "  imgconceal --benchmark=IMAGE\n"\
+    "  imgconceal --input=IMAGE --hide=FILE --profile=fast|balanced|small [--output=NEW_IMAGE]\n\n"\
+    "Change the password of the files hidden on an image:\n"\
+    "  imgconceal --rekey=IMAGE [--output=NEW_IMAGE] [--password=TEXT | --no-password] [--new-password=TEXT]\n\n"\
+    "Remove a hidden file from an image:\n"\
+    "  imgconceal --input=IMAGE --remove=NAME [--output=NEW_IMAGE] [--password=TEXT | --no-password]\n\n"\
+    "Copy the files hidden on an image to another image:\n"\
+    "  imgconceal --transplant SRC_IMAGE DST_IMAGE [--output=NEW_IMAGE] [--password=TEXT | --no-password]\n\n"\
+    "Read the image from a pipe and write the result to another pipe ('-' means the standard input or output):\n"\
+    "  imgconceal --input=- --hide=FILE [--password=TEXT | --no-password] < IMAGE > NEW_IMAGE\n"\
+    "  imgconceal --extract=- --tar [--password=TEXT | --no-password] < IMAGE > FILES.tar\n\n"\
+    "Save the hashed password to a key file (to be used instead of the password):\n"\
+    "  imgconceal --export-key=FILE [--password=TEXT | --no-password]\n\n"\
+    "Generate a key pair for hiding files without a password:\n"\
+    "  imgconceal --generate-keys=FILE\n"\
+    "  imgconceal --input=IMAGE --hide=FILE --recipient=FILE.pub\n"\
+    "  imgconceal --extract=IMAGE --secret-key=FILE\n\n"\
+    "Serve hiding, extraction and checking requests on a Unix-domain socket:\n"\
+    "  imgconceal --serve=SOCKET [--threads=NUM] [--verbose | --silent]\n\n"\
+    "Keep hiding files on (or extracting files from) the new images on a folder:\n"\
+    "  imgconceal --watch=FOLDER [--hide=FILE] [--output=FOLDER] [--password=TEXT | --no-password]\n\n"\
+    "Index a folder of cover images, then hide files on the smallest image where they fit:\n"\
+    "  imgconceal --index=FOLDER [--output=INDEX] [--threads=NUM]\n"\
+    "  imgconceal --pick-from=INDEX --hide=FILE [--output=NEW_IMAGE] [--password=TEXT | --no-password]\n\n"\
+    "Distribute many files over the images of an index, then hide them as planned:\n"\
+    "  imgconceal --plan=INDEX --hide=FILE... [--output=PLAN] [--threads=NUM]\n"\
+    "  imgconceal --run-plan=PLAN [--output=FOLDER] [--threads=NUM] [--password=TEXT | --no-password]\n\n"\
+    "Split a file over many images (when it does not fit on one), then join it back:\n"\
+    "  imgconceal --hide=FILE --shard=IMAGE... [--parity=NUM] [--output=FOLDER] [--password=TEXT | --no-password]\n"\
+    "  imgconceal --join=IMAGE... [--output=FOLDER] [--password=TEXT | --no-password]\n\n"\
     "All options:\n";
 
 static const char imgconceal_algorithm_text[] = "The password is hashed using the Argon2id "\
@@ -60,11 +203,13 @@ static const char imgconceal_algorithm_text[] = "The password is hashed using th
 "last 32 bytes are used to seed the pseudo-random number generator (SHISHUA algorithm) used for "\
 "shuffling the positions on the image where the hidden data is written.\n\n"\
 \
-"In the case of a JPEG cover image, the hidden data is written to the least significant bits of "\
-"the quantized AC coefficients that are not 0 or 1 (that happens after the lossy step of the JPEG "\
-"algorithm, so the hidden data is not lost). For a PNG or WebP cover image, the hidden data is "\
-"written to the least significant bits of the RGB color values of the pixels that are not fully "\
-"transparent. Other image formats are not currently supported as cover image, however any file "\
+"In the case of a JPEG or lossy WebP cover image, the hidden data is written to the least significant "\
+"bits of the quantized AC coefficients that are not 0 or 1 (that happens after the lossy step of the "\
+"compression, so the hidden data is not lost; on lossy WebP images, -1 is also skipped, and the bits go into the "\
+"magnitude of the coefficients). For a PNG, lossless WebP, BMP, PNM or TIFF cover image, the hidden "\
+"data is written to the least significant bits of the color values of the pixels that are not fully "\
+"transparent (BMP, PNM and uncompressed TIFF images are changed directly on the file, without being "\
+"decoded). Other image formats are not currently supported as cover image, however any file "\
 "format can be hidden on the cover image (size permitting). Before encryption, the hidden data is "\
 "compressed using the Deflate algorithm.\n\n"\
 \
@@ -81,7 +226,13 @@ static const char imgconceal_algorithm_text[] = "The password is hashed using th
 \
 "The file's name and timestamps are also stored (both of which are also encrypted), so when "\
 "extracted the file has the same name and modified time. The hidden data is extracted by doing "\
-"the file operations in reverse order, after hashing the password and unscrambling the read order.\n";
+"the file operations in reverse order, after hashing the password and unscrambling the read order.\n\n"\
+\
+"When hiding to a public key (recipient mode), no password is hashed. A new X25519 key pair is "\
+"generated for the image, and the 64 bytes are hashed (BLAKE2b algorithm) from the X25519 shared "\
+"secret between it and the recipient's public key. The new public key is written to 256 bits of the "\
+"cover image chosen by a PRNG seeded with a hash of the recipient's public key, so the recipient "\
+"can find it and repeat the key exchange with their secret key.\n";
 
 // Options and callback function for the command line interface
 static const struct argp argp_struct = {argp_options, &imc_cli_parse_options, NULL, help_text};
@@ -98,11 +249,40 @@ typedef struct UserOptions {
     } hide;             // Linked list with the paths to the files being hidden on the image
     struct HideList *hide_tail; // Last element of the 'hide' linked list
     PassBuff *password; // Plain text password provided by the user
+    char *key_file;     // Path to the key file used instead of the password
+    char *export_key;   // Path where to save the key file generated from the password
+    char *generate_keys;    // Path where to save a new key pair for the recipient mode
+    char *recipient;    // Path to the public key to which the data is hidden
+    char *secret_key;   // Path to the secret key used for extracting the data
+    char *password_list;    // Path to a file with passwords to be tried
+    char *rekey;        // Path to the image whose hidden data is getting a new password
+    PassBuff *new_password; // New password for the hidden data (when using '--rekey')
+    char *transplant;   // Path to the image whose hidden data is being copied
+    char *transplant_dst;   // Path to the image where the hidden data is copied to
+    char *remove;       // Name of the hidden file being removed from the image
+    char *serve;        // Path of the socket where the server listens for requests
+    char *watch;        // Path of the folder being watched for new images
+    char *cover_cache;  // Path of the folder where the decoded cover images are cached
+    char *index;        // Path of the folder whose images are being indexed
+    char *pick_from;    // Path of the index from which the cover image is chosen
+    char *plan;         // Path of the index over which the files are distributed
+    char *run_plan;     // Path of the plan being run
+    char *capacity;     // Path of the image whose capacity is shown
+    char *benchmark;    // Path of the image that is saved with each profile
+    struct HideList shard;      // Linked list with the paths to the images over which a file is split
+    struct HideList *shard_tail;    // Last element of the 'shard' linked list
+    struct HideList join;       // Linked list with the paths to the images whose shards are joined
+    struct HideList *join_tail;     // Last element of the 'join' linked list
+    size_t parity;      // Amount of parity shards when splitting a file
+    size_t threads;     // Maximum amount of worker threads (0 means the amount of logical processors)
+    enum SaveProfile profile;   // Settings of the encoder when saving the images
+    bool has_profile;   // Whether the '--profile' option was given
     int prev_arg;       // The key of the previous parsed command line argument
     bool append;        // Whether the added hidden data is being appended to the existing one
     bool no_password;   // 'true' if not using a password
     bool verbose;       // Prints detailed information during operation
     bool silent;        // Do not print any information during operation
+    bool tar;           // Whether to extract the hidden files as a tar archive
 } UserOptions;
 
 // Get a password from the user on the command-line. The typed characters are not displayed.
@@ -301,7 +481,7 @@ static inline void __password_normalize(PassBuff *password, bool from_argv)
 // Free the memory of a 'PassBuff' struct
 static void imc_cli_password_free(PassBuff *password)
 {
-    sodium_free(password);
+    imc_crypto_password_free(password);
     // Note: the above function already overwrites the memory before freeing it.
 }
 
@@ -339,6 +519,47 @@ static inline void __store_path(const char *path, char **destination)
     #endif // _WIN32
 }
 
+// Add a copy of a path to the end of a linked list of paths ('tail' is NULL while the list is empty)
+static void __append_path(const char *path, struct HideList *head, struct HideList **tail)
+{
+    if (*tail)
+    {
+        struct HideList *node = imc_calloc(1, sizeof(struct HideList));
+        __store_path(path, &node->data);
+        (*tail)->next = node;
+        *tail = node;
+    }
+    else
+    {
+        __store_path(path, &head->data);
+        *tail = head;
+    }
+}
+
+// Free the paths of a linked list (the head of the list is not freed itself)
+static void __free_path_list(struct HideList *head)
+{
+    free(head->data);
+    struct HideList *node = head->next;
+    while (node)
+    {
+        struct HideList *next_node = node->next;
+        imc_free(node->data);
+        imc_free(node);
+        node = next_node;
+    };
+}
+
+// Whether any of the paths on a linked list is the standard input or output ("-")
+static bool __has_stdio_path(const struct HideList *head)
+{
+    for (const struct HideList *node = head; node && node->data; node = node->next)
+    {
+        if (imc_is_stdio_path(node->data)) return true;
+    }
+    return false;
+}
+
 // Check if an option has not been passed before (program exits if this check fails)
 // The idea is to check if the option's value evaluates to 'false'. If it doesn't, then the check fails.
 // The error message contains the name of the option, that is why it is needed.
@@ -403,86 +624,1543 @@ static inline void __filesize_to_string(size_t file_size, char *out_buff, size_t
     }
 }
 
-// Validate the command line options, and perform the requested operation
-// This is a helper for the 'imc_cli_parse_options()' function.
-static inline void __execute_options(struct argp_state *state, void *options)
+// Hash the user's password, then save the result to the path of the '--export-key' option
+// This is a helper for the '__execute_options()' function.
+static void __export_key(struct argp_state *state, struct UserOptions *opt)
 {
-    UserOptions *opt = (UserOptions*)options;
+    uint8_t *secret = sodium_malloc(IMC_SECRET_SIZE);
+    if (!secret) argp_failure(state, EXIT_FAILURE, 0, "no enough memory for hashing the password.");
 
-    // Check if the user has specified exactly one operation
-    int mode_count = (bool)opt->hide.data + (bool)opt->extract + (bool)opt->check;
+    if (opt->verbose && !opt->silent)
+    {
+        if (opt->password->length > 0) printf("Generating secret key... ");
+        else printf("Generating key... ");
+        fflush(stdout);
+    }
 
-    if (mode_count == 0)
+    int status = imc_crypto_derive_secret(opt->password, secret);
+    imc_cli_password_free(opt->password);
+    opt->password = NULL;
+
+    if (opt->verbose && !opt->silent)
     {
-        argp_error(state, "you must specify either the 'hide', 'extract', or 'check' option.");
+        printf( (status == IMC_SUCCESS) ? "Done!\n" : "\n" );
     }
-    else if (mode_count != 1)
+    
+    if (status != IMC_SUCCESS)
     {
-        argp_error(state, "you can specify only one among the 'hide', 'extract', or 'check' options.");
+        sodium_free(secret);
+        argp_failure(state, EXIT_FAILURE, 0, "no enough memory for hashing the password.");
     }
 
-    // Mode of operation
-    enum {HIDE, EXTRACT, CHECK} mode;
+    status = imc_crypto_keyfile_save(opt->export_key, secret);
+    sodium_free(secret);
 
-    if (opt->hide.data)
+    switch (status)
     {
-        if (opt->input)
-        {
-            mode = HIDE;
-        }
-        else
-        {
-            argp_error(state, "please use '--input' to specify the image where to hide the file.");
-        }
+        case IMC_SUCCESS:
+            if (!opt->silent)
+            {
+                printf("The key file was saved to '%s'.\n", opt->export_key);
+            }
+            break;
+        
+        case IMC_ERR_FILE_EXISTS:
+            argp_failure(state, EXIT_FAILURE, 0, "could not save '%s' because a file with the same name already exists.", opt->export_key);
+            break;
+        
+        case IMC_ERR_NO_MEMORY:
+            argp_failure(state, EXIT_FAILURE, 0, "no enough memory for saving the key file.");
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "could not save '%s'. Reason: %s.", opt->export_key, strerror(errno));
+            break;
     }
-    else if (opt->extract)
+}
+
+// Exit with an error message if a key file could not be loaded
+// This is a helper for the functions that load the key files.
+static void __key_load_error(struct argp_state *state, const char *path, int status)
+{
+    switch (status)
     {
-        mode = EXTRACT;
+        case IMC_SUCCESS:
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "key file '%s' could not be opened. Reason: %s.", path, strerror(errno));
+            break;
+        
+        case IMC_ERR_FILE_INVALID:
+            argp_failure(state, EXIT_FAILURE, 0, "file '%s' is not a valid key file for this option.", path);
+            break;
+        
+        case IMC_ERR_FILE_CORRUPTED:
+            argp_failure(state, EXIT_FAILURE, 0, "key file '%s' is corrupted.", path);
+            break;
+        
+        case IMC_ERR_NEWER_VERSION:
+            argp_failure(state, EXIT_FAILURE, 0, "key file '%s' was created by a newer version of %s.", path, state->name);
+            break;
+        
+        case IMC_ERR_NO_MEMORY:
+            argp_failure(state, EXIT_FAILURE, 0, "no enough memory for loading the key file.");
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "unknown error when loading the key file. (%d)", status);
+            break;
     }
-    else if (opt->check)
+}
+
+// Load the secrets from a key file, and initialize a cryptographic context with them
+// This is a helper for the '__execute_options()' function. The program exits if the key file cannot be loaded.
+static struct CryptoContext *__load_key_file(struct argp_state *state, const char *path)
+{
+    uint8_t *secret = NULL;
+    int status = imc_crypto_keyfile_load(path, &secret);
+    __key_load_error(state, path, status);
+
+    CryptoContext *crypto = NULL;
+    status = imc_crypto_context_from_secret(secret, &crypto);
+    sodium_free(secret);
+
+    if (status != IMC_SUCCESS)
     {
-        mode = CHECK;
+        argp_failure(state, EXIT_FAILURE, 0, "no enough memory for loading the key file.");
     }
-    else
+
+    return crypto;
+}
+
+// Load the public key ('secret' is false) or the secret key ('secret' is true) of the recipient mode
+// This is a helper for the '__execute_options()' function. The program exits if the key cannot be loaded.
+// The returned key should be freed with 'sodium_free()'.
+static uint8_t *__load_recipient_key(struct argp_state *state, const char *path, bool secret)
+{
+    uint8_t *key = NULL;
+    const int status = secret ? imc_crypto_secret_key_load(path, &key) : imc_crypto_public_key_load(path, &key);
+    __key_load_error(state, path, status);
+    return key;
+}
+
+// Generate a key pair for the recipient mode, and save it to the path of the '--generate-keys' option
+// This is a helper for the '__execute_options()' function.
+static void __generate_keys(struct argp_state *state, struct UserOptions *opt)
+{
+    const int status = imc_crypto_keypair_save(opt->generate_keys);
+
+    switch (status)
     {
-        argp_error(state, "unknown operation.");
+        case IMC_SUCCESS:
+            if (!opt->silent)
+            {
+                printf(
+                    "The secret key was saved to '%s', and the public key to '%s.pub'.\n"
+                    "Files hidden with the public key can only be extracted with the secret key.\n",
+                    opt->generate_keys, opt->generate_keys
+                );
+            }
+            break;
+        
+        case IMC_ERR_FILE_EXISTS:
+            argp_failure(state, EXIT_FAILURE, 0,
+                "could not save the keys because '%s' or '%s.pub' already exists.", opt->generate_keys, opt->generate_keys
+            );
+            break;
+        
+        case IMC_ERR_NO_MEMORY:
+            argp_failure(state, EXIT_FAILURE, 0, "no enough memory for generating the keys.");
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "could not save the keys to '%s'. Reason: %s.", opt->generate_keys, strerror(errno));
+            break;
     }
+}
 
-    if (mode != HIDE && opt->input)
+// Print a progress message of the library to the standard output (on verbose mode)
+static void __print_progress(void *context, const char *message)
+{
+    (void)context;
+    fputs(message, stdout);
+    fflush(stdout);
+}
+
+// Run the server on the socket of the '--serve' option, until the program is stopped
+// This is a helper for the '__execute_options()' function.
+static void __serve(struct argp_state *state, struct UserOptions *opt)
+{
+    const int status = imc_server_run(opt->serve, opt->threads, opt->verbose && !opt->silent, opt->silent);
+
+    switch (status)
     {
-        argp_error(state, "the 'input' option is used only when hiding a file.");
+        case IMC_SUCCESS:
+            break;
+        
+        case IMC_ERR_UNSUPPORTED:
+            argp_failure(state, EXIT_FAILURE, 0, "the 'serve' option is not available on this system.");
+            break;
+        
+        case IMC_ERR_NAME_TOO_LONG:
+            argp_failure(state, EXIT_FAILURE, 0, "the socket path '%s' is too long.", opt->serve);
+            break;
+        
+        case IMC_ERR_FILE_EXISTS:
+            argp_failure(state, EXIT_FAILURE, 0,
+                "'%s' already exists (and it is not the socket of a server that has stopped).", opt->serve
+            );
+            break;
+        
+        case IMC_ERR_SAVE_FAIL:
+            argp_failure(state, EXIT_FAILURE, 0, "could not create the socket '%s'. Reason: %s.", opt->serve, strerror(errno));
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "unknown error when running the server. (%d)", status);
+            break;
     }
+}
 
-    if (mode != HIDE && opt->append)
+// Hash the password once, then process the new images on the folder of the '--watch' option until the program is stopped
+// This is a helper for the '__execute_options()' function.
+static void __watch(struct argp_state *state, struct UserOptions *opt)
+{
+    CryptoContext *crypto = opt->key_file ? __load_key_file(state, opt->key_file) : __password_context(state, opt->password, opt);
+    imc_cli_password_free(opt->password);
+    opt->password = NULL;
+
+    // Files to be hidden on each image
+    size_t hide_count = 0;
+    for (struct HideList *node = &opt->hide; node && node->data; node = node->next) hide_count++;
+    const char *hide_paths[hide_count + 1];
+    hide_count = 0;
+    for (struct HideList *node = &opt->hide; node && node->data; node = node->next) hide_paths[hide_count++] = node->data;
+
+    const WatchOptions watch_options = {
+        .watch_dir = opt->watch,
+        .out_dir = opt->output,
+        .crypto = crypto,
+        .hide_paths = hide_paths,
+        .hide_count = hide_count,
+        .append = opt->append,
+        .profile = opt->profile,
+        .thread_count = opt->threads,
+        .verbose = opt->verbose && !opt->silent,
+        .silent = opt->silent,
+    };
+
+    const char *failed_path = NULL;
+    const int status = imc_watch_run(&watch_options, &failed_path);
+    imc_crypto_context_destroy(crypto);
+
+    switch (status)
     {
-        argp_error(state, "the 'append' option can only be used when hiding a file.");
+        case IMC_SUCCESS:
+            break;
+        
+        case IMC_ERR_UNSUPPORTED:
+            argp_failure(state, EXIT_FAILURE, 0, "the 'watch' option is not available on this system.");
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "could not open '%s'. Reason: %s.", failed_path, strerror(errno));
+            break;
+        
+        case IMC_ERR_PATH_IS_DIR:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is a directory; instead of a file to be hidden.", failed_path);
+            break;
+        
+        case IMC_ERR_INPUT_TOO_BIG:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is bigger than the maximum of %d bytes that can be hidden.", failed_path, IMC_MAX_INPUT_SIZE);
+            break;
+        
+        case IMC_ERR_FILE_CORRUPTED:
+            argp_failure(state, EXIT_FAILURE, 0, "could not read the whole file '%s'.", failed_path);
+            break;
+        
+        case IMC_ERR_SAVE_FAIL:
+            argp_failure(state, EXIT_FAILURE, 0, "could not use '%s' as the folder for the results. Reason: %s.", failed_path, strerror(errno));
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "unknown error when watching the folder. (%d)", status);
+            break;
+    }
+}
+
+// Open the images on the folder of the '--index' option, and save their capacities to an index file
+// This is a helper for the '__execute_options()' function.
+static void __index(struct argp_state *state, struct UserOptions *opt)
+{
+    // The index goes inside the indexed folder, unless another path was given
+    const size_t default_size = strlen(opt->index) + sizeof(IMC_INDEX_NAME) + 1;
+    char default_path[default_size];
+    snprintf(default_path, default_size, "%s/%s", opt->index, IMC_INDEX_NAME);
+    const char *const index_path = opt->output ? opt->output : default_path;
+
+    const ProgressMonitor progress = {&__print_progress, NULL};
+    size_t count = 0;
+    size_t skipped = 0;
+    
+    const int status = imc_index_build(
+        opt->index, index_path, opt->threads, opt->cover_cache, (opt->verbose && !opt->silent) ? &progress : NULL, &count, &skipped
+    );
+
+    switch (status)
+    {
+        case IMC_SUCCESS:
+            if (!opt->silent) printf("SUCCESS: indexed %zu image(s) on '%s' (%zu other file(s) skipped).\n", count, index_path, skipped);
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "could not read the folder '%s'. Reason: %s.", opt->index, strerror(errno));
+            break;
+        
+        case IMC_ERR_SAVE_FAIL:
+            argp_failure(state, EXIT_FAILURE, 0, "could not save the index to '%s'. Reason: %s.", index_path, strerror(errno));
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "unknown error when indexing the folder. (%d)", status);
+            break;
     }
+}
+
+// Compress the files of the '--hide' option, storing them on 'prepared' (one for each path)
+// If a file could not be read, its error code is stored on 'prepared_status' and the value of 'errno' on 'prepared_error'.
+// Returns the amount of carrier bytes needed for all the files that were read.
+// This is a helper for the '__execute_options()' function.
+static size_t __prepare_files(struct UserOptions *opt, PreparedFile **prepared, int *prepared_status, int *prepared_error)
+{
+    // On recipient mode, the ephemeral public key is also stored on the carrier
+    size_t carrier_bits = opt->recipient ? IMC_RECIPIENT_LOCATOR_BITS : 0;
+    size_t i = 0;
 
-    if ( (mode != HIDE && mode != EXTRACT) && opt->output )
+    const ProgressMonitor progress = {&__print_progress, NULL};
+    
+    for (struct HideList *node = &opt->hide; node && node->data; node = node->next, i++)
     {
-        argp_error(state, "the 'output' option can only be used when hiding or extracting files.");
+        prepared[i] = NULL;
+        prepared_status[i] = imc_steg_prepare(node->data, (opt->verbose && !opt->silent) ? &progress : NULL, &prepared[i]);
+        prepared_error[i] = errno;
+        if (prepared_status[i] == IMC_SUCCESS) carrier_bits += imc_steg_prepared_bits(prepared[i]);
     }
 
-    // Display a password prompt, if a password wasn't provided
-    // (and the user did not specify the '--no-password' option)
-    if (!opt->password)
+    return carrier_bits;
+}
+
+// Choose on the index of the '--pick-from' option the smallest image with at least 'carrier_bits' carrier bytes
+// The chosen image becomes the '--input' option, and its indexed parameters are stored on 'picked'.
+// This is a helper for the '__execute_options()' function.
+static void __pick_cover(struct argp_state *state, struct UserOptions *opt, size_t carrier_bits, struct IndexEntry *picked)
+{
+    char *cover_path = NULL;
+    const int status = imc_index_pick(opt->pick_from, carrier_bits, &cover_path, picked);
+
+    switch (status)
+    {
+        case IMC_SUCCESS:
+            opt->input = cover_path;
+            if (!opt->silent) printf("Using '%s' as the cover image.\n", opt->input);
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "could not open the index '%s'. Reason: %s.", opt->pick_from, strerror(errno));
+            break;
+        
+        case IMC_ERR_FILE_INVALID:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is not a valid index (create it again with '--index').", opt->pick_from);
+            break;
+        
+        case IMC_ERR_FILE_TOO_BIG:
+            char size_needed[256];
+            __filesize_to_string(carrier_bits / 8, size_needed, sizeof(size_needed));
+            argp_failure(state, EXIT_FAILURE, 0, "no image on '%s' has enough space for the hidden files (%s needed).", opt->pick_from, size_needed);
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "unknown error when reading the index. (%d)", status);
+            break;
+    }
+}
+
+// Check on the header of the '--input' image whether any of the compressed files can fit on it
+// If none can, the program exits before the password is asked and before the image is decoded. Nothing is checked
+// if the header does not tell the capacity of the image (then the files are checked while being hidden).
+// This is a helper for the '__execute_options()' function.
+static void __check_fit(struct argp_state *state, struct UserOptions *opt, PreparedFile **prepared, const int *prepared_status)
+{
+    if (imc_is_stdio_path(opt->input)) return;
+
+    size_t max_bits = 0;
+    bool exact = false;
+    if (imc_steg_capacity_bound(opt->input, &max_bits, &exact) != IMC_SUCCESS) return;
+
+    // Smallest amount of carrier bytes that a file needs (on recipient mode, the ephemeral public key is also stored)
+    size_t min_bits = SIZE_MAX;
+    size_t i = 0;
+    for (struct HideList *node = &opt->hide; node && node->data; node = node->next, i++)
+    {
+        if (prepared_status[i] != IMC_SUCCESS) continue;
+        const size_t bits = imc_steg_prepared_bits(prepared[i]) + (opt->recipient ? IMC_RECIPIENT_LOCATOR_BITS : 0);
+        if (bits < min_bits) min_bits = bits;
+    }
+
+    // The bound is an upper limit of the free space (even when appending), so the files that exceed it can never fit
+    if (min_bits != SIZE_MAX && min_bits > max_bits)
+    {
+        char size_needed[256], size_max[256];
+        __filesize_to_string(min_bits / 8, size_needed, sizeof(size_needed));
+        __filesize_to_string(max_bits / 8, size_max, sizeof(size_max));
+        argp_failure(state, EXIT_FAILURE, 0,
+            "no enough space in '%s' to hide any of the files (the image can hide %s%s, and the smallest file needs %s).",
+            basename(opt->input), exact ? "" : "at most ", size_max, size_needed
+        );
+    }
+}
+
+// Show how much data can be hidden on the image of the '--capacity' option (without a password)
+// This is a helper for the '__execute_options()' function.
+static void __capacity(struct argp_state *state, struct UserOptions *opt)
+{
+    size_t carrier_bits = 0;
+    enum CapacitySource source;
+    const int status = imc_steg_capacity(opt->capacity, &carrier_bits, &source);
+
+    switch (status)
+    {
+        case IMC_SUCCESS:
+            char size_str[256];
+            __filesize_to_string(carrier_bits / 8, size_str, sizeof(size_str));
+            const char *source_str = "the image was opened";
+            if (source == IMC_CAPACITY_HEADER) source_str = "read from the header";
+            else if (source == IMC_CAPACITY_SCAN) source_str = "counted without decoding the pixels";
+            printf(
+                "The image '%s' can hide approximately %s (%zu carrier bytes, %s).\n",
+                basename(opt->capacity), size_str, carrier_bits, source_str
+            );
+            break;
+        
+        case IMC_ERR_PATH_IS_DIR:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is a directory, instead of an image.", opt->capacity);
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "could not open '%s'. Reason: %s.", opt->capacity, strerror(errno));
+            break;
+        
+        case IMC_ERR_FILE_INVALID:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is not a valid JPEG, PNG, WebP, BMP, PNM or TIFF image.", opt->capacity);
+            break;
+        
+        case IMC_ERR_UNSUPPORTED:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is in an unsupported format (%s).", opt->capacity, imc_strerror(status));
+            break;
+        
+        case IMC_ERR_NO_CARRIER:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' has no space for hiding data.", opt->capacity);
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "could not read the image '%s'. Reason: %s.", opt->capacity, imc_strerror(status));
+            break;
+    }
+}
+
+// Save the image of the '--benchmark' option with each profile, then show how long it took and the size of the result
+// This is a helper for the '__execute_options()' function.
+static void __benchmark(struct argp_state *state, struct UserOptions *opt)
+{
+    const ProgressMonitor progress = {&__print_progress, NULL};
+    ProfileResult results[IMC_PROFILE_COUNT];
+    const int status = imc_steg_benchmark(opt->benchmark, IMC_BENCHMARK_ROUNDS, (opt->verbose && !opt->silent) ? &progress : NULL, results);
+
+    switch (status)
     {
-        printf("Input password for the hidden file (may be blank)\n");
+        case IMC_SUCCESS:
+            break;
+        
+        case IMC_ERR_PATH_IS_DIR:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is a directory, instead of an image.", opt->benchmark);
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "could not open '%s'. Reason: %s.", opt->benchmark, strerror(errno));
+            break;
+        
+        case IMC_ERR_FILE_INVALID:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is not a valid JPEG, PNG, WebP, BMP, PNM or TIFF image.", opt->benchmark);
+            break;
+        
+        case IMC_ERR_UNSUPPORTED:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is in an unsupported format (%s).", opt->benchmark, imc_strerror(status));
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "could not open the image '%s'. Reason: %s.", opt->benchmark, imc_strerror(status));
+            break;
+    }
 
-        if (mode == HIDE)
+    // Fastest of the rounds of each profile
+    printf("Saving '%s' (fastest of %d rounds):\n", basename(opt->benchmark), IMC_BENCHMARK_ROUNDS);
+    for (size_t i = 0; i < IMC_PROFILE_COUNT; i++)
+    {
+        const ProfileResult *const result = &results[i];
+        if (result->status != IMC_SUCCESS)
         {
-            opt->password = imc_cli_password_input(true);   // Input the password twice
+            printf("  %-8s  failed (%s)\n", imc_profile_name(result->profile), imc_strerror(result->status));
+            continue;
+        }
+
+        char size_str[256];
+        __filesize_to_string(result->size, size_str, sizeof(size_str));
+        printf(
+            "  %-8s  %8.3f seconds  %10s (%zu bytes)\n",
+            imc_profile_name(result->profile), result->seconds, size_str, result->size
+        );
+    }
+}
+
+// Distribute the files of the '--hide' option over the images on the index of the '--plan' option, then save the plan
+// This is a helper for the '__execute_options()' function.
+static void __plan(struct argp_state *state, struct UserOptions *opt)
+{
+    size_t hide_count = 0;
+    for (struct HideList *node = &opt->hide; node && node->data; node = node->next) hide_count++;
+    const char *hide_paths[hide_count + 1];
+    hide_count = 0;
+    for (struct HideList *node = &opt->hide; node && node->data; node = node->next) hide_paths[hide_count++] = node->data;
+
+    const ProgressMonitor progress = {&__print_progress, NULL};
+    Plan *plan = NULL;
+    const int status = imc_plan_build(opt->plan, hide_paths, hide_count, opt->threads, (opt->verbose && !opt->silent) ? &progress : NULL, &plan);
+
+    switch (status)
+    {
+        case IMC_SUCCESS:
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "could not open the index '%s'. Reason: %s.", opt->plan, strerror(errno));
+            break;
+        
+        case IMC_ERR_FILE_INVALID:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is not a valid index (create it again with '--index').", opt->plan);
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "unknown error when planning. (%d)", status);
+            break;
+    }
+
+    // Files left out of the plan
+    for (size_t i = 0; i < plan->file_count; i++)
+    {
+        const PlanFile *const file = &plan->file[i];
+
+        switch (file->status)
+        {
+            case IMC_SUCCESS:
+                if (file->cover == SIZE_MAX)
+                {
+                    fprintf(stderr, "FAIL: no image on '%s' has enough space for '%s'.\n", opt->plan, file->path);
+                }
+                break;
+            
+            case IMC_ERR_FILE_NOT_FOUND:
+                fprintf(stderr, "FAIL: file '%s' could not be opened. Reason: %s.\n", file->path, strerror(file->error));
+                break;
+            
+            case IMC_ERR_PATH_IS_DIR:
+                fprintf(stderr, "FAIL: '%s' is a directory, instead of a single file.\n", file->path);
+                break;
+            
+            case IMC_ERR_FILE_INVALID:
+                fprintf(stderr, "FAIL: the path of '%s' has a line break, which a plan cannot store.\n", file->path);
+                break;
+            
+            default:
+                fprintf(stderr, "FAIL: file '%s' could not be compressed. Reason: %s.\n", file->path, imc_strerror(file->status));
+                break;
+        }
+    }
+
+    const char *const plan_path = opt->output ? opt->output : IMC_PLAN_NAME;
+    const int save_status = imc_plan_save(plan, plan_path);
+
+    if (save_status != IMC_SUCCESS)
+    {
+        imc_plan_free(plan);
+        argp_failure(state, EXIT_FAILURE, 0, "could not save the plan to '%s'. Reason: %s.", plan_path, strerror(errno));
+    }
+
+    // How full the chosen images are
+    size_t planned_count = 0;
+    size_t used_bits = 0;
+    size_t capacity_bits = 0;
+    
+    for (size_t c = 0; c < plan->cover_count; c++)
+    {
+        const PlanCover *const cover = &plan->cover[c];
+        planned_count += cover->file_count;
+        used_bits += cover->used_bits;
+        capacity_bits += cover->capacity;
+
+        if (opt->verbose && !opt->silent)
+        {
+            char used_str[256], capacity_str[256];
+            __filesize_to_string(cover->used_bits / 8, used_str, sizeof(used_str));
+            __filesize_to_string(cover->capacity / 8, capacity_str, sizeof(capacity_str));
+            printf("'%s': %zu file(s), %s of %s.\n", cover->path, cover->file_count, used_str, capacity_str);
+        }
+    }
+
+    if (!opt->silent)
+    {
+        printf(
+            "SUCCESS: planned %zu of %zu file(s) on %zu image(s) (%.1f %% of their space is used), saved to '%s'.\n",
+            planned_count, plan->file_count, plan->cover_count,
+            capacity_bits ? ((double)used_bits / (double)capacity_bits) * 100.0 : 0.0, plan_path
+        );
+    }
+
+    imc_plan_free(plan);
+}
+
+// Hash the password once, then hide the files on the images of the plan of the '--run-plan' option
+// This is a helper for the '__execute_options()' function. The program exits with an error if any image failed.
+static void __run_plan(struct argp_state *state, struct UserOptions *opt)
+{
+    Plan *plan = NULL;
+    const int load_status = imc_plan_load(opt->run_plan, &plan);
+
+    switch (load_status)
+    {
+        case IMC_SUCCESS:
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "could not open the plan '%s'. Reason: %s.", opt->run_plan, strerror(errno));
+            break;
+        
+        case IMC_ERR_FILE_INVALID:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is not a valid plan (create it again with '--plan').", opt->run_plan);
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "unknown error when reading the plan. (%d)", load_status);
+            break;
+    }
+
+    CryptoContext *crypto = opt->key_file ? __load_key_file(state, opt->key_file) : __password_context(state, opt->password, opt);
+    imc_cli_password_free(opt->password);
+    opt->password = NULL;
+
+    const char *const out_dir = opt->output ? opt->output : ".";
+    const ProgressMonitor progress = {&__print_progress, NULL};
+    const size_t saved = imc_plan_run(
+        plan, crypto, out_dir, opt->cover_cache, opt->profile, opt->threads, (opt->verbose && !opt->silent) ? &progress : NULL
+    );
+    imc_crypto_context_destroy(crypto);
+
+    for (size_t c = 0; c < plan->cover_count; c++)
+    {
+        const PlanCover *const cover = &plan->cover[c];
+
+        if (cover->status == IMC_SUCCESS)
+        {
+            if (!opt->silent) printf("SUCCESS: hidden %zu file(s) on '%s' (saved to '%s').\n", cover->file_count, cover->path, cover->out_path);
+        }
+        else if (cover->status == IMC_ERR_FILE_CORRUPTED && cover->failed_file == SIZE_MAX)
+        {
+            fprintf(stderr, "FAIL: '%s' has changed since the index was built (nothing was hidden on it).\n", cover->path);
+        }
+        else if (cover->failed_file != SIZE_MAX)
+        {
+            fprintf(stderr, "FAIL: could not hide '%s' on '%s' (the image was not saved). Reason: %s.\n",
+                cover->files[cover->failed_file], cover->path, imc_strerror(cover->status)
+            );
+        }
+        else
+        {
+            fprintf(stderr, "FAIL: could not process '%s'. Reason: %s.\n", cover->path, imc_strerror(cover->status));
+        }
+    }
+
+    const size_t cover_count = plan->cover_count;
+    imc_plan_free(plan);
+
+    if (saved < cover_count)
+    {
+        argp_failure(state, EXIT_FAILURE, 0, "%zu of %zu image(s) could not be processed.", cover_count - saved, cover_count);
+    }
+    else if (!opt->silent)
+    {
+        printf("All %zu image(s) of the plan were saved to '%s'.\n", cover_count, out_dir);
+    }
+}
+
+// Split the file of the '--hide' option into shards over the images of the '--shard' option
+// This is a helper for the '__execute_options()' function.
+static void __shard(struct argp_state *state, struct UserOptions *opt)
+{
+    size_t count = 0;
+    for (struct HideList *node = &opt->shard; node && node->data; node = node->next) count++;
+    const char *paths[count];
+    count = 0;
+    for (struct HideList *node = &opt->shard; node && node->data; node = node->next) paths[count++] = node->data;
+
+    CryptoContext *crypto = opt->key_file ? __load_key_file(state, opt->key_file) : __password_context(state, opt->password, opt);
+    imc_cli_password_free(opt->password);
+    opt->password = NULL;
+
+    const char *const out_dir = opt->output ? opt->output : ".";
+    const ProgressMonitor progress = {&__print_progress, NULL};
+    ShardCover *covers = NULL;
+    const int status = imc_shard_hide(
+        opt->hide.data, paths, count, opt->parity, crypto, out_dir, opt->cover_cache, opt->profile, opt->threads,
+        (opt->verbose && !opt->silent) ? &progress : NULL, &covers
+    );
+    imc_crypto_context_destroy(crypto);
+
+    // The file itself could not be read
+    if (!covers)
+    {
+        switch (status)
+        {
+            case IMC_ERR_PATH_IS_DIR:
+                argp_failure(state, EXIT_FAILURE, 0, "'%s' is a directory, instead of a single file.", opt->hide.data);
+                break;
+            
+            case IMC_ERR_FILE_NOT_FOUND:
+                argp_failure(state, EXIT_FAILURE, 0, "file '%s' could not be opened. Reason: %s.", opt->hide.data, strerror(errno));
+                break;
+            
+            case IMC_ERR_INPUT_TOO_BIG:
+                argp_failure(state, EXIT_FAILURE, 0, "file '%s' is too big. Maximum size of the hidden file is 500 MB.", opt->hide.data);
+                break;
+            
+            default:
+                argp_failure(state, EXIT_FAILURE, 0, "could not read '%s'. Reason: %s.", opt->hide.data, imc_strerror(status));
+                break;
+        }
+    }
+
+    // With parity, the file fits on the smallest image times the amount of data shards
+    const size_t data_count = count - opt->parity;
+    size_t total_capacity = 0;
+    size_t min_capacity = SIZE_MAX;
+    for (size_t i = 0; i < count; i++)
+    {
+        const ShardCover *const cover = &covers[i];
+        total_capacity += cover->capacity;
+        if (cover->capacity < min_capacity) min_capacity = cover->capacity;
+
+        if (cover->out_path && i >= data_count)
+        {
+            if (!opt->silent) printf("SUCCESS: hidden parity shard %zu of %zu on '%s' (saved to '%s').\n", i - data_count + 1, opt->parity, cover->path, cover->out_path);
+        }
+        else if (cover->out_path)
+        {
+            if (!opt->silent) printf("SUCCESS: hidden shard %zu of %zu on '%s' (saved to '%s').\n", i + 1, data_count, cover->path, cover->out_path);
+        }
+        else if (cover->status != IMC_SUCCESS)
+        {
+            fprintf(stderr, "FAIL: could not process '%s'. Reason: %s.\n", cover->path, imc_strerror(cover->status));
+        }
+    }
+
+    imc_shard_free(covers, count);
+
+    if (status == IMC_ERR_FILE_TOO_BIG && opt->parity > 0)
+    {
+        char size_str[256];
+        __filesize_to_string(min_capacity * data_count, size_str, sizeof(size_str));
+        argp_failure(state, EXIT_FAILURE, 0, "no enough space on the %zu image(s) to split '%s' with %zu parity shard(s) (together they can hide %s).", count, opt->hide.data, opt->parity, size_str);
+    }
+    else if (status == IMC_ERR_FILE_TOO_BIG)
+    {
+        char size_str[256];
+        __filesize_to_string(total_capacity, size_str, sizeof(size_str));
+        argp_failure(state, EXIT_FAILURE, 0, "no enough space on the %zu image(s) to split '%s' (together they can hide %s).", count, opt->hide.data, size_str);
+    }
+    else if (status != IMC_SUCCESS)
+    {
+        argp_failure(state, EXIT_FAILURE, 0, "could not split '%s' over the images.", opt->hide.data);
+    }
+    else if (!opt->silent)
+    {
+        if (opt->parity > 0)
+        {
+            printf("The file '%s' was split into %zu shards and %zu parity shard(s), saved to '%s'.\n", opt->hide.data, data_count, opt->parity, out_dir);
+        }
+        else
+        {
+            printf("The file '%s' was split into %zu shards, saved to '%s'.\n", opt->hide.data, count, out_dir);
+        }
+    }
+}
+
+// Reassemble a file from the shards on the images of the '--join' option
+// This is a helper for the '__execute_options()' function.
+static void __join(struct argp_state *state, struct UserOptions *opt)
+{
+    size_t count = 0;
+    for (struct HideList *node = &opt->join; node && node->data; node = node->next) count++;
+    const char *paths[count];
+    count = 0;
+    for (struct HideList *node = &opt->join; node && node->data; node = node->next) paths[count++] = node->data;
+
+    CryptoContext *crypto = opt->key_file ? __load_key_file(state, opt->key_file) : __password_context(state, opt->password, opt);
+    imc_cli_password_free(opt->password);
+    opt->password = NULL;
+
+    const ProgressMonitor progress = {&__print_progress, NULL};
+    ShardCover *covers = NULL;
+    FileMetadata *info = NULL;
+    const int status = imc_shard_join(
+        paths, count, crypto, opt->output, opt->cover_cache, opt->threads,
+        (opt->verbose && !opt->silent) ? &progress : NULL, &covers, &info
+    );
+    const int error_number = errno;
+    imc_crypto_context_destroy(crypto);
+
+    // Count the shards that were read, and the data shards that had to be rebuilt from the parity shards
+    size_t read_count = 0;
+    size_t data_count = 0;
+    size_t data_read = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const ShardCover *const cover = &covers[i];
+        if (cover->status != IMC_SUCCESS) continue;
+        if (read_count++ == 0) data_count = le32toh(cover->header.count);
+        if (le32toh(cover->header.index) < data_count) data_read++;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const ShardCover *const cover = &covers[i];
+        
+        if (cover->status == IMC_ERR_INVALID_MAGIC)
+        {
+            fprintf(stderr, "FAIL: image '%s' contains no shard or the password is incorrect.\n", cover->path);
+        }
+        else if (cover->status != IMC_SUCCESS)
+        {
+            fprintf(stderr, "FAIL: could not read the shard of '%s'. Reason: %s.\n", cover->path, imc_strerror(cover->status));
+        }
+    }
+
+    imc_shard_free(covers, count);
+
+    switch (status)
+    {
+        case IMC_SUCCESS:
+            if (!opt->silent)
+            {
+                printf("SUCCESS: joined '%s' from %zu shard(s).\n", info->file_name, read_count);
+                if (data_read < data_count) printf("  rebuilt from parity: %zu missing shard(s)\n", data_count - data_read);
+                
+                char date_str[256];
+                __timespec_to_string(&info->steg_time, date_str, sizeof(date_str));
+                printf("  hidden on: %s\n", date_str);
+            }
+            imc_free(info);
+            break;
+        
+        case IMC_ERR_SHARD_MISSING:
+            argp_failure(state, EXIT_FAILURE, 0, "the images do not have enough distinct shards of the same file (all of its images are needed, or all but as many as its parity shards).");
+            break;
+        
+        case IMC_ERR_CRYPTO_FAIL:
+            argp_failure(state, EXIT_FAILURE, 0, "the shards could not be decrypted (they may have been modified).");
+            break;
+        
+        case IMC_ERR_SAVE_FAIL:
+            argp_failure(state, EXIT_FAILURE, 0, "could not save the joined file. Reason: %s.", strerror(error_number));
+            break;
+        
+        case IMC_ERR_FILE_EXISTS:
+            argp_failure(state, EXIT_FAILURE, 0, "could not save the joined file, because too many files with the same name exist.");
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "could not read the shards from the images.");
+            break;
+    }
+}
+
+// Exit with an error message if an image could not be initialized
+// This is a helper for the '__execute_options()' function.
+static void __init_error(struct argp_state *state, int status, const char *path, struct UserOptions *opt)
+{
+    switch (status)
+    {
+        case IMC_SUCCESS:
+            break;
+        
+        case IMC_ERR_PATH_IS_DIR:
+            argp_failure(state, EXIT_FAILURE, 0, "'%s' is a directory; instead of a JPEG, PNG, WebP, BMP, PNM or TIFF image.", path);
+            break;
+        
+        case IMC_ERR_FILE_NOT_FOUND:
+            argp_failure(state, EXIT_FAILURE, 0, "file '%s' could not be opened. Reason: %s.", path, strerror(errno));
+            break;
+        
+        case IMC_ERR_FILE_INVALID:
+            argp_failure(state, EXIT_FAILURE, 0, "file '%s' is not a valid JPEG, PNG, WebP, BMP, PNM or TIFF image.", path);
+            break;
+        
+        case IMC_ERR_UNSUPPORTED:
+            argp_failure(state, EXIT_FAILURE, 0,
+                "image '%s' uses a feature that is not supported (such as compression or a color palette).", path
+            );
+            break;
+        
+        case IMC_ERR_NO_CARRIER:
+            argp_failure(state, EXIT_FAILURE, 0,
+                "image '%s' has no suitable bits for hiding the data. This may happen if the image is fully transparent or just a flat color.",
+                path
+            );
+            break;
+        
+        case IMC_ERR_NO_MEMORY:
+            argp_failure(state, EXIT_FAILURE, 0, "no enough memory for reading '%s'.", path);
+            break;
+        
+        case IMC_ERR_PAYLOAD_OOB:
+            argp_failure(state, EXIT_FAILURE, 0, "image '%s' is too small to hide data to a public key.", path);
+            break;
+        
+        case IMC_ERR_CRYPTO_FAIL:
+            argp_failure(state, EXIT_FAILURE, 0, "file '%s' does not contain a valid public key.", opt->recipient);
+            break;
+        
+        default:
+            argp_failure(state, EXIT_FAILURE, 0, "unknown error when hashing the password. (%d)", status);
+            break;
+    }
+}
+
+// Hash a password into a new cryptographic context
+// This is a helper for the '__execute_options()' function. The program exits if the password could not be hashed.
+static struct CryptoContext *__password_context(struct argp_state *state, const PassBuff *password, struct UserOptions *opt)
+{
+    const bool verbose = opt->verbose && !opt->silent;
+    if (verbose)
+    {
+        if (password->length > 0) printf("Generating secret key... ");
+        else printf("Generating key... ");
+        fflush(stdout);
+    }
+
+    CryptoContext *crypto = NULL;
+    const int status = imc_crypto_context_create(password, &crypto);
+    if (verbose) printf( (status == IMC_SUCCESS) ? "Done!\n" : "\n" );
+    
+    if (status != IMC_SUCCESS)
+    {
+        argp_failure(state, EXIT_FAILURE, 0, "no enough memory for hashing the password.");
+    }
+
+    return crypto;
+}
+
+// Read the passwords on a file (one per line), and store on 'count' how many were read
+// This is a helper for the '__execute_options()' function. The program exits if the file cannot be read,
+// or if a line is longer than the maximum size of a password.
+// Each password should be freed with 'imc_cli_password_free()', then the array with 'imc_free()'.
+static PassBuff **__load_password_list(struct argp_state *state, const char *path, size_t *count)
+{
+    FILE *list_file = fopen(path, "rb");
+    if (!list_file)
+    {
+        argp_failure(state, EXIT_FAILURE, 0, "password list '%s' could not be opened. Reason: %s.", path, strerror(errno));
+    }
+
+    size_t capacity = 16;
+    size_t list_count = 0;
+    PassBuff **list = imc_malloc(capacity * sizeof(PassBuff *));
+    PassBuff *password = NULL;
+    int c;
+
+    // Copy the characters directly to the password buffers, so the passwords are not left on unprotected memory
+    while ((c = fgetc(list_file)) != EOF)
+    {
+        if (!password) password = __alloc_passbuff();
+        
+        if (c == '\n')
+        {
+            // Remove the carriage return of Windows line breaks
+            if (password->length > 0 && password->buffer[password->length - 1] == '\r') password->length--;
+            password->buffer[password->length] = '\0';
+            
+            if (list_count == capacity)
+            {
+                capacity *= 2;
+                list = imc_realloc(list, capacity * sizeof(PassBuff *));
+            }
+            list[list_count++] = password;
+            password = NULL;
+        }
+        else if (password->length < password->capacity - 1)
+        {
+            password->buffer[password->length++] = (uint8_t)c;
+        }
+        else
+        {
+            // The carriage return of a Windows line break may follow a password of the maximum size
+            if (c == '\r')
+            {
+                const int next = fgetc(list_file);
+                if (next == '\n' || next == EOF)
+                {
+                    if (next == '\n') ungetc(next, list_file);
+                    continue;
+                }
+            }
+
+            // A password that does not fit on the buffer would be tried shortened (so it would never match)
+            imc_cli_password_free(password);
+            for (size_t i = 0; i < list_count; i++) imc_cli_password_free(list[i]);
+            imc_free(list);
+            fclose(list_file);
+            argp_failure(
+                state, EXIT_FAILURE, 0, "line %zu of the password list '%s' is longer than %d bytes.",
+                list_count + 1, path, IMC_PASSWORD_MAX_BYTES - 1
+            );
+        }
+    }
+
+    // The last line might not end with a line break
+    if (password)
+    {
+        if (password->length > 0 && password->buffer[password->length - 1] == '\r') password->length--;
+        password->buffer[password->length] = '\0';
+        if (list_count == capacity) list = imc_realloc(list, (capacity + 1) * sizeof(PassBuff *));
+        list[list_count++] = password;
+    }
+    
+    fclose(list_file);
+
+    if (list_count == 0)
+    {
+        imc_free(list);
+        argp_failure(state, EXIT_FAILURE, 0, "password list '%s' is empty.", path);
+    }
+
+    *count = list_count;
+    return list;
+}
+
+// Validate the command line options, and perform the requested operation
+// This is a helper for the 'imc_cli_parse_options()' function.
+static inline void __execute_options(struct argp_state *state, void *options)
+{
+    UserOptions *opt = (UserOptions*)options;
+
+    // Check if the user has specified exactly one operation
+    int mode_count = (opt->hide.data && !opt->watch && !opt->plan && !opt->shard.data) + (bool)opt->extract + (bool)opt->check + (bool)opt->rekey
+        + (bool)opt->transplant + (bool)opt->remove + (bool)opt->export_key + (bool)opt->generate_keys + (bool)opt->serve
+        + (bool)opt->watch + (bool)opt->index + (bool)opt->plan + (bool)opt->run_plan + (bool)opt->capacity
+        + (bool)opt->shard.data + (bool)opt->join.data + (bool)opt->benchmark;
+
+    if (mode_count == 0)
+    {
+        argp_error(state, "you must specify either the 'hide', 'extract', 'check', 'rekey', 'transplant', 'remove', 'export-key', 'generate-keys', 'serve', 'watch', 'index', 'plan', 'run-plan', 'capacity', 'shard', 'join', or 'benchmark' option.");
+    }
+    else if (mode_count != 1)
+    {
+        argp_error(state, "you can specify only one among the 'hide', 'extract', 'check', 'rekey', 'transplant', 'remove', 'export-key', 'generate-keys', 'serve', 'watch', 'index', 'plan', 'run-plan', 'capacity', 'shard', 'join', or 'benchmark' options.");
+    }
+
+    // Mode of operation
+    enum {HIDE, EXTRACT, CHECK, REKEY_MODE, TRANSPLANT_MODE, REMOVE_MODE, EXPORT, KEYGEN, SERVE_MODE, WATCH_MODE, INDEX_MODE, PLAN_MODE, RUN_PLAN_MODE, CAPACITY_MODE, SHARD_MODE, JOIN_MODE, BENCHMARK_MODE} mode;
+
+    if (opt->watch)
+    {
+        mode = WATCH_MODE;
+    }
+    else if (opt->plan)
+    {
+        if (opt->hide.data)
+        {
+            mode = PLAN_MODE;
+        }
+        else
+        {
+            argp_error(state, "please use '--hide' to specify the files being distributed over the images.");
+        }
+    }
+    else if (opt->shard.data)
+    {
+        if (opt->hide.data && !opt->hide.next)
+        {
+            mode = SHARD_MODE;
+        }
+        else
+        {
+            argp_error(state, "please use '--hide' to specify the one file being split over the images.");
+        }
+    }
+    else if (opt->hide.data)
+    {
+        if (opt->input || opt->pick_from)
+        {
+            mode = HIDE;
+        }
+        else
+        {
+            argp_error(state, "please use '--input' (or '--pick-from') to specify the image where to hide the file.");
+        }
+    }
+    else if (opt->extract)
+    {
+        mode = EXTRACT;
+    }
+    else if (opt->check)
+    {
+        mode = CHECK;
+    }
+    else if (opt->rekey)
+    {
+        mode = REKEY_MODE;
+    }
+    else if (opt->transplant)
+    {
+        if (opt->transplant_dst)
+        {
+            mode = TRANSPLANT_MODE;
+        }
+        else
+        {
+            argp_error(state, "please use '--transplant SRC DST' to specify the image where to copy the hidden files.");
+        }
+    }
+    else if (opt->remove)
+    {
+        if (opt->input)
+        {
+            mode = REMOVE_MODE;
+        }
+        else
+        {
+            argp_error(state, "please use '--input' to specify the image where the file is hidden.");
+        }
+    }
+    else if (opt->export_key)
+    {
+        mode = EXPORT;
+    }
+    else if (opt->generate_keys)
+    {
+        mode = KEYGEN;
+    }
+    else if (opt->serve)
+    {
+        mode = SERVE_MODE;
+    }
+    else if (opt->index)
+    {
+        mode = INDEX_MODE;
+    }
+    else if (opt->run_plan)
+    {
+        mode = RUN_PLAN_MODE;
+    }
+    else if (opt->capacity)
+    {
+        mode = CAPACITY_MODE;
+    }
+    else if (opt->benchmark)
+    {
+        mode = BENCHMARK_MODE;
+    }
+    else if (opt->join.data)
+    {
+        mode = JOIN_MODE;
+    }
+    else
+    {
+        argp_error(state, "unknown operation.");
+    }
+
+    if ((mode != HIDE && mode != REMOVE_MODE) && opt->input)
+    {
+        argp_error(state, "the 'input' option is used only when hiding or removing a file.");
+    }
+
+    if (mode != HIDE && opt->pick_from)
+    {
+        argp_error(state, "the 'pick-from' option can only be used when hiding files.");
+    }
+
+    if (opt->pick_from && opt->input)
+    {
+        argp_error(state, "you can specify only one among the 'input' or 'pick-from' options.");
+    }
+
+    if (opt->pick_from && opt->append)
+    {
+        argp_error(state, "the 'append' option cannot be used with 'pick-from' (the chosen image is not known beforehand).");
+    }
+
+    if (!(mode == HIDE || (mode == WATCH_MODE && opt->hide.data)) && opt->append)
+    {
+        argp_error(state, "the 'append' option can only be used when hiding a file.");
+    }
+
+    if ( (mode == CHECK || mode == EXPORT || mode == KEYGEN || mode == SERVE_MODE || mode == CAPACITY_MODE || mode == BENCHMARK_MODE) && opt->output )
+    {
+        argp_error(state, "the 'output' option can only be used when hiding, extracting, removing, copying, or changing the password of files.");
+    }
+
+    if (mode != REKEY_MODE && opt->new_password)
+    {
+        argp_error(state, "the 'new-password' option can only be used with 'rekey'.");
+    }
+
+    if (mode != EXTRACT && opt->tar)
+    {
+        argp_error(state, "the 'tar' option can only be used when extracting files.");
+    }
+
+    if (mode == EXPORT && opt->key_file)
+    {
+        argp_error(state, "the 'key-file' option cannot be used when exporting a key.");
+    }
+
+    if ((mode == EXPORT || mode == KEYGEN || mode == CAPACITY_MODE || mode == BENCHMARK_MODE) && opt->threads)
+    {
+        argp_error(state, "the 'threads' option can only be used when extracting or checking files.");
+    }
+
+    // Only one way of generating the secrets can be used
+    const int secret_count = (bool)opt->password + (bool)opt->key_file + (bool)opt->recipient
+        + (bool)opt->secret_key + (bool)opt->password_list;
+    if (secret_count > 1)
+    {
+        argp_error(state,
+            "you can specify only one among the 'password', 'no-password', 'password-list', 'key-file', 'recipient', or 'secret-key' options."
+        );
+    }
+
+    if (mode == KEYGEN && secret_count > 0)
+    {
+        argp_error(state, "the 'generate-keys' option does not use a password or another key.");
+    }
+
+    if ((mode == INDEX_MODE || mode == PLAN_MODE || mode == CAPACITY_MODE || mode == BENCHMARK_MODE) && secret_count > 0)
+    {
+        argp_error(state, "the 'index', 'plan', 'capacity', and 'benchmark' options do not use a password or a key (the images are not opened with them).");
+    }
+
+    if (mode == CAPACITY_MODE && imc_is_stdio_path(opt->capacity))
+    {
+        argp_error(state, "the 'capacity' option cannot read the image from the standard input ('-').");
+    }
+
+    if (mode == BENCHMARK_MODE && imc_is_stdio_path(opt->benchmark))
+    {
+        argp_error(state, "the 'benchmark' option cannot read the image from the standard input ('-').");
+    }
+
+    if (opt->has_profile && !(mode == HIDE || mode == REKEY_MODE || mode == TRANSPLANT_MODE || mode == REMOVE_MODE
+        || (mode == WATCH_MODE && opt->hide.data) || mode == RUN_PLAN_MODE || mode == SHARD_MODE))
+    {
+        argp_error(state, "the 'profile' option can only be used when saving images (hiding, removing, copying, or changing the password of files).");
+    }
+
+    if ((mode == INDEX_MODE || mode == PLAN_MODE || mode == RUN_PLAN_MODE || opt->pick_from) && (
+        imc_is_stdio_path(opt->index) || imc_is_stdio_path(opt->pick_from) || imc_is_stdio_path(opt->plan) || imc_is_stdio_path(opt->run_plan)
+    ))
+    {
+        argp_error(state, "the 'index', 'pick-from', 'plan', and 'run-plan' options cannot be used with the standard input or output ('-').");
+    }
+
+    if ((mode == INDEX_MODE || mode == PLAN_MODE || mode == RUN_PLAN_MODE) && imc_is_stdio_path(opt->output))
+    {
+        argp_error(state, "the 'index', 'plan', and 'run-plan' options cannot save their results to the standard output ('-').");
+    }
+
+    if (mode == PLAN_MODE)
+    {
+        for (struct HideList *node = &opt->hide; node && node->data; node = node->next)
+        {
+            if (imc_is_stdio_path(node->data))
+            {
+                argp_error(state, "the 'plan' option cannot distribute the standard input ('-'), because the plan stores the path of each file.");
+            }
+        }
+    }
+
+    if (mode != SHARD_MODE && opt->parity)
+    {
+        argp_error(state, "the 'parity' option can only be used when splitting a file with 'shard'.");
+    }
+
+    if (mode == SHARD_MODE && opt->parity)
+    {
+        size_t shard_count = 0;
+        for (struct HideList *node = &opt->shard; node && node->data; node = node->next) shard_count++;
+
+        if (opt->parity >= shard_count)
+        {
+            argp_error(state, "the amount of parity shards must be less than the amount of images of the 'shard' option.");
+        }
+
+        if (shard_count > IMC_ERASURE_MAX_SHARDS)
+        {
+            argp_error(state, "a file can be split with parity over up to %d images.", IMC_ERASURE_MAX_SHARDS);
+        }
+    }
+
+    if ((mode == SHARD_MODE || mode == JOIN_MODE) && (imc_is_stdio_path(opt->output) || __has_stdio_path(&opt->shard) || __has_stdio_path(&opt->join)))
+    {
+        argp_error(state, "the 'shard' and 'join' options cannot be used with the standard input or output ('-') for the images.");
+    }
+
+    if ((mode == RUN_PLAN_MODE || mode == SHARD_MODE || mode == JOIN_MODE) && opt->output)
+    {
+        struct stat output_stat;
+        if (stat(opt->output, &output_stat) != 0 || !S_ISDIR(output_stat.st_mode))
+        {
+            argp_error(state, "the output folder '%s' does not exist.", opt->output);
+        }
+    }
+
+    if (mode == PLAN_MODE && opt->cover_cache)
+    {
+        argp_error(state, "the 'cover-cache' option cannot be used with 'plan' (the images are not opened when planning).");
+    }
+
+    if ((mode == EXPORT || mode == KEYGEN || mode == SERVE_MODE || mode == WATCH_MODE || mode == CAPACITY_MODE || mode == BENCHMARK_MODE) && opt->cover_cache)
+    {
+        argp_error(state, "the 'cover-cache' option cannot be used with 'export-key', 'generate-keys', 'serve', 'watch', 'capacity', or 'benchmark'.");
+    }
+
+    if (opt->cover_cache)
+    {
+        struct stat cache_stat;
+        if (stat(opt->cover_cache, &cache_stat) != 0 || !S_ISDIR(cache_stat.st_mode))
+        {
+            argp_error(state, "the cover cache folder '%s' does not exist.", opt->cover_cache);
+        }
+    }
+
+    if (mode == SERVE_MODE && secret_count > 0)
+    {
+        argp_error(state, "the 'serve' option does not use a password or a key (each request carries its own password).");
+    }
+
+    if (mode != HIDE && opt->recipient)
+    {
+        argp_error(state, "the 'recipient' option can only be used when hiding a file (use 'secret-key' for extracting it).");
+    }
+
+    if (opt->recipient && opt->append)
+    {
+        argp_error(state, "the 'append' option cannot be used with 'recipient', because the existing hidden files can only be read with the secret key.");
+    }
+
+    if ((mode != EXTRACT && mode != CHECK) && opt->password_list)
+    {
+        argp_error(state, "the 'password-list' option can only be used when extracting or checking files.");
+    }
+
+    if ((mode != EXTRACT && mode != CHECK) && opt->secret_key)
+    {
+        argp_error(state, "the 'secret-key' option can only be used when extracting or checking files (use 'recipient' for hiding them).");
+    }
+
+    if (mode == WATCH_MODE)
+    {
+        bool has_stdio = imc_is_stdio_path(opt->watch) || imc_is_stdio_path(opt->output);
+        for (struct HideList *node = &opt->hide; node && node->data; node = node->next)
+        {
+            has_stdio |= imc_is_stdio_path(node->data);
+        }
+
+        if (has_stdio)
+        {
+            argp_error(state, "the 'watch' option cannot be used with the standard input or output ('-').");
+        }
+
+        // The results cannot go to the watched folder, otherwise they would be processed again
+        struct stat watch_stat, output_stat;
+        if ( stat(opt->watch, &watch_stat) == 0 && stat(opt->output ? opt->output : ".", &output_stat) == 0 &&
+             watch_stat.st_dev == output_stat.st_dev && watch_stat.st_ino == output_stat.st_ino )
+        {
+            argp_error(state, "the 'output' folder must be different from the watched folder (use '--output' to choose another folder).");
+        }
+    }
+
+    // Amount of files read from the standard input (their path is "-")
+    size_t stdin_count = imc_is_stdio_path(opt->input) + imc_is_stdio_path(opt->extract) + imc_is_stdio_path(opt->check)
+        + imc_is_stdio_path(opt->rekey) + imc_is_stdio_path(opt->transplant) + imc_is_stdio_path(opt->transplant_dst);
+    for (struct HideList *node = &opt->hide; node && node->data; node = node->next)
+    {
+        stdin_count += imc_is_stdio_path(node->data);
+    }
+
+    if (stdin_count > 1)
+    {
+        argp_error(state, "only one file can be read from the standard input ('-').");
+    }
+
+    // Path where the modified image is saved (if it is "-", the image goes to the standard output)
+    const char *image_out = NULL;
+    if (mode == HIDE || mode == REMOVE_MODE) image_out = opt->output ? opt->output : opt->input;
+    else if (mode == REKEY_MODE) image_out = opt->output ? opt->output : opt->rekey;
+    else if (mode == TRANSPLANT_MODE) image_out = opt->output ? opt->output : opt->transplant_dst;
+
+    // Whether the modified image or the extracted files are written to the standard output
+    const bool stdout_data = imc_is_stdio_path(image_out) || (
+        mode == EXTRACT && (imc_is_stdio_path(opt->output) || (opt->tar && !opt->output))
+    );
+
+    if ((stdin_count > 0 || stdout_data) && secret_count == 0)
+    {
+        argp_error(state,
+            "when reading from the standard input or writing to the standard output, the password must be given "
+            "with the 'password' or 'no-password' options (or with a key option)."
+        );
+    }
+
+    // No status messages are printed when the standard output carries data
+    if (stdout_data)
+    {
+        opt->silent = true;
+        opt->verbose = false;
+    }
+
+    // Generate a key pair for the recipient mode
+    if (mode == KEYGEN)
+    {
+        __generate_keys(state, opt);
+        return;
+    }
+
+    // Serve requests until the program is stopped
+    if (mode == SERVE_MODE)
+    {
+        __serve(state, opt);
+        return;
+    }
+
+    // Save the capacities of the images on a folder to an index
+    if (mode == INDEX_MODE)
+    {
+        __index(state, opt);
+        return;
+    }
+
+    // Distribute the files over the images of an index
+    if (mode == PLAN_MODE)
+    {
+        __plan(state, opt);
+        return;
+    }
+
+    // Show how much data an image can hide
+    if (mode == CAPACITY_MODE)
+    {
+        __capacity(state, opt);
+        return;
+    }
+
+    // Measure the time and size of saving an image with each profile
+    if (mode == BENCHMARK_MODE)
+    {
+        __benchmark(state, opt);
+        return;
+    }
+
+    // Compress the files to be hidden, then choose the cover image where they fit, or check whether they can fit
+    // on the given image (this is done before the password is asked, and before the image is decoded)
+    size_t hide_count = 0;
+    for (struct HideList *node = &opt->hide; node && node->data; node = node->next) hide_count++;
+    PreparedFile *prepared[hide_count + 1];
+    int prepared_status[hide_count + 1];
+    int prepared_error[hide_count + 1];
+    IndexEntry picked = {0};
+    
+    if (mode == HIDE)
+    {
+        const size_t carrier_bits = __prepare_files(opt, prepared, prepared_status, prepared_error);
+        if (opt->pick_from) __pick_cover(state, opt, carrier_bits, &picked);
+        else __check_fit(state, opt, prepared, prepared_status);
+    }
+
+    // Display a password prompt, if a password wasn't provided
+    // (and the user did not specify the '--no-password' option or one of the key options)
+    if (secret_count == 0)
+    {
+        if (mode == REKEY_MODE) printf("Input the current password of the hidden files (may be blank)\n");
+        else printf("Input password for the hidden file (may be blank)\n");
+
+        if (mode == HIDE || mode == EXPORT || mode == RUN_PLAN_MODE || mode == SHARD_MODE || (mode == WATCH_MODE && opt->hide.data))
+        {
+            opt->password = imc_cli_password_input(true);   // Input the password twice
+
+            if (!opt->password)
+            {
+                // Exit the program if the user failed to confirm the password
+                argp_failure(state, EXIT_FAILURE, 0, "passwords do not match.");
+            }
+        }
+        else // (mode == EXTRACT) || (mode == CHECK) || (mode == REKEY_MODE) || (mode == TRANSPLANT_MODE) || (mode == REMOVE_MODE)
+        {
+            opt->password = imc_cli_password_input(false);  // Input the passowrd once
+        }
+    }
+
+    // Prompt for the new password, if changing it and it wasn't provided
+    if (mode == REKEY_MODE && !opt->new_password)
+    {
+        printf("Input the new password for the hidden files (may be blank)\n");
+        opt->new_password = imc_cli_password_input(true);
+
+        if (!opt->new_password)
+        {
+            argp_failure(state, EXIT_FAILURE, 0, "passwords do not match.");
+        }
+    }
+
+    // Hash the password and save the result to a key file
+    if (mode == EXPORT)
+    {
+        __export_key(state, opt);
+        return;
+    }
+
+    // Process the new images on a folder until the program is stopped
+    if (mode == WATCH_MODE)
+    {
+        __watch(state, opt);
+        return;
+    }
+
+    // Hide the files on the images of a plan
+    if (mode == RUN_PLAN_MODE)
+    {
+        __run_plan(state, opt);
+        return;
+    }
+
+    // Split a file over many images, or join it back
+    if (mode == SHARD_MODE)
+    {
+        __shard(state, opt);
+        return;
+    }
 
-            if (!opt->password)
-            {
-                // Exit the program if the user failed to confirm the password
-                argp_failure(state, EXIT_FAILURE, 0, "passwords do not match.");
-            }
-        }
-        else // (mode == EXTRACT) || (mode == CHECK)
-        {
-            opt->password = imc_cli_password_input(false);  // Input the passowrd once
-        }
+    if (mode == JOIN_MODE)
+    {
+        __join(state, opt);
+        return;
     }
 
     CarrierImage *steg_image = NULL;    // Info about the image with steganographic data
@@ -493,6 +2171,7 @@ static inline void __execute_options(struct argp_state *state, void *options)
     switch (mode)
     {
         case HIDE:
+        case REMOVE_MODE:
             steg_path = opt->input;
             break;
         case EXTRACT:
@@ -501,42 +2180,123 @@ static inline void __execute_options(struct argp_state *state, void *options)
         case CHECK:
             steg_path = opt->check;
             break;
+        case REKEY_MODE:
+            steg_path = opt->rekey;
+            break;
+        case TRANSPLANT_MODE:
+            steg_path = opt->transplant;
+            break;
+        case EXPORT:
+        case KEYGEN:
+        case SERVE_MODE:
+        case WATCH_MODE:
+        case INDEX_MODE:
+        case PLAN_MODE:
+        case RUN_PLAN_MODE:
+        case CAPACITY_MODE:
+        case BENCHMARK_MODE:
+        case SHARD_MODE:
+        case JOIN_MODE:
+            break;
     }
     
     // Store the '--verbose' and '--check' flags
-    uint64_t flags = 0;
-    if (opt->check) flags |= IMC_JUST_CHECK;
-    if (opt->verbose && !opt->silent) flags |= IMC_VERBOSE;
+    // (the progress messages of the library are printed to the standard output)
+    StegOptions steg_options = {.progress = {&__print_progress, NULL}};
+    if (opt->check) steg_options.flags |= IMC_JUST_CHECK;
+    if (opt->verbose && !opt->silent) steg_options.flags |= IMC_VERBOSE;
+    steg_options.cache_dir = opt->cover_cache;
+    steg_options.profile = opt->profile;
+
+    // Old and new secrets (when changing the password)
+    CryptoContext *old_crypto = NULL;
+    CryptoContext *new_crypto = NULL;
+
+    // Secrets of both images (when copying the hidden data)
+    CryptoContext *shared_crypto = NULL;
 
     // Initialize the steganography data structure
     // (generate a secret key and seed the pseudo-random number generator)
-    steg_status = imc_steg_init(steg_path, opt->password, &steg_image, flags);
-    imc_cli_password_free( ((UserOptions*)(state->hook))->password );
-
-    switch (steg_status)
+    if (mode == REKEY_MODE)
     {
-        case IMC_SUCCESS:
-            break;
-        
-        case IMC_ERR_PATH_IS_DIR:
-            argp_failure(state, EXIT_FAILURE, 0, "'%s' is a directory; instead of a JPEG, PNG or WebP image.", steg_path);
-            break;
+        // The image is opened without secrets, because its carrier is going to be shuffled with both the old and new ones
+        old_crypto = opt->key_file ? __load_key_file(state, opt->key_file) : __password_context(state, opt->password, opt);
+        new_crypto = __password_context(state, opt->new_password, opt);
+        imc_cli_password_free(opt->new_password);
+        opt->new_password = NULL;
         
-        case IMC_ERR_FILE_NOT_FOUND:
-            argp_failure(state, EXIT_FAILURE, 0, "file '%s' could not be opened. Reason: %s.", steg_path, strerror(errno));
-            break;
-        
-        case IMC_ERR_FILE_INVALID:
-            argp_failure(state, EXIT_FAILURE, 0, "file '%s' is not a valid JPEG, PNG or WebP image.", steg_path);
-            break;
-        
-        case IMC_ERR_NO_MEMORY:
-            argp_failure(state, EXIT_FAILURE, 0, "no enough memory for hashing the password.");
-            break;
+        steg_status = imc_steg_open(steg_path, &steg_image, &steg_options);
+    }
+    else if (mode == TRANSPLANT_MODE)
+    {
+        // The secrets are kept for initializing the destination image too (so the password is hashed only once)
+        shared_crypto = opt->key_file ? __load_key_file(state, opt->key_file) : __password_context(state, opt->password, opt);
+        steg_status = imc_steg_init_context(steg_path, shared_crypto, &steg_image, &steg_options);
+    }
+    else if (opt->key_file)
+    {
+        // Secret key and seed stored on a key file
+        CryptoContext *crypto = __load_key_file(state, opt->key_file);
+        steg_status = imc_steg_init_context(steg_path, crypto, &steg_image, &steg_options);
+        imc_crypto_context_destroy(crypto);
+    }
+    else if (opt->recipient)
+    {
+        // Hide the data to the owner of a public key (an ephemeral key pair is generated)
+        uint8_t *public_key = __load_recipient_key(state, opt->recipient, false);
+        steg_status = imc_steg_init_recipient(steg_path, public_key, &steg_image, &steg_options);
+        sodium_free(public_key);
+    }
+    else if (opt->secret_key)
+    {
+        // Extract the data that was hidden to a public key
+        uint8_t *secret_key = __load_recipient_key(state, opt->secret_key, true);
+        steg_status = imc_steg_init_secret_key(steg_path, secret_key, &steg_image, &steg_options);
+        sodium_free(secret_key);
+    }
+    else if (opt->password_list)
+    {
+        // Read the image once, then try each password on it
+        size_t password_count = 0;
+        PassBuff **passwords = __load_password_list(state, opt->password_list, &password_count);
+        steg_status = imc_steg_open(steg_path, &steg_image, &steg_options);
+
+        if (steg_status == IMC_SUCCESS)
+        {
+            size_t match = 0;
+            const int try_status = imc_steg_try_passwords(
+                steg_image, (const PassBuff *const *)passwords, password_count, opt->threads, &match
+            );
+
+            if (try_status != IMC_SUCCESS)
+            {
+                argp_failure(state, EXIT_FAILURE, 0,
+                    "FAIL: none of the passwords on '%s' could decrypt hidden data on '%s'.", opt->password_list, steg_path
+                );
+            }
+            else if (!opt->silent)
+            {
+                printf("The password on line %zu of '%s' was used.\n", match + 1, opt->password_list);
+            }
+        }
         
-        default:
-            argp_failure(state, EXIT_FAILURE, 0, "unknown error when hashing the password. (%d)", steg_status);
-            break;
+        for (size_t i = 0; i < password_count; i++) imc_cli_password_free(passwords[i]);
+        imc_free(passwords);
+    }
+    else
+    {
+        steg_status = imc_steg_init(steg_path, opt->password, &steg_image, &steg_options);
+    }
+    imc_cli_password_free( ((UserOptions*)(state->hook))->password );
+    ((UserOptions*)(state->hook))->password = NULL;
+
+    __init_error(state, steg_status, steg_path, opt);
+
+    // The chosen image must still be the one whose capacity was indexed
+    if (opt->pick_from && !imc_index_matches(steg_image, &picked))
+    {
+        imc_steg_finish(steg_image);
+        argp_failure(state, EXIT_FAILURE, 0, "'%s' has changed since the index was built (run '--index' again).", steg_path);
     }
 
     // Whether a file has been successfully been hidden on the input image
@@ -563,9 +2323,13 @@ static inline void __execute_options(struct argp_state *state, void *options)
         
         // Hide the files on the image
         struct HideList *node = &opt->hide;
+        size_t hide_index = 0;
         while (node)
         {
-            int hide_status = imc_steg_insert(steg_image, node->data);
+            // The files were already compressed before the image was opened
+            int hide_status = prepared_status[hide_index];
+            if (hide_status == IMC_SUCCESS) hide_status = imc_steg_insert_prepared(steg_image, prepared[hide_index]);
+            else errno = prepared_error[hide_index];
 
             // Error handling and status messages
             switch (hide_status)
@@ -591,6 +2355,10 @@ static inline void __execute_options(struct argp_state *state, void *options)
                     fprintf(stderr, "FAIL: file '%s' is corrupted or might have changed while being hidden.\n", basename(node->data));
                     break;
                 
+                case IMC_ERR_INPUT_TOO_BIG:
+                    fprintf(stderr, "FAIL: file '%s' is too big. Maximum size of the hidden file is 500 MB.\n", basename(node->data));
+                    break;
+                
                 case IMC_ERR_NO_MEMORY:
                     fprintf(stderr, "FAIL: no enough memory for handling file '%s'.\n", basename(node->data));
                     break;
@@ -615,26 +2383,149 @@ static inline void __execute_options(struct argp_state *state, void *options)
 
             // Move to the next file to be hidden
             node = node->next;
+            hide_index++;
+        }
+
+        for (size_t i = 0; i < hide_count; i++)
+        {
+            if (prepared_status[i] == IMC_SUCCESS) imc_steg_prepared_free(prepared[i]);
+        }
+    }
+    else if (mode == REKEY_MODE)
+    {
+        // Decrypt the hidden files with the old secrets, and encrypt them again with the new ones
+        size_t file_count = 0;
+        const int rekey_status = imc_steg_rekey(steg_image, old_crypto, new_crypto, &file_count);
+        imc_crypto_context_destroy(old_crypto);
+        imc_crypto_context_destroy(new_crypto);
+        const char const* image_name = basename(steg_path);
+
+        switch (rekey_status)
+        {
+            case IMC_SUCCESS:
+                if (!opt->silent) printf("SUCCESS: changed the password of %zu hidden file(s) on '%s'.\n", file_count, image_name);
+                image_has_changed = true;
+                break;
+            
+            case IMC_ERR_INVALID_MAGIC:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: image '%s' contains no hidden data or the password is incorrect.", image_name);
+                break;
+            
+            case IMC_ERR_PAYLOAD_OOB:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: image '%s' is too small to contain hidden data.", image_name);
+                break;
+            
+            case IMC_ERR_NEWER_VERSION:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: a newer version of %s was used to hide the data on '%s'.", state->name, image_name);
+                break;
+            
+            case IMC_ERR_CRYPTO_FAIL:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: could not decrypt the data on '%s' (the image was not changed).", image_name);
+                break;
+            
+            default:
+                argp_failure(state, EXIT_FAILURE, 0, "unknown error when changing the password. (%d)", rekey_status);
+                break;
+        }
+    }
+    else if (mode == REMOVE_MODE)
+    {
+        // Remove the hidden file, then move back the hidden files that came after it
+        const int remove_status = imc_steg_remove(steg_image, opt->remove);
+        const char const* image_name = basename(steg_path);
+
+        switch (remove_status)
+        {
+            case IMC_SUCCESS:
+                if (!opt->silent) printf("SUCCESS: removed '%s' from '%s'.\n", opt->remove, image_name);
+                image_has_changed = true;
+                break;
+            
+            case IMC_ERR_FILE_NOT_FOUND:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: no file named '%s' is hidden on '%s'.", opt->remove, image_name);
+                break;
+            
+            case IMC_ERR_INVALID_MAGIC:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: image '%s' contains no hidden data or the password is incorrect.", image_name);
+                break;
+            
+            case IMC_ERR_PAYLOAD_OOB:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: image '%s' is too small to contain hidden data.", image_name);
+                break;
+            
+            case IMC_ERR_NEWER_VERSION:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: a newer version of %s was used to hide the data on '%s'.", state->name, image_name);
+                break;
+            
+            case IMC_ERR_CRYPTO_FAIL:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: could not decrypt the data on '%s' (the image was not changed).", image_name);
+                break;
+            
+            case IMC_ERR_NO_MEMORY:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: no enough memory for reading the data on '%s'.", image_name);
+                break;
+            
+            default:
+                argp_failure(state, EXIT_FAILURE, 0, "unknown error when removing hidden data. (%d)", remove_status);
+                break;
+        }
+    }
+    else if (mode == TRANSPLANT_MODE)
+    {
+        // Open the destination image with the same secrets as the source image
+        CarrierImage *dst_image = NULL;
+        const int dst_status = imc_steg_init_context(opt->transplant_dst, shared_crypto, &dst_image, &steg_options);
+        imc_crypto_context_destroy(shared_crypto);
+        __init_error(state, dst_status, opt->transplant_dst, opt);
+
+        // Copy the encrypted hidden files
+        size_t file_count = 0;
+        const int transplant_status = imc_steg_transplant(steg_image, dst_image, &file_count);
+        const char const* src_name = basename(steg_path);
+        const char const* dst_name = basename(opt->transplant_dst);
+
+        switch (transplant_status)
+        {
+            case IMC_SUCCESS:
+                if (!opt->silent) printf("SUCCESS: copied %zu hidden file(s) from '%s' to '%s'.\n", file_count, src_name, dst_name);
+                image_has_changed = true;
+                break;
+            
+            case IMC_ERR_INVALID_MAGIC:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: image '%s' contains no hidden data or the password is incorrect.", src_name);
+                break;
+            
+            case IMC_ERR_PAYLOAD_OOB:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: image '%s' is too small to contain hidden data.", src_name);
+                break;
+            
+            case IMC_ERR_NEWER_VERSION:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: a newer version of %s was used to hide the data on '%s'.", state->name, src_name);
+                break;
+            
+            case IMC_ERR_FILE_TOO_BIG:
+                argp_failure(state, EXIT_FAILURE, 0, "FAIL: image '%s' is too small to hold the data hidden on '%s'.", dst_name, src_name);
+                break;
+            
+            default:
+                argp_failure(state, EXIT_FAILURE, 0, "unknown error when copying hidden data. (%d)", transplant_status);
+                break;
         }
+
+        // From now on, the destination is the image being saved
+        imc_steg_finish(steg_image);
+        steg_image = dst_image;
+        steg_path = opt->transplant_dst;
     }
     else // (mode == EXTRACT) || (mode == CHECK)
     {
         bool has_file = false;  // Whether the image contains a hidden file
-        
-        // Variables used in case the hidden files are being extracted to another folder
-        char *cwd_start = NULL;         // The current working directory at the beginning of extraction
-        bool outdir_existed = false;    // If the output directory already exists
+        bool outdir_existed = false;    // If the output directory already exists (in case the files are being extracted to another folder)
+        const bool to_stream = (mode == EXTRACT) && (opt->tar || imc_is_stdio_path(opt->output)); // Extract to a single stream instead of a folder
 
         // Create the output folder, if one was specified for the extracted files
-        if (mode == EXTRACT && opt->output)
+        if (mode == EXTRACT && opt->output && !to_stream)
         {
-            // Remember the current working directory
-            #ifdef _WIN32
-            cwd_start = _getcwd(NULL, 0);  // Note: this function is allocating memory
-            #else // Linux
-            cwd_start = getcwd(NULL, 0);   // Note: this function is allocating memory
-            #endif
-
             // Create the output folder
             #ifdef _WIN32
             const int mk_status = _mkdir(opt->output);
@@ -659,35 +2550,62 @@ static inline void __execute_options(struct argp_state *state, void *options)
                     );
                 }
             }
-
-            // Change the current working directory to the output folder
-            #ifdef _WIN32
-            const int ch_status = _chdir(opt->output);
-            #else // Linux
-            const int ch_status = chdir(opt->output);
-            #endif
-
-            if (ch_status != 0)
+        }
+        
+        // Save or just check the files hidden on the image
+        // (the hidden files are processed in parallel, then their status messages are printed in the order they were hidden)
+        ExtractResult *results = NULL;
+        size_t result_count = 0;
+        int end_status;
+        
+        if (to_stream)
+        {
+            // Write the hidden files to the standard output, or to a new file (when extracting as a tar archive)
+            FILE *out_stream = stdout;
+            if (opt->output && !imc_is_stdio_path(opt->output))
             {
-                argp_failure(
-                    state, EXIT_FAILURE, 0,
-                    "Could not extract the hidden files to the directory '%s'. Reason: %s.",
-                    opt->output, strerror(errno)
-                );
+                out_stream = fopen(opt->output, "wbx");
+                if (!out_stream)
+                {
+                    argp_failure(state, EXIT_FAILURE, 0, "could not save '%s'. Reason: %s.", opt->output, strerror(errno));
+                }
             }
+            
+            end_status = imc_steg_extract_stream(steg_image, out_stream, opt->tar, &results, &result_count);
+            if (out_stream != stdout) fclose(out_stream);
+        }
+        else
+        {
+            const char *const out_dir = (mode == EXTRACT) ? opt->output : NULL;
+            end_status = imc_steg_extract_all(steg_image, out_dir, opt->threads, &results, &result_count);
         }
         
-        // Save or just check the files hidden on the image
-        int unhide_status = IMC_SUCCESS;
-        while (unhide_status == IMC_SUCCESS)
+        const char const* image_name = basename(steg_path); // Name of the image with hidden data
+
+        if (end_status == IMC_ERR_SAVE_FAIL && to_stream)
+        {
+            argp_failure(state, EXIT_FAILURE, 0, "Could not write the extracted files. Reason: %s.", strerror(errno));
+        }
+        else if (end_status == IMC_ERR_SAVE_FAIL)
         {
-            unhide_status = imc_steg_extract(steg_image);
-            const char const* image_name = basename(steg_path); // Name of the image with hidden data
-            const char const* unhid_name = steg_image->steg_info->file_name; // Name of the unhidden file
+            argp_failure(
+                state, EXIT_FAILURE, 0,
+                "Could not extract the hidden files to the directory '%s'. Reason: %s.",
+                opt->output, strerror(errno)
+            );
+        }
+        
+        for (size_t i = 0; i <= result_count; i++)
+        {
+            // After the status of all hidden files, handle the reason why there are no more files
+            const bool is_end = (i == result_count);
+            const int unhide_status = is_end ? end_status : results[i].status;
+            FileMetadata *const steg_info = is_end ? NULL : results[i].info;
+            const char const* unhid_name = steg_info ? steg_info->file_name : ""; // Name of the unhidden file
 
             // Error handling and status messages
-            // Note: after all hidden files have been extracted, the function
-            //       will return IMC_ERR_INVALID_MAGIC or IMC_ERR_PAYLOAD_OOB
+            // Note: after all hidden files have been extracted, the last status
+            //       will be IMC_ERR_INVALID_MAGIC or IMC_ERR_PAYLOAD_OOB
             switch (unhide_status)
             {
                 case IMC_SUCCESS:
@@ -696,20 +2614,20 @@ static inline void __execute_options(struct argp_state *state, void *options)
                         if (has_file) printf("\n");
                         else if (opt->verbose) printf("\n");
                         
-                        printf("Found file '%s':\n", steg_image->steg_info->file_name);
+                        printf("Found file '%s':\n", steg_info->file_name);
                         
                         char str_buffer[256];   // Buffer for the formatted strings
 
-                        __timespec_to_string(&steg_image->steg_info->steg_time, str_buffer, sizeof(str_buffer));
+                        __timespec_to_string(&steg_info->steg_time, str_buffer, sizeof(str_buffer));
                         printf("  hidden on:     %s\n", str_buffer);
 
-                        __timespec_to_string(&steg_image->steg_info->access_time, str_buffer, sizeof(str_buffer));
+                        __timespec_to_string(&steg_info->access_time, str_buffer, sizeof(str_buffer));
                         printf("  last access:   %s\n", str_buffer);
 
-                        __timespec_to_string(&steg_image->steg_info->mod_time, str_buffer, sizeof(str_buffer));
+                        __timespec_to_string(&steg_info->mod_time, str_buffer, sizeof(str_buffer));
                         printf("  last modified: %s\n", str_buffer);
                         
-                        __filesize_to_string(steg_image->steg_info->file_size, str_buffer, sizeof(str_buffer));
+                        __filesize_to_string(steg_info->file_size, str_buffer, sizeof(str_buffer));
                         printf("  size: %s\n", str_buffer);
                     }
                     else // (mode == EXTRACT)
@@ -720,7 +2638,7 @@ static inline void __execute_options(struct argp_state *state, void *options)
                             
                             // The date in which the extracted file was hidden on
                             char date_str[256];
-                            __timespec_to_string(&steg_image->steg_info->steg_time, date_str, sizeof(date_str));
+                            __timespec_to_string(&steg_info->steg_time, date_str, sizeof(date_str));
                             printf("  hidden on: %s\n", date_str);
                         }
                     }
@@ -770,7 +2688,7 @@ static inline void __execute_options(struct argp_state *state, void *options)
                     break;
                 
                 case IMC_ERR_SAVE_FAIL:
-                    fprintf(stderr, "FAIL: could not save '%s'. Reason: %s.\n", unhid_name, strerror(errno));
+                    fprintf(stderr, "FAIL: could not save '%s'. Reason: %s.\n", unhid_name, strerror(results[i].error_number));
                     break;
                 
                 default:
@@ -779,26 +2697,16 @@ static inline void __execute_options(struct argp_state *state, void *options)
             }
         }
 
-        if (mode == EXTRACT && opt->output)
+        imc_steg_results_free(results, result_count);
+
+        // Remove the output directory if no file could be extracted and it didn't exist already
+        if (mode == EXTRACT && opt->output && !to_stream && !has_file && !outdir_existed)
         {
-            // Change the current working directory back to the initial one
             #ifdef _WIN32
-            const int ch_status = _chdir(cwd_start);
+            _rmdir(opt->output);
             #else // Linux
-            const int ch_status = chdir(cwd_start);
+            rmdir(opt->output);
             #endif
-
-            free(cwd_start);
-
-            // Remove the output directory if no file could be extracted and it didn't exist already
-            if (!has_file && !outdir_existed)
-            {
-                #ifdef _WIN32
-                const int ch_status = _rmdir(opt->output);
-                #else // Linux
-                const int ch_status = rmdir(opt->output);
-                #endif
-            }
         }
 
         // Prints how much space the image has left, in case of checking one that already has hidden data
@@ -815,10 +2723,11 @@ static inline void __execute_options(struct argp_state *state, void *options)
         }
     }
 
-    // Save the modified image (when hiding a file)
-    if (mode == HIDE && image_has_changed)
+    // Save the modified image (when hiding, removing, copying, or changing the password of files)
+    if ((mode == HIDE || mode == REKEY_MODE || mode == TRANSPLANT_MODE || mode == REMOVE_MODE) && image_has_changed)
     {
-        const char *const save_path = opt->output ? opt->output : opt->input;
+        // (an image chosen from an index is saved to the current working directory, so the indexed folder is not changed)
+        const char *const save_path = opt->output ? opt->output : (opt->pick_from ? basename(steg_path) : steg_path);
         const int save_status = imc_steg_save(steg_image, save_path);
         /* Note: The input image will not be overwritten because our file name
            collision resolution is going to append a number to the output's name. */
@@ -844,6 +2753,11 @@ static inline void __execute_options(struct argp_state *state, void *options)
                 argp_failure(state, EXIT_FAILURE, 0, "could not save '%s'. Reason: %s.", save_path, strerror(errno));
                 break;
             
+            case IMC_ERR_WRITE_FAIL:
+            case IMC_ERR_NO_MEMORY:
+                argp_failure(state, EXIT_FAILURE, 0, "could not encode or write the new image to '%s'.", save_path);
+                break;
+            
             default:
                 argp_failure(state, EXIT_FAILURE, 0, "unknown error when extracting hidden data. (%d)", save_status);
                 break;
@@ -901,22 +2815,118 @@ static int imc_cli_parse_options(int key, char *arg, struct argp_state *state)
         // --hide: File being hidden on the image
         case 'h':
             hide:
-            struct HideList **tail = &((UserOptions*)(state->hook))->hide_tail;
-            
-            // Add the path to the end of the linked list
-            if (*tail)
+            __append_path(arg, &((UserOptions*)(state->hook))->hide, &((UserOptions*)(state->hook))->hide_tail);
+            break;
+        
+        // --shard: Image over which the file is split
+        case SHARD:
+            shard:
+            __append_path(arg, &((UserOptions*)(state->hook))->shard, &((UserOptions*)(state->hook))->shard_tail);
+            break;
+        
+        // --join: Image whose shard is joined
+        case JOIN:
+            join:
+            __append_path(arg, &((UserOptions*)(state->hook))->join, &((UserOptions*)(state->hook))->join_tail);
+            break;
+        
+        // --parity: Amount of parity shards when splitting a file
+        case PARITY:
             {
-                struct HideList *node = imc_calloc(1, sizeof(struct HideList));
-                __store_path(arg, &node->data);
-                (*tail)->next = node;
-                *tail = node;
+                char *end = NULL;
+                const unsigned long long parity = strtoull(arg, &end, 10);
+                if (!isdigit(arg[0]) || *end != '\0' || parity == 0 || parity >= IMC_ERASURE_MAX_SHARDS)
+                {
+                    argp_error(state, "the amount of parity shards must be a number between 1 and %d.", IMC_ERASURE_MAX_SHARDS - 1);
+                }
+                ((UserOptions*)(state->hook))->parity = parity;
             }
-            else
+            break;
+        
+        // --tar: Extract the hidden files as a tar archive
+        case TAR:
+            ((UserOptions*)(state->hook))->tar = true;
+            break;
+        
+        // --serve: Socket where to listen for requests
+        case SERVE:
+            __check_unique_option(state, "serve", ((UserOptions*)(state->hook))->serve);
+            __store_path(arg, &((UserOptions*)(state->hook))->serve);
+            break;
+        
+        // --watch: Folder to be watched for new images
+        case WATCH:
+            __check_unique_option(state, "watch", ((UserOptions*)(state->hook))->watch);
+            __store_path(arg, &((UserOptions*)(state->hook))->watch);
+            break;
+        
+        // --cover-cache: Folder where the decoded cover images are cached
+        case COVER_CACHE:
+            __check_unique_option(state, "cover-cache", ((UserOptions*)(state->hook))->cover_cache);
+            __store_path(arg, &((UserOptions*)(state->hook))->cover_cache);
+            break;
+        
+        // --index: Folder whose images are being indexed
+        case INDEX:
+            __check_unique_option(state, "index", ((UserOptions*)(state->hook))->index);
+            __store_path(arg, &((UserOptions*)(state->hook))->index);
+            break;
+        
+        // --pick-from: Index from which the cover image is chosen
+        case PICK_FROM:
+            __check_unique_option(state, "pick-from", ((UserOptions*)(state->hook))->pick_from);
+            __store_path(arg, &((UserOptions*)(state->hook))->pick_from);
+            break;
+        
+        // --plan: Index over which the files are distributed
+        case PLAN:
+            __check_unique_option(state, "plan", ((UserOptions*)(state->hook))->plan);
+            __store_path(arg, &((UserOptions*)(state->hook))->plan);
+            break;
+        
+        // --run-plan: Plan whose files are hidden
+        case RUN_PLAN:
+            __check_unique_option(state, "run-plan", ((UserOptions*)(state->hook))->run_plan);
+            __store_path(arg, &((UserOptions*)(state->hook))->run_plan);
+            break;
+        
+        // --capacity: Image whose capacity is shown
+        case CAPACITY:
+            __check_unique_option(state, "capacity", ((UserOptions*)(state->hook))->capacity);
+            __store_path(arg, &((UserOptions*)(state->hook))->capacity);
+            break;
+        
+        // --benchmark: Image that is saved with each profile
+        case BENCHMARK:
+            __check_unique_option(state, "benchmark", ((UserOptions*)(state->hook))->benchmark);
+            __store_path(arg, &((UserOptions*)(state->hook))->benchmark);
+            break;
+        
+        // --profile: Settings of the encoder when saving the images
+        case PROFILE:
             {
-                __store_path(arg, &((UserOptions*)(state->hook))->hide.data);
-                *tail = &((UserOptions*)(state->hook))->hide;
+                UserOptions *const opt = (UserOptions*)(state->hook);
+                if (opt->has_profile)
+                {
+                    argp_error(state, "the 'profile' option can be specified only once.");
+                }
+                
+                bool found = false;
+                for (int i = 0; i < IMC_PROFILE_COUNT && !found; i++)
+                {
+                    if (strcmp(arg, imc_profile_name((enum SaveProfile)i)) == 0)
+                    {
+                        opt->profile = (enum SaveProfile)i;
+                        found = true;
+                    }
+                }
+
+                if (!found)
+                {
+                    argp_error(state, "the profile must be 'fast', 'balanced', or 'small'.");
+                }
+                opt->has_profile = true;
             }
-            
             break;
         
         // --append: If the file being hidden is going to be appended to existing ones
@@ -930,6 +2940,10 @@ static int imc_cli_parse_options(int key, char *arg, struct argp_state *state)
             {
                 argp_error(state, "you provided a password even though you specified the 'no password' option.");
             }
+            if (((UserOptions*)(state->hook))->key_file)
+            {
+                argp_error(state, "you provided a password even though you specified a key file.");
+            }
             
             // Create a password buffer and copy the string to it
             {
@@ -947,16 +2961,104 @@ static int imc_cli_parse_options(int key, char *arg, struct argp_state *state)
             
             break;
         
+        // --rekey: Image whose hidden data is getting a new password
+        case REKEY:
+            __check_unique_option(state, "rekey", ((UserOptions*)(state->hook))->rekey);
+            __store_path(arg, &((UserOptions*)(state->hook))->rekey);
+            break;
+        
+        // --transplant: Image whose hidden data is being copied (followed by the image where to copy it)
+        case TRANSPLANT:
+            __check_unique_option(state, "transplant", ((UserOptions*)(state->hook))->transplant);
+            __store_path(arg, &((UserOptions*)(state->hook))->transplant);
+            break;
+        
+        // --remove: Name of the hidden file being removed
+        case REMOVE:
+            __check_unique_option(state, "remove", ((UserOptions*)(state->hook))->remove);
+            __store_path(arg, &((UserOptions*)(state->hook))->remove);
+            break;
+        
+        // --new-password: New password for the hidden data
+        case NEW_PASSWORD:
+            __check_unique_option(state, "new-password", ((UserOptions*)(state->hook))->new_password);
+            {
+                PassBuff *user_password = __alloc_passbuff();
+                user_password->length = strlen(arg);
+                strncpy(user_password->buffer, arg, IMC_PASSWORD_MAX_BYTES);
+                if (user_password->length > IMC_PASSWORD_MAX_BYTES) user_password->length = IMC_PASSWORD_MAX_BYTES;
+                __password_normalize(user_password, true);
+                ((UserOptions*)(state->hook))->new_password = user_password;
+            }
+            break;
+        
+        // --password-list: File with passwords to be tried
+        case PASSWORD_LIST:
+            __check_unique_option(state, "password-list", ((UserOptions*)(state->hook))->password_list);
+            __store_path(arg, &((UserOptions*)(state->hook))->password_list);
+            break;
+        
         // --no-password: Do not show a password prompt if the user has not provided a password
         case 'n':
             if (((UserOptions*)(state->hook))->password)
             {
                 argp_error(state, "you provided a password even though you specified the 'no password' option.");
             }
+            if (((UserOptions*)(state->hook))->key_file)
+            {
+                argp_error(state, "you specified the 'no password' option even though you specified a key file.");
+            }
             ((UserOptions*)(state->hook))->no_password = true;
             ((UserOptions*)(state->hook))->password = __alloc_passbuff();   // Store an empty password
             break;
         
+        // --key-file: Use the secrets from a key file instead of a password
+        case KEY_FILE:
+            __check_unique_option(state, "key-file", ((UserOptions*)(state->hook))->key_file);
+            if (((UserOptions*)(state->hook))->password)
+            {
+                argp_error(state, "you specified a key file even though you provided a password.");
+            }
+            __store_path(arg, &((UserOptions*)(state->hook))->key_file);
+            break;
+        
+        // --export-key: Save the hashed password to a key file
+        case EXPORT_KEY:
+            __check_unique_option(state, "export-key", ((UserOptions*)(state->hook))->export_key);
+            __store_path(arg, &((UserOptions*)(state->hook))->export_key);
+            break;
+        
+        // --generate-keys: Generate a key pair for the recipient mode
+        case GENERATE_KEYS:
+            __check_unique_option(state, "generate-keys", ((UserOptions*)(state->hook))->generate_keys);
+            __store_path(arg, &((UserOptions*)(state->hook))->generate_keys);
+            break;
+        
+        // --recipient: Public key to which the data is hidden
+        case RECIPIENT:
+            __check_unique_option(state, "recipient", ((UserOptions*)(state->hook))->recipient);
+            __store_path(arg, &((UserOptions*)(state->hook))->recipient);
+            break;
+        
+        // --secret-key: Secret key for extracting the data hidden to its public key
+        case SECRET_KEY:
+            __check_unique_option(state, "secret-key", ((UserOptions*)(state->hook))->secret_key);
+            __store_path(arg, &((UserOptions*)(state->hook))->secret_key);
+            break;
+        
+        // --threads: Maximum amount of worker threads
+        case 't':
+            {
+                char *end = NULL;
+                const unsigned long long threads = strtoull(arg, &end, 10);
+                if (!isdigit(arg[0]) || *end != '\0' || threads == 0 || threads > 1024)
+                {
+                    argp_error(state, "the amount of threads must be a number between 1 and 1024.");
+                }
+                ((UserOptions*)(state->hook))->threads = threads;
+            }
+            break;
+        
         // --verbose: Prints detailed information during operation
         case 'v':
             ((UserOptions*)(state->hook))->verbose = true;
@@ -993,19 +3095,30 @@ static int imc_cli_parse_options(int key, char *arg, struct argp_state *state)
             free( ((UserOptions*)(state->hook))->extract );
             free( ((UserOptions*)(state->hook))->input );
             free( ((UserOptions*)(state->hook))->output );
-
-            // Freeing the linked list
-            {
-                free( ((UserOptions*)(state->hook))->hide.data );
-                struct HideList *node = ((UserOptions*)(state->hook))->hide.next;
-                while (node)
-                {
-                    struct HideList *next_node = node->next;
-                    imc_free(node->data);
-                    imc_free(node);
-                    node = next_node;
-                };
-            }
+            free( ((UserOptions*)(state->hook))->key_file );
+            free( ((UserOptions*)(state->hook))->export_key );
+            free( ((UserOptions*)(state->hook))->generate_keys );
+            free( ((UserOptions*)(state->hook))->recipient );
+            free( ((UserOptions*)(state->hook))->secret_key );
+            free( ((UserOptions*)(state->hook))->password_list );
+            free( ((UserOptions*)(state->hook))->rekey );
+            free( ((UserOptions*)(state->hook))->transplant );
+            free( ((UserOptions*)(state->hook))->transplant_dst );
+            free( ((UserOptions*)(state->hook))->remove );
+            free( ((UserOptions*)(state->hook))->serve );
+            free( ((UserOptions*)(state->hook))->watch );
+            free( ((UserOptions*)(state->hook))->cover_cache );
+            free( ((UserOptions*)(state->hook))->index );
+            free( ((UserOptions*)(state->hook))->pick_from );
+            free( ((UserOptions*)(state->hook))->plan );
+            free( ((UserOptions*)(state->hook))->run_plan );
+            free( ((UserOptions*)(state->hook))->capacity );
+            free( ((UserOptions*)(state->hook))->benchmark );
+
+            // Freeing the linked lists
+            __free_path_list(&((UserOptions*)(state->hook))->hide);
+            __free_path_list(&((UserOptions*)(state->hook))->shard);
+            __free_path_list(&((UserOptions*)(state->hook))->join);
 
             imc_free(state->hook);
             state->hook = NULL;
@@ -1022,6 +3135,22 @@ static int imc_cli_parse_options(int key, char *arg, struct argp_state *state)
                 // The '--hide' argument accepts more than one file to hide
                 goto hide;
             }
+            else if (((UserOptions*)(state->hook))->prev_arg == SHARD)
+            {
+                // The '--shard' argument accepts more than one image
+                goto shard;
+            }
+            else if (((UserOptions*)(state->hook))->prev_arg == JOIN)
+            {
+                // The '--join' argument accepts more than one image
+                goto join;
+            }
+            else if (((UserOptions*)(state->hook))->prev_arg == TRANSPLANT && !((UserOptions*)(state->hook))->transplant_dst)
+            {
+                // The '--transplant' argument is followed by the destination image
+                __store_path(arg, &((UserOptions*)(state->hook))->transplant_dst);
+                break;
+            }
             
             // Exit with error if an unknown option has been received
             argp_error(state, "unrecognized option '%s'\n"
@@ -5,15 +5,6 @@
 
 #include "imc_includes.h"
 
-#define IMC_PASSWORD_MAX_BYTES 4080     // Size (in bytes) of the password buffer
-
-// Buffer for the plaintext password
-typedef struct PassBuff {
-    size_t capacity;    // The maximum amount of bytes that the buffer can store
-    size_t length;      // The current amount of bytes stored on the buffer
-    uint8_t buffer[IMC_PASSWORD_MAX_BYTES]; // Array of bytes with the plaintext password
-} PassBuff;
-
 // Get a password from the user on the command-line. The typed characters are not displayed.
 // They are stored on the 'output' buffer, up to 'buffer_size' bytes.
 // Function returns the amount of bytes in the password.
@@ -44,6 +35,16 @@ const struct argp *restrict imc_cli_get_argp_struct();
 // Store on a pointer the full path of a file
 static inline void __store_path(const char *path, char **destination);
 
+// Add a copy of a path to the end of a linked list of paths ('tail' is NULL while the list is empty)
+struct HideList;
+static void __append_path(const char *path, struct HideList *head, struct HideList **tail);
+
+// Free the paths of a linked list (the head of the list is not freed itself)
+static void __free_path_list(struct HideList *head);
+
+// Whether any of the paths on a linked list is the standard input or output ("-")
+static bool __has_stdio_path(const struct HideList *head);
+
 // Check if an option has not been passed before (program exits if this check fails)
 // The idea is to check if the option's value evaluates to 'false'. If it doesn't, then the check fails.
 // The error message contains the name of the option, that is why it is needed.
@@ -55,6 +56,99 @@ static inline void __timespec_to_string(struct timespec *time, char *out_buff, s
 // Convert a file size (in bytes) to a string in the appropriate scale, and store it on 'out_buff'
 static inline void __filesize_to_string(size_t file_size, char *out_buff, size_t buff_size);
 
+// Hash the user's password, then save the result to the path of the '--export-key' option
+// This is a helper for the '__execute_options()' function.
+struct UserOptions;
+static void __export_key(struct argp_state *state, struct UserOptions *opt);
+
+// Exit with an error message if a key file could not be loaded
+// This is a helper for the functions that load the key files.
+static void __key_load_error(struct argp_state *state, const char *path, int status);
+
+// Load the secrets from a key file, and initialize a cryptographic context with them
+// This is a helper for the '__execute_options()' function. The program exits if the key file cannot be loaded.
+static struct CryptoContext *__load_key_file(struct argp_state *state, const char *path);
+
+// Load the public key ('secret' is false) or the secret key ('secret' is true) of the recipient mode
+// This is a helper for the '__execute_options()' function. The program exits if the key cannot be loaded.
+// The returned key should be freed with 'sodium_free()'.
+static uint8_t *__load_recipient_key(struct argp_state *state, const char *path, bool secret);
+
+// Generate a key pair for the recipient mode, and save it to the path of the '--generate-keys' option
+// This is a helper for the '__execute_options()' function.
+static void __generate_keys(struct argp_state *state, struct UserOptions *opt);
+
+// Print a progress message of the library to the standard output (on verbose mode)
+static void __print_progress(void *context, const char *message);
+
+// Run the server on the socket of the '--serve' option, until the program is stopped
+// This is a helper for the '__execute_options()' function.
+static void __serve(struct argp_state *state, struct UserOptions *opt);
+
+// Hash the password once, then process the new images on the folder of the '--watch' option until the program is stopped
+// This is a helper for the '__execute_options()' function.
+static void __watch(struct argp_state *state, struct UserOptions *opt);
+
+// Open the images on the folder of the '--index' option, and save their capacities to an index file
+// This is a helper for the '__execute_options()' function.
+static void __index(struct argp_state *state, struct UserOptions *opt);
+
+// Compress the files of the '--hide' option, storing them on 'prepared' (one for each path)
+// If a file could not be read, its error code is stored on 'prepared_status' and the value of 'errno' on 'prepared_error'.
+// Returns the amount of carrier bytes needed for all the files that were read.
+// This is a helper for the '__execute_options()' function.
+static size_t __prepare_files(struct UserOptions *opt, PreparedFile **prepared, int *prepared_status, int *prepared_error);
+
+// Choose on the index of the '--pick-from' option the smallest image with at least 'carrier_bits' carrier bytes
+// The chosen image becomes the '--input' option, and its indexed parameters are stored on 'picked'.
+// This is a helper for the '__execute_options()' function.
+struct IndexEntry;
+static void __pick_cover(struct argp_state *state, struct UserOptions *opt, size_t carrier_bits, struct IndexEntry *picked);
+
+// Check on the header of the '--input' image whether any of the compressed files can fit on it
+// If none can, the program exits before the password is asked and before the image is decoded. Nothing is checked
+// if the header does not tell the capacity of the image (then the files are checked while being hidden).
+// This is a helper for the '__execute_options()' function.
+static void __check_fit(struct argp_state *state, struct UserOptions *opt, PreparedFile **prepared, const int *prepared_status);
+
+// Show how much data can be hidden on the image of the '--capacity' option (without a password)
+// This is a helper for the '__execute_options()' function.
+static void __capacity(struct argp_state *state, struct UserOptions *opt);
+
+// Save the image of the '--benchmark' option with each profile, then show how long it took and the size of the result
+// This is a helper for the '__execute_options()' function.
+static void __benchmark(struct argp_state *state, struct UserOptions *opt);
+
+// Distribute the files of the '--hide' option over the images on the index of the '--plan' option, then save the plan
+// This is a helper for the '__execute_options()' function.
+static void __plan(struct argp_state *state, struct UserOptions *opt);
+
+// Hash the password once, then hide the files on the images of the plan of the '--run-plan' option
+// This is a helper for the '__execute_options()' function. The program exits with an error if any image failed.
+static void __run_plan(struct argp_state *state, struct UserOptions *opt);
+
+// Split the file of the '--hide' option into shards over the images of the '--shard' option
+// This is a helper for the '__execute_options()' function.
+static void __shard(struct argp_state *state, struct UserOptions *opt);
+
+// Reassemble a file from the shards on the images of the '--join' option
+// This is a helper for the '__execute_options()' function.
+static void __join(struct argp_state *state, struct UserOptions *opt);
+
+// Exit with an error message if an image could not be initialized
+// This is a helper for the '__execute_options()' function.
+static void __init_error(struct argp_state *state, int status, const char *path, struct UserOptions *opt);
+
+// Hash a password into a new cryptographic context
+// This is a helper for the '__execute_options()' function. The program exits if the password could not be hashed.
+static struct CryptoContext *__password_context(struct argp_state *state, const PassBuff *password, struct UserOptions *opt);
+
+// Read the passwords on a file (one per line), and store on 'count' how many were read
+// This is a helper for the '__execute_options()' function. The program exits if the file cannot be read,
+// or if a line is longer than the maximum size of a password.
+// Each password should be freed with 'imc_cli_password_free()', then the array with 'imc_free()'.
+static PassBuff **__load_password_list(struct argp_state *state, const char *path, size_t *count);
+
 // Validate the command line options, and perform the requested operation
 // This is a helper for the 'imc_cli_parse_options()' function.
 static inline void __execute_options(struct argp_state *state, void *options);
@@ -1,10 +1,59 @@
 /* Encryption, decryption, and pseudo-random number generation. */
 
 #include "imc_includes.h"
+#include "imc_nopass_key.h" // Generated when building (see 'tools/gen_nopass_key.c')
+
+// Copy a plaintext password of 'length' bytes to a new password buffer (in locked memory)
+// The buffer should be freed with 'imc_crypto_password_free()'. Returns IMC_ERR_INVALID_PASS if the password is too long.
+int imc_crypto_password_create(const uint8_t *text, size_t length, PassBuff **out)
+{
+    if (length > IMC_PASSWORD_MAX_BYTES) return IMC_ERR_INVALID_PASS;
+    if (sodium_init() < 0) return IMC_ERR_CRYPTO_FAIL;
+    
+    PassBuff *password = sodium_malloc(sizeof(PassBuff));
+    if (!password) return IMC_ERR_NO_MEMORY;
+    sodium_memzero(password, sizeof(PassBuff));
+
+    password->capacity = sizeof(password->buffer);
+    password->length = length;
+    if (length > 0) memcpy(password->buffer, text, length);
+
+    *out = password;
+    return IMC_SUCCESS;
+}
+
+// Clear and free a password buffer
+void imc_crypto_password_free(PassBuff *password)
+{
+    sodium_free(password);
+    // Note: the above function already overwrites the memory before freeing it.
+}
 
 // Generate cryptographic secrets key from a password
 int imc_crypto_context_create(const PassBuff *password, CryptoContext **out)
 {
+    // Storage for the password hash
+    uint8_t *secret = sodium_malloc(IMC_SECRET_SIZE);
+    if (!secret) return IMC_ERR_NO_MEMORY;
+
+    int status = imc_crypto_derive_secret(password, secret);
+    if (status == IMC_SUCCESS) status = imc_crypto_context_from_secret(secret, out);
+    
+    sodium_free(secret);
+    return status;
+}
+
+// Hash the password into the secrets used by the program (encryption key and PRNG seed)
+// The output buffer must be able to hold 'IMC_SECRET_SIZE' bytes, and it should be in locked memory.
+int imc_crypto_derive_secret(const PassBuff *password, uint8_t *secret)
+{
+    // The hash of an empty password is always the same, so it was computed when building the program
+    if (password->length == 0)
+    {
+        memcpy(secret, IMC_NOPASS_SECRET, IMC_SECRET_SIZE);
+        return IMC_SUCCESS;
+    }
+    
     // Salt for generating a secret key from a password
     uint8_t salt[crypto_pwhash_SALTBYTES];
     memset(salt, 0, sizeof(salt));
@@ -12,6 +61,25 @@ int imc_crypto_context_create(const PassBuff *password, CryptoContext **out)
     if (salt_len > crypto_pwhash_SALTBYTES) salt_len = crypto_pwhash_SALTBYTES;
     memcpy(salt, IMC_SALT, salt_len);
     
+    // Password hashing: generate enough bytes for both the secret key and the PRNG seed
+    int status = crypto_pwhash(
+        secret,                     // Output buffer for the hash
+        IMC_SECRET_SIZE,            // Size in bytes of the output buffer
+        password->buffer,           // Input buffer with the password
+        password->length,           // Size in bytes of the input buffer
+        salt,                       // Salt to be appended to the password
+        IMC_OPSLIMIT,               // Amount of times that the hashing is repeated
+        IMC_MEMLIMIT,               // Amount of memory used for hashing
+        crypto_pwhash_ALG_ARGON2ID13    // Hashing algorithm
+    );
+    if (status < 0) return IMC_ERR_NO_MEMORY;
+
+    return IMC_SUCCESS;
+}
+
+// Initialize the encryption key and the PRNG from secrets previously derived from a password
+int imc_crypto_context_from_secret(const uint8_t *secret, CryptoContext **out)
+{
     // Storage for the secret key and the state of the pseudorandom number generator (PRNG)
     CryptoContext *context = sodium_malloc(sizeof(CryptoContext));
     if (!context) return IMC_ERR_NO_MEMORY;
@@ -21,31 +89,14 @@ int imc_crypto_context_create(const PassBuff *password, CryptoContext **out)
     uint64_t prng_seed[4];
     sodium_mlock(prng_seed, sizeof(prng_seed));
     
-    // Storage for the password hash
     const size_t key_size = sizeof(context->xcc20_key);
     const size_t seed_size = sizeof(prng_seed);
-    const size_t out_len = key_size + seed_size;
-    uint8_t output[out_len];
-    sodium_mlock(output, sizeof(output));
-    
-    // Password hashing: generate enough bytes for both the secret key and the PRNG seed
-    int status = crypto_pwhash(
-        (uint8_t * const)&output,   // Output buffer for the hash
-        sizeof(output),             // Size in bytes of the output buffer
-        password->buffer,           // Input buffer with the password
-        password->length,           // Size in bytes of the input buffer
-        salt,                       // Salt to be appended to the password
-        IMC_OPSLIMIT,               // Amount of times that the hashing is repeated
-        IMC_MEMLIMIT,               // Amount of memory used for hashing
-        crypto_pwhash_ALG_ARGON2ID13    // Hashing algorithm
-    );
-    if (status < 0) return IMC_ERR_NO_MEMORY;
 
     // The lower bytes are used for the key (32 bytes)
-    memcpy(&context->xcc20_key, &output[0], key_size);
+    memcpy(&context->xcc20_key, &secret[0], key_size);
 
     // The upper bytes are used for the seed: four 64-bit unsigned integers (32 bytes)
-    memcpy(prng_seed, &output[key_size], seed_size);
+    memcpy(prng_seed, &secret[key_size], seed_size);
 
     // Invert the byte order if on a big-endian system
     for (size_t i = 0; i < 4; i++)
@@ -59,12 +110,404 @@ int imc_crypto_context_create(const PassBuff *password, CryptoContext **out)
     
     // Release the unecessary memory and store the output
     sodium_munlock(prng_seed, sizeof(prng_seed));
-    sodium_munlock(output, sizeof(output));
     *out = context;
 
     return IMC_SUCCESS;
 }
 
+// Make an independent copy of a cryptographic context (including the current state of the PRNG)
+int imc_crypto_context_clone(const CryptoContext *state, CryptoContext **out)
+{
+    CryptoContext *context = sodium_malloc(sizeof(CryptoContext));
+    if (!context) return IMC_ERR_NO_MEMORY;
+    memcpy(context, state, sizeof(CryptoContext));
+    
+    *out = context;
+    return IMC_SUCCESS;
+}
+
+// Save the secrets derived from a password to a key file
+// The file is created with read and write permissions only for the current user, and it is never overwritten.
+int imc_crypto_keyfile_save(const char *path, const uint8_t *secret)
+{
+    return __keyfile_write(path, IMC_KEYFILE_MAGIC, secret, IMC_SECRET_SIZE);
+}
+
+// Load the secrets stored on a key file
+// The output is allocated in locked memory, which should be freed with 'sodium_free()'.
+int imc_crypto_keyfile_load(const char *path, uint8_t **secret)
+{
+    return __keyfile_read(path, IMC_KEYFILE_MAGIC, IMC_SECRET_SIZE, secret);
+}
+
+// Generate a X25519 key pair for the recipient mode, and save it to two files:
+// the secret key to 'path', and the public key to 'path' with the '.pub' extension added.
+// The secret key is written with read and write permissions only for the current user.
+int imc_crypto_keypair_save(const char *path)
+{
+    const size_t path_len = strlen(path);
+    char pub_path[path_len + 5];
+    snprintf(pub_path, sizeof(pub_path), "%s.pub", path);
+    
+    uint8_t public_key[crypto_box_PUBLICKEYBYTES];
+    uint8_t *secret_key = sodium_malloc(crypto_box_SECRETKEYBYTES);
+    if (!secret_key) return IMC_ERR_NO_MEMORY;
+    crypto_box_keypair(public_key, secret_key);
+
+    int status = __keyfile_write(path, IMC_SECRET_KEY_MAGIC, secret_key, crypto_box_SECRETKEYBYTES);
+    sodium_free(secret_key);
+    if (status != IMC_SUCCESS) return status;
+
+    status = __keyfile_write(pub_path, IMC_PUBLIC_KEY_MAGIC, public_key, crypto_box_PUBLICKEYBYTES);
+    if (status != IMC_SUCCESS)
+    {
+        // Do not leave behind a secret key without its public key
+        const int error_number = errno;
+        remove(path);
+        errno = error_number;
+    }
+    
+    return status;
+}
+
+// Load the public key of a recipient from a file created by 'imc_crypto_keypair_save()'
+// The output is allocated in locked memory, which should be freed with 'sodium_free()'.
+int imc_crypto_public_key_load(const char *path, uint8_t **public_key)
+{
+    return __keyfile_read(path, IMC_PUBLIC_KEY_MAGIC, crypto_box_PUBLICKEYBYTES, public_key);
+}
+
+// Load the secret key of a recipient from a file created by 'imc_crypto_keypair_save()'
+// The output is allocated in locked memory, which should be freed with 'sodium_free()'.
+int imc_crypto_secret_key_load(const char *path, uint8_t **secret_key)
+{
+    return __keyfile_read(path, IMC_SECRET_KEY_MAGIC, crypto_box_SECRETKEYBYTES, secret_key);
+}
+
+// Create a new file with read and write permissions only for the current user (fails if the file already exists)
+// On failure, NULL is returned and 'errno' is set ('EEXIST' if the file exists).
+static FILE *__keyfile_create(const char *path)
+{
+    #ifdef _WIN32
+
+    /* Note: On Windows, a new file gets the permissions inherited from its folder, which may allow other users to read it.
+             So the file is created with a protected access control list ("D:P", which does not inherit any entry),
+             whose only entry gives full access ("FA") to the security identifier (SID) of the current user. */
+    
+    // Security identifier of the user running the program
+    HANDLE token = NULL;
+    DWORD token_size = 0;
+    TOKEN_USER *user = NULL;
+    wchar_t *user_sid = NULL;
+    PSECURITY_DESCRIPTOR descriptor = NULL;
+    bool security_ok = false;
+
+    if (OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token))
+    {
+        GetTokenInformation(token, TokenUser, NULL, 0, &token_size);
+        user = (token_size > 0) ? imc_malloc(token_size) : NULL;
+        
+        if ( user &&
+             GetTokenInformation(token, TokenUser, user, token_size, &token_size) &&
+             ConvertSidToStringSidW(user->User.Sid, &user_sid) )
+        {
+            // Security descriptor with the access control list
+            wchar_t sddl[wcslen(user_sid) + 16];
+            swprintf(sddl, sizeof(sddl) / sizeof(wchar_t), L"D:P(A;;FA;;;%ls)", user_sid);
+            security_ok = ConvertStringSecurityDescriptorToSecurityDescriptorW(sddl, SDDL_REVISION_1, &descriptor, NULL);
+        }
+        
+        CloseHandle(token);
+    }
+
+    if (user_sid) LocalFree(user_sid);
+    imc_free(user);
+
+    if (!security_ok)
+    {
+        errno = EACCES;
+        return NULL;
+    }
+
+    // Convert the file path string to wide char, in order to properly handle UTF-8 characters
+    const size_t path_len = strlen(path) + 1;
+    const int w_path_len = MultiByteToWideChar(CP_UTF8, 0, path, path_len, NULL, 0);
+    wchar_t w_path[w_path_len];
+    MultiByteToWideChar(CP_UTF8, 0, path, path_len, w_path, w_path_len);
+
+    SECURITY_ATTRIBUTES attributes = {
+        .nLength = sizeof(SECURITY_ATTRIBUTES),
+        .lpSecurityDescriptor = descriptor,
+        .bInheritHandle = FALSE,
+    };
+
+    HANDLE key_handle = CreateFileW(
+        w_path,                 // Path to the key file
+        GENERIC_WRITE,          // Open file for writing
+        0,                      // No access for other programs while it is being written
+        &attributes,            // Access only for the current user
+        CREATE_NEW,             // Fail if the file already exists
+        FILE_ATTRIBUTE_NORMAL,  // Normal file (that is, no system or temporary file)
+        NULL                    // No template for the attributes
+    );
+    
+    const DWORD error = GetLastError();
+    LocalFree(descriptor);
+    
+    if (key_handle == INVALID_HANDLE_VALUE)
+    {
+        errno = (error == ERROR_FILE_EXISTS || error == ERROR_ALREADY_EXISTS) ? EEXIST : EACCES;
+        return NULL;
+    }
+
+    // Wrap the handle on a C stream
+    const int key_fd = _open_osfhandle((intptr_t)key_handle, _O_WRONLY | _O_BINARY);
+    if (key_fd < 0)
+    {
+        CloseHandle(key_handle);
+        return NULL;
+    }
+    
+    FILE *key_file = _fdopen(key_fd, "wb");
+    if (!key_file) _close(key_fd);
+    return key_file;
+
+    #else // Linux
+
+    const int key_fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    FILE *key_file = (key_fd >= 0) ? fdopen(key_fd, "wb") : NULL;
+    if (key_fd >= 0 && !key_file) close(key_fd);
+    return key_file;
+
+    #endif // _WIN32
+}
+
+// Write 'size' bytes of key material to a new file, preceded by the magic bytes and the version, and followed by a checksum
+static int __keyfile_write(const char *path, const char *magic, const uint8_t *data, size_t size)
+{
+    // Contents of the key file
+    const size_t blob_size = size + IMC_KEYFILE_OVERHEAD;
+    uint8_t *blob = sodium_malloc(blob_size);
+    if (!blob) return IMC_ERR_NO_MEMORY;
+    
+    const uint32_t version = htole32( (uint32_t)IMC_KEYFILE_VERSION );
+    memcpy(&blob[0], magic, 4);
+    memcpy(&blob[4], &version, 4);
+    memcpy(&blob[8], data, size);
+
+    // Checksum for detecting a truncated or damaged key file
+    crypto_generichash(&blob[8 + size], crypto_generichash_BYTES, blob, 8 + size, NULL, 0);
+
+    // Create the file (fail if it already exists)
+    FILE *key_file = __keyfile_create(path);
+
+    if (!key_file)
+    {
+        const int error_number = errno;
+        sodium_free(blob);
+        errno = error_number;
+        return (errno == EEXIST) ? IMC_ERR_FILE_EXISTS : IMC_ERR_SAVE_FAIL;
+    }
+
+    size_t write_count = fwrite(blob, 1, blob_size, key_file);
+    int close_status = fclose(key_file);
+    sodium_free(blob);
+
+    if (write_count != blob_size || close_status != 0)
+    {
+        const int error_number = errno;
+        remove(path);
+        errno = error_number;
+        return IMC_ERR_SAVE_FAIL;
+    }
+
+    return IMC_SUCCESS;
+}
+
+// Read the 'size' bytes of key material from a file written by '__keyfile_write()' with the same magic bytes
+// The output is allocated in locked memory, which should be freed with 'sodium_free()'.
+static int __keyfile_read(const char *path, const char *magic, size_t size, uint8_t **out)
+{
+    FILE *key_file = fopen(path, "rb");
+    if (!key_file) return IMC_ERR_FILE_NOT_FOUND;
+
+    const size_t blob_size = size + IMC_KEYFILE_OVERHEAD;
+    uint8_t *blob = sodium_malloc(blob_size + 1);
+    if (!blob)
+    {
+        fclose(key_file);
+        return IMC_ERR_NO_MEMORY;
+    }
+
+    // Read one byte more than expected, in order to detect if the file is too big
+    const size_t read_count = fread(blob, 1, blob_size + 1, key_file);
+    fclose(key_file);
+
+    int status = IMC_SUCCESS;
+
+    if (read_count != blob_size || memcmp(&blob[0], magic, 4) != 0)
+    {
+        status = IMC_ERR_FILE_INVALID;
+    }
+    else
+    {
+        uint32_t version;
+        memcpy(&version, &blob[4], 4);
+        version = le32toh(version);
+
+        if (version > IMC_KEYFILE_VERSION)
+        {
+            status = IMC_ERR_NEWER_VERSION;
+        }
+        else
+        {
+            // Verify the checksum
+            uint8_t checksum[crypto_generichash_BYTES];
+            crypto_generichash(checksum, sizeof(checksum), blob, 8 + size, NULL, 0);
+            
+            if (sodium_memcmp(checksum, &blob[8 + size], sizeof(checksum)) != 0)
+            {
+                status = IMC_ERR_FILE_CORRUPTED;
+            }
+        }
+    }
+
+    if (status == IMC_SUCCESS)
+    {
+        *out = sodium_malloc(size);
+        if (*out) memcpy(*out, &blob[8], size);
+        else status = IMC_ERR_NO_MEMORY;
+    }
+
+    sodium_free(blob);
+    return status;
+}
+
+// Hash some data into the 64 bytes used to initialize a cryptographic context on the recipient mode
+// The hash is separated by the version string of the recipient mode and by a label of what the hash is used for.
+static void __recipient_hash(const char *label, const uint8_t *data, size_t data_len, uint8_t *secret)
+{
+    crypto_generichash_state hash_state;
+    crypto_generichash_init(&hash_state, NULL, 0, IMC_SECRET_SIZE);
+    crypto_generichash_update(&hash_state, (const uint8_t *)IMC_RECIPIENT_DOMAIN, sizeof(IMC_RECIPIENT_DOMAIN));
+    crypto_generichash_update(&hash_state, (const uint8_t *)label, strlen(label) + 1);
+    crypto_generichash_update(&hash_state, data, data_len);
+    crypto_generichash_final(&hash_state, secret, IMC_SECRET_SIZE);
+    sodium_memzero(&hash_state, sizeof(hash_state));
+}
+
+// Initialize the PRNG that chooses the carrier positions of the ephemeral public key, on the recipient mode
+// It only depends on the recipient's public key, so both the sender and the recipient can find the ephemeral key.
+int imc_crypto_locator_context(const uint8_t *recipient_pk, CryptoContext **out)
+{
+    uint8_t *secret = sodium_malloc(IMC_SECRET_SIZE);
+    if (!secret) return IMC_ERR_NO_MEMORY;
+
+    __recipient_hash("locator", recipient_pk, crypto_box_PUBLICKEYBYTES, secret);
+    const int status = imc_crypto_context_from_secret(secret, out);
+    
+    sodium_free(secret);
+    return status;
+}
+
+// Generate the session secrets from the X25519 shared secret, on the recipient mode
+// (the secrets are bound to both the ephemeral public key and the recipient's public key)
+static int __recipient_session(
+    const uint8_t *shared,
+    const uint8_t *ephemeral_pk,
+    const uint8_t *recipient_pk,
+    CryptoContext **out
+)
+{
+    const size_t key_size = crypto_box_PUBLICKEYBYTES;
+    uint8_t *data = sodium_malloc(crypto_scalarmult_BYTES + 2 * key_size);
+    uint8_t *secret = sodium_malloc(IMC_SECRET_SIZE);
+    
+    if (!data || !secret)
+    {
+        sodium_free(data);
+        sodium_free(secret);
+        return IMC_ERR_NO_MEMORY;
+    }
+
+    memcpy(&data[0], shared, crypto_scalarmult_BYTES);
+    memcpy(&data[crypto_scalarmult_BYTES], ephemeral_pk, key_size);
+    memcpy(&data[crypto_scalarmult_BYTES + key_size], recipient_pk, key_size);
+    
+    __recipient_hash("session", data, crypto_scalarmult_BYTES + 2 * key_size, secret);
+    const int status = imc_crypto_context_from_secret(secret, out);
+
+    sodium_free(data);
+    sodium_free(secret);
+    return status;
+}
+
+// Sender side of the recipient mode: generate an ephemeral key pair, then derive the session secrets
+// from the shared secret between the ephemeral key and the recipient's public key.
+// The representative of the ephemeral public key is written to 'representative' (it needs to be stored with the hidden data).
+// It looks like random bytes, and the recipient gets the public key back with 'imc_elligator_decode()'.
+int imc_crypto_recipient_seal(const uint8_t *recipient_pk, uint8_t *representative, CryptoContext **out)
+{
+    uint8_t *ephemeral_sk = sodium_malloc(crypto_box_SECRETKEYBYTES);
+    uint8_t *shared = sodium_malloc(crypto_scalarmult_BYTES);
+    uint8_t ephemeral_pk[crypto_box_PUBLICKEYBYTES];
+    int status = IMC_SUCCESS;
+
+    if (!ephemeral_sk || !shared)
+    {
+        status = IMC_ERR_NO_MEMORY;
+    }
+    else
+    {
+        status = imc_elligator_keypair(representative, ephemeral_pk, ephemeral_sk);
+    }
+    
+    if (status == IMC_SUCCESS)
+    {
+        // The scalar multiplication fails if the recipient's public key is a low order point
+        if (crypto_scalarmult(shared, ephemeral_sk, recipient_pk) != 0)
+        {
+            status = IMC_ERR_CRYPTO_FAIL;
+        }
+        else
+        {
+            status = __recipient_session(shared, ephemeral_pk, recipient_pk, out);
+        }
+    }
+
+    sodium_free(ephemeral_sk);
+    sodium_free(shared);
+    return status;
+}
+
+// Recipient side of the recipient mode: derive the session secrets from the
+// shared secret between the recipient's secret key and the ephemeral public key (decoded from its representative)
+int imc_crypto_recipient_open(const uint8_t *secret_key, const uint8_t *representative, CryptoContext **out)
+{
+    uint8_t recipient_pk[crypto_box_PUBLICKEYBYTES];
+    crypto_scalarmult_base(recipient_pk, secret_key);
+
+    uint8_t ephemeral_pk[crypto_box_PUBLICKEYBYTES];
+    imc_elligator_decode(representative, ephemeral_pk);
+    
+    uint8_t *shared = sodium_malloc(crypto_scalarmult_BYTES);
+    if (!shared) return IMC_ERR_NO_MEMORY;
+    
+    int status;
+    if (crypto_scalarmult(shared, secret_key, ephemeral_pk) != 0)
+    {
+        // The ephemeral key is a point of low order (most likely, there is no hidden data for this recipient)
+        status = IMC_ERR_CRYPTO_FAIL;
+    }
+    else
+    {
+        status = __recipient_session(shared, ephemeral_pk, recipient_pk, out);
+    }
+
+    sodium_free(shared);
+    return status;
+}
+
 // Pseudorandom number generator using the SHISHUA algorithm
 // It writes a given amount of bytes to the output.
 void imc_crypto_prng(CryptoContext *state, size_t num_bytes, uint8_t *output)
@@ -94,7 +537,8 @@ uint64_t imc_crypto_prng_uint64(CryptoContext *state)
 }
 
 // Randomize the order of the elements in an array of pointers
-void imc_crypto_shuffle_ptr(CryptoContext *state, uintptr_t *array, size_t num_elements, bool print_status)
+// The progress is sent to 'progress' (which can be NULL).
+void imc_crypto_shuffle_ptr(CryptoContext *state, uintptr_t *array, size_t num_elements, const ProgressMonitor *progress)
 {
     if (num_elements <= 1) return;
     
@@ -112,20 +556,115 @@ void imc_crypto_shuffle_ptr(CryptoContext *state, uintptr_t *array, size_t num_e
         array[new_i] ^= array[i];
         array[i] ^= array[new_i];
 
-        if (print_status && (i % 4096 == 0))
+        if (progress && (i % 4096 == 0))
         {
-            // Print the progress if we are on "verbose" mode
-            // Note: For performance reasons, we are printing it once every 4096 steps.
+            // Report the progress if we are on "verbose" mode
+            // Note: For performance reasons, we are reporting it once every 4096 steps.
             //       The compiler can optimize (i % 4096) to (i & 4095), because 4096 is a power of 2.
             const double percent = ((double)(num_elements - i) / (double)num_elements) * 100.0;
-            printf_prog("Shuffling carrier's read/write order... %.1f %%\r", percent);
+            imc_progress_rate(progress, "Shuffling carrier's read/write order... %.1f %%\r", percent);
         }
     }
     
-    if (print_status)
+    imc_progress(progress, "Shuffling carrier's read/write order... Done!  \n");
+}
+
+// Find which of the 'count' positions on 'position' is at the array index 'index' (returns 'count' if none is)
+// 'filter' has, for each bucket of indices, how many of the positions are in it (so most indices are ruled out without a search).
+static inline size_t __shuffle_find(const size_t *position, size_t count, const uint16_t *filter, size_t index)
+{
+    if (filter[index % IMC_SHUFFLE_FILTER] == 0) return count;
+    
+    for (size_t p = 0; p < count; p++)
     {
-        printf("Shuffling carrier's read/write order... Done!  \n");
+        if (position[p] == index) return p;
     }
+
+    return count;
+}
+
+// Find which elements 'imc_crypto_shuffle_ptr()' would move to the first 'count' positions of an array of 'num_elements'
+// 'out_index' receives, for each of those positions, the index that its element had before the shuffle. The PRNG is advanced
+// in the same way as by the shuffle, but the array itself is not needed (the memory used does not depend on its size).
+// Returns IMC_ERR_NO_MEMORY if the saved states of the PRNG could not be allocated.
+int imc_crypto_shuffle_prefix(CryptoContext *state, size_t num_elements, size_t count, size_t *out_index)
+{
+    if (count > num_elements) count = num_elements;
+    for (size_t p = 0; p < count; p++) out_index[p] = p;
+    if (num_elements <= 1 || count == 0) return IMC_SUCCESS;
+
+    /* Note: The shuffle swaps the element 'i' with a random element before it, for 'i' going from the end of the array
+       to its start. Undoing those swaps in the reverse order, starting from the first positions of the shuffled array,
+       gives the indices that their elements had before the shuffle. But that needs the pseudorandom numbers in the
+       reverse order of how they were generated. So the state of the PRNG is saved every 'IMC_SHUFFLE_CHUNK' numbers,
+       then the chunks of numbers are generated again, from the last chunk to the first. */
+    
+    const size_t num_count = num_elements - 1;  // One number for each swap
+    const size_t chunk_count = (num_count + IMC_SHUFFLE_CHUNK - 1) / IMC_SHUFFLE_CHUNK;
+    
+    // The saved states of the PRNG are in locked memory, like the context itself
+    CryptoContext *const saved = sodium_allocarray(chunk_count, sizeof(CryptoContext));
+    CryptoContext *const chunk_state = sodium_malloc(sizeof(CryptoContext));
+    if (!saved || !chunk_state)
+    {
+        sodium_free(saved);
+        sodium_free(chunk_state);
+        return IMC_ERR_NO_MEMORY;
+    }
+    
+    uint64_t *const numbers = imc_malloc(IMC_SHUFFLE_CHUNK * sizeof(uint64_t));
+    uint16_t *const filter = imc_calloc(IMC_SHUFFLE_FILTER, sizeof(uint16_t));
+
+    // Generate all numbers, saving the state of the PRNG at the start of each chunk
+    for (size_t c = 0; c < chunk_count; c++)
+    {
+        saved[c] = *state;
+        sodium_memzero(saved[c].xcc20_key, sizeof(saved[c].xcc20_key));
+        const size_t chunk_size = (c == chunk_count - 1) ? num_count - c * IMC_SHUFFLE_CHUNK : IMC_SHUFFLE_CHUNK;
+        imc_crypto_prng(state, chunk_size * sizeof(uint64_t), (uint8_t *)numbers);
+    }
+
+    for (size_t p = 0; p < count; p++) filter[p % IMC_SHUFFLE_FILTER]++;
+
+    // Undo the swaps, from the last one to the first
+    for (size_t c = chunk_count; c-- > 0;)
+    {
+        *chunk_state = saved[c];
+        const size_t chunk_start = c * IMC_SHUFFLE_CHUNK;
+        const size_t chunk_size = (c == chunk_count - 1) ? num_count - chunk_start : IMC_SHUFFLE_CHUNK;
+        imc_crypto_prng(chunk_state, chunk_size * sizeof(uint64_t), (uint8_t *)numbers);
+
+        for (size_t n = chunk_size; n-- > 0;)
+        {
+            // Same indices that were swapped by the shuffle
+            const size_t i = num_elements - 1 - (chunk_start + n);
+            const size_t new_i = le64toh(numbers[n]) % i;
+            
+            const size_t at_i = __shuffle_find(out_index, count, filter, i);
+            const size_t at_new_i = __shuffle_find(out_index, count, filter, new_i);
+            
+            if (at_i < count)
+            {
+                out_index[at_i] = new_i;
+                filter[i % IMC_SHUFFLE_FILTER]--;
+                filter[new_i % IMC_SHUFFLE_FILTER]++;
+            }
+            
+            if (at_new_i < count)
+            {
+                out_index[at_new_i] = i;
+                filter[new_i % IMC_SHUFFLE_FILTER]--;
+                filter[i % IMC_SHUFFLE_FILTER]++;
+            }
+        }
+    }
+
+    sodium_memzero(numbers, IMC_SHUFFLE_CHUNK * sizeof(uint64_t));
+    imc_free(numbers);
+    imc_free(filter);
+    sodium_free(chunk_state);
+    sodium_free(saved);
+    return IMC_SUCCESS;
 }
 
 // Encrypt a data stream
@@ -244,6 +783,89 @@ int imc_crypto_decrypt(
     }
 }
 
+// Encrypt a data stream split into parts, each part becoming a message of the same encrypted stream
+// The parts are the 'part_count' consecutive pieces of 'data' with the sizes on 'part_size'. Each part is authenticated along
+// with its own 'ad_len' bytes of additional data, and written to its buffer on 'output' (which must have room for the part's
+// size plus 'crypto_secretstream_xchacha20poly1305_ABYTES'). The decryption header, shared by all parts, is written to 'header'.
+int imc_crypto_encrypt_parts(
+    const CryptoContext *state,
+    const uint8_t *data,
+    const size_t *part_size,
+    size_t part_count,
+    const uint8_t *const *ad,
+    size_t ad_len,
+    uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES],
+    uint8_t *const *output
+)
+{
+    crypto_secretstream_xchacha20poly1305_state encryption_state;
+    int status = crypto_secretstream_xchacha20poly1305_init_push(&encryption_state, header, state->xcc20_key);
+    if (status < 0) return status;
+
+    for (size_t i = 0; i < part_count; i++)
+    {
+        // Only the last part is tagged as FINAL, so a stream missing its end is detected when decrypting
+        const unsigned char tag = (i == part_count - 1)
+            ? crypto_secretstream_xchacha20poly1305_TAG_FINAL
+            : crypto_secretstream_xchacha20poly1305_TAG_MESSAGE;
+        
+        status = crypto_secretstream_xchacha20poly1305_push(
+            &encryption_state, output[i], NULL, data, part_size[i], ad[i], ad_len, tag
+        );
+        if (status < 0) break;
+        
+        data += part_size[i];
+    }
+
+    sodium_memzero(&encryption_state, sizeof(encryption_state));
+    return status;
+}
+
+// Decrypt the parts of a stream encrypted by 'imc_crypto_encrypt_parts()', in the same order as they were encrypted
+// Each part on 'data' has the size on 'data_len', and its additional data on 'ad'. The decrypted parts are written one after
+// another to 'output', which must have room for all of them (each part loses 'crypto_secretstream_xchacha20poly1305_ABYTES').
+// Fails if any part was modified, if the parts are out of order, or if the stream does not end on the last part.
+int imc_crypto_decrypt_parts(
+    const CryptoContext *state,
+    const uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES],
+    const uint8_t *const *data,
+    const size_t *data_len,
+    size_t part_count,
+    const uint8_t *const *ad,
+    size_t ad_len,
+    uint8_t *output
+)
+{
+    crypto_secretstream_xchacha20poly1305_state decryption_state;
+    int status = crypto_secretstream_xchacha20poly1305_init_pull(&decryption_state, header, state->xcc20_key);
+    if (status < 0) return status;
+
+    uint8_t *out_pos = output;
+
+    for (size_t i = 0; i < part_count; i++)
+    {
+        unsigned long long out_len = 0;
+        unsigned char tag = 0;
+        status = crypto_secretstream_xchacha20poly1305_pull(
+            &decryption_state, out_pos, &out_len, &tag, data[i], data_len[i], ad[i], ad_len
+        );
+        if (status < 0) break;
+        out_pos += out_len;
+
+        // The FINAL tag must be on the last part, and only there
+        const bool is_final = (tag == crypto_secretstream_xchacha20poly1305_TAG_FINAL);
+        if (is_final != (i == part_count - 1))
+        {
+            status = -1;
+            break;
+        }
+    }
+
+    if (status < 0) sodium_memzero(output, out_pos - output);
+    sodium_memzero(&decryption_state, sizeof(decryption_state));
+    return status;
+}
+
 // Free the memory used by the cryptographic secrets
 void imc_crypto_context_destroy(CryptoContext *state)
 {
@@ -14,7 +14,8 @@
 // for storing the size of the stream following it).
 // libsodium adds a 24 bytes header (used for decryption), and 17 bytes on the stream itself.
 // Total: 53 bytes
-#define IMC_HEADER_OVERHEAD (12 + crypto_secretstream_xchacha20poly1305_HEADERBYTES)
+#define IMC_SEGMENT_META_SIZE 12  // Magic bytes, version, and size of the encrypted stream
+#define IMC_HEADER_OVERHEAD (IMC_SEGMENT_META_SIZE + crypto_secretstream_xchacha20poly1305_HEADERBYTES)
 #define IMC_CRYPTO_OVERHEAD (IMC_HEADER_OVERHEAD + crypto_secretstream_xchacha20poly1305_ABYTES)
 
 // Signature that this program will add to the beginning of the data stream that was hidden
@@ -26,6 +27,30 @@
 // Note: Maximum size is 16 characters, it will be truncated if beyond that.
 #define IMC_SALT "imageconceal2023"
 
+// Size in bytes of the secrets derived from the password
+// The first 32 bytes are the encryption key, and the last 32 bytes are the seed of the pseudorandom number generator.
+#define IMC_SECRET_SIZE (crypto_secretstream_xchacha20poly1305_KEYBYTES + 32)
+
+// Signatures at the beginning of the key files
+#define IMC_KEYFILE_MAGIC       "imck"  // Secrets derived from a password
+#define IMC_PUBLIC_KEY_MAGIC    "imcp"  // X25519 public key of a recipient
+#define IMC_SECRET_KEY_MAGIC    "imcs"  // X25519 secret key of a recipient
+
+// Amount of bytes that a key file has besides the key itself
+// 4 bytes for the magic, 4 bytes for the version, and (after the key) a BLAKE2b checksum of everything before it.
+#define IMC_KEYFILE_OVERHEAD (8 + crypto_generichash_BYTES)
+
+// Recipient mode: the hidden data is encrypted to a X25519 public key instead of a password
+// The sender generates an ephemeral key pair for each image, and the session secrets are hashed from the
+// X25519 shared secret. The ephemeral public key is written to 256 carrier bits chosen by a PRNG seeded
+// with the recipient's public key (see 'imc_steg_init_recipient()'). Anyone with the recipient's public key
+// can read those bits, so the key is stored as its Elligator 2 representative, which looks like random bytes
+// (see 'imc_elligator.h'). Those bits are removed from the carrier, then the remaining ones are shuffled with
+// the session secrets in the same way as when using a password.
+// The domain string goes into all hashes of the recipient mode, and it must change if this scheme ever changes.
+#define IMC_RECIPIENT_DOMAIN "imgconceal-x25519-v2"
+#define IMC_RECIPIENT_LOCATOR_BITS (crypto_box_PUBLICKEYBYTES * 8)
+
 // How many bytes the buffer of the pseudorandom number generator holds
 // Each time the generator function is called, it generates that many bytes and stores them on the buffer.
 // Then our program can request a certain number of bytes, which are taken from the buffer.
@@ -33,6 +58,21 @@
 // IMPORTANT: This value must be a multiple of 128.
 #define IMC_PRNG_BUFFER 128
 
+// Amount of pseudorandom numbers between each saved state of the PRNG, when finding the start of a shuffled array
+#define IMC_SHUFFLE_CHUNK 65536
+
+// Amount of buckets of the filter that tells which positions of the shuffled array are being followed
+#define IMC_SHUFFLE_FILTER 65536
+
+#define IMC_PASSWORD_MAX_BYTES 4080     // Size (in bytes) of the password buffer
+
+// Buffer for the plaintext password
+typedef struct PassBuff {
+    size_t capacity;    // The maximum amount of bytes that the buffer can store
+    size_t length;      // The current amount of bytes stored on the buffer
+    uint8_t buffer[IMC_PASSWORD_MAX_BYTES]; // Array of bytes with the plaintext password
+} PassBuff;
+
 // Stores the secret key for encryption and the state of the pseudorandom number generator
 typedef struct CryptoContext
 {
@@ -44,9 +84,85 @@ typedef struct CryptoContext
     } prng_buffer;
 } CryptoContext;
 
+// Copy a plaintext password of 'length' bytes to a new password buffer (in locked memory)
+// The buffer should be freed with 'imc_crypto_password_free()'. Returns IMC_ERR_INVALID_PASS if the password is too long.
+int imc_crypto_password_create(const uint8_t *text, size_t length, PassBuff **out);
+
+// Clear and free a password buffer
+void imc_crypto_password_free(PassBuff *password);
+
 // Generate cryptographic secrets key from a password
 int imc_crypto_context_create(const PassBuff *password, CryptoContext **out);
 
+// Hash the password into the secrets used by the program (encryption key and PRNG seed)
+// The output buffer must be able to hold 'IMC_SECRET_SIZE' bytes, and it should be in locked memory.
+int imc_crypto_derive_secret(const PassBuff *password, uint8_t *secret);
+
+// Initialize the encryption key and the PRNG from secrets previously derived from a password
+int imc_crypto_context_from_secret(const uint8_t *secret, CryptoContext **out);
+
+// Make an independent copy of a cryptographic context (including the current state of the PRNG)
+int imc_crypto_context_clone(const CryptoContext *state, CryptoContext **out);
+
+// Save the secrets derived from a password to a key file
+// The file is created with read and write permissions only for the current user, and it is never overwritten.
+int imc_crypto_keyfile_save(const char *path, const uint8_t *secret);
+
+// Load the secrets stored on a key file
+// The output is allocated in locked memory, which should be freed with 'sodium_free()'.
+int imc_crypto_keyfile_load(const char *path, uint8_t **secret);
+
+// Generate a X25519 key pair for the recipient mode, and save it to two files:
+// the secret key to 'path', and the public key to 'path' with the '.pub' extension added.
+// The secret key is written with read and write permissions only for the current user.
+int imc_crypto_keypair_save(const char *path);
+
+// Load the public key of a recipient from a file created by 'imc_crypto_keypair_save()'
+// The output is allocated in locked memory, which should be freed with 'sodium_free()'.
+int imc_crypto_public_key_load(const char *path, uint8_t **public_key);
+
+// Load the secret key of a recipient from a file created by 'imc_crypto_keypair_save()'
+// The output is allocated in locked memory, which should be freed with 'sodium_free()'.
+int imc_crypto_secret_key_load(const char *path, uint8_t **secret_key);
+
+// Create a new file with read and write permissions only for the current user (fails if the file already exists)
+// On failure, NULL is returned and 'errno' is set ('EEXIST' if the file exists).
+static FILE *__keyfile_create(const char *path);
+
+// Write 'size' bytes of key material to a new file, preceded by the magic bytes and the version, and followed by a checksum
+static int __keyfile_write(const char *path, const char *magic, const uint8_t *data, size_t size);
+
+// Read the 'size' bytes of key material from a file written by '__keyfile_write()' with the same magic bytes
+// The output is allocated in locked memory, which should be freed with 'sodium_free()'.
+static int __keyfile_read(const char *path, const char *magic, size_t size, uint8_t **out);
+
+// Hash some data into the 64 bytes used to initialize a cryptographic context on the recipient mode
+// The hash is separated by the version string of the recipient mode and by a label of what the hash is used for.
+static void __recipient_hash(const char *label, const uint8_t *data, size_t data_len, uint8_t *secret);
+
+// Initialize the PRNG that chooses the carrier positions of the ephemeral public key, on the recipient mode
+// It only depends on the recipient's public key, so both the sender and the recipient can find the ephemeral key.
+int imc_crypto_locator_context(const uint8_t *recipient_pk, CryptoContext **out);
+
+// Generate the session secrets from the X25519 shared secret, on the recipient mode
+// (the secrets are bound to both the ephemeral public key and the recipient's public key)
+static int __recipient_session(
+    const uint8_t *shared,
+    const uint8_t *ephemeral_pk,
+    const uint8_t *recipient_pk,
+    CryptoContext **out
+);
+
+// Sender side of the recipient mode: generate an ephemeral key pair, then derive the session secrets
+// from the shared secret between the ephemeral key and the recipient's public key.
+// The representative of the ephemeral public key is written to 'representative' (it needs to be stored with the hidden data).
+// It looks like random bytes, and the recipient gets the public key back with 'imc_elligator_decode()'.
+int imc_crypto_recipient_seal(const uint8_t *recipient_pk, uint8_t *representative, CryptoContext **out);
+
+// Recipient side of the recipient mode: derive the session secrets from the
+// shared secret between the recipient's secret key and the ephemeral public key (decoded from its representative)
+int imc_crypto_recipient_open(const uint8_t *secret_key, const uint8_t *representative, CryptoContext **out);
+
 // Pseudorandom number generator using the SHISHUA algorithm
 // It writes a given amount of bytes to the output.
 void imc_crypto_prng(CryptoContext *state, size_t num_bytes, uint8_t *output);
@@ -55,7 +171,18 @@ void imc_crypto_prng(CryptoContext *state, size_t num_bytes, uint8_t *output);
 uint64_t imc_crypto_prng_uint64(CryptoContext *state);
 
 // Randomize the order of the elements in an array of pointers
-void imc_crypto_shuffle_ptr(CryptoContext *state, uintptr_t *array, size_t num_elements, bool print_status);
+// The progress is sent to 'progress' (which can be NULL).
+void imc_crypto_shuffle_ptr(CryptoContext *state, uintptr_t *array, size_t num_elements, const ProgressMonitor *progress);
+
+// Find which of the 'count' positions on 'position' is at the array index 'index' (returns 'count' if none is)
+// 'filter' has, for each bucket of indices, how many of the positions are in it (so most indices are ruled out without a search).
+static inline size_t __shuffle_find(const size_t *position, size_t count, const uint16_t *filter, size_t index);
+
+// Find which elements 'imc_crypto_shuffle_ptr()' would move to the first 'count' positions of an array of 'num_elements'
+// 'out_index' receives, for each of those positions, the index that its element had before the shuffle. The PRNG is advanced
+// in the same way as by the shuffle, but the array itself is not needed (the memory used does not depend on its size).
+// Returns IMC_ERR_NO_MEMORY if the saved states of the PRNG could not be allocated.
+int imc_crypto_shuffle_prefix(CryptoContext *state, size_t num_elements, size_t count, size_t *out_index);
 
 // Encrypt a data stream
 int imc_crypto_encrypt(
@@ -76,6 +203,36 @@ int imc_crypto_decrypt(
     unsigned long long *output_len
 );
 
+// Encrypt a data stream split into parts, each part becoming a message of the same encrypted stream
+// The parts are the 'part_count' consecutive pieces of 'data' with the sizes on 'part_size'. Each part is authenticated along
+// with its own 'ad_len' bytes of additional data, and written to its buffer on 'output' (which must have room for the part's
+// size plus 'crypto_secretstream_xchacha20poly1305_ABYTES'). The decryption header, shared by all parts, is written to 'header'.
+int imc_crypto_encrypt_parts(
+    const CryptoContext *state,
+    const uint8_t *data,
+    const size_t *part_size,
+    size_t part_count,
+    const uint8_t *const *ad,
+    size_t ad_len,
+    uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES],
+    uint8_t *const *output
+);
+
+// Decrypt the parts of a stream encrypted by 'imc_crypto_encrypt_parts()', in the same order as they were encrypted
+// Each part on 'data' has the size on 'data_len', and its additional data on 'ad'. The decrypted parts are written one after
+// another to 'output', which must have room for all of them (each part loses 'crypto_secretstream_xchacha20poly1305_ABYTES').
+// Fails if any part was modified, if the parts are out of order, or if the stream does not end on the last part.
+int imc_crypto_decrypt_parts(
+    const CryptoContext *state,
+    const uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES],
+    const uint8_t *const *data,
+    const size_t *data_len,
+    size_t part_count,
+    const uint8_t *const *ad,
+    size_t ad_len,
+    uint8_t *output
+);
+
 // Free the memory used by the cryptographic secrets
 void imc_crypto_context_destroy(CryptoContext *state);
 
@@ -0,0 +1,321 @@
+/* Encoding X25519 public keys as bytes that cannot be told apart from random data (Elligator 2). */
+
+#include "imc_includes.h"
+
+// Coefficient A of Curve25519
+#define IMC_CURVE_A 486662
+
+// Exponents used for the inverse, the Legendre symbol, and the square roots
+static const uint8_t fe_exp_inverse[32] = IMC_FE_EXPONENT(0xEB, 0x7F);     // p - 2
+static const uint8_t fe_exp_legendre[32] = IMC_FE_EXPONENT(0xF6, 0x3F);    // (p - 1) / 2
+static const uint8_t fe_exp_sqrt[32] = IMC_FE_EXPONENT(0xFE, 0x0F);        // (p + 3) / 8
+static const uint8_t fe_exp_sqrt_m1[32] = IMC_FE_EXPONENT(0xFB, 0x1F);     // (p - 1) / 4
+
+// Largest representative: (p - 1) / 2 (little-endian)
+static const uint8_t fe_half[32] = IMC_FE_EXPONENT(0xF6, 0x3F);
+
+// Ed25519 point of order 8 (its multiples are all the points of low order)
+static const uint8_t ed25519_order8[32] = {
+    0x26, 0xE8, 0x95, 0x8F, 0xC2, 0xB2, 0x27, 0xB0, 0x45, 0xC3, 0xF4, 0x89, 0xF2, 0xEF, 0x98, 0xF0,
+    0xD5, 0xDF, 0xAC, 0x05, 0xD3, 0xC6, 0x33, 0x39, 0xB1, 0x38, 0x02, 0x88, 0x6D, 0x53, 0xFC, 0x05
+};
+
+// Copy a field element
+static inline void __fe_copy(imc_fe out, const imc_fe a)
+{
+    for (size_t i = 0; i < 16; i++) out[i] = a[i];
+}
+
+// Set a field element to a small integer
+static inline void __fe_set(imc_fe out, int64_t value)
+{
+    out[0] = value;
+    for (size_t i = 1; i < 16; i++) out[i] = 0;
+    __fe_carry(out);
+}
+
+// Propagate the carries between the limbs (the amount over 2^255 is folded back as 38 times the amount over 2^256)
+static void __fe_carry(imc_fe a)
+{
+    for (size_t i = 0; i < 16; i++)
+    {
+        const int64_t carry = a[i] >> 16;
+        a[i] -= carry * 65536;
+
+        if (i < 15) a[i + 1] += carry;
+        else a[0] += 38 * carry;
+    }
+}
+
+// Sum of two field elements
+static inline void __fe_add(imc_fe out, const imc_fe a, const imc_fe b)
+{
+    for (size_t i = 0; i < 16; i++) out[i] = a[i] + b[i];
+}
+
+// Difference of two field elements
+static inline void __fe_sub(imc_fe out, const imc_fe a, const imc_fe b)
+{
+    for (size_t i = 0; i < 16; i++) out[i] = a[i] - b[i];
+}
+
+// Product of two field elements
+static void __fe_mul(imc_fe out, const imc_fe a, const imc_fe b)
+{
+    int64_t product[31] = {0};
+
+    for (size_t i = 0; i < 16; i++)
+    {
+        for (size_t j = 0; j < 16; j++) product[i + j] += a[i] * b[j];
+    }
+
+    // 2^256 is congruent to 38
+    for (size_t i = 0; i < 15; i++) product[i] += 38 * product[i + 16];
+    for (size_t i = 0; i < 16; i++) out[i] = product[i];
+
+    __fe_carry(out);
+    __fe_carry(out);
+}
+
+// Raise a field element to an exponent of 32 bytes (little-endian)
+// The exponent is always a constant, so the sequence of operations does not depend on secret values.
+static void __fe_pow(imc_fe out, const imc_fe base, const uint8_t *exponent)
+{
+    imc_fe value, result;
+    __fe_copy(value, base);
+    __fe_set(result, 1);
+
+    for (int bit = 255; bit >= 0; bit--)
+    {
+        __fe_mul(result, result, result);
+        if ((exponent[bit / 8] >> (bit % 8)) & 1) __fe_mul(result, result, value);
+    }
+
+    __fe_copy(out, result);
+}
+
+// Swap two field elements if 'swap' is 1, or leave them as they are if it is 0 (without branching on 'swap')
+static void __fe_swap(imc_fe a, imc_fe b, int64_t swap)
+{
+    const int64_t mask = -swap;
+
+    for (size_t i = 0; i < 16; i++)
+    {
+        const int64_t diff = mask & (a[i] ^ b[i]);
+        a[i] ^= diff;
+        b[i] ^= diff;
+    }
+}
+
+// Write the fully reduced value of a field element to 32 bytes (little-endian)
+static void __fe_pack(uint8_t *out, const imc_fe a)
+{
+    imc_fe value, reduced;
+    __fe_copy(value, a);
+    __fe_carry(value);
+    __fe_carry(value);
+    __fe_carry(value);
+
+    // Subtract p up to two times, keeping the result only when it did not go below zero
+    for (size_t round = 0; round < 2; round++)
+    {
+        reduced[0] = value[0] - 0xFFED;
+        for (size_t i = 1; i < 15; i++)
+        {
+            reduced[i] = value[i] - 0xFFFF - ((reduced[i - 1] >> 16) & 1);
+            reduced[i - 1] &= 0xFFFF;
+        }
+        reduced[15] = value[15] - 0x7FFF - ((reduced[14] >> 16) & 1);
+        reduced[14] &= 0xFFFF;
+
+        const int64_t borrow = (reduced[15] >> 16) & 1;
+        __fe_swap(value, reduced, 1 - borrow);
+    }
+
+    for (size_t i = 0; i < 16; i++)
+    {
+        out[2 * i] = (uint8_t)(value[i] & 0xFF);
+        out[2 * i + 1] = (uint8_t)(value[i] >> 8);
+    }
+}
+
+// Read a field element from 32 bytes (little-endian), ignoring the highest bit
+static void __fe_unpack(imc_fe out, const uint8_t *in)
+{
+    for (size_t i = 0; i < 16; i++) out[i] = (int64_t)in[2 * i] | ((int64_t)in[2 * i + 1] << 8);
+    out[15] &= 0x7FFF;
+}
+
+// Whether two field elements are equal (1) or not (0)
+static int __fe_equal(const imc_fe a, const imc_fe b)
+{
+    uint8_t bytes_a[32], bytes_b[32];
+    __fe_pack(bytes_a, a);
+    __fe_pack(bytes_b, b);
+    return sodium_memcmp(bytes_a, bytes_b, 32) == 0;
+}
+
+// Square root of a field element
+// Returns false if the element is not a square.
+static bool __fe_sqrt(imc_fe out, const imc_fe a)
+{
+    // Since p = 5 (mod 8), a^((p + 3) / 8) is a square root of either 'a' or '-a'
+    // (in the second case, it gets multiplied by a square root of -1)
+    imc_fe root, square, negative, zero;
+    __fe_pow(root, a, fe_exp_sqrt);
+    __fe_mul(square, root, root);
+    __fe_set(zero, 0);
+    __fe_sub(negative, zero, a);
+
+    if (__fe_equal(square, negative))
+    {
+        imc_fe two, sqrt_m1;
+        __fe_set(two, 2);
+        __fe_pow(sqrt_m1, two, fe_exp_sqrt_m1);
+        __fe_mul(root, root, sqrt_m1);
+    }
+    else if (!__fe_equal(square, a))
+    {
+        return false;
+    }
+
+    __fe_copy(out, root);
+    return true;
+}
+
+// Map a representative (32 bytes, whose two highest bits are ignored) to the X25519 public key that it represents
+void imc_elligator_decode(const uint8_t *representative, uint8_t *public_key)
+{
+    uint8_t bytes[32];
+    memcpy(bytes, representative, 32);
+    bytes[31] &= 0x3F;
+
+    imc_fe r, one, curve_a, zero, w, temp, value;
+    __fe_unpack(r, bytes);
+    __fe_set(one, 1);
+    __fe_set(curve_a, IMC_CURVE_A);
+    __fe_set(zero, 0);
+
+    // w = -A / (1 + 2*r^2)
+    // (the denominator is never zero, because -1/2 is not a square)
+    __fe_mul(temp, r, r);
+    __fe_add(temp, temp, temp);
+    __fe_add(temp, temp, one);
+    __fe_pow(temp, temp, fe_exp_inverse);
+    __fe_mul(temp, temp, curve_a);
+    __fe_sub(w, zero, temp);
+
+    // w^3 + A*w^2 + w = w * (w * (w + A) + 1)
+    __fe_add(value, w, curve_a);
+    __fe_mul(value, value, w);
+    __fe_add(value, value, one);
+    __fe_mul(value, value, w);
+
+    // The Legendre symbol is p - 1 when the value is not a square, in which case the coordinate is -w - A
+    imc_fe legendre, minus_one, other;
+    __fe_pow(legendre, value, fe_exp_legendre);
+    __fe_sub(minus_one, zero, one);
+    __fe_sub(other, zero, w);
+    __fe_sub(other, other, curve_a);
+    __fe_swap(w, other, __fe_equal(legendre, minus_one));
+
+    __fe_pack(public_key, w);
+}
+
+// Find the representative of a X25519 public key, with its two highest bits set to 'tweak'
+// Returns false if the key has no representative.
+static bool __elligator_encode(const uint8_t *public_key, uint8_t tweak, uint8_t *representative)
+{
+    imc_fe u, curve_a, zero, numerator, denominator, r;
+    __fe_unpack(u, public_key);
+    __fe_set(curve_a, IMC_CURVE_A);
+    __fe_set(zero, 0);
+
+    // The points with u = 0 or u = -A are left out
+    __fe_add(numerator, u, curve_a);
+    if (__fe_equal(u, zero) || __fe_equal(numerator, zero)) return false;
+
+    // r = sqrt(-(u + A) / (2*u))
+    __fe_sub(numerator, zero, numerator);
+    __fe_add(denominator, u, u);
+    __fe_pow(denominator, denominator, fe_exp_inverse);
+    __fe_mul(r, numerator, denominator);
+    if (!__fe_sqrt(r, r)) return false;
+
+    // Both 'r' and '-r' map to the same point, and the one used is the smaller
+    __fe_pack(representative, r);
+    for (int i = 31; i >= 0; i--)
+    {
+        if (representative[i] == fe_half[i]) continue;
+
+        if (representative[i] > fe_half[i])
+        {
+            __fe_sub(r, zero, r);
+            __fe_pack(representative, r);
+        }
+
+        break;
+    }
+
+    representative[31] |= (uint8_t)(tweak << 6);
+    return true;
+}
+
+// Generate a X25519 key pair whose public key is on the whole curve (not only on its prime order subgroup),
+// and which has a representative. The secret key works with 'crypto_scalarmult()' in the usual way.
+// Returns IMC_ERR_CRYPTO_FAIL if the point operations of libsodium failed.
+int imc_elligator_keypair(uint8_t *representative, uint8_t *public_key, uint8_t *secret_key)
+{
+    uint8_t *const scalar = sodium_malloc(crypto_scalarmult_SCALARBYTES);
+    if (!scalar) return IMC_ERR_NO_MEMORY;
+
+    int status = IMC_SUCCESS;
+    bool found = false;
+
+    // About half of the keys have a representative
+    while (!found)
+    {
+        randombytes_buf(secret_key, crypto_scalarmult_SCALARBYTES);
+
+        // Same scalar as the one used by 'crypto_scalarmult()'
+        memcpy(scalar, secret_key, crypto_scalarmult_SCALARBYTES);
+        scalar[0] &= 248;
+        scalar[31] &= 127;
+        scalar[31] |= 64;
+
+        // The three lowest bits of the secret key are not part of the scalar, so they choose the point of low order
+        uint8_t point[32];
+        uint8_t low_order[32] = {1};
+        for (uint8_t i = 0; i < (secret_key[0] & 7); i++)
+        {
+            if (crypto_core_ed25519_add(low_order, low_order, ed25519_order8) != 0) status = IMC_ERR_CRYPTO_FAIL;
+        }
+
+        if (crypto_scalarmult_ed25519_base_noclamp(point, scalar) != 0) status = IMC_ERR_CRYPTO_FAIL;
+        if (crypto_core_ed25519_add(point, point, low_order) != 0) status = IMC_ERR_CRYPTO_FAIL;
+        if (status != IMC_SUCCESS) break;
+
+        // Coordinate on Curve25519 of the Ed25519 point: u = (1 + y) / (1 - y)
+        imc_fe y, one, numerator, denominator;
+        __fe_unpack(y, point);
+        __fe_set(one, 1);
+        __fe_add(numerator, one, y);
+        __fe_sub(denominator, one, y);
+        __fe_pow(denominator, denominator, fe_exp_inverse);
+        __fe_mul(numerator, numerator, denominator);
+        __fe_pack(public_key, numerator);
+
+        found = __elligator_encode(public_key, (uint8_t)randombytes_uniform(4), representative);
+    }
+
+    // Check that the representative gives back the same public key
+    if (status == IMC_SUCCESS)
+    {
+        uint8_t decoded[crypto_scalarmult_BYTES];
+        imc_elligator_decode(representative, decoded);
+        if (sodium_memcmp(decoded, public_key, crypto_scalarmult_BYTES) != 0) status = IMC_ERR_CRYPTO_FAIL;
+    }
+
+    sodium_free(scalar);
+    return status;
+}
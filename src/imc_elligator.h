@@ -0,0 +1,91 @@
+/* Encoding X25519 public keys as bytes that cannot be told apart from random data (Elligator 2). */
+
+#ifndef _IMC_ELLIGATOR_H
+#define _IMC_ELLIGATOR_H
+
+#include "imc_includes.h"
+
+/*  A X25519 public key is the u-coordinate of a point on Curve25519 (v^2 = u^3 + A*u^2 + u, with A = 486662),
+    so its bytes are not random: the highest bit is always 0, and only about half of the numbers are coordinates
+    of a point. On top of that, the points made by 'crypto_box_keypair()' are all on the subgroup of prime order,
+    which has 1/8 of the points of the curve. Those keys would be noticed after reading a few cover images.
+
+    Elligator 2 maps a number 'r' from 0 to (p - 1) / 2 (where p = 2^255 - 19) to a point of the curve:
+        w = -A / (1 + 2*r^2)
+        u = w           if w^3 + A*w^2 + w is a square
+        u = -w - A      otherwise
+    About half of the points have such a number (their "representative"), and the representatives of uniformly
+    random points are uniformly random numbers. The inverse used here is r = sqrt(-(u + A) / (2*u)), which
+    exists when -2*u*(u + A) is a square, and which gives w = u on the map above.
+
+    In order to get points on the whole curve, the public key gets a random point of low order added to it
+    (one of the 8 multiples of a point of order 8). The X25519 secret key of the recipient is a multiple of 8,
+    so that point vanishes on the key exchange, and the shared secret is the same as without it. Key pairs
+    are generated until the public key has a representative, which is stored on 254 bits, with the other
+    2 bits of the 32 bytes set at random.
+
+    The field arithmetic uses 16 limbs of 16 bits on signed 64-bit integers (in the same way as TweetNaCl).
+    Its running time does not depend on the values, except on the encoding of a public key (which is not secret).
+*/
+
+// Element of the field of integers modulo 2^255 - 19 (16 limbs of 16 bits, least significant first)
+typedef int64_t imc_fe[16];
+
+// Exponent (little-endian) of the form: 'high' * 2^248 + (2^248 - 256) + 'low'
+// (all exponents used for the field have 30 bytes of 0xFF in the middle)
+#define IMC_FE_EXPONENT(low, high) { \
+    low, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, \
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, high \
+}
+
+// Copy a field element
+static inline void __fe_copy(imc_fe out, const imc_fe a);
+
+// Set a field element to a small integer
+static inline void __fe_set(imc_fe out, int64_t value);
+
+// Propagate the carries between the limbs (the amount over 2^255 is folded back as 38 times the amount over 2^256)
+static void __fe_carry(imc_fe a);
+
+// Sum of two field elements
+static inline void __fe_add(imc_fe out, const imc_fe a, const imc_fe b);
+
+// Difference of two field elements
+static inline void __fe_sub(imc_fe out, const imc_fe a, const imc_fe b);
+
+// Product of two field elements
+static void __fe_mul(imc_fe out, const imc_fe a, const imc_fe b);
+
+// Raise a field element to an exponent of 32 bytes (little-endian)
+// The exponent is always a constant, so the sequence of operations does not depend on secret values.
+static void __fe_pow(imc_fe out, const imc_fe base, const uint8_t *exponent);
+
+// Swap two field elements if 'swap' is 1, or leave them as they are if it is 0 (without branching on 'swap')
+static void __fe_swap(imc_fe a, imc_fe b, int64_t swap);
+
+// Write the fully reduced value of a field element to 32 bytes (little-endian)
+static void __fe_pack(uint8_t *out, const imc_fe a);
+
+// Read a field element from 32 bytes (little-endian), ignoring the highest bit
+static void __fe_unpack(imc_fe out, const uint8_t *in);
+
+// Whether two field elements are equal (1) or not (0)
+static int __fe_equal(const imc_fe a, const imc_fe b);
+
+// Square root of a field element
+// Returns false if the element is not a square.
+static bool __fe_sqrt(imc_fe out, const imc_fe a);
+
+// Map a representative (32 bytes, whose two highest bits are ignored) to the X25519 public key that it represents
+void imc_elligator_decode(const uint8_t *representative, uint8_t *public_key);
+
+// Find the representative of a X25519 public key, with its two highest bits set to 'tweak'
+// Returns false if the key has no representative.
+static bool __elligator_encode(const uint8_t *public_key, uint8_t tweak, uint8_t *representative);
+
+// Generate a X25519 key pair whose public key is on the whole curve (not only on its prime order subgroup),
+// and which has a representative. The secret key works with 'crypto_scalarmult()' in the usual way.
+// Returns IMC_ERR_CRYPTO_FAIL if the point operations of libsodium failed.
+int imc_elligator_keypair(uint8_t *representative, uint8_t *public_key, uint8_t *secret_key);
+
+#endif  // _IMC_ELLIGATOR_H
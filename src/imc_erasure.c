@@ -0,0 +1,396 @@
+/* Reed-Solomon erasure code over GF(2^8), for rebuilding the missing shards of a file from its parity shards. */
+
+#include "imc_includes.h"
+
+// Logarithms and powers of the generator (2) on GF(2^8)
+// (the exponential table is doubled, so the sum of two logarithms can be looked up without a modulo)
+static uint8_t gf_log[256];
+static uint8_t gf_exp[512];
+
+// Region multiplication chosen for this processor, and its name
+static imc_gf_region_func gf_region = NULL;
+static const char *gf_kernel = "scalar";
+
+// The tables are built only once, by the first thread that needs them
+static pthread_once_t gf_once = PTHREAD_ONCE_INIT;
+
+// Build the logarithm and exponential tables of GF(2^8), and choose the fastest region multiplication
+static void __gf_init()
+{
+    unsigned int value = 1;
+    for (size_t i = 0; i < 255; i++)
+    {
+        gf_exp[i] = (uint8_t)value;
+        gf_log[value] = (uint8_t)i;
+        value <<= 1;
+        if (value & 0x100) value ^= 0x11D;  // Reduce by the polynomial x^8 + x^4 + x^3 + x^2 + 1
+    }
+
+    for (size_t i = 255; i < 512; i++) gf_exp[i] = gf_exp[i - 255];
+
+    gf_region = &__gf_region_scalar;
+
+    #if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        gf_region = &__gf_region_avx2;
+        gf_kernel = "AVX2";
+    }
+    else if (__builtin_cpu_supports("ssse3"))
+    {
+        gf_region = &__gf_region_ssse3;
+        gf_kernel = "SSSE3";
+    }
+    #endif  // x86
+}
+
+// Product of two elements of GF(2^8)
+static inline uint8_t __gf_mul(uint8_t a, uint8_t b)
+{
+    if (a == 0 || b == 0) return 0;
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+// Multiplicative inverse of a nonzero element of GF(2^8)
+static inline uint8_t __gf_inv(uint8_t a)
+{
+    return gf_exp[255 - gf_log[a]];
+}
+
+// Products of 'factor' by the values of the low 4 bits (0x00 to 0x0F) and of the high 4 bits (0x00 to 0xF0) of a byte
+static void __gf_nibble_tables(uint8_t factor, uint8_t *low, uint8_t *high)
+{
+    for (size_t i = 0; i < 16; i++)
+    {
+        low[i] = __gf_mul(factor, (uint8_t)i);
+        high[i] = __gf_mul(factor, (uint8_t)(i << 4));
+    }
+}
+
+// Multiply a region of bytes by a constant, one byte at a time (used when the processor has no 'pshufb' instruction)
+static void __gf_region_scalar(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate)
+{
+    uint8_t low[16], high[16];
+    __gf_nibble_tables(factor, low, high);
+
+    if (accumulate)
+    {
+        for (size_t i = 0; i < size; i++) dst[i] ^= low[src[i] & 0x0F] ^ high[src[i] >> 4];
+    }
+    else
+    {
+        for (size_t i = 0; i < size; i++) dst[i] = low[src[i] & 0x0F] ^ high[src[i] >> 4];
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Multiply a region of bytes by a constant, 16 bytes at a time (SSSE3)
+__attribute__ ((target ("ssse3")))
+static void __gf_region_ssse3(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate)
+{
+    uint8_t low[16], high[16];
+    __gf_nibble_tables(factor, low, high);
+
+    const __m128i table_low = _mm_loadu_si128((const __m128i *)low);
+    const __m128i table_high = _mm_loadu_si128((const __m128i *)high);
+    const __m128i mask = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        // Each 4-bit half of the bytes selects its product from the tables, then both halves are added
+        const __m128i value = _mm_loadu_si128((const __m128i *)&src[i]);
+        const __m128i nibble_low = _mm_and_si128(value, mask);
+        const __m128i nibble_high = _mm_and_si128(_mm_srli_epi64(value, 4), mask);
+        __m128i product = _mm_xor_si128(_mm_shuffle_epi8(table_low, nibble_low), _mm_shuffle_epi8(table_high, nibble_high));
+
+        if (accumulate) product = _mm_xor_si128(product, _mm_loadu_si128((const __m128i *)&dst[i]));
+        _mm_storeu_si128((__m128i *)&dst[i], product);
+    }
+
+    // Bytes left after the last full block
+    if (i < size) __gf_region_scalar(&dst[i], &src[i], factor, size - i, accumulate);
+}
+
+// Multiply a region of bytes by a constant, 32 bytes at a time (AVX2)
+__attribute__ ((target ("avx2")))
+static void __gf_region_avx2(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate)
+{
+    uint8_t low[16], high[16];
+    __gf_nibble_tables(factor, low, high);
+
+    // 'vpshufb' looks up each 128-bit lane separately, so both lanes get a copy of the tables
+    const __m256i table_low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)low));
+    const __m256i table_high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)high));
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        const __m256i value = _mm256_loadu_si256((const __m256i *)&src[i]);
+        const __m256i nibble_low = _mm256_and_si256(value, mask);
+        const __m256i nibble_high = _mm256_and_si256(_mm256_srli_epi64(value, 4), mask);
+        __m256i product = _mm256_xor_si256(_mm256_shuffle_epi8(table_low, nibble_low), _mm256_shuffle_epi8(table_high, nibble_high));
+
+        if (accumulate) product = _mm256_xor_si256(product, _mm256_loadu_si256((const __m256i *)&dst[i]));
+        _mm256_storeu_si256((__m256i *)&dst[i], product);
+    }
+
+    if (i < size) __gf_region_scalar(&dst[i], &src[i], factor, size - i, accumulate);
+}
+
+#endif  // x86
+
+// Coefficient of a data shard on a parity shard (an element of the Cauchy matrix)
+static inline uint8_t __cauchy(size_t parity, size_t data, size_t data_count)
+{
+    // The parity shards use the field elements after those of the data shards, so the sum is never zero
+    return __gf_inv((uint8_t)((data_count + parity) ^ data));
+}
+
+// Invert a square matrix of GF(2^8) in place (Gauss-Jordan elimination)
+// Returns 'false' if the matrix is singular (which does not happen for the rows of the code's matrix).
+static bool __gf_invert(uint8_t *matrix, size_t size)
+{
+    // The matrix is extended with the identity on its right side, and the operations that turn
+    // the left side into the identity turn the right side into the inverse
+    const size_t width = size * 2;
+    uint8_t *const work = imc_calloc(size * width, 1);
+
+    for (size_t row = 0; row < size; row++)
+    {
+        memcpy(&work[row * width], &matrix[row * size], size);
+        work[row * width + size + row] = 1;
+    }
+
+    bool success = true;
+
+    for (size_t col = 0; col < size; col++)
+    {
+        // Find a row with a nonzero value on the column, and move it to the diagonal
+        size_t pivot = col;
+        while (pivot < size && work[pivot * width + col] == 0) pivot++;
+
+        if (pivot == size)
+        {
+            success = false;
+            break;
+        }
+
+        if (pivot != col)
+        {
+            for (size_t i = 0; i < width; i++)
+            {
+                const uint8_t temp = work[col * width + i];
+                work[col * width + i] = work[pivot * width + i];
+                work[pivot * width + i] = temp;
+            }
+        }
+
+        // Scale the row so the diagonal becomes 1
+        uint8_t *const pivot_row = &work[col * width];
+        const uint8_t scale = __gf_inv(pivot_row[col]);
+        for (size_t i = 0; i < width; i++) pivot_row[i] = __gf_mul(pivot_row[i], scale);
+
+        // Clear the column on all other rows
+        for (size_t row = 0; row < size; row++)
+        {
+            uint8_t *const this_row = &work[row * width];
+            const uint8_t factor = this_row[col];
+            if (row == col || factor == 0) continue;
+            for (size_t i = 0; i < width; i++) this_row[i] ^= __gf_mul(factor, pivot_row[i]);
+        }
+    }
+
+    if (success)
+    {
+        for (size_t row = 0; row < size; row++) memcpy(&matrix[row * size], &work[row * width + size], size);
+    }
+
+    imc_free(work);
+    return success;
+}
+
+// Task of the worker threads: compute the combinations of one slice of the shards
+static void __erasure_task(void *context, size_t task, size_t worker)
+{
+    (void)worker;
+    const ErasureJob *const job = (const ErasureJob *)context;
+
+    const size_t start = task * IMC_ERASURE_SLICE_SIZE;
+    const size_t size = (job->size - start < IMC_ERASURE_SLICE_SIZE) ? job->size - start : IMC_ERASURE_SLICE_SIZE;
+
+    // The slice of every source shard is read once for each combination, while it is still on the cache
+    for (size_t row = 0; row < job->dst_count; row++)
+    {
+        const uint8_t *const coefficient = &job->matrix[row * job->src_count];
+        for (size_t col = 0; col < job->src_count; col++)
+        {
+            imc_erasure_mul_region(&job->dst[row][start], &job->src[col][start], coefficient[col], size, col > 0);
+        }
+    }
+}
+
+// Compute the linear combinations of a job, on up to 'thread_count' threads (0 for the amount of logical processors)
+static void __erasure_run(const ErasureJob *job, size_t thread_count)
+{
+    const size_t slice_count = (job->size + IMC_ERASURE_SLICE_SIZE - 1) / IMC_ERASURE_SLICE_SIZE;
+    imc_parallel_for(slice_count, thread_count, &__erasure_task, (void *)job);
+}
+
+// Name of the region multiplication used on this processor ("AVX2", "SSSE3", or "scalar")
+const char *imc_erasure_kernel()
+{
+    pthread_once(&gf_once, &__gf_init);
+    return gf_kernel;
+}
+
+// Multiply a region of 'size' bytes by a constant of GF(2^8)
+// If 'accumulate' is true, the product is added (XOR) to 'dst', otherwise it overwrites 'dst'.
+void imc_erasure_mul_region(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate)
+{
+    pthread_once(&gf_once, &__gf_init);
+
+    // Multiplying by 0 or 1 needs no table lookups
+    if (factor == 0)
+    {
+        if (!accumulate) memset(dst, 0, size);
+    }
+    else if (factor == 1)
+    {
+        if (accumulate)
+        {
+            for (size_t i = 0; i < size; i++) dst[i] ^= src[i];
+        }
+        else
+        {
+            memcpy(dst, src, size);
+        }
+    }
+    else
+    {
+        gf_region(dst, src, factor, size, accumulate);
+    }
+}
+
+// Compute 'parity_count' parity shards from 'data_count' data shards, all of them with 'size' bytes
+// The shards are processed in slices, on up to 'thread_count' threads (0 for the amount of logical processors).
+// Returns IMC_ERR_FILE_TOO_BIG if there are more than IMC_ERASURE_MAX_SHARDS shards.
+int imc_erasure_encode(
+    const uint8_t *const *data,
+    size_t data_count,
+    uint8_t *const *parity,
+    size_t parity_count,
+    size_t size,
+    size_t thread_count
+)
+{
+    if (data_count + parity_count > IMC_ERASURE_MAX_SHARDS) return IMC_ERR_FILE_TOO_BIG;
+    if (data_count == 0 || parity_count == 0 || size == 0) return IMC_SUCCESS;
+    pthread_once(&gf_once, &__gf_init);
+
+    uint8_t *const matrix = imc_malloc(parity_count * data_count);
+    for (size_t row = 0; row < parity_count; row++)
+    {
+        for (size_t col = 0; col < data_count; col++) matrix[row * data_count + col] = __cauchy(row, col, data_count);
+    }
+
+    const ErasureJob job = {
+        .src = data,
+        .src_count = data_count,
+        .dst = parity,
+        .dst_count = parity_count,
+        .matrix = matrix,
+        .size = size,
+    };
+
+    __erasure_run(&job, thread_count);
+
+    imc_free(matrix);
+    return IMC_SUCCESS;
+}
+
+// Rebuild the missing data shards of a set, from any 'data_count' of its shards
+// 'shards' has the data shards followed by the parity shards (all of them with 'size' bytes), and 'present' tells
+// which of them are available. The missing data shards are written to their buffers on 'shards' (which must be allocated),
+// while the missing parity shards are left untouched. The work is done on up to 'thread_count' threads.
+// Returns IMC_ERR_SHARD_MISSING if less than 'data_count' shards are available.
+int imc_erasure_reconstruct(
+    uint8_t *const *shards,
+    const bool *present,
+    size_t data_count,
+    size_t parity_count,
+    size_t size,
+    size_t thread_count
+)
+{
+    const size_t total = data_count + parity_count;
+    if (total > IMC_ERASURE_MAX_SHARDS) return IMC_ERR_FILE_TOO_BIG;
+    pthread_once(&gf_once, &__gf_init);
+
+    // Choose the shards used for rebuilding (the data shards come first, since their rows are the simplest)
+    size_t chosen[data_count];
+    size_t chosen_count = 0;
+    for (size_t i = 0; i < total && chosen_count < data_count; i++)
+    {
+        if (present[i]) chosen[chosen_count++] = i;
+    }
+
+    if (chosen_count < data_count) return IMC_ERR_SHARD_MISSING;
+
+    size_t missing[data_count];
+    size_t missing_count = 0;
+    for (size_t i = 0; i < data_count; i++)
+    {
+        if (!present[i]) missing[missing_count++] = i;
+    }
+
+    if (missing_count == 0 || size == 0) return IMC_SUCCESS;
+
+    // Rows of the code's matrix for the chosen shards: each chosen shard is that combination of the data shards
+    uint8_t *const matrix = imc_calloc(data_count * data_count, 1);
+    for (size_t row = 0; row < data_count; row++)
+    {
+        const size_t shard = chosen[row];
+        for (size_t col = 0; col < data_count; col++)
+        {
+            matrix[row * data_count + col] = (shard < data_count) ? (shard == col) : __cauchy(shard - data_count, col, data_count);
+        }
+    }
+
+    // The inverse gives each data shard as a combination of the chosen shards
+    if (!__gf_invert(matrix, data_count))
+    {
+        imc_free(matrix);
+        return IMC_ERR_SHARD_MISSING;
+    }
+
+    // Only the rows of the missing data shards are computed
+    uint8_t *const rows = imc_malloc(missing_count * data_count);
+    const uint8_t *src[data_count];
+    uint8_t *dst[missing_count];
+
+    for (size_t i = 0; i < data_count; i++) src[i] = shards[chosen[i]];
+    for (size_t i = 0; i < missing_count; i++)
+    {
+        memcpy(&rows[i * data_count], &matrix[missing[i] * data_count], data_count);
+        dst[i] = shards[missing[i]];
+    }
+
+    const ErasureJob job = {
+        .src = src,
+        .src_count = data_count,
+        .dst = dst,
+        .dst_count = missing_count,
+        .matrix = rows,
+        .size = size,
+    };
+
+    __erasure_run(&job, thread_count);
+
+    imc_free(rows);
+    imc_free(matrix);
+    return IMC_SUCCESS;
+}
@@ -0,0 +1,107 @@
+/* Reed-Solomon erasure code over GF(2^8), for rebuilding the missing shards of a file from its parity shards. */
+
+#ifndef _IMC_ERASURE_H
+#define _IMC_ERASURE_H
+
+#include "imc_includes.h"
+
+/*  The code is systematic: the data shards are stored as they are, and each parity shard is a linear combination
+    of all data shards (byte by byte, on the Galois field GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1).
+    The coefficients of the parity shards come from a Cauchy matrix, so any square matrix made from the rows of the
+    identity (data shards) and of the Cauchy matrix (parity shards) can be inverted. That means any 'data_count'
+    shards out of 'data_count + parity_count' are enough to rebuild the data shards.
+
+    The multiplication of a region of bytes by a constant is done with two tables of 16 products (one for the low
+    and one for the high 4 bits of each byte), which are looked up 32 or 16 bytes at a time with the 'pshufb'
+    instruction when the processor supports AVX2 or SSSE3 (checked when the program runs).
+*/
+
+// Maximum amount of shards (data plus parity) on a set, because the Cauchy matrix needs a different field element for each shard
+#define IMC_ERASURE_MAX_SHARDS 256
+
+// Size in bytes of the slices of the shards that are processed by each task of the worker threads
+// (the slices of all shards being combined should fit together on the processor's cache)
+#define IMC_ERASURE_SLICE_SIZE (32 * 1024)
+
+// Function that multiplies a region of bytes by a constant of GF(2^8)
+// If 'accumulate' is true, the product is added (XOR) to 'dst', otherwise it overwrites 'dst'.
+typedef void (*imc_gf_region_func)(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate);
+
+// Linear combinations of shards being computed by the worker threads
+typedef struct ErasureJob {
+    const uint8_t *const *src;  // Shards being combined
+    size_t src_count;           // Amount of shards on 'src'
+    uint8_t *const *dst;        // Shards receiving the combinations
+    size_t dst_count;           // Amount of shards on 'dst'
+    const uint8_t *matrix;      // Coefficients of each combination ('dst_count' rows of 'src_count' elements)
+    size_t size;                // Size in bytes of each shard
+} ErasureJob;
+
+// Build the logarithm and exponential tables of GF(2^8), and choose the fastest region multiplication
+static void __gf_init();
+
+// Product of two elements of GF(2^8)
+static inline uint8_t __gf_mul(uint8_t a, uint8_t b);
+
+// Multiplicative inverse of a nonzero element of GF(2^8)
+static inline uint8_t __gf_inv(uint8_t a);
+
+// Products of 'factor' by the values of the low 4 bits (0x00 to 0x0F) and of the high 4 bits (0x00 to 0xF0) of a byte
+static void __gf_nibble_tables(uint8_t factor, uint8_t *low, uint8_t *high);
+
+// Multiply a region of bytes by a constant, one byte at a time (used when the processor has no 'pshufb' instruction)
+static void __gf_region_scalar(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate);
+
+// Multiply a region of bytes by a constant, 16 bytes at a time (SSSE3)
+static void __gf_region_ssse3(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate);
+
+// Multiply a region of bytes by a constant, 32 bytes at a time (AVX2)
+static void __gf_region_avx2(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate);
+
+// Coefficient of a data shard on a parity shard (an element of the Cauchy matrix)
+static inline uint8_t __cauchy(size_t parity, size_t data, size_t data_count);
+
+// Invert a square matrix of GF(2^8) in place (Gauss-Jordan elimination)
+// Returns 'false' if the matrix is singular (which does not happen for the rows of the code's matrix).
+static bool __gf_invert(uint8_t *matrix, size_t size);
+
+// Task of the worker threads: compute the combinations of one slice of the shards
+static void __erasure_task(void *context, size_t task, size_t worker);
+
+// Compute the linear combinations of a job, on up to 'thread_count' threads (0 for the amount of logical processors)
+static void __erasure_run(const ErasureJob *job, size_t thread_count);
+
+// Name of the region multiplication used on this processor ("AVX2", "SSSE3", or "scalar")
+const char *imc_erasure_kernel();
+
+// Multiply a region of 'size' bytes by a constant of GF(2^8)
+// If 'accumulate' is true, the product is added (XOR) to 'dst', otherwise it overwrites 'dst'.
+void imc_erasure_mul_region(uint8_t *dst, const uint8_t *src, uint8_t factor, size_t size, bool accumulate);
+
+// Compute 'parity_count' parity shards from 'data_count' data shards, all of them with 'size' bytes
+// The shards are processed in slices, on up to 'thread_count' threads (0 for the amount of logical processors).
+// Returns IMC_ERR_FILE_TOO_BIG if there are more than IMC_ERASURE_MAX_SHARDS shards.
+int imc_erasure_encode(
+    const uint8_t *const *data,
+    size_t data_count,
+    uint8_t *const *parity,
+    size_t parity_count,
+    size_t size,
+    size_t thread_count
+);
+
+// Rebuild the missing data shards of a set, from any 'data_count' of its shards
+// 'shards' has the data shards followed by the parity shards (all of them with 'size' bytes), and 'present' tells
+// which of them are available. The missing data shards are written to their buffers on 'shards' (which must be allocated),
+// while the missing parity shards are left untouched. The work is done on up to 'thread_count' threads.
+// Returns IMC_ERR_SHARD_MISSING if less than 'data_count' shards are available.
+int imc_erasure_reconstruct(
+    uint8_t *const *shards,
+    const bool *present,
+    size_t data_count,
+    size_t parity_count,
+    size_t size,
+    size_t thread_count
+);
+
+#endif  // _IMC_ERASURE_H
@@ -1,5 +1,5 @@
 /* Functions for reading or writing hidden data into a cover image.
- * Supported cover image's formats: JPEG and PNG.
+ * Supported cover image's formats: JPEG, PNG, WebP, BMP, PNM and TIFF.
  */
 
 #include "imc_includes.h"
@@ -10,38 +10,294 @@ static const uint8_t bit[8] = {1, 2, 4, 8, 16, 32, 64, 128};    // Masks for get
 static const uint8_t lsb_get   = 1;     // (0b00000001) Mask for getting the least significant bit of a byte
 static const uint8_t lsb_clear = 254;   // (0b11111110) Mask for clearing the least significant bit of a byte
 
-// Info for progress monitoring of PNG images
-static _Thread_local double png_num_passes = -1.0;  // How many passes for reading or writing the image
-static _Thread_local double png_num_rows = -1.0;    // Image's height
-// Note: I am storing these thread local variables, because libpng provides no
-//       easy way to access those values from within the row callback function.
-
 // Initialize an image for hiding data in it
-int imc_steg_init(const char *path, const PassBuff *password, CarrierImage **output, uint64_t flags)
+// The image is read from 'path', or from the buffer on 'options' (see the 'StegOptions' struct). 'options' can be NULL.
+int imc_steg_init(const char *path, const PassBuff *password, CarrierImage **output, const StegOptions *options)
 {
-    if (__is_directory(path)) return IMC_ERR_PATH_IS_DIR;
-    FILE *image = fopen(path, "rb");
-    if (image == NULL) return IMC_ERR_FILE_NOT_FOUND;
+    return __steg_init(path, password, NULL, output, options);
+}
+
+// Initialize an image for hiding data in it, using an existing cryptographic context
+// (the image gets its own copy of the context, so the same context can be used to initialize other images)
+int imc_steg_init_context(const char *path, const CryptoContext *crypto, CarrierImage **output, const StegOptions *options)
+{
+    return __steg_init(path, NULL, crypto, output, options);
+}
+
+// Open an image and find its carrier bytes, without generating a cryptographic context or shuffling the carrier
+// A context can be added later with 'imc_steg_try_passwords()'.
+int imc_steg_open(const char *path, CarrierImage **output, const StegOptions *options)
+{
+    return __steg_init(path, NULL, NULL, output, options);
+}
+
+// Try a list of passwords on an image opened by 'imc_steg_open()'
+// The image is decoded only once: for each password, only the hashing and the reading of the magic bytes of the hidden data
+// are done (on up to 'thread_count' threads, 0 for all processors). The carrier is shuffled, and the first hidden file decrypted,
+// only for the passwords whose magic bytes match. The first hidden file is decompressed later, for the password that is used.
+// The first password on the list whose hidden data could be decrypted is used for the image, and its index is stored on 'match'.
+// Returns IMC_ERR_INVALID_PASS if none of the passwords worked.
+int imc_steg_try_passwords(
+    CarrierImage *carrier_img,
+    const PassBuff *const *passwords,
+    size_t password_count,
+    size_t thread_count,
+    size_t *match
+)
+{
+    PasswordJob job = {
+        .carrier_img = carrier_img,
+        .passwords = passwords,
+        .match = password_count,
+        .carrier = NULL,
+        .crypto = NULL,
+    };
+    pthread_mutex_init(&job.lock, NULL);
+
+    imc_progress(&carrier_img->progress, "Trying %zu passwords... ", password_count);
+    
+    imc_parallel_for(password_count, thread_count, &__password_task, &job);
+    pthread_mutex_destroy(&job.lock);
+    
+    const size_t found = atomic_load(&job.match);
+    imc_progress(&carrier_img->progress, (found < password_count) ? "Done!\n" : "\n");
+    if (found >= password_count) return IMC_ERR_INVALID_PASS;
+
+    // Use the carrier and the context of the password that worked
+    imc_free(carrier_img->carrier);
+    imc_crypto_context_destroy(carrier_img->crypto);
+    carrier_img->carrier = job.carrier;
+    carrier_img->crypto = job.crypto;
+    carrier_img->carrier_pos = 0;
+    
+    *match = found;
+    return IMC_SUCCESS;
+}
+
+// Task of the workers of 'imc_steg_try_passwords()': check if the hidden data can be decrypted with one of the passwords
+static void __password_task(void *context, size_t task, size_t worker)
+{
+    PasswordJob *const job = (PasswordJob *)context;
+    
+    // Skip the password if an earlier one on the list has already worked
+    if (task > atomic_load(&job->match)) return;
+
+    CryptoContext *crypto = NULL;
+    if (imc_crypto_context_create(job->passwords[task], &crypto) != IMC_SUCCESS) return;
+    
+    // Check again, because the password hashing takes a while
+    if (task > atomic_load(&job->match))
+    {
+        imc_crypto_context_destroy(crypto);
+        return;
+    }
+    
+    // Find the carrier bytes where the shuffle would put the metadata of the first hidden file, without shuffling the carrier
+    // (the shuffle is done on a copy of the context, because the context that worked should be the one after the shuffle)
+    const size_t length = job->carrier_img->carrier_lenght;
+    size_t meta_index[IMC_SEGMENT_META_SIZE * 8];
+    carrier_bytes_t meta_carrier[IMC_SEGMENT_META_SIZE * 8];
+    CryptoContext *probe = NULL;
+    int status = (length >= IMC_SEGMENT_META_SIZE * 8) ? imc_crypto_context_clone(crypto, &probe) : IMC_ERR_PAYLOAD_OOB;
+    if (status == IMC_SUCCESS) status = imc_crypto_shuffle_prefix(probe, length, IMC_SEGMENT_META_SIZE * 8, meta_index);
+    imc_crypto_context_destroy(probe);
+    
+    // Check the magic bytes of the hidden data
+    CarrierImage view = *job->carrier_img;
+    if (status == IMC_SUCCESS)
+    {
+        for (size_t i = 0; i < IMC_SEGMENT_META_SIZE * 8; i++) meta_carrier[i] = job->carrier_img->carrier[meta_index[i]];
+        view.carrier = meta_carrier;
+        view.carrier_lenght = IMC_SEGMENT_META_SIZE * 8;
+        
+        uint32_t crypto_size = 0;
+        status = __read_segment_meta(&view, 0, &crypto_size);
+    }
+    
+    if (status != IMC_SUCCESS || task > atomic_load(&job->match))
+    {
+        imc_crypto_context_destroy(crypto);
+        return;
+    }
+
+    // The magic bytes match: shuffle a copy of the carrier, in the same way as 'imc_steg_init()' does
+    carrier_bytes_t *carrier = imc_malloc(length * sizeof(carrier_bytes_t));
+    memcpy(carrier, job->carrier_img->carrier, length * sizeof(carrier_bytes_t));
+    imc_crypto_shuffle_ptr(crypto, (uintptr_t *)carrier, length, NULL);
+
+    // Check if the first hidden file can be decrypted (it is only decompressed later, when extracting or checking)
+    view.carrier = carrier;
+    view.carrier_lenght = length;
+    view.crypto = crypto;
+    
+    size_t pos = 0;
+    uint8_t *stream = NULL;
+    size_t stream_size = 0;
+    status = __segment_decrypt(&view, &pos, false, &stream, &stream_size);
+    
+    if (status == IMC_SUCCESS)
+    {
+        imc_clear_free(stream, stream_size);
+        
+        // Keep the results if this is the earliest password on the list that worked
+        pthread_mutex_lock(&job->lock);
+        if (task < atomic_load(&job->match))
+        {
+            imc_free(job->carrier);
+            imc_crypto_context_destroy(job->crypto);
+            job->carrier = carrier;
+            job->crypto = crypto;
+            atomic_store(&job->match, task);
+            carrier = NULL;
+            crypto = NULL;
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    imc_free(carrier);
+    imc_crypto_context_destroy(crypto);
+}
+
+// Initialize an image for hiding data to the owner of a X25519 public key (recipient mode)
+// A new ephemeral key pair is generated, and the representative of its public key is written to the carrier.
+int imc_steg_init_recipient(const char *path, const uint8_t *recipient_pk, CarrierImage **output, const StegOptions *options)
+{
+    CarrierImage *carrier_img = NULL;
+    int status = __steg_init(path, NULL, NULL, &carrier_img, options);
+    if (status != IMC_SUCCESS) return status;
+
+    // Generate the ephemeral key and the session secrets
+    uint8_t representative[crypto_box_PUBLICKEYBYTES];
+    status = imc_crypto_recipient_seal(recipient_pk, representative, &carrier_img->crypto);
+    
+    // Write the ephemeral public key to the carrier, then shuffle the rest of the carrier
+    if (status == IMC_SUCCESS) status = __recipient_carrier(carrier_img, recipient_pk, representative, true);
+    
+    if (status != IMC_SUCCESS)
+    {
+        imc_steg_finish(carrier_img);
+        return status;
+    }
+
+    *output = carrier_img;
+    return IMC_SUCCESS;
+}
+
+// Initialize an image for extracting the data that was hidden to the owner of a X25519 secret key (recipient mode)
+int imc_steg_init_secret_key(const char *path, const uint8_t *secret_key, CarrierImage **output, const StegOptions *options)
+{
+    CarrierImage *carrier_img = NULL;
+    int status = __steg_init(path, NULL, NULL, &carrier_img, options);
+    if (status != IMC_SUCCESS) return status;
+
+    uint8_t recipient_pk[crypto_box_PUBLICKEYBYTES];
+    uint8_t representative[crypto_box_PUBLICKEYBYTES];
+    crypto_scalarmult_base(recipient_pk, secret_key);
+    
+    // Read the ephemeral public key from the carrier
+    status = __recipient_carrier(carrier_img, recipient_pk, representative, false);
+
+    if (status == IMC_SUCCESS)
+    {
+        // Generate the session secrets, then shuffle the rest of the carrier
+        status = imc_crypto_recipient_open(secret_key, representative, &carrier_img->crypto);
+
+        if (status == IMC_ERR_CRYPTO_FAIL)
+        {
+            // The bits read represent a point of low order, so no data was hidden for this recipient.
+            // A random context is used in this case, so the extraction fails in the same way as with a wrong password.
+            uint8_t random_secret[IMC_SECRET_SIZE];
+            randombytes_buf(random_secret, sizeof(random_secret));
+            status = imc_crypto_context_from_secret(random_secret, &carrier_img->crypto);
+        }
+    }
+
+    if (status == IMC_SUCCESS)
+    {
+        imc_crypto_shuffle_ptr(
+            carrier_img->crypto,
+            (uintptr_t *)(&carrier_img->carrier[0]),
+            carrier_img->carrier_lenght,
+            &carrier_img->progress
+        );
+    }
+    
+    if (status != IMC_SUCCESS)
+    {
+        imc_steg_finish(carrier_img);
+        return status;
+    }
+
+    *output = carrier_img;
+    return IMC_SUCCESS;
+}
+
+// Helper function for the recipient mode: choose the carrier positions of the ephemeral public key,
+// then write its representative ('write_key' is true) or read it ('write_key' is false). Those positions are removed
+// from the carrier afterwards. When writing, the rest of the carrier is also shuffled with the session secrets.
+static int __recipient_carrier(CarrierImage *carrier_img, const uint8_t *recipient_pk, uint8_t *representative, bool write_key)
+{
+    if (carrier_img->carrier_lenght < IMC_RECIPIENT_LOCATOR_BITS) return IMC_ERR_PAYLOAD_OOB;
+    
+    CryptoContext *locator = NULL;
+    const int status = imc_crypto_locator_context(recipient_pk, &locator);
+    if (status != IMC_SUCCESS) return status;
+
+    // Move some random carrier positions to the beginning of the array
+    // (the same steps as the shuffle, but stopping after the positions needed for the key)
+    uintptr_t *const array = (uintptr_t *)(&carrier_img->carrier[0]);
+    const size_t length = carrier_img->carrier_lenght;
+    
+    for (size_t i = 0; i < IMC_RECIPIENT_LOCATOR_BITS; i++)
+    {
+        const size_t new_i = i + (imc_crypto_prng_uint64(locator) % (length - i));
+        const uintptr_t temp = array[i];
+        array[i] = array[new_i];
+        array[new_i] = temp;
+    }
+    
+    imc_crypto_context_destroy(locator);
+
+    if (write_key)
+    {
+        __write_payload_at(carrier_img, 0, crypto_box_PUBLICKEYBYTES, representative);
+    }
+    else
+    {
+        __read_payload_at(carrier_img, 0, crypto_box_PUBLICKEYBYTES, representative);
+    }
+
+    // Remove the positions of the key from the carrier
+    memmove(&array[0], &array[IMC_RECIPIENT_LOCATOR_BITS], (length - IMC_RECIPIENT_LOCATOR_BITS) * sizeof(uintptr_t));
+    carrier_img->carrier_lenght -= IMC_RECIPIENT_LOCATOR_BITS;
 
+    if (write_key)
+    {
+        imc_crypto_shuffle_ptr(carrier_img->crypto, array, carrier_img->carrier_lenght, &carrier_img->progress);
+    }
+
+    return IMC_SUCCESS;
+}
+
+// Find the format of an image from the signature at the beginning of its file
+// Returns IMC_ERR_FILE_INVALID if the format is not one of the supported ones.
+static int __image_type(const uint8_t *image_data, size_t image_size, enum ImageType *out_type)
+{
+    enum ImageType img_type;
+    
     // The file should start with one of these sequences of bytes
     static const uint8_t JPEG_MAGIC[] = {0xFF, 0xD8, 0xFF};
     static const uint8_t PNG_MAGIC[]  = {0x89, 0x50, 0x4E, 0x47};
     static const uint8_t RIFF_MAGIC[] = {'R', 'I', 'F', 'F'};   // First 4 bytes of an WebP image
     static const uint8_t WEBP_MAGIC[] = {'W', 'E', 'B', 'P'};   // Bytes 8 to 11 of an WebP image (counting from 0)
+    static const uint8_t BMP_MAGIC[]  = {'B', 'M'};
+    static const uint8_t TIFF_LE_MAGIC[] = {'I', 'I', 42, 0};   // TIFF image in little-endian byte order
+    static const uint8_t TIFF_BE_MAGIC[] = {'M', 'M', 0, 42};   // TIFF image in big-endian byte order
 
     // Get the file signature
     const size_t sig_size = 4;
-    uint8_t img_marker[sig_size];
-    size_t read_count = fread(img_marker, 1, sig_size, image);
-    if (read_count != sig_size)
-    {
-        fclose(image);
-        return IMC_ERR_FILE_INVALID;
-    }
-    fseek(image, 0, SEEK_SET);
-
-    // Determine the image format
-    enum ImageType img_type;
+    if (image_size < sig_size) return IMC_ERR_FILE_INVALID;
+    const uint8_t *const img_marker = image_data;
     
     if (memcmp(img_marker, JPEG_MAGIC, sizeof(JPEG_MAGIC)) == 0)
     {
@@ -56,52 +312,173 @@ int imc_steg_init(const char *path, const PassBuff *password, CarrierImage **out
         // Get the WebP file signature
         // The first 12 bytes should be something like: RIFF....WEBP
         // (where '....' is the file size)
-        fseek(image, 8, SEEK_SET);
-        size_t count = fread(img_marker, 1, sizeof(WEBP_MAGIC), image);
-        fseek(image, 0, SEEK_SET);
+        const size_t webp_offset = 8;
 
         // Check if the WebP signature matches
-        if (count != sizeof(WEBP_MAGIC) || memcmp(img_marker, WEBP_MAGIC, sizeof(WEBP_MAGIC)) == 0)
+        if ( image_size >= webp_offset + sizeof(WEBP_MAGIC) &&
+             memcmp(&image_data[webp_offset], WEBP_MAGIC, sizeof(WEBP_MAGIC)) == 0 )
         {
             img_type = IMC_WEBP;
         }
         else
         {
-            goto file_magic_error;
+            return IMC_ERR_FILE_INVALID;
         }
     }
+    else if (memcmp(img_marker, BMP_MAGIC, sizeof(BMP_MAGIC)) == 0)
+    {
+        img_type = IMC_BMP;
+    }
+    else if (
+        memcmp(img_marker, TIFF_LE_MAGIC, sizeof(TIFF_LE_MAGIC)) == 0 ||
+        memcmp(img_marker, TIFF_BE_MAGIC, sizeof(TIFF_BE_MAGIC)) == 0
+    )
+    {
+        img_type = IMC_TIFF;
+    }
+    else if ( img_marker[0] == 'P' && (img_marker[1] == '5' || img_marker[1] == '6') && isspace(img_marker[2]) )
+    {
+        // Binary PGM ('P5') or PPM ('P6') image
+        img_type = IMC_PNM;
+    }
+    else
+    {
+        return IMC_ERR_FILE_INVALID;
+    }
+
+    *out_type = img_type;
+    return IMC_SUCCESS;
+}
+
+// Settings of the encoders for each save profile (in the same order as 'enum SaveProfile')
+/* Note: the filter types of a PNG image are only chosen if the original image does not have filters on its rows,
+   otherwise the rows get the same filters as on the original image (with any profile). */
+static const SaveSettings imc_save_settings[IMC_PROFILE_COUNT] = {
+    [IMC_PROFILE_BALANCED] = {
+        .png_level = 6,                     // Default settings of libpng
+        .png_strategy = Z_FILTERED,
+        .png_filters = PNG_ALL_FILTERS,
+        .webp_method = 3,
+        .webp_effort = 75.0,
+    },
+    [IMC_PROFILE_FAST] = {
+        .png_level = 1,                     // Only repeated bytes, which is most of what is left after filtering the rows
+        .png_strategy = Z_RLE,
+        .png_filters = PNG_FILTER_SUB | PNG_FILTER_UP,
+        .webp_method = 0,
+        .webp_effort = 25.0,
+    },
+    [IMC_PROFILE_SMALL] = {
+        .png_level = 9,
+        .png_strategy = Z_FILTERED,
+        .png_filters = PNG_ALL_FILTERS,
+        .webp_method = 5,
+        .webp_effort = 90.0,
+    },
+};
+
+// Helper function for initializing an image
+// The cryptographic context is either generated from 'password' or copied from 'crypto' (the other one should be NULL).
+// If both are NULL, the image is opened without a cryptographic context, and its carrier is not shuffled.
+static int __steg_init(
+    const char *path,
+    const PassBuff *password,
+    const CryptoContext *crypto,
+    CarrierImage **output,
+    const StegOptions *options
+)
+{
+    // The library's functions can be called without going through the command line interface
+    if (sodium_init() < 0) return IMC_ERR_CRYPTO_FAIL;
+    
+    static const StegOptions default_options = {0};
+    if (!options) options = &default_options;
+    
+    FILE *image = NULL;
+    uint8_t *image_data = NULL;
+    size_t image_size = 0;
+    int map_status;
+
+    if (options->image_data)
+    {
+        // Copy the image from the caller's buffer
+        // (the decoders can change the image's contents, so the caller's buffer is not used directly)
+        if (options->image_size == 0) return IMC_ERR_FILE_INVALID;
+        image_data = imc_malloc(options->image_size);
+        memcpy(image_data, options->image_data, options->image_size);
+        image_size = options->image_size;
+        map_status = IMC_SUCCESS;
+    }
+    else if (imc_is_stdio_path(path))
+    {
+        // Read the whole image from the standard input
+        __set_binary_mode(stdin);
+        map_status = __read_stream(stdin, SIZE_MAX, &image_data, &image_size);
+    }
     else
     {
-        file_magic_error:
-        fclose(image);
+        if (__is_directory(path)) return IMC_ERR_PATH_IS_DIR;
+        image = fopen(path, "rb");
+        if (image == NULL) return IMC_ERR_FILE_NOT_FOUND;
+
+        // Map the image to memory, so the decoders can read it without copying it
+        map_status = imc_map_file(image, &image_data, &image_size);
+        if (map_status != IMC_SUCCESS) fclose(image);
+    }
+
+    if (map_status != IMC_SUCCESS) return map_status;
+
+    // Determine the image format
+    enum ImageType img_type;
+    if (__image_type(image_data, image_size, &img_type) != IMC_SUCCESS)
+    {
+        __release_input(image, image_data, image_size);
         return IMC_ERR_FILE_INVALID;
     }
 
+    // Animated and lossy WebP images have their own functions
+    size_t vp8_offset, vp8_size;
+    const bool animated = (img_type == IMC_WEBP) && __webp_is_animated(image_data, image_size);
+    const bool lossy = (img_type == IMC_WEBP) && !animated && imc_vp8_find(image_data, image_size, &vp8_offset, &vp8_size);
+
     // Holds the information needed for hiding data in the image
     CarrierImage *carrier_img = imc_calloc(1, sizeof(CarrierImage));
     carrier_img->type = img_type;
     carrier_img->file = image;
+    carrier_img->mapping = image_data;
+    carrier_img->mapping_size = image_size;
     
     // Set up the flags for processing the open image
-    if (flags & IMC_JUST_CHECK) carrier_img->just_check = true; // '--check' option
-    if (flags & IMC_VERBOSE)    carrier_img->verbose = true;    // '--verbose' option
+    if (options->flags & IMC_JUST_CHECK) carrier_img->just_check = true; // '--check' option
+    if (options->flags & IMC_VERBOSE)    carrier_img->verbose = true;    // '--verbose' option
+    carrier_img->profile = (options->profile < IMC_PROFILE_COUNT) ? options->profile : IMC_PROFILE_BALANCED;  // '--profile' option
+    
+    // The progress messages are only sent on verbose mode
+    if (carrier_img->verbose) carrier_img->progress = options->progress;
 
-    // Status message (verbose)
-    if (carrier_img->verbose)
+    int crypto_status = IMC_SUCCESS;
+
+    if (password)
     {
-        if (password->length > 0) printf("Generating secret key... ");
-        else printf("Generating key... ");
-        fflush(stdout);
-    }
+        // Status message (verbose)
+        imc_progress(&carrier_img->progress, (password->length > 0) ? "Generating secret key... " : "Generating key... ");
 
-    // Generate a secret key, and seed the number generator
-    const int crypto_status = imc_crypto_context_create(password, &carrier_img->crypto);
-    if (carrier_img->verbose)
+        // Generate a secret key, and seed the number generator
+        crypto_status = imc_crypto_context_create(password, &carrier_img->crypto);
+        imc_progress(&carrier_img->progress, (crypto_status == IMC_SUCCESS) ? "Done!\n" : "\n");
+    }
+    else if (crypto)
+    {
+        // Use the secret key and the number generator that were already initialized
+        crypto_status = imc_crypto_context_clone(crypto, &carrier_img->crypto);
+    }
+    
+    if (crypto_status != IMC_SUCCESS)
     {
-        if (crypto_status == IMC_SUCCESS) printf("Done!\n");
-        else printf("\n");
+        __release_input(image, image_data, image_size);
+        imc_free(carrier_img);
+        return crypto_status;
     }
-    if (crypto_status != IMC_SUCCESS) return crypto_status;
 
     // Set the struct's methods
     // ("open", "save", and "close" functions for the different supported image formats)
@@ -120,122 +497,643 @@ int imc_steg_init(const char *path, const PassBuff *password, CarrierImage **out
             break;
         
         case IMC_WEBP:
-            carrier_img->open  = &imc_webp_carrier_open;
-            carrier_img->save  = &imc_webp_carrier_save;
-            carrier_img->close = &imc_webp_carrier_close;
+            if (animated)
+            {
+                carrier_img->open  = &imc_webp_anim_carrier_open;
+                carrier_img->save  = &imc_webp_anim_carrier_save;
+                carrier_img->close = &imc_webp_anim_carrier_close;
+            }
+            else if (lossy)
+            {
+                carrier_img->open  = &imc_webp_lossy_carrier_open;
+                carrier_img->save  = &imc_webp_lossy_carrier_save;
+                carrier_img->close = &imc_webp_lossy_carrier_close;
+            }
+            else
+            {
+                carrier_img->open  = &imc_webp_carrier_open;
+                carrier_img->save  = &imc_webp_carrier_save;
+                carrier_img->close = &imc_webp_carrier_close;
+            }
+            break;
+        
+        case IMC_BMP:
+            carrier_img->open  = &imc_bmp_carrier_open;
+            carrier_img->save  = &imc_raw_carrier_save;
+            carrier_img->close = &imc_raw_carrier_close;
+            break;
+        
+        case IMC_PNM:
+            carrier_img->open  = &imc_pnm_carrier_open;
+            carrier_img->save  = &imc_raw_carrier_save;
+            carrier_img->close = &imc_raw_carrier_close;
+            break;
+        
+        case IMC_TIFF:
+            carrier_img->open  = &imc_tiff_carrier_open;
+            carrier_img->save  = &imc_raw_carrier_save;
+            carrier_img->close = &imc_raw_carrier_close;
             break;
     }
     
+    // Look for the decoded image on the cover cache
+    // (animated images are not cached, because the cache files hold a single picture,
+    //  and neither are lossy images, whose carriers are coefficients instead of pixels)
+    if (options->cache_dir && (img_type == IMC_PNG || (img_type == IMC_WEBP && !animated && !lossy)))
+    {
+        __cover_cache_load(carrier_img, options->cache_dir);
+    }
+    
     // Get the carrier bytes from the image
-    carrier_img->open(carrier_img);
+    // (on failure, the open function has already freed what it had allocated)
+    const int open_status = carrier_img->open(carrier_img);
+    carrier_img->cache_dir = NULL;
+    
+    if (open_status != IMC_SUCCESS)
+    {
+        imc_unmap_file(carrier_img->cache_mapping, carrier_img->cache_mapping_size);
+        __release_input(image, image_data, image_size);
+        imc_crypto_context_destroy(carrier_img->crypto);
+        imc_free(carrier_img);
+        return open_status;
+    }
 
     // Shuffle the array of pointers
     // (so the order that the bytes are written depends on the password)
-    imc_crypto_shuffle_ptr(
-        carrier_img->crypto,    // Has the state of the pseudo-random number generator
-        (uintptr_t *)(&carrier_img->carrier[0]),    // Beginning of the array
-        carrier_img->carrier_lenght,                // Amount of elements on the array
-        carrier_img->verbose    // Print the progress if on "verbose" mode
-    );
+    if (carrier_img->crypto)
+    {
+        imc_crypto_shuffle_ptr(
+            carrier_img->crypto,    // Has the state of the pseudo-random number generator
+            (uintptr_t *)(&carrier_img->carrier[0]),    // Beginning of the array
+            carrier_img->carrier_lenght,                // Amount of elements on the array
+            &carrier_img->progress  // Receives the progress if on "verbose" mode
+        );
+    }
     
     *output = carrier_img;
     return IMC_SUCCESS;
 }
 
-// Convenience function for converting the bytes from a timespec struct into
-// the byte layout used by this program: 64-bit little endian (each value)
-static inline struct timespec64 __timespec_to_64le(struct timespec time)
+// Upper bound of the carrier bytes of a PNG image, read from its 'IHDR' chunk (and from a 'tRNS' chunk before the pixels)
+// The bound is exact if the image has no transparency, since only the fully transparent pixels are not used as carriers.
+static int __png_capacity_bound(const uint8_t *data, size_t size, size_t *out_bits, bool *out_exact)
 {
-    return (struct timespec64){
-        .tv_sec  = htole64((int64_t)time.tv_sec),
-        .tv_nsec = htole64((int64_t)time.tv_nsec)
-    };
+    // After the 8 bytes of signature, each chunk has: length (4 bytes), type (4 bytes), data, and CRC (4 bytes)
+    static const size_t sig_size = 8;
+    static const size_t ihdr_size = 13;
+    if (size < sig_size + 8 + ihdr_size || memcmp(&data[sig_size + 4], "IHDR", 4) != 0) return IMC_ERR_FILE_INVALID;
+
+    const uint8_t *const ihdr = &data[sig_size + 8];
+    const size_t width = __read_uint(&ihdr[0], 4, true);
+    const size_t height = __read_uint(&ihdr[4], 4, true);
+    const uint8_t bit_depth = ihdr[8];
+    const uint8_t color_type = ihdr[9];
+    if (width == 0 || height == 0) return IMC_ERR_FILE_INVALID;
+
+    // Look for a 'tRNS' chunk (transparent colors) before the first 'IDAT' chunk (pixels)
+    bool has_trns = false;
+    size_t pos = sig_size;
+    while (pos + 8 <= size)
+    {
+        const size_t chunk_size = __read_uint(&data[pos], 4, true);
+        const uint8_t *const chunk_type = &data[pos + 4];
+        if (memcmp(chunk_type, "IDAT", 4) == 0) break;
+        if (memcmp(chunk_type, "tRNS", 4) == 0) has_trns = true;
+        if (chunk_size > size - pos - 8) break;
+        pos += 12 + chunk_size;
+    }
+
+    // The images are read with 'png_set_expand()' only if they are palettized or have less than 8 bits per sample,
+    // and only then the transparent colors of a 'tRNS' chunk become an alpha channel.
+    const bool expanded = (color_type & PNG_COLOR_MASK_PALETTE) || (bit_depth < 8);
+    const bool has_alpha = (color_type & PNG_COLOR_MASK_ALPHA) || (has_trns && expanded);
+    const size_t num_colors = (color_type & PNG_COLOR_MASK_COLOR) ? 3 : 1;
+
+    *out_bits = width * height * num_colors;
+    *out_exact = !has_alpha;
+    return IMC_SUCCESS;
 }
 
-// Convenience function for converting the bytes from the byte layout used
-// by this program (64-bit little endian) to the standard timespec struct
-static inline struct timespec __timespec_from_64le(struct timespec64 time)
+// Upper bound of the carrier bytes of a WebP image, read from its header with 'WebPGetFeatures()'
+// For a lossless image, the bound is exact if the image has no transparency, since only the fully transparent pixels
+// are not used as carriers. For a lossy image, it is the bound of the coefficients that can be carriers.
+static int __webp_capacity_bound(const uint8_t *data, size_t size, size_t *out_bits, bool *out_exact)
 {
-    return (struct timespec){
-        .tv_sec  = le64toh(time.tv_sec),
-        .tv_nsec = le64toh(time.tv_nsec)
-    };
+    WebPBitstreamFeatures features;
+    const VP8StatusCode status = WebPGetFeatures(data, size, &features);
+    if (status != VP8_STATUS_OK) return IMC_ERR_FILE_INVALID;
+
+    // A lossy image has at most 15 carriers on each of the 24 blocks (not counting the Y2 block) of its 16 x 16 macroblocks
+    size_t vp8_offset, vp8_size;
+    if (!features.has_animation && imc_vp8_find(data, size, &vp8_offset, &vp8_size))
+    {
+        *out_bits = (size_t)((features.width + 15) / 16) * (size_t)((features.height + 15) / 16) * IMC_VP8_Y2_BLOCK * 15;
+        *out_exact = false;
+        return IMC_SUCCESS;
+    }
+
+    if (!features.has_animation)
+    {
+        *out_bits = (size_t)features.width * (size_t)features.height * 3;
+        *out_exact = !features.has_alpha;
+        return IMC_SUCCESS;
+    }
+
+    // An animated image has the carrier bytes of all of its frames
+    // (the frames are listed from the container, without being decoded)
+    const WebPData webp_data = {data, size};
+    WebPDemuxer *const demux = WebPDemux(&webp_data);
+    if (!demux) return IMC_ERR_FILE_INVALID;
+
+    size_t bits = 0;
+    bool exact = true;
+    WebPIterator iter;
+    if (WebPDemuxGetFrame(demux, 1, &iter))
+    {
+        do
+        {
+            bits += (size_t)iter.width * (size_t)iter.height * 3;
+            if (iter.has_alpha) exact = false;
+        } while (WebPDemuxNextFrame(&iter));
+        
+        WebPDemuxReleaseIterator(&iter);
+    }
+
+    WebPDemuxDelete(demux);
+    *out_bits = bits;
+    *out_exact = exact;
+    return IMC_SUCCESS;
 }
 
-// Hide a file in an image
-// Note: function can be called multiple times in order to hide more files in the same image.
-int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
+// Count the carrier bytes of a JPEG image, by reading its DCT coefficients (without decoding the pixels)
+// This only undoes the entropy coding, and counts the same AC coefficients that 'imc_jpeg_carrier_open()' uses.
+static int __jpeg_capacity_scan(const uint8_t *data, size_t size, size_t *out_bits)
 {
-    if (__is_directory(file_path)) return IMC_ERR_PATH_IS_DIR;
-    FILE *file = fopen(file_path, "rb");
-    if (file == NULL) return IMC_ERR_FILE_NOT_FOUND;
+    struct jpeg_decompress_struct jpeg_obj = {0};
+    JpegError jpeg_err;
+    jpeg_obj.err = jpeg_std_error(&jpeg_err.manager);
+    jpeg_err.manager.error_exit = &__jpeg_error_exit;
+    jpeg_err.manager.output_message = &__jpeg_output_message;
 
-    // Get the file's metadata
+    if (setjmp(jpeg_err.jump))
+    {
+        jpeg_destroy_decompress(&jpeg_obj);
+        return IMC_ERR_FILE_INVALID;
+    }
 
-    #ifdef _WIN32   // Windows systems
-    
-    HANDLE file_handle = __win_get_file_handle(file);   // File handle on Windows
-    
-    // File size
-    LARGE_INTEGER file_size_win = {0};                  // A Windows struct with the file size
-    GetFileSizeEx(file_handle, &file_size_win);
-    const off_t file_size = file_size_win.QuadPart;     // File size in bytes
+    jpeg_create_decompress(&jpeg_obj);
+    jpeg_mem_src(&jpeg_obj, data, size);
+    jpeg_read_header(&jpeg_obj, true);
+    jvirt_barray_ptr *jpeg_dct = jpeg_read_coefficients(&jpeg_obj);
 
-    // Timestamps
-    FILETIME file_mod_time_win = {0};       // Last modified time (Windows timestamp)
-    FILETIME file_access_time_win = {0};    // Last access time (Windows timestamp)
-    GetFileTime(file_handle, NULL, &file_access_time_win, &file_mod_time_win);
-    const struct timespec file_mod_time = __win_filetime_to_timespec(file_mod_time_win);        // Last modified time (Unix timestamp)
-    const struct timespec file_access_time = __win_filetime_to_timespec(file_access_time_win);  // Last access time (Unix timestamp)
-    
-    #else   // Linux systems
-    
-    int file_descriptor = fileno(file);
-    
-    // File size
-    struct stat file_stats = {0};
-    fstat(file_descriptor, &file_stats);
-    const off_t file_size = file_stats.st_size;
+    size_t count = 0;
+    for (int comp = 0; comp < jpeg_obj.num_components; comp++)
+    {
+        for (JDIMENSION y = 0; y < jpeg_obj.comp_info[comp].height_in_blocks; y++)
+        {
+            JBLOCKARRAY coef_array = jpeg_obj.mem->access_virt_barray((j_common_ptr)&jpeg_obj, jpeg_dct[comp], y, 1, false);
 
-    // Timestamps
-    const struct timespec file_mod_time = file_stats.st_mtim;       // Last modified time (Unix timestamp)
-    const struct timespec file_access_time = file_stats.st_atim;    // Last access time (Unix timestamp)
-    
-    #endif // _WIN32
+            for (JDIMENSION x = 0; x < jpeg_obj.comp_info[comp].width_in_blocks; x++)
+            {
+                // The DC coefficient is skipped, and the AC coefficients that are 0 or 1 are not carriers
+                for (JCOEF i = 1; i < DCTSIZE2; i++)
+                {
+                    const JCOEF coef = coef_array[0][x][i];
+                    if (coef != 0 && coef != 1) count++;
+                }
+            }
+        }
+    }
+
+    jpeg_destroy_decompress(&jpeg_obj);
+    if (count == 0) return IMC_ERR_NO_CARRIER;
+
+    *out_bits = count;
+    return IMC_SUCCESS;
+}
+
+// Count the carrier bytes of a lossy WebP image, by reading the coefficients of its VP8 bitstream (without decoding the pixels)
+// This counts the same coefficients that 'imc_webp_lossy_carrier_open()' uses.
+static int __webp_lossy_capacity_scan(const uint8_t *data, size_t size, size_t *out_bits)
+{
+    Vp8Image *vp8 = NULL;
+    const int status = imc_vp8_read(data, size, &vp8);
+    if (status != IMC_SUCCESS) return status;
+
+    size_t count = 0;
+    const size_t block_count = vp8->mb_width * vp8->mb_height * IMC_VP8_BLOCKS;
     
-    // Sanity check
-    if (file_size > IMC_MAX_INPUT_SIZE)
+    for (size_t b = 0; b < block_count; b++)
     {
-        fprintf(stderr, "Error: Maximum size of the hidden file is 500 MB");
-        exit(EXIT_FAILURE);
-        /* Note:
-            The 500 MB limit is for preventing a huge file from being accidentally loaded.
-            Since the amount of data that can realistically be hidden usually is quite small,
-            I thought it would be an overkill to optimize the program for handling large files.
-        */
+        // The Y2 blocks are skipped, and so are the coefficients whose magnitude is 0 or 1 (or that are too big to be changed)
+        if (b % IMC_VP8_BLOCKS == IMC_VP8_Y2_BLOCK) continue;
+        
+        for (size_t i = 1; i < 16; i++)
+        {
+            if (IMC_VP8_IS_CARRIER(vp8->coef[b * 16 + i])) count++;
+        }
     }
 
-    // Get the file name from the path
-    const size_t path_len = strlen(file_path);
+    imc_vp8_free(vp8);
+    if (count == 0) return IMC_ERR_NO_CARRIER;
+
+    *out_bits = count;
+    return IMC_SUCCESS;
+}
+
+// Map an image file to memory and find its format (the file is closed afterwards)
+// This is a helper for the capacity functions. The mapping should be released with 'imc_unmap_file()'.
+static int __map_image(const char *path, uint8_t **out_data, size_t *out_size, enum ImageType *out_type)
+{
+    if (__is_directory(path)) return IMC_ERR_PATH_IS_DIR;
+    FILE *image = fopen(path, "rb");
+    if (!image) return IMC_ERR_FILE_NOT_FOUND;
+
+    const int map_status = imc_map_file(image, out_data, out_size);
+    fclose(image);
+    if (map_status != IMC_SUCCESS) return map_status;
+
+    if (__image_type(*out_data, *out_size, out_type) != IMC_SUCCESS)
+    {
+        imc_unmap_file(*out_data, *out_size);
+        return IMC_ERR_FILE_INVALID;
+    }
+
+    return IMC_SUCCESS;
+}
+
+// Upper bound of the carrier bytes of an image, read only from its header (nothing is decoded, and no password is needed)
+// 'out_exact' receives whether the bound is also the exact amount (PNG and WebP images without transparency).
+// Returns IMC_ERR_UNSUPPORTED for the formats whose header does not tell the amount (JPEG, BMP, PNM and TIFF).
+int imc_steg_capacity_bound(const char *path, size_t *out_bits, bool *out_exact)
+{
+    uint8_t *data = NULL;
+    size_t size = 0;
+    enum ImageType type;
+    int status = __map_image(path, &data, &size, &type);
+    if (status != IMC_SUCCESS) return status;
+
+    switch (type)
+    {
+        case IMC_PNG:
+            status = __png_capacity_bound(data, size, out_bits, out_exact);
+            break;
+        
+        case IMC_WEBP:
+            status = __webp_capacity_bound(data, size, out_bits, out_exact);
+            break;
+        
+        default:
+            status = IMC_ERR_UNSUPPORTED;
+            break;
+    }
+
+    imc_unmap_file(data, size);
+    return status;
+}
+
+// Amount of carrier bytes of an image (each one can hold one bit of hidden data), found without a password
+// The cheapest exact method for the image is used, and 'out_source' (which can be NULL) receives which one:
+// the header of PNG and lossless WebP images without transparency, a scan of the coefficients of JPEG and lossy WebP images,
+// or else opening the image (BMP, PNM and TIFF images are not decoded, but transparent PNG and WebP images are).
+int imc_steg_capacity(const char *path, size_t *out_bits, enum CapacitySource *out_source)
+{
+    uint8_t *data = NULL;
+    size_t size = 0;
+    enum ImageType type;
+    int status = __map_image(path, &data, &size, &type);
+    if (status != IMC_SUCCESS) return status;
+
+    size_t bits = 0;
+    bool exact = false;
+    enum CapacitySource source = IMC_CAPACITY_OPEN;
+    size_t vp8_offset, vp8_size;
+
+    switch (type)
+    {
+        case IMC_PNG:
+            status = __png_capacity_bound(data, size, &bits, &exact);
+            source = IMC_CAPACITY_HEADER;
+            break;
+        
+        case IMC_WEBP:
+            if (imc_vp8_find(data, size, &vp8_offset, &vp8_size) && !__webp_is_animated(data, size))
+            {
+                status = __webp_lossy_capacity_scan(data, size, &bits);
+                exact = true;
+                source = IMC_CAPACITY_SCAN;
+            }
+            else
+            {
+                status = __webp_capacity_bound(data, size, &bits, &exact);
+                source = IMC_CAPACITY_HEADER;
+            }
+            break;
+        
+        case IMC_JPEG:
+            status = __jpeg_capacity_scan(data, size, &bits);
+            exact = true;
+            source = IMC_CAPACITY_SCAN;
+            break;
+        
+        default:
+            break;
+    }
+
+    imc_unmap_file(data, size);
+    if (status != IMC_SUCCESS) return status;
+
+    if (!exact)
+    {
+        CarrierImage *carrier_img = NULL;
+        status = imc_steg_open(path, &carrier_img, NULL);
+        if (status != IMC_SUCCESS) return status;
+
+        bits = carrier_img->carrier_lenght;
+        source = IMC_CAPACITY_OPEN;
+        imc_steg_finish(carrier_img);
+    }
+
+    *out_bits = bits;
+    if (out_source) *out_source = source;
+    return IMC_SUCCESS;
+}
+
+// Seconds elapsed since an arbitrary point in time (monotonic clock)
+static double __seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Save an image with each save profile (to memory, without hiding anything), measuring the time taken and the size of the image
+// The image is opened once, then saved 'rounds' times with each profile. 'out_results' receives IMC_PROFILE_COUNT results,
+// in the same order as 'enum SaveProfile'. 'progress' (can be NULL) receives the profile being measured.
+int imc_steg_benchmark(const char *path, size_t rounds, const ProgressMonitor *progress, ProfileResult *out_results)
+{
+    // The image is opened without a password, since it is only going to be saved again
+    CarrierImage *carrier_img = NULL;
+    const int status = imc_steg_open(path, &carrier_img, NULL);
+    if (status != IMC_SUCCESS) return status;
+    if (rounds == 0) rounds = 1;
+
+    for (size_t i = 0; i < IMC_PROFILE_COUNT; i++)
+    {
+        ProfileResult *const result = &out_results[i];
+        *result = (ProfileResult){.profile = (enum SaveProfile)i, .status = IMC_SUCCESS, .seconds = INFINITY};
+        carrier_img->profile = result->profile;
+        imc_progress(progress, "Saving the image with the '%s' profile... ", imc_profile_name(result->profile));
+
+        for (size_t round = 0; round < rounds && result->status == IMC_SUCCESS; round++)
+        {
+            uint8_t *data = NULL;
+            size_t size = 0;
+            
+            const double start = __seconds();
+            result->status = imc_steg_save_memory(carrier_img, &data, &size);
+            const double elapsed = __seconds() - start;
+            
+            if (result->status != IMC_SUCCESS) break;
+            if (elapsed < result->seconds) result->seconds = elapsed;
+            result->size = size;
+            imc_free(data);
+        }
+
+        imc_progress(progress, "%s\n", (result->status == IMC_SUCCESS) ? "Done!" : "Failed!");
+    }
+
+    imc_steg_finish(carrier_img);
+    return IMC_SUCCESS;
+}
+
+// Convenience function for converting the bytes from a timespec struct into
+// the byte layout used by this program: 64-bit little endian (each value)
+static inline struct timespec64 __timespec_to_64le(struct timespec time)
+{
+    return (struct timespec64){
+        .tv_sec  = htole64((int64_t)time.tv_sec),
+        .tv_nsec = htole64((int64_t)time.tv_nsec)
+    };
+}
+
+// Convenience function for converting the bytes from the byte layout used
+// by this program (64-bit little endian) to the standard timespec struct
+static inline struct timespec __timespec_from_64le(struct timespec64 time)
+{
+    return (struct timespec){
+        .tv_sec  = le64toh(time.tv_sec),
+        .tv_nsec = le64toh(time.tv_nsec)
+    };
+}
+
+// Hide a file in an image
+// Note: function can be called multiple times in order to hide more files in the same image.
+int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
+{
+    PreparedFile *prepared = NULL;
+    const int prepare_status = imc_steg_prepare(file_path, &carrier_img->progress, &prepared);
+    if (prepare_status != IMC_SUCCESS) return prepare_status;
+
+    const int insert_status = imc_steg_insert_prepared(carrier_img, prepared);
+    imc_steg_prepared_free(prepared);
+    
+    return insert_status;
+}
+
+// Read and compress a file, so it can be hidden later (its name is the last component of the path)
+// The size that the file takes on the carrier is known at this point, before any image is opened.
+// 'progress' can be NULL. The prepared file should be freed with 'imc_steg_prepared_free()'.
+int imc_steg_prepare(const char *file_path, const ProgressMonitor *progress, PreparedFile **output)
+{
+    FILE *file = NULL;
+    uint8_t *stdin_data = NULL;     // Contents of the file, if it is read from the standard input
+    off_t file_size = 0;
+    struct timespec file_mod_time = {0};
+    struct timespec file_access_time = {0};
+    
+    if (imc_is_stdio_path(file_path))
+    {
+        // Read the whole standard input, since its size is not known beforehand
+        __set_binary_mode(stdin);
+        size_t stdin_size = 0;
+        const int read_status = __read_stream(stdin, IMC_MAX_INPUT_SIZE, &stdin_data, &stdin_size);
+        if (read_status == IMC_ERR_FILE_TOO_BIG) file_size = IMC_MAX_INPUT_SIZE + 1;
+        else if (read_status != IMC_SUCCESS) return IMC_ERR_FILE_NOT_FOUND;
+        else file_size = stdin_size;
+
+        // The data is timestamped with the current time
+        #ifdef _WIN32
+        timespec_get(&file_mod_time, TIME_UTC);
+        #else
+        clock_gettime(CLOCK_REALTIME, &file_mod_time);
+        #endif
+        file_access_time = file_mod_time;
+    }
+    else
+    {
+        if (__is_directory(file_path)) return IMC_ERR_PATH_IS_DIR;
+        file = fopen(file_path, "rb");
+        if (file == NULL) return IMC_ERR_FILE_NOT_FOUND;
+
+        // Get the file's metadata
+
+        #ifdef _WIN32   // Windows systems
+        
+        HANDLE file_handle = __win_get_file_handle(file);   // File handle on Windows
+        
+        // File size
+        LARGE_INTEGER file_size_win = {0};                  // A Windows struct with the file size
+        GetFileSizeEx(file_handle, &file_size_win);
+        file_size = file_size_win.QuadPart;                 // File size in bytes
+
+        // Timestamps
+        FILETIME file_mod_time_win = {0};       // Last modified time (Windows timestamp)
+        FILETIME file_access_time_win = {0};    // Last access time (Windows timestamp)
+        GetFileTime(file_handle, NULL, &file_access_time_win, &file_mod_time_win);
+        file_mod_time = __win_filetime_to_timespec(file_mod_time_win);        // Last modified time (Unix timestamp)
+        file_access_time = __win_filetime_to_timespec(file_access_time_win);  // Last access time (Unix timestamp)
+        
+        #else   // Linux systems
+        
+        int file_descriptor = fileno(file);
+        
+        // File size
+        struct stat file_stats = {0};
+        fstat(file_descriptor, &file_stats);
+        file_size = file_stats.st_size;
+
+        // Timestamps
+        file_mod_time = file_stats.st_mtim;       // Last modified time (Unix timestamp)
+        file_access_time = file_stats.st_atim;    // Last access time (Unix timestamp)
+        
+        #endif // _WIN32
+    }
+    
+    // Sanity check
+    if (file_size > IMC_MAX_INPUT_SIZE)
+    {
+        if (file) fclose(file);
+        imc_free(stdin_data);
+        return IMC_ERR_INPUT_TOO_BIG;
+        /* Note:
+            The 500 MB limit is for preventing a huge file from being accidentally loaded.
+            Since the amount of data that can realistically be hidden usually is quite small,
+            I thought it would be an overkill to optimize the program for handling large files.
+        */
+    }
+
+    // Get the file name from the path
+    // (the data from the standard input is hidden with the name "stdin")
+    const size_t path_len = strlen(file_path);
     char path_temp[path_len+1];
     strcpy(path_temp, file_path);
-    const char *const file_name = basename(path_temp);
+    const char *const file_name = file ? basename(path_temp) : IMC_STDIN_NAME;
     
     // Calculate the size for the file's metadata that will be stored
     const size_t name_size = strlen(file_name) + 1;
-    if (name_size > UINT16_MAX) return IMC_ERR_NAME_TOO_LONG;
+    if (name_size > UINT16_MAX)
+    {
+        if (file) fclose(file);
+        imc_clear_free(stdin_data, file_size);
+        return IMC_ERR_NAME_TOO_LONG;
+    }
     const size_t info_size = sizeof(FileInfo) + name_size;
     
     // Read the file into a buffer
-    if (carrier_img->verbose) printf("Loading '%s'... ", file_name);
-    if (carrier_img->verbose) fflush(stdout);
+    imc_progress(progress, "Loading '%s'... ", file_name);
     const size_t raw_size = info_size + file_size;
     uint8_t *const raw_buffer = imc_malloc(raw_size);
-    const size_t read_count = fread(&raw_buffer[info_size], 1, file_size, file);
-    fclose(file);
-    if (carrier_img->verbose) printf("Done!\n");
-    if (read_count != file_size) return IMC_ERR_FILE_CORRUPTED;
+    size_t read_count = file_size;
+    
+    if (file)
+    {
+        read_count = fread(&raw_buffer[info_size], 1, file_size, file);
+        fclose(file);
+    }
+    else
+    {
+        memcpy(&raw_buffer[info_size], stdin_data, file_size);
+        imc_clear_free(stdin_data, file_size);
+    }
+    imc_progress(progress, "Done!\n");
+    
+    if (read_count != (size_t)file_size)
+    {
+        imc_clear_free(raw_buffer, raw_size);
+        return IMC_ERR_FILE_CORRUPTED;
+    }
+
+    return __prepare_buffer(progress, file_name, raw_buffer, file_size, file_access_time, file_mod_time, output);
+}
+
+// Hide in an image a file stored on a memory buffer (the file is hidden with the name 'file_name')
+// The "last access" time of the hidden file is the same as 'mod_time'.
+int imc_steg_insert_memory(
+    CarrierImage *carrier_img,
+    const char *file_name,
+    const uint8_t *data,
+    size_t data_size,
+    struct timespec mod_time
+)
+{
+    if (data_size > IMC_MAX_INPUT_SIZE) return IMC_ERR_INPUT_TOO_BIG;
+    
+    const size_t name_size = strlen(file_name) + 1;
+    if (name_size > UINT16_MAX) return IMC_ERR_NAME_TOO_LONG;
+    
+    // Copy the file to the buffer, after the space for its metadata
+    const size_t info_size = sizeof(FileInfo) + name_size;
+    uint8_t *const raw_buffer = imc_malloc(info_size + data_size);
+    if (data_size > 0) memcpy(&raw_buffer[info_size], data, data_size);
+
+    PreparedFile *prepared = NULL;
+    const int prepare_status = __prepare_buffer(&carrier_img->progress, file_name, raw_buffer, data_size, mod_time, mod_time, &prepared);
+    if (prepare_status != IMC_SUCCESS) return prepare_status;
+
+    const int insert_status = imc_steg_insert_prepared(carrier_img, prepared);
+    imc_steg_prepared_free(prepared);
+    
+    return insert_status;
+}
+
+// Hide a prepared file in an image, at the current position of the carrier
+// The same prepared file can be hidden in any amount of images.
+int imc_steg_insert_prepared(CarrierImage *carrier_img, const PreparedFile *file)
+{
+    return __segment_pack(carrier_img, file->stream, file->stream_size, file->name);
+}
+
+// Amount of carrier bytes that a prepared file takes when hidden (each carrier byte holds one bit)
+size_t imc_steg_prepared_bits(const PreparedFile *file)
+{
+    return (IMC_CRYPTO_OVERHEAD + file->stream_size) * 8;
+}
+
+// Clear and free a prepared file
+void imc_steg_prepared_free(PreparedFile *file)
+{
+    if (!file) return;
+    imc_clear_free(file->stream, file->stream_size);
+    imc_free(file->name);
+    imc_free(file);
+}
 
+// Compress a file whose contents are already on 'raw_buffer', after the space for its 'FileInfo' struct
+// The buffer is cleared and freed by this function (its size is 'sizeof(FileInfo)' plus the sizes of the name and of the file).
+static int __prepare_buffer(
+    const ProgressMonitor *progress,
+    const char *file_name,
+    uint8_t *raw_buffer,
+    size_t file_size,
+    struct timespec access_time,
+    struct timespec mod_time,
+    PreparedFile **output
+)
+{
+    const size_t name_size = strlen(file_name) + 1;
+    const size_t raw_size = sizeof(FileInfo) + name_size + file_size;
+    
     // The offset from which the data will be compressed
     const size_t compressed_offset = offsetof(FileInfo, access_time);
     
@@ -245,8 +1143,8 @@ int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
     
     file_info->version = htole32((uint32_t)IMC_FILEINFO_VERSION);
     file_info->uncompressed_size = htole64(raw_size - compressed_offset);
-    file_info->access_time = __timespec_to_64le(file_access_time);
-    file_info->mod_time = __timespec_to_64le(file_mod_time);
+    file_info->access_time = __timespec_to_64le(access_time);
+    file_info->mod_time = __timespec_to_64le(mod_time);
     file_info->name_size = htole16(name_size);
     
     memcpy(&file_info->file_name[0], file_name, name_size);
@@ -282,8 +1180,7 @@ int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
     #endif // _WIN32
 
     // Compress the data on the buffer (from the '.access_time' onwards)
-    if (carrier_img->verbose) printf("Compressing '%s'... ", file_name);
-    if (carrier_img->verbose) fflush(stdout);
+    imc_progress(progress, "Compressing '%s'... ", file_name);
     int zlib_status = compress2(
         &zlib_buffer[compressed_offset],    // Output buffer to store the compressed data (starting after the uncompressed section)
         #ifdef _WIN32
@@ -305,12 +1202,12 @@ int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
         // The only way for decompression to fail here is if no enough memory was available
         imc_clear_free(zlib_buffer, zlib_buffer_size + compressed_offset);
         imc_clear_free(raw_buffer, raw_size);
-        if (carrier_img->verbose) printf("\n");
+        imc_progress(progress, "\n");
         return IMC_ERR_NO_MEMORY;
     }
 
     imc_clear_free(raw_buffer, raw_size);
-    if (carrier_img->verbose) printf("Done!\n");
+    imc_progress(progress, "Done!\n");
     
     // Store the actual size of the compressed data
     ((FileInfo *)zlib_buffer)->compressed_size = htole64(zlib_buffer_size);
@@ -319,13 +1216,27 @@ int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
     // Free the unused space in the output buffer
     zlib_buffer = imc_realloc(zlib_buffer, zlib_buffer_size);
 
+    // The compressed stream is encrypted only when it is written to a carrier
+    PreparedFile *const prepared = imc_malloc(sizeof(PreparedFile));
+    prepared->name = imc_malloc(strlen(file_name) + 1);
+    strcpy(prepared->name, file_name);
+    prepared->stream = zlib_buffer;
+    prepared->stream_size = zlib_buffer_size;
+    *output = prepared;
+
+    return IMC_SUCCESS;
+}
+
+// Encrypt a stream (the header of the 'FileInfo' struct, followed by the compressed data),
+// then write it to the carrier at the current position. The 'file_name' is used for the status messages.
+static int __segment_pack(CarrierImage *carrier_img, const uint8_t *stream, size_t stream_size, const char *file_name)
+{
     // Total size of the encrypted stream
-    const size_t crypto_size = IMC_CRYPTO_OVERHEAD + zlib_buffer_size;
+    const size_t crypto_size = IMC_CRYPTO_OVERHEAD + stream_size;
 
     if (crypto_size * 8 > carrier_img->carrier_lenght - carrier_img->carrier_pos)
     {
         // The carrier is not big enough to store the encrypted stream
-        imc_clear_free(zlib_buffer, zlib_buffer_size);
         return IMC_ERR_FILE_TOO_BIG;
     }
     
@@ -334,12 +1245,11 @@ int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
     unsigned long long crypto_output_len;
     
     // Encrypt the data stream
-    if (carrier_img->verbose) printf("Encrypting '%s'... ", file_name);
-    if (carrier_img->verbose) fflush(stdout);
+    imc_progress(&carrier_img->progress, "Encrypting '%s'... ", file_name);
     int crypto_status = imc_crypto_encrypt(
         carrier_img->crypto,    // Has the secret key (generated from the password)
-        zlib_buffer,            // Unencrypted data stream
-        zlib_buffer_size,       // Size in bytes of the unencrypted stream
+        stream,                 // Unencrypted data stream
+        stream_size,            // Size in bytes of the unencrypted stream
         crypto_buffer,          // Output buffer for the encrypted data
         &crypto_output_len      // Stores the amount of bytes written to the output buffer
     );
@@ -348,15 +1258,12 @@ int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
     {
         // It does not seem that encryption can fail, if the parameters are correct and the buffer is big enough.
         // But I still am doing this check here, just to be on the safe side.
-        imc_clear_free(zlib_buffer, zlib_buffer_size);
         imc_clear_free(crypto_buffer, crypto_size);
-        if (carrier_img->verbose) printf("\n");
+        imc_progress(&carrier_img->progress, "\n");
         return IMC_ERR_CRYPTO_FAIL;
     }
 
-    // Clear and free the buffer of the unencrypted strem
-    imc_clear_free(zlib_buffer, zlib_buffer_size);
-    if (carrier_img->verbose) printf("Done!\n");
+    imc_progress(&carrier_img->progress, "Done!\n");
 
     // Store the encrypted data stream on the least significant bits of the carrier
     for (size_t i = 0; i < crypto_size; i++)
@@ -378,11 +1285,11 @@ int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
         if ( carrier_img->verbose && (i % 512 == 0) )
         {
             const double percent = ((double)i / (double)crypto_size) * 100.0;
-            printf_prog("Writing encrypted '%s' to the carrier... %.1f %%\r", file_name, percent);
+            imc_progress_rate(&carrier_img->progress, "Writing encrypted '%s' to the carrier... %.1f %%\r", file_name, percent);
         }
     }
 
-    if (carrier_img->verbose) printf("Writing encrypted '%s' to the carrier... Done!  \n", file_name);
+    imc_progress(&carrier_img->progress, "Writing encrypted '%s' to the carrier... Done!  \n", file_name);
 
     // Clear and free the buffer of the encrypted stream
     imc_clear_free(crypto_buffer, crypto_size);
@@ -390,12 +1297,46 @@ int imc_steg_insert(CarrierImage *carrier_img, const char *file_path)
     return IMC_SUCCESS;
 }
 
+// Helper function for writing a given amount of bytes (the payload) starting from a given position of the carrier
+// Returns 'false' if the write would go out of bounds (no write is done in this case).
+static bool __write_payload_at(CarrierImage *carrier_img, size_t pos, size_t num_bytes, const uint8_t *data)
+{
+    if ( (pos > carrier_img->carrier_lenght) || ((num_bytes * 8) > (carrier_img->carrier_lenght - pos)) )
+    {
+        // There is no enough space left on the carrier
+        return false;
+    }
+
+    for (size_t i = 0; i < num_bytes; i++)
+    {
+        for (size_t j = 0; j < 8; j++)
+        {
+            // Clear the least significant bit of the carrier, then store the data bit there
+            uint8_t *const carrier_byte = carrier_img->carrier[pos++];
+            *carrier_byte &= lsb_clear;
+            *carrier_byte |= (data[i] & bit[j]) != 0;
+        }
+    }
+
+    return true;
+}
+
 // Helper function for reading a given amount of bytes (the payload) from the carrier of an image
 // Returns 'false' if the read would go out of bounds (no read is done in this case).
 // Returns 'true' if the read could be made (the bytes are stored of the provided buffer).
 static bool __read_payload(CarrierImage *carrier_img, size_t num_bytes, uint8_t *out_buffer)
 {
-    if ( (num_bytes * 8) > (carrier_img->carrier_lenght - carrier_img->carrier_pos) )
+    const bool read_status = __read_payload_at(carrier_img, carrier_img->carrier_pos, num_bytes, out_buffer);
+    if (read_status) carrier_img->carrier_pos += num_bytes * 8;
+    return read_status;
+}
+
+// Helper function for reading a given amount of bytes (the payload) starting from a given position of the carrier
+// Unlike '__read_payload()', the read position of the image is not changed, so this can be used by many threads at once.
+// Returns 'false' if the read would go out of bounds (no read is done in this case).
+static bool __read_payload_at(const CarrierImage *carrier_img, size_t pos, size_t num_bytes, uint8_t *out_buffer)
+{
+    if ( (pos > carrier_img->carrier_lenght) || ((num_bytes * 8) > (carrier_img->carrier_lenght - pos)) )
     {
         // The amount of data left to be read is bigger than the requested amount
         return false;
@@ -408,7 +1349,7 @@ static bool __read_payload(CarrierImage *carrier_img, size_t num_bytes, uint8_t
         for (size_t j = 0; j < 8; j++)
         {
             // Get the least significant bit from the carrier, then store the bit on the buffer
-            const uint8_t carrier_byte = *carrier_img->carrier[carrier_img->carrier_pos++];
+            const uint8_t carrier_byte = *carrier_img->carrier[pos++];
             if (carrier_byte & lsb_get) out_buffer[i] |= bit[j];
         }
     }
@@ -416,120 +1357,147 @@ static bool __read_payload(CarrierImage *carrier_img, size_t num_bytes, uint8_t
     return true;
 }
 
-// Read the hidden data from the carrier bytes, and save it
-// The function extracts and save one file each time it is called.
-// So in order to extract all the hidden files, it should be called
-// until it stops returning the IMC_SUCCESS status code.
-// Note: The filename is stored with the hidden data
-int imc_steg_extract(CarrierImage *carrier_img)
+// Read the metadata of the data segment that begins at the carrier position 'pos'
+// Returns IMC_SUCCESS if the segment is valid, and stores on 'crypto_size' the size of its encrypted stream.
+// Otherwise, returns IMC_ERR_PAYLOAD_OOB, IMC_ERR_INVALID_MAGIC or IMC_ERR_NEWER_VERSION.
+static int __read_segment_meta(const CarrierImage *carrier_img, size_t pos, uint32_t *crypto_size)
 {
-    bool read_status;
-    
-    // File magic (should be "imcl")
-    char magic[IMC_CRYPTO_MAGIC_SIZE];
-    memset(magic, 0, sizeof(magic));
-    read_status = __read_payload(carrier_img, sizeof(magic)-1, (uint8_t *)magic);
+    // Magic bytes (4), version (4), and size of the encrypted stream (4)
+    uint8_t meta[IMC_SEGMENT_META_SIZE];
+    const bool read_status = __read_payload_at(carrier_img, pos, sizeof(meta), meta);
     if (!read_status) return IMC_ERR_PAYLOAD_OOB;
 
-    // Check magic
-    if ( strcmp(magic, IMC_CRYPTO_MAGIC) != 0 )
+    // Check magic (should be "imcl")
+    if ( memcmp(&meta[0], IMC_CRYPTO_MAGIC, IMC_CRYPTO_MAGIC_SIZE - 1) != 0 )
     {
         return IMC_ERR_INVALID_MAGIC;
     }
 
     // Check the version of the encrypted data
     uint32_t crypto_version;
-    read_status = __read_payload(carrier_img, sizeof(crypto_version), (uint8_t *)&crypto_version);
-    if (!read_status) return IMC_ERR_PAYLOAD_OOB;
+    memcpy(&crypto_version, &meta[4], sizeof(crypto_version));
     crypto_version = le32toh(crypto_version);
     if (crypto_version > IMC_CRYPTO_VERSION) return IMC_ERR_NEWER_VERSION;
 
     // Get the size of the encrypted stream
-    uint32_t crypto_size;
-    read_status = __read_payload(carrier_img, sizeof(crypto_size), (uint8_t *)&crypto_size);
-    if (!read_status) return IMC_ERR_PAYLOAD_OOB;
-    crypto_size = le32toh(crypto_size);
+    memcpy(crypto_size, &meta[8], sizeof(*crypto_size));
+    *crypto_size = le32toh(*crypto_size);
 
-    // Get the header from the stream
-    uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
-    read_status = __read_payload(carrier_img, sizeof(header), header);
-    if (!read_status) return IMC_ERR_PAYLOAD_OOB;
-    crypto_size -= sizeof(header);
+    return IMC_SUCCESS;
+}
 
-    // Read the encrypted stream into a buffer
-    uint8_t *crypto_buffer = imc_malloc(crypto_size);
-    if (carrier_img->verbose && carrier_img->just_check) printf("\n");
-    if (carrier_img->verbose) printf("Reading hidden file... ");
-    if (carrier_img->verbose) fflush(stdout);
-    read_status = __read_payload(carrier_img, crypto_size, crypto_buffer);
-    if (!read_status)
+// Find where each data segment begins and ends on the carrier
+// The returned struct should be freed with 'imc_steg_index_free()'.
+SegmentIndex *imc_steg_index(const CarrierImage *carrier_img)
+{
+    SegmentIndex *index = imc_calloc(1, sizeof(SegmentIndex));
+    size_t capacity = 8;
+    index->segment = imc_malloc(capacity * sizeof(CarrierSegment));
+    
+    // Walk through the segments, starting from the beginning of the carrier
+    size_t pos = 0;
+    
+    while (true)
     {
-        imc_free(crypto_buffer);
-        if (carrier_img->verbose) printf("\n");
-        return IMC_ERR_PAYLOAD_OOB;
-    }
-    if (carrier_img->verbose) printf("Done!\n");
-
-    // Allocate a buffer for the decrypted data
-    unsigned long long decrypt_size = crypto_size - crypto_secretstream_xchacha20poly1305_ABYTES;
-    const unsigned long long decrypt_size_start = decrypt_size;
-    uint8_t *decrypt_buffer = imc_malloc(decrypt_size);
+        uint32_t crypto_size = 0;
+        index->status = __read_segment_meta(carrier_img, pos, &crypto_size);
+        if (index->status != IMC_SUCCESS) break;
 
-    // Whether to print a status message for decryption and decompression
-    const bool print_msg = carrier_img->verbose && !carrier_img->just_check;
+        // Check if the whole segment fits on the carrier
+        const size_t segment_bits = ((size_t)IMC_SEGMENT_META_SIZE + crypto_size) * 8;
+        if (segment_bits > carrier_img->carrier_lenght - pos)
+        {
+            index->status = IMC_ERR_PAYLOAD_OOB;
+            break;
+        }
 
-    // Decrypt the data
-    if (print_msg) printf("Decrypting hidden file... ");
-    if (print_msg) fflush(stdout);
-    int decrypt_status = imc_crypto_decrypt(
-        carrier_img->crypto,    // Has the secret key (generated from the password)
-        header,                 // Header generated during encryption
-        crypto_buffer,          // Encrypted data
-        crypto_size,            // Size in bytes of the encrypted data
-        decrypt_buffer,         // Output buffer for the decrypted data
-        &decrypt_size           // Size in bytes of the output buffer
-    );
+        // Resize the array of segments if it is full
+        if (index->count == capacity)
+        {
+            capacity *= 2;
+            index->segment = imc_realloc(index->segment, capacity * sizeof(CarrierSegment));
+        }
 
-    if (decrypt_status < 0 || decrypt_size != decrypt_size_start)
-    {
-        imc_free(crypto_buffer);
-        imc_free(decrypt_buffer);
-        if (print_msg) printf("\n");
-        return IMC_ERR_CRYPTO_FAIL;
+        // Store the segment's location, then skip to its end
+        index->segment[index->count++] = (CarrierSegment){
+            .start = pos,
+            .end = pos + segment_bits,
+            .crypto_size = crypto_size,
+        };
+        pos += segment_bits;
     }
 
-    imc_free(crypto_buffer);
-    if (print_msg) printf("Done!\n");
+    index->end = pos;
+    return index;
+}
 
-    // Current position on the decrypted stream
-    size_t d_pos = 0;
+// Free the memory used by a 'SegmentIndex' struct
+void imc_steg_index_free(SegmentIndex *index)
+{
+    if (!index) return;
+    imc_free(index->segment);
+    imc_free(index);
+}
+
+// Read, decrypt and decompress the data segment that begins at the carrier position 'pos'
+// On success, 'out_stream' receives the decompressed stream (the 'FileInfo' struct, followed by the file),
+// 'out_size' receives its size in bytes, and 'pos' is moved to right after the end of the segment.
+static int __segment_unpack(const CarrierImage *carrier_img, size_t *pos, bool verbose, uint8_t **out_stream, size_t *out_size)
+{
+    uint8_t *decrypt_buffer = NULL;
+    size_t decrypt_size = 0;
+    size_t read_pos = *pos;
+    const int decrypt_status = __segment_decrypt(carrier_img, &read_pos, verbose, &decrypt_buffer, &decrypt_size);
+    if (decrypt_status != IMC_SUCCESS) return decrypt_status;
+
+    // Whether to print a status message for decompression
+    const bool print_msg = verbose && !carrier_img->just_check;
+
+    const int decompress_status = __stream_decompress(
+        decrypt_buffer, decrypt_size, print_msg ? &carrier_img->progress : NULL, out_stream, out_size
+    );
+    imc_clear_free(decrypt_buffer, decrypt_size);
+    if (decompress_status != IMC_SUCCESS) return decompress_status;
+
+    *pos = read_pos;
+    return IMC_SUCCESS;
+}
+
+// Decompress a decrypted stream (the header of the 'FileInfo' struct, followed by the compressed data)
+// On success, 'out_stream' receives the decompressed stream (the 'FileInfo' struct, followed by the file),
+// and 'out_size' receives its size in bytes. The progress is sent to 'progress' (which can be NULL).
+static int __stream_decompress(const uint8_t *stream, size_t stream_size, const ProgressMonitor *progress, uint8_t **out_stream, size_t *out_size)
+{
+    // The stream must contain at least the version and the sizes of the 'FileInfo' struct
+    if (stream_size < sizeof(uint32_t) + 2 * sizeof(uint64_t)) return IMC_ERR_CRYPTO_FAIL;
+
+    // Current position on the decrypted stream
+    size_t d_pos = 0;
     
     // Get the version of the compressed data
     uint32_t compress_version = UINT32_MAX;
-    memcpy(&compress_version, &decrypt_buffer[d_pos], sizeof(compress_version));
+    memcpy(&compress_version, &stream[d_pos], sizeof(compress_version));
     compress_version = le32toh(compress_version);
-    if (compress_version > IMC_FILEINFO_VERSION)
-    {
-        imc_free(decrypt_buffer);
-        return IMC_ERR_NEWER_VERSION;
-    }
+    if (compress_version > IMC_FILEINFO_VERSION) return IMC_ERR_NEWER_VERSION;
     d_pos += sizeof(compress_version);
 
     // Get the compressed and uncompressed sizes
     uint64_t compress_size, decompress_size;
     
-    memcpy(&decompress_size, &decrypt_buffer[d_pos], sizeof(decompress_size));
+    memcpy(&decompress_size, &stream[d_pos], sizeof(decompress_size));
     decompress_size = le64toh(decompress_size);
     d_pos += sizeof(decompress_size);
     
-    memcpy(&compress_size, &decrypt_buffer[d_pos], sizeof(compress_size));
+    memcpy(&compress_size, &stream[d_pos], sizeof(compress_size));
     compress_size = le64toh(compress_size);
     d_pos += sizeof(compress_size);
 
+    if (compress_size > stream_size - d_pos) return IMC_ERR_CRYPTO_FAIL;
+
     // Allocate buffer for decompressed data
     const size_t d_size = d_pos + decompress_size;
     uint8_t *decompress_buffer = imc_malloc(d_size);
-    memcpy(&decompress_buffer[0], decrypt_buffer, d_pos);   // Copy the header to the beginning of the buffer
+    memcpy(&decompress_buffer[0], stream, d_pos);   // Copy the header to the beginning of the buffer
 
     #ifdef _WIN32
     uLongf decompress_size_win = decompress_size;
@@ -541,8 +1509,7 @@ int imc_steg_extract(CarrierImage *carrier_img)
     #endif // _WIN32
 
     // Decompress the data using Zlib
-    if (print_msg) printf("Decompressing hidden file... ");
-    if (print_msg) fflush(stdout);
+    imc_progress(progress, "Decompressing hidden file... ");
     int decompress_status = uncompress(
         &decompress_buffer[d_pos],  // Output 
         #ifdef _WIN32
@@ -550,7 +1517,7 @@ int imc_steg_extract(CarrierImage *carrier_img)
         #else
         &decompress_size,           // Size of the output buffer
         #endif // _WIN32
-        &decrypt_buffer[d_pos],     // Input buffer
+        &stream[d_pos],             // Input buffer
         compress_size               // Size of the input buffer
     );
 
@@ -562,36 +1529,174 @@ int imc_steg_extract(CarrierImage *carrier_img)
     {
         // If the file was not tampered with, the actual decompressed size
         // should be exactly the same as the size stored on the metadata
-        imc_clear_free(decrypt_buffer, decrypt_size);
         imc_clear_free(decompress_buffer, d_size);
-        if (print_msg) printf("\n");
+        imc_progress(progress, "\n");
         return IMC_ERR_CRYPTO_FAIL;
     }
 
-    imc_free(decrypt_buffer);
-    if (print_msg) printf("Done!\n");
+    imc_progress(progress, "Done!\n");
+
+    *out_stream = decompress_buffer;
+    *out_size = d_size;
     
-    // Get the data needed to reconstruct the hidden file
-    FileInfo *file_info = (FileInfo*)decompress_buffer;
+    return IMC_SUCCESS;
+}
 
-    // Calculate the file size
-    const size_t name_len = le16toh(file_info->name_size);  // Size of the name's string
-    const size_t file_start = sizeof(FileInfo) + name_len;  // Data offset where the file begins
-    const size_t file_size  = offsetof(FileInfo, access_time) + decompress_size - file_start;   // Size of the file (bytes)
+// Read and decrypt the data segment that begins at the carrier position 'pos' (without decompressing it)
+// On success, 'out_stream' receives the decrypted stream (the header of the 'FileInfo' struct, followed by the compressed data),
+// 'out_size' receives its size in bytes, and 'pos' is moved to right after the end of the segment.
+static int __segment_decrypt(const CarrierImage *carrier_img, size_t *pos, bool verbose, uint8_t **out_stream, size_t *out_size)
+{
+    bool read_status;
+    size_t read_pos = *pos;
+
+    // Check the magic bytes and the version, then get the size of the encrypted stream
+    uint32_t crypto_size;
+    const int meta_status = __read_segment_meta(carrier_img, read_pos, &crypto_size);
+    if (meta_status != IMC_SUCCESS) return meta_status;
+    read_pos += IMC_SEGMENT_META_SIZE * 8;
 
-    // Struct to store the information of the hidden file
-    // (since this function can be called multiple times, the struct is only malloc'ed on the first time)
-    if (!carrier_img->steg_info)
+    // The stream must be big enough to contain at least the decryption header and the authentication bytes
+    if (crypto_size < crypto_secretstream_xchacha20poly1305_HEADERBYTES + crypto_secretstream_xchacha20poly1305_ABYTES)
     {
-        carrier_img->steg_info = imc_malloc(sizeof(FileMetadata) + name_len);
+        return IMC_ERR_CRYPTO_FAIL;
     }
-    else
+
+    // Get the header from the stream
+    uint8_t header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+    read_status = __read_payload_at(carrier_img, read_pos, sizeof(header), header);
+    if (!read_status) return IMC_ERR_PAYLOAD_OOB;
+    read_pos += sizeof(header) * 8;
+    crypto_size -= sizeof(header);
+
+    // Read the encrypted stream into a buffer
+    uint8_t *crypto_buffer = imc_malloc(crypto_size);
+    if (verbose && carrier_img->just_check) imc_progress(&carrier_img->progress, "\n");
+    if (verbose) imc_progress(&carrier_img->progress, "Reading hidden file... ");
+    read_status = __read_payload_at(carrier_img, read_pos, crypto_size, crypto_buffer);
+    if (!read_status)
+    {
+        imc_free(crypto_buffer);
+        if (verbose) imc_progress(&carrier_img->progress, "\n");
+        return IMC_ERR_PAYLOAD_OOB;
+    }
+    read_pos += (size_t)crypto_size * 8;
+    if (verbose) imc_progress(&carrier_img->progress, "Done!\n");
+
+    // Allocate a buffer for the decrypted data
+    unsigned long long decrypt_size = crypto_size - crypto_secretstream_xchacha20poly1305_ABYTES;
+    const unsigned long long decrypt_size_start = decrypt_size;
+    uint8_t *decrypt_buffer = imc_malloc(decrypt_size);
+
+    // Whether to print a status message for decryption
+    const bool print_msg = verbose && !carrier_img->just_check;
+
+    // Decrypt the data
+    if (print_msg) imc_progress(&carrier_img->progress, "Decrypting hidden file... ");
+    int decrypt_status = imc_crypto_decrypt(
+        carrier_img->crypto,    // Has the secret key (generated from the password)
+        header,                 // Header generated during encryption
+        crypto_buffer,          // Encrypted data
+        crypto_size,            // Size in bytes of the encrypted data
+        decrypt_buffer,         // Output buffer for the decrypted data
+        &decrypt_size           // Size in bytes of the output buffer
+    );
+
+    if (decrypt_status < 0 || decrypt_size != decrypt_size_start)
+    {
+        imc_free(crypto_buffer);
+        imc_free(decrypt_buffer);
+        if (print_msg) imc_progress(&carrier_img->progress, "\n");
+        return IMC_ERR_CRYPTO_FAIL;
+    }
+
+    imc_free(crypto_buffer);
+    if (print_msg) imc_progress(&carrier_img->progress, "Done!\n");
+
+    // The decrypted stream must contain at least the version and the sizes of the 'FileInfo' struct
+    if (decrypt_size < sizeof(uint32_t) + 2 * sizeof(uint64_t))
+    {
+        imc_free(decrypt_buffer);
+        return IMC_ERR_CRYPTO_FAIL;
+    }
+
+    *out_stream = decrypt_buffer;
+    *out_size = decrypt_size;
+    *pos = read_pos;
+    
+    return IMC_SUCCESS;
+}
+
+// Decompress only the name of a hidden file from its decrypted stream (the header of the 'FileInfo' struct, followed by the compressed data)
+// The name is stored on a newly allocated string, and the rest of the compressed data is left untouched.
+static int __segment_file_name(const uint8_t *stream, size_t stream_size, char **out_name)
+{
+    const size_t compressed_offset = offsetof(FileInfo, access_time);
+    if (stream_size <= compressed_offset) return IMC_ERR_CRYPTO_FAIL;
+
+    z_stream zlib_stream = {0};
+    if (inflateInit(&zlib_stream) != Z_OK) return IMC_ERR_NO_MEMORY;
+    zlib_stream.next_in = (Bytef *)&stream[compressed_offset];
+    zlib_stream.avail_in = stream_size - compressed_offset;
+
+    // Decompress the compressed part of the 'FileInfo' struct, up to the size of the name
+    uint8_t info_buffer[sizeof(FileInfo) - compressed_offset];
+    zlib_stream.next_out = info_buffer;
+    zlib_stream.avail_out = sizeof(info_buffer);
+    int zlib_status = inflate(&zlib_stream, Z_SYNC_FLUSH);
+
+    if ( (zlib_status != Z_OK && zlib_status != Z_STREAM_END) || zlib_stream.avail_out != 0 )
+    {
+        inflateEnd(&zlib_stream);
+        return IMC_ERR_CRYPTO_FAIL;
+    }
+
+    uint16_t name_size;
+    memcpy(&name_size, &info_buffer[offsetof(FileInfo, name_size) - compressed_offset], sizeof(name_size));
+    name_size = le16toh(name_size);
+    
+    if (name_size == 0 || zlib_status == Z_STREAM_END)
+    {
+        inflateEnd(&zlib_stream);
+        return IMC_ERR_CRYPTO_FAIL;
+    }
+
+    // Decompress the name
+    char *name = imc_malloc(name_size);
+    zlib_stream.next_out = (Bytef *)name;
+    zlib_stream.avail_out = name_size;
+    zlib_status = inflate(&zlib_stream, Z_SYNC_FLUSH);
+    inflateEnd(&zlib_stream);
+
+    if ( (zlib_status != Z_OK && zlib_status != Z_STREAM_END) || zlib_stream.avail_out != 0 )
     {
-        carrier_img->steg_info = imc_realloc(carrier_img->steg_info, sizeof(FileMetadata) + name_len);
+        imc_free(name);
+        return IMC_ERR_CRYPTO_FAIL;
     }
 
+    name[name_size - 1] = '\0';
+    *out_name = name;
+    
+    return IMC_SUCCESS;
+}
+
+// Get the metadata of a hidden file from its decompressed stream
+// The metadata is stored on a newly allocated struct, and 'file_start' receives the offset of the file on the stream.
+static int __file_metadata(const uint8_t *stream, size_t stream_size, FileMetadata **out_info, size_t *file_start)
+{
+    // Get the data needed to reconstruct the hidden file
+    const FileInfo *file_info = (const FileInfo*)stream;
+    if (stream_size < sizeof(FileInfo)) return IMC_ERR_CRYPTO_FAIL;
+
+    // Calculate the file size
+    const size_t name_len = le16toh(file_info->name_size);  // Size of the name's string
+    const size_t f_start  = sizeof(FileInfo) + name_len;    // Data offset where the file begins
+    if (name_len == 0 || f_start > stream_size) return IMC_ERR_CRYPTO_FAIL;
+    const size_t file_size = stream_size - f_start;         // Size of the file (bytes)
+
     // Store the file's metadata
-    *(carrier_img->steg_info) = (FileMetadata){
+    FileMetadata *info = imc_malloc(sizeof(FileMetadata) + name_len);
+    *info = (FileMetadata){
         .access_time = __timespec_from_64le(file_info->access_time),
         .mod_time = __timespec_from_64le(file_info->mod_time),
         .steg_time = __timespec_from_64le(file_info->steg_time),
@@ -599,32 +1704,29 @@ int imc_steg_extract(CarrierImage *carrier_img)
         .name_size = name_len,
     };
 
-    memcpy( carrier_img->steg_info->file_name, file_info->file_name, name_len );
+    memcpy( info->file_name, file_info->file_name, name_len );
+    info->file_name[name_len - 1] = '\0';   // Ensure that the name is null-terminated
     
-    // If on "check mode": Exit the function without saving the file
-    if (carrier_img->just_check)
-    {
-        imc_free(decompress_buffer);
-        return IMC_SUCCESS;
-    }
+    *out_info = info;
+    *file_start = f_start;
 
-    // Get the last access and last modified times of the hidden file
-    struct timespec file_times[2] = {
-        __timespec_from_64le(file_info->access_time),
-        __timespec_from_64le(file_info->mod_time),
-    };
+    return IMC_SUCCESS;
+}
 
-    // Get the name of the hidden file
-    char file_name[name_len + 16];  // Extra size added in case it needs to be renamed for avoinding name collision
-    memset(file_name, 0, sizeof(file_name));
-    memcpy(file_name, file_info->file_name, name_len);
+// Copy the name of a hidden file to a buffer, replacing the characters that the system does not allow in filenames
+// IMPORTANT: 'out_name' must have at least 16 more bytes than the size of the name.
+static void __extracted_filename(const FileMetadata *info, char *out_name)
+{
+    const size_t name_len = info->name_size;
+    memset(out_name, 0, name_len + 16);
+    memcpy(out_name, info->file_name, name_len);
 
     // On Windows, replace by an underscore the forbidden filename characters
     #ifdef _WIN32
     static const char forbidden_chars[] = "\\/|;:*?<>";
     for (size_t i = 0; i < (name_len - 1); i++)
     {
-        char *const my_char = &file_name[i];
+        char *const my_char = &out_name[i];
         for (size_t j = 0; j < (sizeof(forbidden_chars) - 1); j++)
         {
             if (*my_char == forbidden_chars[j]) *my_char = '_';
@@ -640,30 +1742,92 @@ int imc_steg_extract(CarrierImage *carrier_img)
         limit which characters the user can have on filenames. Because my design choice
         is to restore the file as close to the original as possible.
     */
+}
+
+// Create the output file for an extracted file (the file is never overwritten if it already exists)
+// If the name already exists on the directory, a number is appended to its stem (the name on 'file_name' is updated).
+// IMPORTANT: 'file_name' must have at least 16 more bytes than the size of the name.
+// Returns NULL on failure, and 'status' receives the reason (IMC_ERR_FILE_EXISTS or IMC_ERR_SAVE_FAIL).
+static FILE *__create_output_at(imc_dir_t dir, char *file_name, int *status)
+{
+    const size_t name_len = strlen(file_name);
+    char original[name_len + 1];
+    memcpy(original, file_name, sizeof(original));
     
-    // Make the filename unique (if it already isn't)
-    bool is_unique = __resolve_filename_collision(file_name);
-    if (!is_unique) return IMC_ERR_FILE_EXISTS;
+    for (int i = 0; i <= IMC_MAX_FILENAME_DUPLICATES; i++)
+    {
+        // Append a number to the file's stem if the previous name already exists
+        // Example: 'Image.jpg' might become 'Image (1).jpg'
+        if (i > 0) __numbered_filename(original, i, file_name);
+
+        // Create the file only if it does not exist yet
+        // (the check and the creation are done at once, so two threads cannot get the same name)
+        
+        #ifdef _WIN32   // Windows systems
+        
+        FILE *out_file = NULL;
+        if (dir)
+        {
+            char path[strlen(dir) + strlen(file_name) + 2];
+            snprintf(path, sizeof(path), "%s\\%s", dir, file_name);
+            out_file = fopen(path, "wbx");
+        }
+        else
+        {
+            out_file = fopen(file_name, "wbx");
+        }
+        
+        #else   // Linux systems
+        
+        FILE *out_file = NULL;
+        const int out_fd = openat(dir, file_name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (out_fd >= 0)
+        {
+            out_file = fdopen(out_fd, "wb");
+            if (!out_file) close(out_fd);
+        }
+        
+        #endif // _WIN32
+
+        if (out_file) return out_file;
+        
+        if (errno != EEXIST)
+        {
+            *status = IMC_ERR_SAVE_FAIL;
+            return NULL;
+        }
+    }
+
+    // No new name could be created
+    // (the amount of tries is limited to 99)
+    *status = IMC_ERR_FILE_EXISTS;
+    return NULL;
+}
 
+// Write the contents of an extracted file, then restore its "last access" and "last modified" times
+static void __write_extracted(FILE *out_file, imc_dir_t dir, const char *file_name, const FileMetadata *info, const uint8_t *data, const ProgressMonitor *progress)
+{
     // Write the hidden file to disk
-    FILE *out_file = fopen(file_name, "wb");
-    if (!out_file) return IMC_ERR_SAVE_FAIL;
-    if (carrier_img->verbose) printf("Saving extracted file to '%s'... ", file_name);
-    if (carrier_img->verbose) fflush(stdout);
-    fwrite(&decompress_buffer[file_start], file_size, 1, out_file);
+    imc_progress(progress, "Saving extracted file to '%s'... ", file_name);
+    fwrite(data, info->file_size, 1, out_file);
     fclose(out_file);
-    if (carrier_img->verbose) printf("Done!\n");
-    imc_free(decompress_buffer);
+    imc_progress(progress, "Done!\n");
 
     // Restore the file's 'last access' and 'last modified' times
+    const struct timespec file_times[2] = {info->access_time, info->mod_time};
     
     #ifdef _WIN32   // Windows systems
     
+    // Path to the extracted file
+    char path[(dir ? strlen(dir) + 1 : 0) + strlen(file_name) + 1];
+    if (dir) snprintf(path, sizeof(path), "%s\\%s", dir, file_name);
+    else strcpy(path, file_name);
+    
     // Convert the file path string to wide char, in order to properly handle UTF-8 characters
-    size_t path_len = strlen(file_name) + 1;
-    int w_path_len = MultiByteToWideChar(CP_UTF8, 0, file_name, path_len, NULL, 0);
+    size_t path_len = strlen(path) + 1;
+    int w_path_len = MultiByteToWideChar(CP_UTF8, 0, path, path_len, NULL, 0);
     wchar_t w_path[w_path_len];
-    MultiByteToWideChar(CP_UTF8, 0, file_name, path_len, w_path, w_path_len);
+    MultiByteToWideChar(CP_UTF8, 0, path, path_len, w_path, w_path_len);
     
     // Open the file with only the permission to change its attributes
     HANDLE file_out = CreateFileW(
@@ -688,208 +1852,2262 @@ int imc_steg_extract(CarrierImage *carrier_img)
     #else   // Unix systems
     
     // Write the timestamps to the file's metadata
-    utimensat(AT_FDCWD, file_name, file_times, 0);
+    utimensat(dir, file_name, file_times, 0);
     
     #endif // _WIN32
-
-    return IMC_SUCCESS;
 }
 
-// Move the read position of the carrier bytes to right after the end of the last hidden file
-// Note: this function is intended to be used when in "append mode" while hiding a file.
-void imc_steg_seek_to_end(CarrierImage *carrier_img)
+// Read the hidden data from the carrier bytes, and save it
+// The function extracts and save one file each time it is called.
+// So in order to extract all the hidden files, it should be called
+// until it stops returning the IMC_SUCCESS status code.
+// Note: The filename is stored with the hidden data
+int imc_steg_extract(CarrierImage *carrier_img)
 {
-    // Start from the beginning
-    carrier_img->carrier_pos = 0;
-    size_t original_pos = 0;
+    // Decrypt and decompress the hidden file
+    uint8_t *stream = NULL;
+    size_t stream_size = 0;
+    const int unpack_status = __segment_unpack(carrier_img, &carrier_img->carrier_pos, carrier_img->verbose, &stream, &stream_size);
+    if (unpack_status != IMC_SUCCESS) return unpack_status;
+
+    // Store the file's metadata
+    FileMetadata *info = NULL;
+    size_t file_start = 0;
+    const int info_status = __file_metadata(stream, stream_size, &info, &file_start);
+    if (info_status != IMC_SUCCESS)
+    {
+        imc_free(stream);
+        return info_status;
+    }
     
-    while (true)
+    // (since this function can be called multiple times, the previous metadata is replaced)
+    imc_free(carrier_img->steg_info);
+    carrier_img->steg_info = info;
+    
+    // If on "check mode": Exit the function without saving the file
+    if (carrier_img->just_check)
     {
-        // Read position after the last successfull check
-        original_pos = carrier_img->carrier_pos;
-        
-        // Magic bytes of the current data segment
-        char magic[IMC_CRYPTO_MAGIC_SIZE];
-        const size_t magic_size = sizeof(magic) - 1;
-        memset(magic, 0, sizeof(magic));
-        const bool read_success = __read_payload(carrier_img, magic_size, (uint8_t *)(&magic));
+        imc_free(stream);
+        return IMC_SUCCESS;
+    }
 
-        // Keep parsing the data segments the magic bytes are not found
-        if ( read_success && (strcmp(magic, IMC_CRYPTO_MAGIC) == 0) )
-        {
-            // Check the version of the encrypted data
-            uint32_t crypto_version = 0;
-            {
-                const bool read_success = __read_payload(carrier_img, sizeof(crypto_version), (uint8_t *)&crypto_version);
-                if (!read_success) break;
-            }
-            crypto_version = le32toh(crypto_version);
-            if (crypto_version > IMC_CRYPTO_VERSION) break;
+    // The extracted file is saved to the current working directory
+    #ifdef _WIN32
+    const imc_dir_t cwd = NULL;
+    #else
+    const imc_dir_t cwd = AT_FDCWD;
+    #endif // _WIN32
 
-            // Get the size of the encrypted stream
-            uint32_t crypto_size = 0;
-            {
-                const bool read_success = __read_payload(carrier_img, sizeof(crypto_size), (uint8_t *)&crypto_size);
-                if (!read_success) break;
-            }
-            crypto_size = le32toh(crypto_size);
+    // Get the name of the hidden file
+    char file_name[info->name_size + 16];   // Extra size added in case it needs to be renamed for avoinding name collision
+    __extracted_filename(info, file_name);
 
-            // Skip the encrypted stream
-            carrier_img->carrier_pos += crypto_size * 8;
-        }
-        else
-        {
-            // The magic bytes were not found
-            break;
-        }
+    // Create the output file (its name is made unique, if it already isn't)
+    int save_status = IMC_SUCCESS;
+    FILE *out_file = __create_output_at(cwd, file_name, &save_status);
+    if (!out_file)
+    {
+        imc_free(stream);
+        return save_status;
     }
+    
+    // Write the hidden file to disk
+    __write_extracted(out_file, cwd, file_name, info, &stream[file_start], &carrier_img->progress);
+    imc_free(stream);
 
-    // Return the read position to where it was before the failed check
-    carrier_img->carrier_pos = original_pos;
+    return IMC_SUCCESS;
 }
 
-// Progress monitor when reading a JPEG image
-static void __jpeg_read_callback(j_common_ptr jpeg_obj)
+// Read the next hidden file into memory, instead of saving it
+// On success, 'out_info' receives the metadata of the file and 'out_data' its contents (both should be freed with 'imc_free()').
+// Returns the same status codes as 'imc_steg_extract()' (IMC_ERR_INVALID_MAGIC or IMC_ERR_PAYLOAD_OOB when there are no more hidden files).
+int imc_steg_extract_memory(CarrierImage *carrier_img, FileMetadata **out_info, uint8_t **out_data)
 {
-    // Units of work within a reading pass
-    const double unit_count = jpeg_obj->progress->pass_counter;
-    const double unit_max   = jpeg_obj->progress->pass_limit;
+    // Decrypt and decompress the hidden file
+    uint8_t *stream = NULL;
+    size_t stream_size = 0;
+    size_t pos = carrier_img->carrier_pos;
+    const int unpack_status = __segment_unpack(carrier_img, &pos, carrier_img->verbose, &stream, &stream_size);
+    if (unpack_status != IMC_SUCCESS) return unpack_status;
 
-    // Reading passes through the image
-    const double pass_count = jpeg_obj->progress->completed_passes;
-    const double pass_max   = jpeg_obj->progress->total_passes;
+    // Get the file's metadata
+    FileMetadata *info = NULL;
+    size_t file_start = 0;
+    const int info_status = __file_metadata(stream, stream_size, &info, &file_start);
+    if (info_status != IMC_SUCCESS)
+    {
+        imc_clear_free(stream, stream_size);
+        return info_status;
+    }
 
-    // Percentage completed
-    const double percent = ((pass_count + (unit_count / unit_max)) / pass_max) * 100.0;
-    printf_prog("Reading JPEG image... %.1f %%\r", percent);
+    // Copy the file's contents to their own buffer
+    // (one extra byte is allocated, so an empty file still gets a buffer)
+    uint8_t *const data = imc_malloc(info->file_size + 1);
+    memcpy(data, &stream[file_start], info->file_size);
+    imc_clear_free(stream, stream_size);
+
+    carrier_img->carrier_pos = pos;
+    *out_info = info;
+    *out_data = data;
+    
+    return IMC_SUCCESS;
 }
 
-// Get the bytes from a JPEG image that will carry the hidden data
-void imc_jpeg_carrier_open(CarrierImage *carrier_img)
+// Amount of bytes of a stream that fit on a shard hidden in an image (0 if not even the shard's overhead fits)
+size_t imc_steg_shard_capacity(const CarrierImage *carrier_img)
 {
-    // Open the image for reading
-    FILE *jpeg_file = carrier_img->file;
-    struct jpeg_decompress_struct *jpeg_obj = imc_malloc(sizeof(struct jpeg_decompress_struct));
-    struct jpeg_error_mgr *jpeg_err = imc_malloc(sizeof(struct jpeg_error_mgr));
-    jpeg_obj->err = jpeg_std_error(jpeg_err);   // Use the default error handler
-    jpeg_create_decompress(jpeg_obj);
-    jpeg_stdio_src(jpeg_obj, jpeg_file);
+    const size_t carrier_bytes = carrier_img->carrier_lenght / 8;
+    return (carrier_bytes > IMC_SHARD_OVERHEAD) ? carrier_bytes - IMC_SHARD_OVERHEAD : 0;
+}
 
-    // Save to memory the application markers and comment marker
-    // (This is being done in order to preserve the metadata from the original image)
-    for (size_t i = 1; i < 16; i++)
+// Write a shard to the beginning of the carrier (the existing hidden data is overwritten)
+// 'data' is the part of the stream that was encrypted for this shard by 'imc_crypto_encrypt_parts()',
+// and 'crypto_header' the decryption header of the whole stream (the same on all shards of a set).
+int imc_steg_insert_shard(
+    CarrierImage *carrier_img,
+    const ShardHeader *shard,
+    const uint8_t *crypto_header,
+    const uint8_t *data,
+    size_t data_size
+)
+{
+    // Size of the shard after its metadata
+    const size_t shard_size = sizeof(ShardHeader) + crypto_secretstream_xchacha20poly1305_HEADERBYTES + data_size;
+    if (shard_size > UINT32_MAX || (IMC_SEGMENT_META_SIZE + shard_size) * 8 > carrier_img->carrier_lenght)
     {
-        if (i == 14) continue;
-        jpeg_save_markers(jpeg_obj, JPEG_APP0+i, 0xFFFF);
-        /* Note:
-            The JFIF marker (JPEG_APP0) and the Adobe marker (JPEG_APP14) are being skipped
-            because libjpeg-turbo already handles those automatically.
-        */
+        return IMC_ERR_FILE_TOO_BIG;
     }
-    jpeg_save_markers(jpeg_obj, JPEG_COM, 0xFFFF);
 
-    // Setup the progress monitor for the JPEG's read operation
-    if (carrier_img->verbose)
+    // Magic bytes (4), version (4), and size of the rest of the shard (4)
+    uint8_t meta[IMC_SEGMENT_META_SIZE];
+    const uint32_t version = htole32((uint32_t)IMC_SHARD_VERSION);
+    const uint32_t size_le = htole32((uint32_t)shard_size);
+    memcpy(&meta[0], IMC_SHARD_MAGIC, 4);
+    memcpy(&meta[4], &version, sizeof(version));
+    memcpy(&meta[8], &size_le, sizeof(size_le));
+
+    size_t pos = 0;
+    __write_payload_at(carrier_img, pos, sizeof(meta), meta);
+    pos += sizeof(meta) * 8;
+    __write_payload_at(carrier_img, pos, sizeof(ShardHeader), (const uint8_t *)shard);
+    pos += sizeof(ShardHeader) * 8;
+    __write_payload_at(carrier_img, pos, crypto_secretstream_xchacha20poly1305_HEADERBYTES, crypto_header);
+    pos += crypto_secretstream_xchacha20poly1305_HEADERBYTES * 8;
+    __write_payload_at(carrier_img, pos, data_size, data);
+    pos += data_size * 8;
+
+    carrier_img->carrier_pos = pos;
+    return IMC_SUCCESS;
+}
+
+// Read the shard at the beginning of the carrier (its data is still encrypted)
+// On success, 'out_shard' receives the shard's header, 'crypto_header' the decryption header of the stream,
+// and 'out_data' the encrypted part of the stream (to be freed with 'imc_free()'), whose size goes to 'out_size'.
+// Returns IMC_ERR_INVALID_MAGIC if there is no shard on the image (or the password is incorrect).
+int imc_steg_read_shard(
+    const CarrierImage *carrier_img,
+    ShardHeader *out_shard,
+    uint8_t *crypto_header,
+    uint8_t **out_data,
+    size_t *out_size
+)
+{
+    uint8_t meta[IMC_SEGMENT_META_SIZE];
+    if (!__read_payload_at(carrier_img, 0, sizeof(meta), meta)) return IMC_ERR_PAYLOAD_OOB;
+    if (memcmp(&meta[0], IMC_SHARD_MAGIC, 4) != 0) return IMC_ERR_INVALID_MAGIC;
+
+    uint32_t version, shard_size;
+    memcpy(&version, &meta[4], sizeof(version));
+    memcpy(&shard_size, &meta[8], sizeof(shard_size));
+    if (le32toh(version) > IMC_SHARD_VERSION) return IMC_ERR_NEWER_VERSION;
+    shard_size = le32toh(shard_size);
+
+    // The shard must have at least its headers and the authentication bytes of its part of the stream
+    const size_t headers_size = sizeof(ShardHeader) + crypto_secretstream_xchacha20poly1305_HEADERBYTES;
+    if (shard_size < headers_size + crypto_secretstream_xchacha20poly1305_ABYTES) return IMC_ERR_CRYPTO_FAIL;
+
+    size_t pos = sizeof(meta) * 8;
+    if (!__read_payload_at(carrier_img, pos, sizeof(ShardHeader), (uint8_t *)out_shard)) return IMC_ERR_PAYLOAD_OOB;
+    pos += sizeof(ShardHeader) * 8;
+    if (!__read_payload_at(carrier_img, pos, crypto_secretstream_xchacha20poly1305_HEADERBYTES, crypto_header)) return IMC_ERR_PAYLOAD_OOB;
+    pos += crypto_secretstream_xchacha20poly1305_HEADERBYTES * 8;
+
+    const size_t data_size = shard_size - headers_size;
+    uint8_t *const data = imc_malloc(data_size);
+    if (!__read_payload_at(carrier_img, pos, data_size, data))
     {
-        jpeg_obj->progress = imc_calloc(1, sizeof(struct jpeg_progress_mgr));
-        jpeg_obj->progress->progress_monitor = &__jpeg_read_callback;
+        imc_free(data);
+        return IMC_ERR_PAYLOAD_OOB;
     }
 
-    // Read the DCT coefficients from the image
-    jpeg_read_header(jpeg_obj, true);
-    jvirt_barray_ptr *jpeg_dct = jpeg_read_coefficients(jpeg_obj);
+    *out_data = data;
+    *out_size = data_size;
+    return IMC_SUCCESS;
+}
 
-    // Finish the read's progress monitor
-    if (carrier_img->verbose)
+// Decompress a stream that was reassembled from its shards, then save its file to 'out_dir' (or the current working directory, if NULL)
+// 'stream' is the decrypted stream (the header of the 'FileInfo' struct, followed by the compressed data), and 'progress' can be NULL.
+// On success, 'out_info' receives the metadata of the file (to be freed with 'imc_free()').
+// Returns IMC_ERR_SAVE_FAIL if the file could not be created (and 'errno' has the reason).
+int imc_steg_extract_buffer(
+    const uint8_t *stream,
+    size_t stream_size,
+    const char *out_dir,
+    const ProgressMonitor *progress,
+    FileMetadata **out_info
+)
+{
+    uint8_t *file_stream = NULL;
+    size_t file_stream_size = 0;
+    int status = __stream_decompress(stream, stream_size, progress, &file_stream, &file_stream_size);
+    if (status != IMC_SUCCESS) return status;
+
+    FileMetadata *info = NULL;
+    size_t file_start = 0;
+    status = __file_metadata(file_stream, file_stream_size, &info, &file_start);
+    if (status != IMC_SUCCESS)
     {
-        imc_free(jpeg_obj->progress);
-        jpeg_obj->progress = NULL;
-        printf("Reading JPEG image... Done!  \n");
+        imc_clear_free(file_stream, file_stream_size);
+        return status;
     }
 
-    // Calculate the total amount of DCT coeficients
-    size_t dct_count = 0;
-    for (int comp = 0; comp < jpeg_obj->num_components; comp++)
+    #ifdef _WIN32   // Windows systems
+    const imc_dir_t dir = out_dir;
+    
+    #else   // Linux systems
+    const imc_dir_t dir = out_dir ? open(out_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : AT_FDCWD;
+    if (dir < 0)
     {
-        dct_count += jpeg_obj->comp_info[comp].height_in_blocks * jpeg_obj->comp_info[comp].width_in_blocks * DCTSIZE2;
+        imc_clear_free(file_stream, file_stream_size);
+        imc_free(info);
+        return IMC_ERR_SAVE_FAIL;
     }
+    
+    #endif  // _WIN32
 
-    // Estimate the size of the array of carrier values and allocate it
-    size_t carrier_capacity = dct_count / 8;
-    if (carrier_capacity == 0) carrier_capacity = 1;
-    carrier_bytes_t carrier_bytes = imc_calloc(carrier_capacity, sizeof(uint8_t));
-    size_t carrier_count = 0;
+    // Create the output file (its name is made unique, if it already isn't)
+    char file_name[info->name_size + 16];
+    __extracted_filename(info, file_name);
+    FILE *out_file = __create_output_at(dir, file_name, &status);
     
-    // Iterate over the color components
-    for (int comp = 0; comp < jpeg_obj->num_components; comp++)
-    {
-        // Iterate row by row from from top to bottom
-        for (JDIMENSION y = 0; y < jpeg_obj->comp_info[comp].height_in_blocks; y++)
+    if (out_file) __write_extracted(out_file, dir, file_name, info, &file_stream[file_start], progress);
+    
+    #ifndef _WIN32
+    const int error_number = errno;
+    if (dir != AT_FDCWD) close(dir);
+    errno = error_number;
+    #endif  // _WIN32
+    
+    imc_clear_free(file_stream, file_stream_size);
+    
+    if (!out_file)
+    {
+        imc_free(info);
+        return status;
+    }
+
+    *out_info = info;
+    return IMC_SUCCESS;
+}
+
+// Worker function for extracting the hidden file of index 'task'
+static void __extract_task(void *context, size_t task, size_t worker)
+{
+    ExtractJob *const job = (ExtractJob *)context;
+    ExtractResult *const result = &job->results[task];
+    const CarrierImage *const carrier_img = job->carrier_img;
+    
+    // Decrypt and decompress the hidden file
+    size_t pos = job->index->segment[task].start;
+    uint8_t *stream = NULL;
+    size_t stream_size = 0;
+    size_t file_start = 0;
+    result->status = __segment_unpack(carrier_img, &pos, job->verbose, &stream, &stream_size);
+
+    // Get the file's metadata
+    if (result->status == IMC_SUCCESS)
+    {
+        result->status = __file_metadata(stream, stream_size, &result->info, &file_start);
+    }
+
+    // Name of the output file
+    const size_t name_size = (result->info) ? result->info->name_size : 0;
+    char file_name[name_size + 16];
+    FILE *out_file = NULL;
+    
+    // Wait for the turn of this file, then create the output file
+    pthread_mutex_lock(&job->lock);
+    while (job->next_turn != task) pthread_cond_wait(&job->turn, &job->lock);
+    
+    if (result->status == IMC_SUCCESS && !carrier_img->just_check)
+    {
+        __extracted_filename(result->info, file_name);
+        out_file = __create_output_at(job->dirs[worker], file_name, &result->status);
+        if (!out_file) result->error_number = errno;
+    }
+
+    job->next_turn++;
+    pthread_cond_broadcast(&job->turn);
+    pthread_mutex_unlock(&job->lock);
+
+    // Write the hidden file to disk
+    // (this is done after passing the turn, so other files can be created in the meantime)
+    if (out_file)
+    {
+        __write_extracted(out_file, job->dirs[worker], file_name, result->info, &stream[file_start], job->verbose ? &carrier_img->progress : NULL);
+    }
+
+    imc_free(stream);
+}
+
+// Extract all the hidden files at once, with up to 'thread_count' files being processed in parallel
+// The files are saved to 'out_dir' (or the current working directory, if NULL), each worker using its own handle of the directory.
+// On 'results' is stored a newly allocated array with the outcome for each hidden file (in the same order as they were hidden),
+// and on 'result_count' the amount of hidden files found. The array should be freed with 'imc_steg_results_free()'.
+// The returned status code is the reason why there are no more hidden files after the last one
+// (IMC_ERR_INVALID_MAGIC, IMC_ERR_PAYLOAD_OOB or IMC_ERR_NEWER_VERSION), or IMC_ERR_SAVE_FAIL if 'out_dir' could not be opened.
+int imc_steg_extract_all(CarrierImage *carrier_img, const char *out_dir, size_t thread_count, ExtractResult **results, size_t *result_count)
+{
+    *results = NULL;
+    *result_count = 0;
+
+    // Find where the hidden files are on the carrier
+    if (carrier_img->verbose && !carrier_img->just_check) imc_progress(&carrier_img->progress, "Indexing hidden data... ");
+    SegmentIndex *index = imc_steg_index(carrier_img);
+    if (carrier_img->verbose && !carrier_img->just_check) imc_progress(&carrier_img->progress, "Done!\n");
+    
+    const size_t count = index->count;
+    const int end_status = index->status;
+    carrier_img->carrier_pos = index->end;
+    
+    if (count == 0)
+    {
+        imc_steg_index_free(index);
+        return end_status;
+    }
+
+    if (thread_count == 0) thread_count = imc_cpu_count();
+    if (thread_count > count) thread_count = count;
+
+    // Open the output directory once for each worker
+    imc_dir_t dirs[thread_count];
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        #ifdef _WIN32   // Windows systems
+        dirs[i] = out_dir;
+        
+        #else   // Linux systems
+        if (!out_dir || carrier_img->just_check)
+        {
+            dirs[i] = AT_FDCWD;
+            continue;
+        }
+        
+        dirs[i] = open(out_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirs[i] < 0)
+        {
+            const int error_number = errno;
+            for (size_t j = 0; j < i; j++) close(dirs[j]);
+            imc_steg_index_free(index);
+            errno = error_number;
+            return IMC_ERR_SAVE_FAIL;
+        }
+        
+        #endif  // _WIN32
+    }
+    
+    // Shared state of the workers
+    ExtractJob job = {
+        .carrier_img = carrier_img,
+        .index = index,
+        .results = imc_calloc(count, sizeof(ExtractResult)),
+        .dirs = dirs,
+        .verbose = carrier_img->verbose && (thread_count == 1),
+        .next_turn = 0,
+    };
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.turn, NULL);
+    /* Note:
+        The per-step status messages are only printed when there is a single worker,
+        otherwise the messages from different files would be mixed together.
+    */
+
+    // Process the hidden files
+    const bool print_msg = carrier_img->verbose && (thread_count > 1);
+    if (print_msg && carrier_img->just_check) imc_progress(&carrier_img->progress, "\n");
+    if (print_msg) imc_progress(&carrier_img->progress, "Processing %zu hidden files on %zu threads... ", count, thread_count);
+    imc_parallel_for(count, thread_count, &__extract_task, &job);
+    if (print_msg) imc_progress(&carrier_img->progress, "Done!\n");
+
+    // Close the directories
+    #ifndef _WIN32
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        if (dirs[i] != AT_FDCWD) close(dirs[i]);
+    }
+    #endif  // _WIN32
+
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.turn);
+    imc_steg_index_free(index);
+
+    *results = job.results;
+    *result_count = count;
+    
+    return end_status;
+}
+
+// Write the header block of a tar archive's entry (POSIX ustar format)
+static void __tar_header(uint8_t *block, const char *name, size_t size, int64_t mod_time, char type)
+{
+    memset(block, 0, IMC_TAR_BLOCK_SIZE);
+    
+    strncpy((char *)&block[0], name, 100);                                          // Name
+    snprintf((char *)&block[100], 8, "%07o", 0644);                                 // Permissions
+    snprintf((char *)&block[108], 8, "%07o", 0);                                    // User ID
+    snprintf((char *)&block[116], 8, "%07o", 0);                                    // Group ID
+    snprintf((char *)&block[124], 12, "%011llo", (unsigned long long)size);         // Size
+    snprintf((char *)&block[136], 12, "%011llo", (unsigned long long)(mod_time > 0 ? mod_time : 0)); // Modified time
+    block[156] = type;                                                              // Type of the entry
+    memcpy(&block[257], "ustar", 6);                                                // Magic
+    memcpy(&block[263], "00", 2);                                                   // Version
+
+    // Checksum (sum of all bytes of the header, counting the checksum field itself as spaces)
+    memset(&block[148], ' ', 8);
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < IMC_TAR_BLOCK_SIZE; i++) checksum += block[i];
+    snprintf((char *)&block[148], 8, "%06o", checksum);
+    block[155] = ' ';
+}
+
+// Write data to a tar archive, followed by the zeros that pad it to a whole amount of blocks
+// Returns 'false' if the data could not be written.
+static bool __tar_write_data(FILE *out_stream, const uint8_t *data, size_t size)
+{
+    static const uint8_t zeros[IMC_TAR_BLOCK_SIZE] = {0};
+    const size_t padding = (IMC_TAR_BLOCK_SIZE - (size % IMC_TAR_BLOCK_SIZE)) % IMC_TAR_BLOCK_SIZE;
+    
+    if (size > 0 && fwrite(data, 1, size, out_stream) != size) return false;
+    if (padding > 0 && fwrite(zeros, 1, padding, out_stream) != padding) return false;
+    return true;
+}
+
+// Write an extracted file to a tar archive
+// The entry has the name and modified time of the file. If the name does not fit on the ustar header,
+// it is stored on a PAX extended header before the entry.
+static int __tar_write_file(FILE *out_stream, const FileMetadata *info, const uint8_t *data)
+{
+    // Keep the archive flat, in case the name has directory separators
+    char name[info->name_size];
+    memcpy(name, info->file_name, info->name_size);
+    name[info->name_size - 1] = '\0';
+    for (size_t i = 0; name[i] != '\0'; i++)
+    {
+        if (name[i] == '/' || name[i] == '\\') name[i] = '_';
+    }
+    
+    const size_t name_len = strlen(name);
+    uint8_t header[IMC_TAR_BLOCK_SIZE];
+
+    if (name_len >= 100)
+    {
+        // PAX record: "<length> path=<name>\n" (the length counts its own digits)
+        const size_t base_len = strlen(" path=\n") + name_len;
+        size_t record_len = base_len + 1;
+        while (snprintf(NULL, 0, "%zu", record_len) + base_len != record_len) record_len++;
+        
+        char record[record_len + 1];
+        snprintf(record, sizeof(record), "%zu path=%s\n", record_len, name);
+        
+        __tar_header(header, "PaxHeader", record_len, info->mod_time.tv_sec, 'x');
+        if (!__tar_write_data(out_stream, header, sizeof(header))) return IMC_ERR_SAVE_FAIL;
+        if (!__tar_write_data(out_stream, (uint8_t *)record, record_len)) return IMC_ERR_SAVE_FAIL;
+    }
+
+    // Header of the file, followed by its contents
+    // (a name that is too long gets truncated here, but the PAX header takes precedence over it)
+    __tar_header(header, name, info->file_size, info->mod_time.tv_sec, '0');
+    if (!__tar_write_data(out_stream, header, sizeof(header))) return IMC_ERR_SAVE_FAIL;
+    if (!__tar_write_data(out_stream, data, info->file_size)) return IMC_ERR_SAVE_FAIL;
+    
+    return IMC_SUCCESS;
+}
+
+// Extract the hidden files to an open stream (such as the standard output), in the same order as they were hidden
+// If 'tar' is true, the files are written as a tar archive (with their names and modified times).
+// Otherwise, only the first hidden file is written to the stream (as it is).
+// The results are returned in the same way as 'imc_steg_extract_all()', and the returned status code is also the same,
+// except that IMC_ERR_SAVE_FAIL means that a file could not be written to the stream (and 'errno' has the reason).
+int imc_steg_extract_stream(CarrierImage *carrier_img, FILE *out_stream, bool tar, ExtractResult **results, size_t *result_count)
+{
+    *results = NULL;
+    *result_count = 0;
+
+    SegmentIndex *index = imc_steg_index(carrier_img);
+    const size_t count = (tar || index->count == 0) ? index->count : 1;
+    int end_status = index->status;
+    carrier_img->carrier_pos = index->end;
+
+    if (count == 0)
+    {
+        imc_steg_index_free(index);
+        return end_status;
+    }
+    
+    __set_binary_mode(out_stream);
+    ExtractResult *res = imc_calloc(count, sizeof(ExtractResult));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Decrypt and decompress the hidden file
+        size_t pos = index->segment[i].start;
+        uint8_t *stream = NULL;
+        size_t stream_size = 0;
+        size_t file_start = 0;
+        res[i].status = __segment_unpack(carrier_img, &pos, carrier_img->verbose, &stream, &stream_size);
+
+        // Get the file's metadata
+        if (res[i].status == IMC_SUCCESS)
+        {
+            res[i].status = __file_metadata(stream, stream_size, &res[i].info, &file_start);
+        }
+
+        // Write the file to the stream
+        if (res[i].status == IMC_SUCCESS)
+        {
+            if (tar)
+            {
+                res[i].status = __tar_write_file(out_stream, res[i].info, &stream[file_start]);
+            }
+            else if (fwrite(&stream[file_start], 1, res[i].info->file_size, out_stream) != res[i].info->file_size)
+            {
+                res[i].status = IMC_ERR_SAVE_FAIL;
+            }
+            
+            if (res[i].status != IMC_SUCCESS) res[i].error_number = errno;
+        }
+
+        imc_free(stream);
+    }
+
+    // Two empty blocks mark the end of a tar archive
+    if (tar)
+    {
+        static const uint8_t end_blocks[IMC_TAR_BLOCK_SIZE * 2] = {0};
+        fwrite(end_blocks, 1, sizeof(end_blocks), out_stream);
+    }
+
+    if (fflush(out_stream) != 0) end_status = IMC_ERR_SAVE_FAIL;
+
+    imc_steg_index_free(index);
+    *results = res;
+    *result_count = count;
+    
+    return end_status;
+}
+
+// Free the memory used by the array of results of 'imc_steg_extract_all()'
+void imc_steg_results_free(ExtractResult *results, size_t result_count)
+{
+    if (!results) return;
+    for (size_t i = 0; i < result_count; i++)
+    {
+        imc_free(results[i].info);
+    }
+    imc_free(results);
+}
+
+// Change the password of the data hidden on an image opened by 'imc_steg_open()'
+// The carrier is shuffled with both the old and the new secrets. The hidden files are decrypted with 'old_crypto',
+// then encrypted again with 'new_crypto' (they are not decompressed, so they are not compressed again either).
+// The old positions of the hidden data get random bits before the data is written to its new positions.
+// On success, 'file_count' receives the amount of hidden files. Nothing is changed on the image if any file fails to decrypt.
+int imc_steg_rekey(CarrierImage *carrier_img, const CryptoContext *old_crypto, const CryptoContext *new_crypto, size_t *file_count)
+{
+    const size_t length = carrier_img->carrier_lenght;
+    carrier_bytes_t *const image_order = carrier_img->carrier;  // Carrier on the same order as the image
+    
+    // Shuffle a copy of the carrier with the old secrets
+    carrier_bytes_t *old_carrier = imc_malloc(length * sizeof(carrier_bytes_t));
+    memcpy(old_carrier, image_order, length * sizeof(carrier_bytes_t));
+    
+    int status = imc_crypto_context_clone(old_crypto, &carrier_img->crypto);
+    if (status != IMC_SUCCESS)
+    {
+        imc_free(old_carrier);
+        return status;
+    }
+    
+    imc_crypto_shuffle_ptr(carrier_img->crypto, (uintptr_t *)old_carrier, length, &carrier_img->progress);
+    carrier_img->carrier = old_carrier;
+
+    // Find and decrypt the hidden files
+    SegmentIndex *index = imc_steg_index(carrier_img);
+    uint8_t **streams = imc_calloc(index->count, sizeof(uint8_t *));
+    size_t *stream_sizes = imc_calloc(index->count, sizeof(size_t));
+    
+    if (index->count == 0) status = index->status;
+    
+    for (size_t i = 0; i < index->count && status == IMC_SUCCESS; i++)
+    {
+        size_t pos = index->segment[i].start;
+        status = __segment_decrypt(carrier_img, &pos, carrier_img->verbose, &streams[i], &stream_sizes[i]);
+    }
+
+    if (status == IMC_SUCCESS)
+    {
+        // Overwrite the old hidden data with random bits
+        const size_t old_size = index->end / 8;
+        uint8_t *noise = imc_malloc(old_size);
+        randombytes_buf(noise, old_size);
+        __write_payload_at(carrier_img, 0, old_size, noise);
+        imc_free(noise);
+    }
+
+    // Go back to the carrier on the image's order
+    imc_crypto_context_destroy(carrier_img->crypto);
+    carrier_img->crypto = NULL;
+    carrier_img->carrier = image_order;
+    imc_free(old_carrier);
+
+    if (status == IMC_SUCCESS)
+    {
+        // Shuffle the carrier with the new secrets
+        status = imc_crypto_context_clone(new_crypto, &carrier_img->crypto);
+    }
+
+    if (status == IMC_SUCCESS)
+    {
+        imc_crypto_shuffle_ptr(carrier_img->crypto, (uintptr_t *)image_order, length, &carrier_img->progress);
+        carrier_img->carrier_pos = 0;
+        
+        // Encrypt the hidden files again, on the same order as before
+        // (they fit, because the sizes of the encrypted streams do not change)
+        for (size_t i = 0; i < index->count && status == IMC_SUCCESS; i++)
+        {
+            char label[32];
+            snprintf(label, sizeof(label), "hidden file %zu", i + 1);
+            status = __segment_pack(carrier_img, streams[i], stream_sizes[i], label);
+        }
+    }
+
+    if (status == IMC_SUCCESS) *file_count = index->count;
+
+    for (size_t i = 0; i < index->count; i++)
+    {
+        if (streams[i]) imc_clear_free(streams[i], stream_sizes[i]);
+    }
+    imc_free(streams);
+    imc_free(stream_sizes);
+    imc_steg_index_free(index);
+
+    return status;
+}
+
+// Copy the data hidden on an image to another image, without decrypting it
+// Both images must have been initialized with the same secrets, so the encrypted hidden files are valid on either of them.
+// The hidden files are written to the beginning of the destination's carrier (overwriting the data previously hidden there).
+// On success, 'file_count' receives the amount of hidden files that were copied. Nothing is changed on the source image.
+int imc_steg_transplant(const CarrierImage *source, CarrierImage *destination, size_t *file_count)
+{
+    // Find the hidden files on the source image
+    SegmentIndex *index = imc_steg_index(source);
+    int status = IMC_SUCCESS;
+    
+    if (index->count == 0)
+    {
+        status = index->status;
+    }
+    else if (index->end > destination->carrier_lenght)
+    {
+        status = IMC_ERR_FILE_TOO_BIG;
+    }
+
+    if (status == IMC_SUCCESS)
+    {
+        // Copy the raw bytes of the hidden files (they are still encrypted)
+        const size_t size = index->end / 8;
+        uint8_t *raw_data = imc_malloc(size);
+        
+        imc_progress(&source->progress, "Copying %zu hidden file(s)...", index->count);
+        __read_payload_at(source, 0, size, raw_data);
+        __write_payload_at(destination, 0, size, raw_data);
+        imc_progress(&source->progress, " Done!\n");
+        
+        imc_free(raw_data);
+        destination->carrier_pos = index->end;
+        *file_count = index->count;
+    }
+
+    imc_steg_index_free(index);
+    return status;
+}
+
+// Remove from the image the first hidden file named 'file_name'
+// The hidden files are decrypted in order until the file is found, but only their names are decompressed.
+// The encrypted hidden files after it are moved back (without decrypting them) to where the removed file began,
+// and the space freed at the end of the hidden data gets random bits. Returns IMC_ERR_FILE_NOT_FOUND if no hidden file has that name.
+int imc_steg_remove(CarrierImage *carrier_img, const char *file_name)
+{
+    SegmentIndex *index = imc_steg_index(carrier_img);
+    int status = (index->count == 0) ? index->status : IMC_ERR_FILE_NOT_FOUND;
+    size_t target = 0;
+
+    // Look for the hidden file with the given name
+    const bool print_msg = carrier_img->verbose && index->count > 0;
+    if (print_msg) imc_progress(&carrier_img->progress, "Looking for '%s'... ", file_name);
+    
+    for (size_t i = 0; i < index->count; i++)
+    {
+        size_t pos = index->segment[i].start;
+        uint8_t *stream = NULL;
+        size_t stream_size = 0;
+        int read_status = __segment_decrypt(carrier_img, &pos, false, &stream, &stream_size);
+        
+        char *name = NULL;
+        if (read_status == IMC_SUCCESS)
+        {
+            read_status = __segment_file_name(stream, stream_size, &name);
+            imc_clear_free(stream, stream_size);
+        }
+
+        if (read_status != IMC_SUCCESS)
+        {
+            status = read_status;
+            break;
+        }
+
+        const bool name_match = (strcmp(name, file_name) == 0);
+        imc_free(name);
+
+        if (name_match)
+        {
+            status = IMC_SUCCESS;
+            target = i;
+            break;
+        }
+    }
+
+    if (print_msg) imc_progress(&carrier_img->progress, status == IMC_SUCCESS ? "Done!\n" : "\n");
+
+    if (status == IMC_SUCCESS)
+    {
+        const CarrierSegment *const removed = &index->segment[target];
+        const size_t removed_bits = removed->end - removed->start;
+        const size_t tail_size = (index->end - removed->end) / 8;
+
+        // Move the hidden files that come after the removed one (they are still encrypted)
+        if (tail_size > 0)
+        {
+            imc_progress(&carrier_img->progress, "Moving %zu hidden file(s)... ", index->count - target - 1);
+            uint8_t *tail = imc_malloc(tail_size);
+            __read_payload_at(carrier_img, removed->end, tail_size, tail);
+            __write_payload_at(carrier_img, removed->start, tail_size, tail);
+            imc_free(tail);
+            imc_progress(&carrier_img->progress, "Done!\n");
+        }
+
+        // Overwrite the freed space with random bits
+        const size_t new_end = index->end - removed_bits;
+        const size_t noise_size = removed_bits / 8;
+        uint8_t *noise = imc_malloc(noise_size);
+        randombytes_buf(noise, noise_size);
+        __write_payload_at(carrier_img, new_end, noise_size, noise);
+        imc_free(noise);
+
+        carrier_img->carrier_pos = new_end;
+    }
+
+    imc_steg_index_free(index);
+    return status;
+}
+
+// Move the read position of the carrier bytes to right after the end of the last hidden file
+// Note: this function is intended to be used when in "append mode" while hiding a file.
+void imc_steg_seek_to_end(CarrierImage *carrier_img)
+{
+    SegmentIndex *index = imc_steg_index(carrier_img);
+    carrier_img->carrier_pos = index->end;
+    imc_steg_index_free(index);
+}
+
+// Map the contents of an open file to memory (copy-on-write)
+// The memory can be changed, but the changes are private to this program (they are never written back to the file).
+// The mapping should be released with 'imc_unmap_file()'. The file can be closed after that.
+int imc_map_file(FILE *file, uint8_t **out_data, size_t *out_size)
+{
+    #ifdef _WIN32   // Windows systems
+    
+    HANDLE file_handle = __win_get_file_handle(file);
+    LARGE_INTEGER file_size_win = {0};
+    GetFileSizeEx(file_handle, &file_size_win);
+    const size_t file_size = file_size_win.QuadPart;
+    if (file_size == 0) return IMC_ERR_FILE_INVALID;
+
+    HANDLE map_handle = CreateFileMapping(file_handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (map_handle == NULL) return IMC_ERR_FILE_INVALID;
+    
+    uint8_t *data = MapViewOfFile(map_handle, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(map_handle);    // The view keeps the mapping alive until it is unmapped
+    if (data == NULL) return IMC_ERR_NO_MEMORY;
+
+    #else   // Linux systems
+    
+    const int file_descriptor = fileno(file);
+    struct stat file_stats = {0};
+    if (fstat(file_descriptor, &file_stats) != 0 || file_stats.st_size <= 0) return IMC_ERR_FILE_INVALID;
+    const size_t file_size = file_stats.st_size;
+
+    // Only the pages that get changed are copied to memory, the other pages keep being read from the file
+    void *data = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file_descriptor, 0);
+    if (data == MAP_FAILED) return (errno == ENOMEM) ? IMC_ERR_NO_MEMORY : IMC_ERR_FILE_INVALID;
+
+    #endif // _WIN32
+
+    *out_data = (uint8_t *)data;
+    *out_size = file_size;
+    return IMC_SUCCESS;
+}
+
+// Release the memory mapping of a file
+void imc_unmap_file(const uint8_t *data, size_t size)
+{
+    if (!data) return;
+    
+    #ifdef _WIN32
+    UnmapViewOfFile(data);
+    #else
+    munmap((void *)data, size);
+    #endif // _WIN32
+}
+
+// Release the contents of a cover image, then close its file
+// (if 'file' is NULL, the image was read from the standard input into a heap buffer)
+static void __release_input(FILE *file, const uint8_t *data, size_t size)
+{
+    if (file)
+    {
+        imc_unmap_file(data, size);
+        fclose(file);
+    }
+    else
+    {
+        imc_free((void *)data);
+    }
+}
+
+// Read all the remaining data from a stream (such as the standard input) into a newly allocated buffer
+// Returns IMC_ERR_FILE_TOO_BIG if the stream has more than 'max_size' bytes, or IMC_ERR_FILE_INVALID if the stream could not be read.
+static int __read_stream(FILE *stream, size_t max_size, uint8_t **out_data, size_t *out_size)
+{
+    size_t capacity = 65536;
+    size_t size = 0;
+    uint8_t *data = imc_malloc(capacity);
+
+    while (!feof(stream) && !ferror(stream))
+    {
+        // Double the buffer when it gets full
+        if (size == capacity)
+        {
+            capacity *= 2;
+            data = imc_realloc(data, capacity);
+        }
+        
+        size += fread(&data[size], 1, capacity - size, stream);
+        
+        if (size > max_size)
+        {
+            imc_clear_free(data, size);
+            return IMC_ERR_FILE_TOO_BIG;
+        }
+    }
+
+    if (ferror(stream))
+    {
+        imc_clear_free(data, size);
+        return IMC_ERR_FILE_INVALID;
+    }
+
+    *out_data = data;
+    *out_size = size;
+    return IMC_SUCCESS;
+}
+
+// Hash the cover image, then map its file on the cover cache to 'cache_mapping' (if the file exists and is valid)
+// This is done only for the formats whose decoded pixels can be cached (PNG and WebP).
+static void __cover_cache_load(CarrierImage *carrier_img, const char *cache_dir)
+{
+    carrier_img->cache_dir = cache_dir;
+    crypto_generichash(
+        carrier_img->cache_hash, sizeof(carrier_img->cache_hash),
+        carrier_img->mapping, carrier_img->mapping_size,
+        NULL, 0
+    );
+
+    char *const cache_path = __cover_cache_path(cache_dir, carrier_img->cache_hash, "");
+    FILE *cache_file = fopen(cache_path, "rb");
+    imc_free(cache_path);
+    if (!cache_file) return;
+
+    // The file is mapped copy-on-write, so the hidden data can be written directly on the cached pixels
+    uint8_t *data = NULL;
+    size_t size = 0;
+    const int map_status = imc_map_file(cache_file, &data, &size);
+    fclose(cache_file);
+    if (map_status != IMC_SUCCESS) return;
+
+    // Check if the file was made for this image, by this version of the program, on a machine with the same byte order
+    const CoverCacheHeader *const header = (const CoverCacheHeader *)data;
+    const bool valid = (
+        size >= IMC_CACHE_DATA_OFFSET &&
+        memcmp(header->magic, IMC_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->byte_order == IMC_CACHE_BYTE_ORDER &&
+        header->version == IMC_CACHE_VERSION &&
+        header->type == carrier_img->type &&
+        memcmp(header->hash, carrier_img->cache_hash, sizeof(header->hash)) == 0
+    );
+
+    if (!valid)
+    {
+        imc_unmap_file(data, size);
+        return;
+    }
+
+    carrier_img->cache_mapping = data;
+    carrier_img->cache_mapping_size = size;
+}
+
+// Path of the cover cache file of an image, with 'suffix' added to its end (the path should be freed with 'imc_free()')
+static char *__cover_cache_path(const char *cache_dir, const uint8_t *hash, const char *suffix)
+{
+    char hash_hex[crypto_generichash_BYTES * 2 + 1];
+    sodium_bin2hex(hash_hex, sizeof(hash_hex), hash, crypto_generichash_BYTES);
+
+    #ifdef _WIN32
+    static const char separator = '\\';
+    #else
+    static const char separator = '/';
+    #endif // _WIN32
+
+    const size_t path_size = strlen(cache_dir) + sizeof(hash_hex) + strlen(suffix) + 8;
+    char *const path = imc_malloc(path_size);
+    snprintf(path, path_size, "%s%c%s.imcc%s", cache_dir, separator, hash_hex, suffix);
+    
+    return path;
+}
+
+// Get the carrier from the cached image, after checking that its dimensions match the ones of the cover image
+// Returns the cached pixels, or NULL if the cache file cannot be used (the file is unmapped in this case, so the image is decoded instead).
+static uint8_t *__cover_cache_carrier(CarrierImage *carrier_img, uint32_t width, uint32_t height, size_t stride)
+{
+    uint8_t *const data = carrier_img->cache_mapping;
+    const size_t size = carrier_img->cache_mapping_size;
+    const CoverCacheHeader *const header = (const CoverCacheHeader *)data;
+
+    // Size of each section of the file
+    const uint64_t pixels_size = header->pixels_size;
+    const uint64_t carrier_count = header->carrier_count;
+    const uint64_t carrier_offset = IMC_CACHE_DATA_OFFSET + ((pixels_size + IMC_CACHE_ALIGN - 1) / IMC_CACHE_ALIGN) * IMC_CACHE_ALIGN;
+    
+    const bool valid = (
+        header->width == width &&
+        header->height == height &&
+        header->stride == stride &&
+        pixels_size == (uint64_t)height * stride &&
+        pixels_size <= UINT32_MAX &&
+        carrier_count > 0 &&
+        carrier_offset <= size &&
+        carrier_count <= (size - carrier_offset) / sizeof(uint32_t)
+    );
+
+    uint8_t *const pixels = &data[IMC_CACHE_DATA_OFFSET];
+    const uint32_t *const position = (const uint32_t *)&data[carrier_offset];
+    carrier_bytes_t *carrier = valid ? imc_malloc(sizeof(carrier_bytes_t) * carrier_count) : NULL;
+
+    for (size_t i = 0; carrier && i < carrier_count; i++)
+    {
+        // A position outside the pixels means that the file is damaged
+        if (position[i] >= pixels_size)
+        {
+            imc_free(carrier);
+            carrier = NULL;
+            break;
+        }
+        
+        carrier[i] = &pixels[position[i]];
+    }
+
+    if (!carrier)
+    {
+        imc_unmap_file(data, size);
+        carrier_img->cache_mapping = NULL;
+        carrier_img->cache_mapping_size = 0;
+        return NULL;
+    }
+
+    imc_progress(&carrier_img->progress, "Reading decoded image from the cover cache... Done!  \n");
+
+    carrier_img->carrier = carrier;
+    carrier_img->carrier_lenght = carrier_count;
+    carrier_img->bytes = pixels;
+
+    return pixels;
+}
+
+// Write the decoded pixels and the (not shuffled yet) carrier of an image to the cover cache
+// The file is written under a temporary name, then renamed, so other processes never map a partial file.
+// Failing to write it is not an error, since the cache only makes the next openings faster.
+static void __cover_cache_store(CarrierImage *carrier_img, uint32_t width, uint32_t height, size_t stride, const uint8_t *pixels)
+{
+    const uint64_t pixels_size = (uint64_t)height * stride;
+    if (pixels_size > UINT32_MAX) return;   // The carrier positions have 4 bytes
+
+    // Each writer gets its own temporary file
+    uint8_t random_bytes[8];
+    char random_hex[sizeof(random_bytes) * 2 + 1];
+    randombytes_buf(random_bytes, sizeof(random_bytes));
+    sodium_bin2hex(random_hex, sizeof(random_hex), random_bytes, sizeof(random_bytes));
+    char temp_suffix[sizeof(random_hex) + 8];
+    snprintf(temp_suffix, sizeof(temp_suffix), ".%s.tmp", random_hex);
+
+    char *const cache_path = __cover_cache_path(carrier_img->cache_dir, carrier_img->cache_hash, "");
+    char *const temp_path = __cover_cache_path(carrier_img->cache_dir, carrier_img->cache_hash, temp_suffix);
+    FILE *cache_file = fopen(temp_path, "wb");
+    
+    if (!cache_file)
+    {
+        imc_free(cache_path);
+        imc_free(temp_path);
+        return;
+    }
+
+    imc_progress(&carrier_img->progress, "Writing decoded image to the cover cache... ");
+
+    CoverCacheHeader header = {
+        .magic = IMC_CACHE_MAGIC,
+        .byte_order = IMC_CACHE_BYTE_ORDER,
+        .version = IMC_CACHE_VERSION,
+        .type = carrier_img->type,
+        .width = width,
+        .height = height,
+        .stride = stride,
+        .pixels_size = pixels_size,
+        .carrier_count = carrier_img->carrier_lenght,
+    };
+    memcpy(header.hash, carrier_img->cache_hash, sizeof(header.hash));
+
+    static const uint8_t padding[IMC_CACHE_DATA_OFFSET] = {0};
+    const size_t pixels_padding = (IMC_CACHE_ALIGN - (pixels_size % IMC_CACHE_ALIGN)) % IMC_CACHE_ALIGN;
+    
+    bool success = (
+        fwrite(&header, sizeof(header), 1, cache_file) == 1 &&
+        fwrite(padding, 1, IMC_CACHE_DATA_OFFSET - sizeof(header), cache_file) == IMC_CACHE_DATA_OFFSET - sizeof(header) &&
+        fwrite(pixels, 1, pixels_size, cache_file) == pixels_size &&
+        fwrite(padding, 1, pixels_padding, cache_file) == pixels_padding
+    );
+
+    // Convert the carrier's pointers to positions on the pixels, a block at a time
+    uint32_t position[4096];
+    const size_t block_size = sizeof(position) / sizeof(uint32_t);
+    
+    for (size_t i = 0; success && i < carrier_img->carrier_lenght; i += block_size)
+    {
+        const size_t count = (carrier_img->carrier_lenght - i < block_size) ? carrier_img->carrier_lenght - i : block_size;
+        for (size_t j = 0; j < count; j++)
+        {
+            position[j] = (uint32_t)(carrier_img->carrier[i + j] - pixels);
+        }
+        success = fwrite(position, sizeof(uint32_t), count, cache_file) == count;
+    }
+
+    if (fclose(cache_file) != 0) success = false;
+
+    // Note: on Windows, the renaming fails if another process has cached the same image meanwhile (then its file is kept)
+    if (!success || rename(temp_path, cache_path) != 0) remove(temp_path);
+    
+    imc_progress(&carrier_img->progress, success ? "Done!  \n" : "\n");
+
+    imc_free(cache_path);
+    imc_free(temp_path);
+}
+
+// Whether a path means the standard input or the standard output (that is, the path is "-")
+bool imc_is_stdio_path(const char *path)
+{
+    return path && strcmp(path, "-") == 0;
+}
+
+// Rename a file or a folder, failing with 'errno' set to EEXIST if something already has the new name
+// Returns false if it could not be renamed ('errno' receives the reason).
+bool imc_rename_noreplace(const char *old_path, const char *new_path)
+{
+    #ifdef _WIN32
+    // On Windows, 'rename()' already fails if the new name exists
+    if (rename(old_path, new_path) == 0) return true;
+    if (errno == EACCES && _access(new_path, 0) == 0) errno = EEXIST;
+    return false;
+    
+    #else // Linux / Unix
+    #ifdef RENAME_NOREPLACE
+    if (renameat2(AT_FDCWD, old_path, AT_FDCWD, new_path, RENAME_NOREPLACE) == 0) return true;
+    if (errno != EINVAL && errno != ENOSYS) return false;
+    #endif // RENAME_NOREPLACE
+    
+    /* Note: without 'renameat2()' (or on file systems that do not support it), a file is renamed by creating a hard link
+       to it, because unlike 'rename()' it fails if the name exists. A folder cannot be linked, so it is renamed if nothing
+       has the name ('rename()' still refuses to replace a folder that has files, or a file with a folder). */
+    if (link(old_path, new_path) == 0)
+    {
+        unlink(old_path);
+        return true;
+    }
+
+    struct stat old_stat, new_stat;
+    if (errno != EPERM || lstat(old_path, &old_stat) != 0 || !S_ISDIR(old_stat.st_mode)) return false;
+    if (lstat(new_path, &new_stat) == 0)
+    {
+        errno = EEXIST;
+        return false;
+    }
+
+    return (errno == ENOENT && rename(old_path, new_path) == 0);
+    #endif // _WIN32
+}
+
+// Move a finished file from 'temp_path' to 'path', without replacing an existing file
+// If the name already exists, a number is appended to the file's stem (in the same way as when saving an image).
+// On success, 'out_path' receives the new path (to be freed with 'imc_free()').
+// Returns IMC_ERR_FILE_EXISTS if no free name was found, or IMC_ERR_SAVE_FAIL if the file could not be moved.
+int imc_move_file(const char *temp_path, const char *path, char **out_path)
+{
+    const size_t path_len = strlen(path);
+    if (path_len > UINT16_MAX) return IMC_ERR_SAVE_FAIL;
+    char new_path[path_len+16];
+
+    // The number goes up to 99, in order to avoid creating too many files accidentally
+    for (int i = 0; i <= IMC_MAX_FILENAME_DUPLICATES; i++)
+    {
+        if (i == 0) strcpy(new_path, path);
+        else __numbered_filename(path, i, new_path);
+
+        if (imc_rename_noreplace(temp_path, new_path))
+        {
+            *out_path = strdup(new_path);
+            return IMC_SUCCESS;
+        }
+
+        if (errno != EEXIST) return IMC_ERR_SAVE_FAIL;
+    }
+
+    return IMC_ERR_FILE_EXISTS;
+}
+
+// Stop the system from converting the line breaks of a standard stream (on Windows), so binary data can go through it
+static void __set_binary_mode(FILE *stream)
+{
+    #ifdef _WIN32
+    _setmode(_fileno(stream), _O_BINARY);
+    #else
+    (void)stream;
+    #endif // _WIN32
+}
+
+// Error handler of libjpeg-turbo: return to where 'setjmp()' was called with the 'JpegError' struct
+static void __jpeg_error_exit(j_common_ptr jpeg_obj)
+{
+    JpegError *const error = (JpegError *)jpeg_obj->err;
+    longjmp(error->jump, 1);
+}
+
+// Message handler of libjpeg-turbo: the warnings are ignored, since the library should not print anything
+static void __jpeg_output_message(j_common_ptr jpeg_obj)
+{
+    (void)jpeg_obj;
+}
+
+// Progress monitor when reading a JPEG image
+static void __jpeg_read_callback(j_common_ptr jpeg_obj)
+{
+    // Units of work within a reading pass
+    const double unit_count = jpeg_obj->progress->pass_counter;
+    const double unit_max   = jpeg_obj->progress->pass_limit;
+
+    // Reading passes through the image
+    const double pass_count = jpeg_obj->progress->completed_passes;
+    const double pass_max   = jpeg_obj->progress->total_passes;
+
+    // Percentage completed
+    const double percent = ((pass_count + (unit_count / unit_max)) / pass_max) * 100.0;
+    const JpegProgress *const progress = (JpegProgress *)jpeg_obj->progress;
+    imc_progress_rate(progress->progress, "Reading JPEG image... %.1f %%\r", percent);
+}
+
+// Get the bytes from a JPEG image that will carry the hidden data
+int imc_jpeg_carrier_open(CarrierImage *carrier_img)
+{
+    // Open the image for reading
+    struct jpeg_decompress_struct *jpeg_obj = imc_calloc(1, sizeof(struct jpeg_decompress_struct));
+    JpegError *jpeg_err = imc_malloc(sizeof(JpegError));
+    jpeg_obj->err = jpeg_std_error(&jpeg_err->manager);
+    jpeg_err->manager.error_exit = &__jpeg_error_exit;          // Return an error instead of exiting the program
+    jpeg_err->manager.output_message = &__jpeg_output_message;  // Do not print the warnings
+    
+    if (setjmp(jpeg_err->jump))
+    {
+        // The library has failed to decode the image
+        jpeg_destroy_decompress(jpeg_obj);
+        imc_free(jpeg_obj->progress);
+        imc_free(jpeg_obj);
+        imc_free(jpeg_err);
+        imc_free(carrier_img->bytes);
+        carrier_img->bytes = NULL;
+        return IMC_ERR_FILE_INVALID;
+    }
+    
+    jpeg_create_decompress(jpeg_obj);
+    jpeg_mem_src(jpeg_obj, carrier_img->mapping, carrier_img->mapping_size);
+
+    // Save to memory the application markers and comment marker
+    // (This is being done in order to preserve the metadata from the original image)
+    for (size_t i = 1; i < 16; i++)
+    {
+        if (i == 14) continue;
+        jpeg_save_markers(jpeg_obj, JPEG_APP0+i, 0xFFFF);
+        /* Note:
+            The JFIF marker (JPEG_APP0) and the Adobe marker (JPEG_APP14) are being skipped
+            because libjpeg-turbo already handles those automatically.
+        */
+    }
+    jpeg_save_markers(jpeg_obj, JPEG_COM, 0xFFFF);
+
+    // Setup the progress monitor for the JPEG's read operation
+    if (carrier_img->verbose)
+    {
+        JpegProgress *const progress = imc_calloc(1, sizeof(JpegProgress));
+        progress->manager.progress_monitor = &__jpeg_read_callback;
+        progress->progress = &carrier_img->progress;
+        jpeg_obj->progress = &progress->manager;
+    }
+
+    // Read the DCT coefficients from the image
+    jpeg_read_header(jpeg_obj, true);
+    jvirt_barray_ptr *jpeg_dct = jpeg_read_coefficients(jpeg_obj);
+
+    // Finish the read's progress monitor
+    if (carrier_img->verbose)
+    {
+        imc_free(jpeg_obj->progress);
+        jpeg_obj->progress = NULL;
+        imc_progress(&carrier_img->progress, "Reading JPEG image... Done!  \n");
+    }
+
+    // Calculate the total amount of DCT coeficients
+    size_t dct_count = 0;
+    for (int comp = 0; comp < jpeg_obj->num_components; comp++)
+    {
+        dct_count += jpeg_obj->comp_info[comp].height_in_blocks * jpeg_obj->comp_info[comp].width_in_blocks * DCTSIZE2;
+    }
+
+    // Estimate the size of the array of carrier values and allocate it
+    size_t carrier_capacity = dct_count / 8;
+    if (carrier_capacity == 0) carrier_capacity = 1;
+    carrier_bytes_t carrier_bytes = imc_calloc(carrier_capacity, sizeof(uint8_t));
+    size_t carrier_count = 0;
+    carrier_img->bytes = carrier_bytes;
+    /* Note:
+        The array is also stored on the struct, so it can be freed if the library jumps back to the 'setjmp()' above.
+        (the local variables changed after a 'setjmp()' have undefined values after the jump)
+    */
+    
+    // Iterate over the color components
+    for (int comp = 0; comp < jpeg_obj->num_components; comp++)
+    {
+        // Iterate row by row from from top to bottom
+        for (JDIMENSION y = 0; y < jpeg_obj->comp_info[comp].height_in_blocks; y++)
+        {
+            // Array of DCT coefficients for the current color component
+            JBLOCKARRAY coef_array = jpeg_obj->mem->access_virt_barray(
+                (j_common_ptr)jpeg_obj,     // Pointer to the JPEG object
+                jpeg_dct[comp],             // DCT coefficients for the current color component
+                y,                          // The current row of DCT blocks on the image
+                1,                          // Read one row of DCT blocks at a time
+                false                       // Opening the array in read-only mode
+            );
+
+            // Print status message (on verbose)
+            if (carrier_img->verbose)
+            {
+                const double row_count = jpeg_obj->comp_info[comp].height_in_blocks;
+                const double row_fraction = ((double)y / row_count) / (double)jpeg_obj->num_components;
+                const double comp_fraction = (double)comp / (double)jpeg_obj->num_components;
+                const double percent = (comp_fraction + row_fraction) * 100.0;
+                imc_progress_rate(&carrier_img->progress, "Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+            }
+
+            // Iterate column by column from left to right
+            for (JDIMENSION x = 0; x < jpeg_obj->comp_info[comp].width_in_blocks; x++)
+            {
+                // Iterate over the 63 AC coefficients
+                // (the DC coefficient of the block is skipped, because modifying it causes a bigger visual impact,
+                //  because this coefficient represents the average color of the current block of pixels)
+                for (JCOEF i = 1; i < DCTSIZE2; i++)
+                {
+                    // Resize the array of carriers if it is full
+                    if (carrier_count == carrier_capacity)
+                    {
+                        carrier_capacity *= 2;
+                        carrier_bytes = imc_realloc(carrier_bytes, carrier_capacity * sizeof(uint8_t));
+                        carrier_img->bytes = carrier_bytes;
+                    }
+
+                    // The current coefficient
+                    const JCOEF coef = coef_array[0][x][i];
+
+                    // Only the AC coefficients that are not 0 or 1 are used as carriers
+                    // (that makes the new image to have nearly the same size as the original image,
+                    //  because JPEG compresses zeroes using run length encoding)
+                    if (coef != 0 && coef != 1)
+                    {
+                        // Store the value of the least significant byte of the coefficient
+                        carrier_bytes[carrier_count++] = (uint8_t)(coef & (JCOEF)255);
+                    }
+                }
+            }
+        }
+    }
+
+    // Print status message (on verbose)
+    imc_progress(&carrier_img->progress, "Scanning cover image for suitable carrier bits... Done!  \n");
+
+    // Check for edge case
+    // (this may happen if the image is just a flat color)
+    if (carrier_count == 0)
+    {
+        jpeg_destroy_decompress(jpeg_obj);
+        imc_free(jpeg_obj);
+        imc_free(jpeg_err);
+        imc_free(carrier_bytes);
+        carrier_img->bytes = NULL;
+        return IMC_ERR_NO_CARRIER;
+    }
+    
+    // Free the unusued space of the array
+    carrier_bytes = imc_realloc(carrier_bytes, carrier_count * sizeof(uint8_t));
+
+    // Store the pointers to each element of the bytes array
+    carrier_bytes_t *carrier_ptr = imc_calloc(carrier_count, sizeof(uint8_t *));
+
+    for (size_t i = 0; i < carrier_count; i++)
+    {
+        carrier_ptr[i] = &carrier_bytes[i];
+    }
+
+    // Store the output
+    carrier_img->bytes = carrier_bytes;             // Array of bytes
+    carrier_img->carrier = carrier_ptr;             // Array of pointers to bytes
+    carrier_img->carrier_lenght = carrier_count;    // Total amount of pointers to bytes
+    carrier_img->object = jpeg_obj;                 // Image handler
+    carrier_img->width = jpeg_obj->image_width;
+    carrier_img->height = jpeg_obj->image_height;
+    
+    // Store the additional heap allocated memory for the purpose of memory management
+    carrier_img->heap = imc_malloc(sizeof(void *) * 2);
+    carrier_img->heap[0] = (void *)jpeg_err;
+    carrier_img->heap[1] = (void *)jpeg_dct;
+    carrier_img->heap_lenght = 1;
+    /* Note:
+        The lenght above is set to 1, even though it is actually 2, because
+        the memory of '*jpeg_dct' is managed by libjpeg-turbo (instead of my code).
+        The lenght of 1 prevents my code from attempting to free that memory.
+    */
+
+    return IMC_SUCCESS;
+}
+
+// Error handler of libpng: return to where 'setjmp()' was called (without printing the error)
+static void __png_error(png_structp png_obj, png_const_charp message)
+{
+    (void)message;
+    png_longjmp(png_obj, 1);
+}
+
+// Warning handler of libpng: the warnings are ignored, since the library should not print anything
+static void __png_warning(png_structp png_obj, png_const_charp message)
+{
+    (void)png_obj;
+    (void)message;
+}
+
+// Progress monitor when reading a PNG image
+static void __png_read_callback(png_structp png_obj, png_uint_32 row, int pass)
+{
+    const PngState *const state = (PngState *)png_get_error_ptr(png_obj);
+    const double percent = (((double)pass + ((double)row / state->num_rows)) / state->num_passes) * 100.0;
+    imc_progress_rate(state->progress, "Reading PNG image... %.1f %%\r", percent);
+}
+
+// Read function for libpng: copy the next bytes of the PNG file from its memory mapping
+static void __png_read_mapping(png_structp png_obj, png_bytep out_data, size_t length)
+{
+    PngState *const state = (PngState *)png_get_io_ptr(png_obj);
+    
+    if (length > state->input_size - state->input_pos)
+    {
+        // Error handling jumps back to the 'setjmp()' on 'imc_png_carrier_open()'
+        png_error(png_obj, "Unexpected end of the PNG file");
+    }
+
+    memcpy(out_data, &state->input[state->input_pos], length);
+    state->input_pos += length;
+}
+
+// Value that a filter of a PNG image subtracts from a byte, given the bytes to its left (a), above (b), and above to the left (c)
+static inline int __png_predictor(uint8_t type, int a, int b, int c)
+{
+    switch (type)
+    {
+        case PNG_FILTER_VALUE_SUB:
+            return a;
+        
+        case PNG_FILTER_VALUE_UP:
+            return b;
+        
+        case PNG_FILTER_VALUE_AVG:
+            return (a + b) / 2;
+        
+        case PNG_FILTER_VALUE_PAETH:
+        {
+            const int pa = abs(b - c);
+            const int pb = abs(a - c);
+            const int pc = abs(a + b - c - c);
+            return (pa <= pb && pa <= pc) ? a : ((pb <= pc) ? b : c);
+        }
+        
+        default:    // PNG_FILTER_VALUE_NONE
+            return 0;
+    }
+}
+
+// Reverse the filter of a row of a PNG image
+// 'previous' is the unfiltered row above it (all zeroes on the first row).
+static void __png_unfilter_row(uint8_t type, const uint8_t *filtered, const uint8_t *previous, size_t stride, size_t pixel_size, uint8_t *out_row)
+{
+    for (size_t i = 0; i < stride; i++)
+    {
+        // Bytes to the left (a), above (b), and above to the left (c) of the current byte
+        const int a = (i >= pixel_size) ? out_row[i - pixel_size] : 0;
+        const int b = previous[i];
+        const int c = (i >= pixel_size) ? previous[i - pixel_size] : 0;
+        out_row[i] = (uint8_t)(filtered[i] + __png_predictor(type, a, b, c));
+    }
+}
+
+// Decode the rows of a non-interlaced PNG image directly from its file, keeping the filter type of each row
+// 'out_filters' receives the filter type of each row. Returns IMC_ERR_UNSUPPORTED if there are other chunks after the
+// image's data (besides IEND), in which case the image should be decoded by libpng (so those chunks are also read).
+// Returns IMC_ERR_FILE_INVALID if the image's data is damaged.
+static int __png_decode_rows(
+    const uint8_t *file,
+    size_t file_size,
+    png_bytep *row_pointers,
+    size_t height,
+    size_t stride,
+    size_t pixel_size,
+    const ProgressMonitor *progress,
+    uint8_t *out_filters
+)
+{
+    // Find the consecutive IDAT chunks, and check that there is nothing else after them
+    size_t first_idat = 0;  // Position of the first IDAT chunk
+    size_t end_idat = 0;    // Position after the last IDAT chunk
+    size_t pos = 8;         // The chunks come after the PNG signature (8 bytes)
+    bool done = false;
+
+    while (!done && pos + 12 <= file_size)
+    {
+        const size_t length = __read_uint(&file[pos], 4, true);
+        const uint8_t *const type = &file[pos + 4];
+        if (length > file_size - pos - 12) return IMC_ERR_FILE_INVALID;
+        
+        if (memcmp(type, "IDAT", 4) == 0)
+        {
+            if (end_idat > 0 && end_idat != pos) return IMC_ERR_FILE_INVALID;
+            if (first_idat == 0) first_idat = pos;
+            end_idat = pos + length + 12;
+        }
+        else if (memcmp(type, "IEND", 4) == 0)
+        {
+            done = true;
+        }
+        else if (end_idat > 0)
+        {
+            return IMC_ERR_UNSUPPORTED;
+        }
+
+        pos += length + 12;
+    }
+
+    if (first_idat == 0) return IMC_ERR_FILE_INVALID;
+
+    z_stream stream = {0};
+    if (inflateInit(&stream) != Z_OK) return IMC_ERR_NO_MEMORY;
+
+    const size_t row_size = stride + 1;
+    uint8_t *const filtered = imc_malloc(row_size);
+    uint8_t *const zero_row = imc_calloc(1, stride);
+    size_t row = 0;
+    int status = IMC_SUCCESS;
+    int z_status = Z_OK;
+
+    // Decompress the rows, one at a time, and reverse their filters
+    for (pos = first_idat; pos < end_idat && status == IMC_SUCCESS && row < height; )
+    {
+        const size_t length = __read_uint(&file[pos], 4, true);
+        const uint32_t crc = (uint32_t)__read_uint(&file[pos + 8 + length], 4, true);
+        if (crc32_z(crc32_z(0L, Z_NULL, 0), &file[pos + 4], length + 4) != crc)
+        {
+            status = IMC_ERR_FILE_INVALID;
+            break;
+        }
+        
+        stream.next_in = (Bytef *)&file[pos + 8];
+        stream.avail_in = length;
+
+        while (stream.avail_in > 0 && row < height)
+        {
+            if (stream.avail_out == 0)
+            {
+                stream.next_out = filtered;
+                stream.avail_out = row_size;
+            }
+            
+            z_status = inflate(&stream, Z_NO_FLUSH);
+            if (z_status != Z_OK && z_status != Z_STREAM_END)
+            {
+                status = IMC_ERR_FILE_INVALID;
+                break;
+            }
+
+            if (stream.avail_out == 0)
+            {
+                // The first byte of each row is its filter type
+                if (filtered[0] >= PNG_FILTER_VALUE_LAST)
+                {
+                    status = IMC_ERR_FILE_INVALID;
+                    break;
+                }
+                
+                const uint8_t *const previous = (row > 0) ? row_pointers[row - 1] : zero_row;
+                __png_unfilter_row(filtered[0], &filtered[1], previous, stride, pixel_size, row_pointers[row]);
+                out_filters[row++] = filtered[0];
+                imc_progress_rate(progress, "Reading PNG image... %.1f %%\r", ((double)row / (double)height) * 100.0);
+            }
+            
+            if (z_status == Z_STREAM_END) break;
+        }
+
+        if (z_status == Z_STREAM_END) break;
+        pos += length + 12;
+    }
+
+    // The stream should have all the rows
+    if (status == IMC_SUCCESS && row < height) status = IMC_ERR_FILE_INVALID;
+
+    inflateEnd(&stream);
+    imc_free(filtered);
+    imc_free(zero_row);
+    return status;
+}
+
+// Get the bytes from a PNG image that will carry the hidden data
+int imc_png_carrier_open(CarrierImage *carrier_img)
+{
+    // The PNG file is read from its memory mapping
+    PngState *state = imc_malloc(sizeof(PngState));
+    *state = (PngState){
+        .input = carrier_img->mapping,
+        .input_size = carrier_img->mapping_size,
+        .input_pos = 0,
+        .progress = &carrier_img->progress,
+        .row_pointers = NULL,
+        .row_filters = NULL,
+    };
+    
+    // Allocate memory for the PNG processing structs
+    png_structp png_obj = png_create_read_struct(PNG_LIBPNG_VER_STRING, state, &__png_error, &__png_warning);
+    png_infop png_info = png_create_info_struct(png_obj);
+    if (!png_obj || !png_info)
+    {
+        png_destroy_read_struct(&png_obj, &png_info, NULL);
+        imc_free(state);
+        return IMC_ERR_NO_MEMORY;
+    }
+
+    // Error handling
+    // (the buffer of the image is stored on the state, because the local variables changed after 'setjmp()' have undefined values after the jump)
+    if (setjmp(png_jmpbuf(png_obj)))
+    {
+        png_destroy_read_struct(&png_obj, &png_info, NULL);
+        imc_free(state->row_pointers);
+        imc_free(state->row_filters);
+        imc_free(state);
+        return IMC_ERR_FILE_INVALID;
+    }
+
+    // Metadata of the PNG image
+    png_uint_32 width;
+    png_uint_32 height;
+    int bit_depth;
+    int color_type;
+    int interlace_method;
+    int compression_method;
+    int filter_method;
+
+    // Parse the metadata from PNG file
+    png_set_read_fn(png_obj, state, &__png_read_mapping);
+    png_read_info(png_obj, png_info);
+    png_get_IHDR(
+        png_obj, png_info,
+        &width, &height,
+        &bit_depth, &color_type,
+        &interlace_method, &compression_method, &filter_method
+    );
+    
+    // If this is a palettized image or the bit depth is smaller than 8,
+    // it will be converted so it is non-palettized with bit depth of at least 8.
+    // Since we are going to modify the last bits of the image's data, doing so
+    // on a palettized image would completely mess the colors because the bytes
+    // represent an index on the color palette.
+    // And if the bit depth is 1, 2, or 4; changing the last bit would have a
+    // noticeable visual impact.
+    const bool expanded = (color_type & PNG_COLOR_MASK_PALETTE) || (bit_depth < 8);
+    if (expanded)
+    {
+        png_set_expand(png_obj);
+        png_read_update_info(png_obj, png_info);
+        png_get_IHDR(
+            png_obj, png_info,
+            &width, &height,
+            &bit_depth, &color_type,
+            &interlace_method, &compression_method, &filter_method
+        );
+    }
+
+    // Setup the progress monitor (when on verbose)
+    if (carrier_img->verbose)
+    {
+        state->num_passes = (interlace_method == PNG_INTERLACE_ADAM7) ? PNG_INTERLACE_ADAM7_PASSES : 1.0;
+        state->num_rows = height;
+        png_set_read_status_fn(png_obj, &__png_read_callback);
+    }
+
+    // Check if the bit depth has a valid value
+    if (bit_depth != 8 && bit_depth != 16)
+    {
+        png_destroy_read_struct(&png_obj, &png_info, NULL);
+        imc_free(state);
+        return IMC_ERR_FILE_INVALID;
+    }
+    /* from this point onwards, this function assumes that the bit depth to be either 8 or 16 */
+
+    // Amount of bytes per row of the image
+    const size_t stride = png_get_rowbytes(png_obj, png_info);
+
+    // Use the decoded pixels on the cover cache, if the image is there
+    uint8_t *const cached_pixels = carrier_img->cache_mapping ? __cover_cache_carrier(carrier_img, width, height, stride) : NULL;
+    if (cached_pixels)
+    {
+        png_bytep *row_pointers = imc_malloc(height * sizeof(png_bytep));
+        for (size_t i = 0; i < height; i++)
+        {
+            row_pointers[i] = &cached_pixels[i * stride];
+        }
+
+        state->object = png_obj;
+        state->info = png_info;
+        state->row_pointers = row_pointers;
+        carrier_img->object = state;
+        carrier_img->width = width;
+        carrier_img->height = height;
+        
+        return IMC_SUCCESS;
+    }
+    
+    // Buffer for storing the image's color values
+    const size_t buffer_size = (height * sizeof(png_bytep)) + (height * stride);
+    png_bytep *row_pointers = imc_malloc(buffer_size);
+    state->row_pointers = row_pointers;
+
+    // Pointer to the buffer's position where the values of a row begin
+    uintptr_t offset = (uintptr_t)row_pointers + ((size_t)height * sizeof(png_bytep));
+    const carrier_bytes_t initial_offset = (carrier_bytes_t)offset;
+    
+    for (size_t i = 0; i < height; i++)
+    {
+        // Set the pointers to each row of the image
+        row_pointers[i] = (png_bytep)offset;
+        offset += stride;
+    }
+    
+    // Metadata found before the image's data
+    const png_uint_32 chunks_before = png_get_valid(png_obj, png_info, UINT32_MAX);
+    const int texts_before = png_get_text(png_obj, png_info, NULL, NULL);
+    
+    // Read the image into the buffer
+    // (non-interlaced images without conversions are decoded here, so the filter type of each row is kept for when saving the image)
+    int decode_status = IMC_ERR_UNSUPPORTED;
+    if (interlace_method == PNG_INTERLACE_NONE && !expanded)
+    {
+        const size_t pixel_size = (size_t)png_get_channels(png_obj, png_info) * (bit_depth / 8);
+        state->row_filters = imc_malloc(height);
+        decode_status = __png_decode_rows(
+            carrier_img->mapping, carrier_img->mapping_size,
+            row_pointers, height, stride, pixel_size,
+            &carrier_img->progress, state->row_filters
+        );
+        
+        if (decode_status == IMC_ERR_FILE_INVALID) png_error(png_obj, "Damaged image data");
+
+        // An image without filters on any of its rows was probably saved by an encoder that does not filter the rows,
+        // rather than by one that chose not to filter them. So in that case the filters are chosen when saving the image.
+        bool filtered = false;
+        for (size_t i = 0; i < height && decode_status == IMC_SUCCESS && !filtered; i++)
+        {
+            filtered = (state->row_filters[i] != PNG_FILTER_VALUE_NONE);
+        }
+        
+        if (decode_status != IMC_SUCCESS || !filtered)
+        {
+            imc_free(state->row_filters);
+            state->row_filters = NULL;
+        }
+    }
+    
+    // Other images are decoded by libpng
+    if (decode_status != IMC_SUCCESS)
+    {
+        png_read_image(png_obj, row_pointers);
+        png_read_end(png_obj, png_info);
+    }
+    imc_progress(&carrier_img->progress, "Reading PNG image... Done!  \n");
+
+    // An image with metadata after its data is not cached, because the data is not read when the image comes from the cache
+    const bool cacheable = (
+        png_get_valid(png_obj, png_info, UINT32_MAX) == chunks_before &&
+        png_get_text(png_obj, png_info, NULL, NULL) == texts_before
+    );
+
+    const bool has_alpha = color_type & PNG_COLOR_MASK_ALPHA;                   // If the image has transparency
+    const png_byte num_channels = png_get_channels(png_obj, png_info);          // Total amount of channels in image
+    const png_byte num_colors = has_alpha ? num_channels - 1 : num_channels;    // Amount of channels excluding the alpha channel
+    const size_t bytes_per_pixel = num_channels * (bit_depth/8);                // Amount of bytes to represent a single pixel
+
+    // Buffer of pointers to the carrier bytes of the image
+    carrier_bytes_t *carrier = imc_malloc(sizeof(carrier_bytes_t) * width * height * num_colors);
+    size_t pos = 0;
+
+    // Loop through all pixels in the image to get the carrier bytes
+    // (we are going to use pixels with alpha > 0, but the alpha channel itself will not be used as carrier)
+    for (size_t y = 0; y < height; y++)
+    {
+        // Print status message (on verbose)
+        if (carrier_img->verbose)
+        {
+            const double percent = ((double)y / (double)height) * 100.0;
+            imc_progress_rate(&carrier_img->progress, "Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+        }
+        
+        for (size_t x = 0; x < width; x++)
         {
-            // Array of DCT coefficients for the current color component
-            JBLOCKARRAY coef_array = jpeg_obj->mem->access_virt_barray(
-                (j_common_ptr)jpeg_obj,     // Pointer to the JPEG object
-                jpeg_dct[comp],             // DCT coefficients for the current color component
-                y,                          // The current row of DCT blocks on the image
-                1,                          // Read one row of DCT blocks at a time
-                false                       // Opening the array in read-only mode
-            );
+            uint8_t *const pixel = &row_pointers[y][x * bytes_per_pixel];
+
+            // The bit depths can be either 8 or 16
+            // For the later, each color value is stored in big-endian byte order
+            if (bit_depth == 8)
+            {
+                const uint8_t alpha = has_alpha ? pixel[num_channels-1] : UINT8_MAX;
+                if (alpha > 0)
+                {
+                    for (size_t n = 0; n < num_colors; n++)
+                    {
+                        // Store the pointer to the color value (1 byte)
+                        carrier[pos++] = &pixel[n];
+                    }
+                }
+            }
+            else    // bit_depth == 16
+            {
+                // Cast the value to 16-bit unsigned integer, then convert it to the same byte order as the system
+                // (16-bit PNG uses the big-endian byte order)
+                const uint16_t alpha = has_alpha ? be16toh( *(uint16_t*)(&pixel[(num_channels - 1) * 2]) ) : UINT16_MAX;
+                if (alpha > 0)
+                {
+                    for (size_t n = 0; n < num_colors; n++)
+                    {
+                        // Store the pointer to the least significant byte of the color value
+                        carrier[pos++] = &pixel[1 + (n * 2)];
+                    }
+                }
+            }
+        }
+    }
+
+    // Print status message (on verbose)
+    imc_progress(&carrier_img->progress, "Scanning cover image for suitable carrier bits... Done!  \n");
+
+    // Check for edge case
+    // (this may happen if the image is fully transparent)
+    if (pos == 0)
+    {
+        png_destroy_read_struct(&png_obj, &png_info, NULL);
+        imc_free(carrier);
+        imc_free(row_pointers);
+        imc_free(state->row_filters);
+        imc_free(state);
+        return IMC_ERR_NO_CARRIER;
+    }
+    
+    // Free the unused space of the carrier buffer
+    carrier = imc_realloc(carrier, pos * sizeof(carrier_bytes_t));
+    
+    // Store the structures necessary to handle the opened image
+    state->object = png_obj;
+    state->info = png_info;
+    state->row_pointers = row_pointers;
+    carrier_img->object = state;
+
+    // Store the information about the carrier bytes
+    carrier_img->carrier = carrier;
+    carrier_img->carrier_lenght = pos;
+    carrier_img->bytes = initial_offset;
+    carrier_img->width = width;
+    carrier_img->height = height;
+
+    if (carrier_img->cache_dir && cacheable)
+    {
+        __cover_cache_store(carrier_img, width, height, stride, initial_offset);
+    }
+
+    return IMC_SUCCESS;
+}
+
+// Get the bytes from an WebP image that will carry the hidden data
+int imc_webp_carrier_open(CarrierImage *carrier_img)
+{
+    // The WebP image is decoded directly from its memory mapping
+    const uint8_t *const in_buffer = carrier_img->mapping;
+    const size_t file_size = carrier_img->mapping_size;
+
+    // Maximum size of an WebP image is 4 GB
+    if (file_size > UINT32_MAX) return IMC_ERR_UNSUPPORTED;
+
+    imc_progress(&carrier_img->progress, "Reading WebP image... ");
+
+    // Data of the decoded WebP image (original file)
+    WebPDecoderConfig *webp_obj = imc_calloc(1, sizeof(WebPDecoderConfig));
+    WebPInitDecoderConfig(webp_obj);
+    VP8StatusCode status_vp8 = WebPGetFeatures(in_buffer, file_size, &webp_obj->input);
+
+    // Could not retrieve the header of the WebP image
+    // (animated WebP images are opened by 'imc_webp_anim_carrier_open()' instead)
+    if (status_vp8 != VP8_STATUS_OK || webp_obj->input.has_animation)
+    {
+        imc_progress(&carrier_img->progress, "\n");
+        imc_free(webp_obj);
+        return (status_vp8 != VP8_STATUS_OK) ? IMC_ERR_FILE_INVALID : IMC_ERR_UNSUPPORTED;
+    }
+    
+    // Set the decoding options
+    webp_obj->options.use_threads = 1;     // Use multithreading
+    #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    webp_obj->output.colorspace = MODE_ARGB;    // 32-bit color value on big endian byte order
+    #else
+    webp_obj->output.colorspace = MODE_BGRA;    // 32-bit color value on little endian byte order
+    #endif
+
+    // Use the decoded pixels on the cover cache, if the image is there
+    // (they become an external buffer of the decoder, which is not freed by 'WebPFreeDecBuffer()')
+    const uint32_t cache_width = webp_obj->input.width;
+    const uint32_t cache_height = webp_obj->input.height;
+    uint8_t *const cached_pixels = carrier_img->cache_mapping
+        ? __cover_cache_carrier(carrier_img, cache_width, cache_height, (size_t)cache_width * 4)
+        : NULL;
+    
+    if (cached_pixels)
+    {
+        webp_obj->output.width = cache_width;
+        webp_obj->output.height = cache_height;
+        webp_obj->output.is_external_memory = 1;
+        webp_obj->output.u.RGBA.rgba = cached_pixels;
+        webp_obj->output.u.RGBA.stride = cache_width * 4;
+        webp_obj->output.u.RGBA.size = (size_t)cache_width * 4 * cache_height;
+        carrier_img->object = webp_obj;
+        carrier_img->width = cache_width;
+        carrier_img->height = cache_height;
+        
+        return IMC_SUCCESS;
+    }
+    
+    // Decode the original image
+    status_vp8 = WebPDecode(in_buffer, file_size, webp_obj);
+    if (status_vp8 != VP8_STATUS_OK)
+    {
+        imc_progress(&carrier_img->progress, "\n");
+        WebPFreeDecBuffer(&webp_obj->output);
+        imc_free(webp_obj);
+        
+        // Reason why the image could not be decoded
+        switch (status_vp8)
+        {
+            case VP8_STATUS_OUT_OF_MEMORY:
+                return IMC_ERR_NO_MEMORY;
+            
+            case VP8_STATUS_UNSUPPORTED_FEATURE:
+                return IMC_ERR_UNSUPPORTED;
+            
+            default:    // The file is corrupted or it is not a valid WebP image
+                return IMC_ERR_FILE_INVALID;
+        }
+    }
+
+    imc_progress(&carrier_img->progress, "Done!  \n");
+
+    // Calculate the total amount of pixels in the image
+    const size_t width = webp_obj->output.width;
+    const size_t height = webp_obj->output.height;
+    const size_t pixel_count = width * height;
+    
+    // Pointers to the carrier bytes of the image
+    carrier_bytes_t *carrier = imc_malloc(sizeof(carrier_bytes_t) * pixel_count * 3);
+    size_t pos = 0; // Position on the carrier array
+    
+    // Loop through all pixels in the image to get the carrier bytes
+    // (we are going to use pixels with alpha > 0, but the alpha channel itself will not be used as carrier)
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        uint8_t *const pixel = &webp_obj->output.u.RGBA.rgba[i*4];  // Image always is 4 bytes per pixel
+        
+        // Get the 4 color components of the pixel (alpha, red, green, blue)
+        // Note: the alpha value is the most significant byte of a 32-bit unsigned integer,
+        //       followed by red > green > blue (in decreasing order of significance).
+        #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        uint8_t *const alpha = &pixel[0];
+        uint8_t *const red   = &pixel[1];
+        uint8_t *const green = &pixel[2];
+        uint8_t *const blue  = &pixel[3];
+        #else // __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint8_t *const alpha = &pixel[3];
+        uint8_t *const red   = &pixel[2];
+        uint8_t *const green = &pixel[1];
+        uint8_t *const blue  = &pixel[0];
+        #endif
+        
+        // Use the RGB bytes as carriers if the pixel is not fully transparent
+        if (*alpha > 0)
+        {
+            carrier[pos++] = red;
+            carrier[pos++] = green;
+            carrier[pos++] = blue;
+        }
+
+        // Print the progress when on verbose mode
+        if ( carrier_img->verbose && (i % 4096 == 0) )
+        {
+            double percent = ((double)i / (double)pixel_count) * 100.0;
+            imc_progress_rate(&carrier_img->progress, "Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+        }
+    }
+
+    imc_progress(&carrier_img->progress, "Scanning cover image for suitable carrier bits... Done!  \n");
+
+    // Check for edge case
+    // (this may happen if the image is fully transparent)
+    if (pos == 0)
+    {
+        WebPFreeDecBuffer(&webp_obj->output);
+        imc_free(webp_obj);
+        imc_free(carrier);
+        return IMC_ERR_NO_CARRIER;
+    }
+    
+    // Free the unused space of the carrier buffer
+    carrier = imc_realloc(carrier, pos * sizeof(carrier_bytes_t));
+    
+    // Store the structure necessary to handle the opened image
+    carrier_img->object = webp_obj;
+
+    // Store the information about the carrier bytes
+    carrier_img->carrier = carrier;
+    carrier_img->carrier_lenght = pos;
+    carrier_img->width = width;
+    carrier_img->height = height;
+
+    if (carrier_img->cache_dir)
+    {
+        __cover_cache_store(carrier_img, width, height, webp_obj->output.u.RGBA.stride, webp_obj->output.u.RGBA.rgba);
+    }
+
+    return IMC_SUCCESS;
+}
+
+// Whether a WebP image is animated
+static bool __webp_is_animated(const uint8_t *data, size_t size)
+{
+    WebPBitstreamFeatures features;
+    return WebPGetFeatures(data, size, &features) == VP8_STATUS_OK && features.has_animation;
+}
+
+// Task of the worker threads: decode one frame of an animated WebP image
+static void __webp_frame_decode_task(void *context, size_t task, size_t worker)
+{
+    AnimatedWebP *const anim = (AnimatedWebP *)context;
+    AnimatedFrame *const frame = &anim->frame[task];
+
+    WebPInitDecoderConfig(&frame->decoder);
+    frame->decoder.options.use_threads = 0;     // The frames themselves are already decoded in parallel
+    #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    frame->decoder.output.colorspace = MODE_ARGB;
+    #else
+    frame->decoder.output.colorspace = MODE_BGRA;
+    #endif
+
+    // The frame's data (its optional alpha chunk, then its image chunk) can be decoded by itself
+    const VP8StatusCode status_vp8 = WebPDecode(frame->fragment.bytes, frame->fragment.size, &frame->decoder);
+    switch (status_vp8)
+    {
+        case VP8_STATUS_OK:
+            frame->status = IMC_SUCCESS;
+            break;
+        
+        case VP8_STATUS_OUT_OF_MEMORY:
+            frame->status = IMC_ERR_NO_MEMORY;
+            break;
+        
+        case VP8_STATUS_UNSUPPORTED_FEATURE:
+            frame->status = IMC_ERR_UNSUPPORTED;
+            break;
+        
+        default:
+            frame->status = IMC_ERR_FILE_INVALID;
+            break;
+    }
+
+    const size_t done = atomic_fetch_add(&anim->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(anim->progress, "Reading WebP animation... %.1f %%\r", ((double)done / (double)anim->frame_count) * 100.0);
+}
+
+// Get the bytes from an animated WebP image that will carry the hidden data
+// The frames are decoded in parallel, and their carrier bytes are put together (in the order of the frames),
+// so the hidden data is shuffled over all frames as a single space.
+int imc_webp_anim_carrier_open(CarrierImage *carrier_img)
+{
+    // Maximum size of an WebP image is 4 GB
+    if (carrier_img->mapping_size > UINT32_MAX) return IMC_ERR_UNSUPPORTED;
+
+    // List the frames of the animation (they point to the file's memory mapping, which outlives the demuxer)
+    const WebPData webp_data = {carrier_img->mapping, carrier_img->mapping_size};
+    WebPDemuxer *const demux = WebPDemux(&webp_data);
+    if (!demux) return IMC_ERR_FILE_INVALID;
+
+    const size_t frame_count = WebPDemuxGetI(demux, WEBP_FF_FRAME_COUNT);
+    if (frame_count == 0)
+    {
+        WebPDemuxDelete(demux);
+        return IMC_ERR_FILE_INVALID;
+    }
+
+    AnimatedWebP *const anim = imc_calloc(1, sizeof(AnimatedWebP));
+    anim->frame = imc_calloc(frame_count, sizeof(AnimatedFrame));
+    anim->canvas_width = WebPDemuxGetI(demux, WEBP_FF_CANVAS_WIDTH);
+    anim->canvas_height = WebPDemuxGetI(demux, WEBP_FF_CANVAS_HEIGHT);
+    anim->loop_count = WebPDemuxGetI(demux, WEBP_FF_LOOP_COUNT);
+    anim->bgcolor = WebPDemuxGetI(demux, WEBP_FF_BACKGROUND_COLOR);
+    anim->progress = &carrier_img->progress;
+
+    WebPIterator iter;
+    if (WebPDemuxGetFrame(demux, 1, &iter))
+    {
+        do
+        {
+            if (anim->frame_count == frame_count) break;
+            AnimatedFrame *const frame = &anim->frame[anim->frame_count++];
+            frame->fragment = iter.fragment;
+            frame->x_offset = iter.x_offset;
+            frame->y_offset = iter.y_offset;
+            frame->duration = iter.duration;
+            frame->dispose = iter.dispose_method;
+            frame->blend = iter.blend_method;
+        } while (WebPDemuxNextFrame(&iter));
+        
+        WebPDemuxReleaseIterator(&iter);
+    }
+
+    WebPDemuxDelete(demux);
+    carrier_img->object = anim;
+
+    // Decode the frames in parallel
+    imc_progress(&carrier_img->progress, "Reading WebP animation... ");
+    imc_parallel_for(anim->frame_count, 0, &__webp_frame_decode_task, anim);
+
+    int status = (anim->frame_count == frame_count) ? IMC_SUCCESS : IMC_ERR_FILE_INVALID;
+    size_t pixel_count = 0;
+    for (size_t i = 0; i < anim->frame_count; i++)
+    {
+        if (status == IMC_SUCCESS) status = anim->frame[i].status;
+        pixel_count += (size_t)anim->frame[i].decoder.output.width * (size_t)anim->frame[i].decoder.output.height;
+    }
+
+    if (status != IMC_SUCCESS)
+    {
+        imc_progress(&carrier_img->progress, "\n");
+        imc_webp_anim_carrier_close(carrier_img);
+        carrier_img->object = NULL;
+        return status;
+    }
+
+    imc_progress(&carrier_img->progress, "Reading WebP animation... Done!  \n");
+
+    // Pointers to the carrier bytes of all frames
+    carrier_bytes_t *carrier = imc_malloc(sizeof(carrier_bytes_t) * pixel_count * 3);
+    size_t pos = 0; // Position on the carrier array
+
+    for (size_t f = 0; f < anim->frame_count; f++)
+    {
+        const WebPDecBuffer *const output = &anim->frame[f].decoder.output;
+        const size_t width = output->width;
+        const size_t height = output->height;
+
+        for (size_t y = 0; y < height; y++)
+        {
+            uint8_t *const row = &output->u.RGBA.rgba[y * output->u.RGBA.stride];
+
+            for (size_t x = 0; x < width; x++)
+            {
+                uint8_t *const pixel = &row[x*4];
+                
+                // Same layout of the color components as on the still images
+                #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                uint8_t *const alpha = &pixel[0];
+                uint8_t *const red   = &pixel[1];
+                uint8_t *const green = &pixel[2];
+                uint8_t *const blue  = &pixel[3];
+                #else // __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                uint8_t *const alpha = &pixel[3];
+                uint8_t *const red   = &pixel[2];
+                uint8_t *const green = &pixel[1];
+                uint8_t *const blue  = &pixel[0];
+                #endif
+                
+                // Use the RGB bytes as carriers if the pixel is not fully transparent
+                if (*alpha > 0)
+                {
+                    carrier[pos++] = red;
+                    carrier[pos++] = green;
+                    carrier[pos++] = blue;
+                }
+            }
+        }
+
+        if (carrier_img->verbose)
+        {
+            double percent = ((double)(f + 1) / (double)anim->frame_count) * 100.0;
+            imc_progress_rate(&carrier_img->progress, "Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+        }
+    }
+
+    imc_progress(&carrier_img->progress, "Scanning cover image for suitable carrier bits... Done!  \n");
+
+    // Check for edge case
+    // (this may happen if all frames are fully transparent)
+    if (pos == 0)
+    {
+        imc_free(carrier);
+        imc_webp_anim_carrier_close(carrier_img);
+        carrier_img->object = NULL;
+        return IMC_ERR_NO_CARRIER;
+    }
+
+    // Free the unused space of the carrier buffer
+    carrier = imc_realloc(carrier, pos * sizeof(carrier_bytes_t));
+
+    // Store the information about the carrier bytes
+    carrier_img->carrier = carrier;
+    carrier_img->carrier_lenght = pos;
+    carrier_img->width = anim->canvas_width;
+    carrier_img->height = anim->canvas_height;
+
+    return IMC_SUCCESS;
+}
+
+// Get the bytes from a lossy WebP image that will carry the hidden data
+// Like on JPEG images, the carriers are the quantized coefficients of the VP8 bitstream, so the pixels are never decoded.
+int imc_webp_lossy_carrier_open(CarrierImage *carrier_img)
+{
+    imc_progress(&carrier_img->progress, "Reading WebP image... ");
+
+    // Read the coefficients of the image
+    Vp8Image *vp8 = NULL;
+    const int read_status = imc_vp8_read(carrier_img->mapping, carrier_img->mapping_size, &vp8);
+    if (read_status != IMC_SUCCESS)
+    {
+        imc_progress(&carrier_img->progress, "\n");
+        return read_status;
+    }
 
-            // Print status message (on verbose)
-            if (carrier_img->verbose)
-            {
-                const double row_count = jpeg_obj->comp_info[comp].height_in_blocks;
-                const double row_fraction = ((double)y / row_count) / (double)jpeg_obj->num_components;
-                const double comp_fraction = (double)comp / (double)jpeg_obj->num_components;
-                const double percent = (comp_fraction + row_fraction) * 100.0;
-                printf_prog("Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
-            }
+    imc_progress(&carrier_img->progress, "Done!  \n");
 
-            // Iterate column by column from left to right
-            for (JDIMENSION x = 0; x < jpeg_obj->comp_info[comp].width_in_blocks; x++)
+    size_t carrier_capacity = 4096;
+    size_t carrier_count = 0;
+    uint8_t *carrier_bytes = imc_malloc(carrier_capacity * sizeof(uint8_t));
+
+    const size_t mb_count = vp8->mb_width * vp8->mb_height;
+    for (size_t mb = 0; mb < mb_count; mb++)
+    {
+        // Print status message (on verbose)
+        if (carrier_img->verbose && (mb % 1024 == 0))
+        {
+            const double percent = ((double)mb / (double)mb_count) * 100.0;
+            imc_progress_rate(&carrier_img->progress, "Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+        }
+
+        // The Y2 block is skipped, because its coefficients are the DC coefficients of the luma blocks
+        // (changing them has a bigger visual impact, for the same reason that the DC coefficients of JPEG images are not used)
+        for (size_t b = 0; b < IMC_VP8_Y2_BLOCK; b++)
+        {
+            const int16_t *const coef = &vp8->coef[(mb * IMC_VP8_BLOCKS + b) * 16];
+            
+            for (size_t i = 1; i < 16; i++)
             {
-                // Iterate over the 63 AC coefficients
-                // (the DC coefficient of the block is skipped, because modifying it causes a bigger visual impact,
-                //  because this coefficient represents the average color of the current block of pixels)
-                for (JCOEF i = 1; i < DCTSIZE2; i++)
+                // Resize the array of carriers if it is full
+                if (carrier_count == carrier_capacity)
                 {
-                    // Resize the array of carriers if it is full
-                    if (carrier_count == carrier_capacity)
-                    {
-                        carrier_capacity *= 2;
-                        carrier_bytes = imc_realloc(carrier_bytes, carrier_capacity * sizeof(uint8_t));
-                    }
-
-                    // The current coefficient
-                    const JCOEF coef = coef_array[0][x][i];
+                    carrier_capacity *= 2;
+                    carrier_bytes = imc_realloc(carrier_bytes, carrier_capacity * sizeof(uint8_t));
+                }
 
-                    // Only the AC coefficients that are not 0 or 1 are used as carriers
-                    // (that makes the new image to have nearly the same size as the original image,
-                    //  because JPEG compresses zeroes using run length encoding)
-                    if (coef != 0 && coef != 1)
-                    {
-                        // Store the value of the least significant byte of the coefficient
-                        carrier_bytes[carrier_count++] = (uint8_t)(coef & (JCOEF)255);
-                    }
+                // Only the coefficients whose magnitude is 2 or more are used as carriers, so the blocks keep ending
+                // at the same token, and the tokens keep their contexts (see 'imc_vp8.h')
+                // (2114 is also skipped, because it is the biggest magnitude that the bitstream can hold)
+                if (IMC_VP8_IS_CARRIER(coef[i]))
+                {
+                    // Store the least significant byte of the coefficient's magnitude
+                    carrier_bytes[carrier_count++] = (uint8_t)(abs(coef[i]) & 255);
                 }
             }
         }
     }
 
-    // Print status message (on verbose)
-    if (carrier_img->verbose)
-    {
-        printf("Scanning cover image for suitable carrier bits... Done!  \n");
-    }
+    imc_progress(&carrier_img->progress, "Scanning cover image for suitable carrier bits... Done!  \n");
 
     // Check for edge case
+    // (this may happen if the image is just a flat color)
     if (carrier_count == 0)
     {
-        fprintf(stderr, "Error: the JPEG image has no suitable bits for hiding the data. "
-            "This may happen if the image is just a flat color.\n");
-        exit(EXIT_FAILURE);
+        imc_vp8_free(vp8);
+        imc_free(carrier_bytes);
+        return IMC_ERR_NO_CARRIER;
     }
-    
+
     // Free the unusued space of the array
     carrier_bytes = imc_realloc(carrier_bytes, carrier_count * sizeof(uint8_t));
 
@@ -902,410 +4120,582 @@ void imc_jpeg_carrier_open(CarrierImage *carrier_img)
     }
 
     // Store the output
-    carrier_img->bytes = carrier_bytes;             // Array of bytes
-    carrier_img->carrier = carrier_ptr;             // Array of pointers to bytes
-    carrier_img->carrier_lenght = carrier_count;    // Total amount of pointers to bytes
-    carrier_img->object = jpeg_obj;                 // Image handler
-    
-    // Store the additional heap allocated memory for the purpose of memory management
-    carrier_img->heap = imc_malloc(sizeof(void *) * 2);
-    carrier_img->heap[0] = (void *)jpeg_err;
-    carrier_img->heap[1] = (void *)jpeg_dct;
-    carrier_img->heap_lenght = 1;
-    /* Note:
-        The lenght above is set to 1, even though it is actually 2, because
-        the memory of '*jpeg_dct' is managed by libjpeg-turbo (instead of my code).
-        The lenght of 1 prevents my code from attempting to free that memory.
-    */
-}
+    carrier_img->bytes = carrier_bytes;
+    carrier_img->carrier = carrier_ptr;
+    carrier_img->carrier_lenght = carrier_count;
+    carrier_img->object = vp8;
+    carrier_img->width = vp8->width;
+    carrier_img->height = vp8->height;
 
-// Progress monitor when reading a PNG image
-static void __png_read_callback(png_structp png_obj, png_uint_32 row, int pass)
-{
-    const double percent = (((double)pass + ((double)row / png_num_rows)) / png_num_passes) * 100.0;
-    printf_prog("Reading PNG image... %.1f %%\r", percent);
+    return IMC_SUCCESS;
 }
 
-// Get the bytes from a PNG image that will carry the hidden data
-void imc_png_carrier_open(CarrierImage *carrier_img)
+// Read an unsigned integer of 'num_bytes' bytes (at most 4) from a buffer, in the given byte order
+static inline uint32_t __read_uint(const uint8_t *data, size_t num_bytes, bool big_endian)
 {
-    // Allocate memory for the PNG processing structs
-    png_structp png_obj = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    png_infop png_info = png_create_info_struct(png_obj);
-    if (!png_obj || !png_info)
-    {
-        png_destroy_read_struct(&png_obj, &png_info, NULL);
-        fprintf(stderr, "Error: No enough memory for reading the PNG file.\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Error handling
-    if (setjmp(png_jmpbuf(png_obj)))
+    uint32_t value = 0;
+    
+    for (size_t i = 0; i < num_bytes; i++)
     {
-        png_destroy_read_struct(&png_obj, &png_info, NULL);
-        fprintf(stderr, "Error: Failed to read PNG file.\n");
-        exit(EXIT_FAILURE);
+        const size_t byte_pos = big_endian ? (num_bytes - 1 - i) : i;
+        value |= (uint32_t)data[i] << (8 * byte_pos);
     }
 
-    // Metadata of the PNG image
-    png_uint_32 width;
-    png_uint_32 height;
-    int bit_depth;
-    int color_type;
-    int interlace_method;
-    int compression_method;
-    int filter_method;
+    return value;
+}
 
-    // Parse the metadata from PNG file
-    FILE *png_file = carrier_img->file;
-    png_init_io(png_obj, png_file);
-    png_read_info(png_obj, png_info);
-    png_get_IHDR(
-        png_obj, png_info,
-        &width, &height,
-        &bit_depth, &color_type,
-        &interlace_method, &compression_method, &filter_method
-    );
+// Get the bytes from a BMP image that will carry the hidden data
+// The carrier bytes are the color values on the file's memory mapping, so the image is neither decoded nor encoded.
+int imc_bmp_carrier_open(CarrierImage *carrier_img)
+{
+    uint8_t *const bmp = carrier_img->mapping;
+    const size_t file_size = carrier_img->mapping_size;
+
+    // The file begins with a header of 14 bytes, followed by the header with the image's properties
+    // (which has 40 bytes or more, except on the old OS/2 format where it has 12 bytes)
+    if (file_size < 26) goto invalid_bmp;
+    const size_t data_offset = __read_uint(&bmp[10], 4, false);  // Where the pixel data begins
+    const size_t header_size = __read_uint(&bmp[14], 4, false);
     
-    // If this is a palettized image or the bit depth is smaller than 8,
-    // it will be converted so it is non-palettized with bit depth of at least 8.
-    // Since we are going to modify the last bits of the image's data, doing so
-    // on a palettized image would completely mess the colors because the bytes
-    // represent an index on the color palette.
-    // And if the bit depth is 1, 2, or 4; changing the last bit would have a
-    // noticeable visual impact.
-    if ( (color_type & PNG_COLOR_MASK_PALETTE) || (bit_depth < 8) )
+    int64_t width;
+    int64_t height;
+    uint32_t bit_count;     // Bits per pixel
+    uint32_t compression;   // Compression method (0 means uncompressed)
+
+    if (header_size == 12)
     {
-        png_set_expand(png_obj);
-        png_read_update_info(png_obj, png_info);
-        png_get_IHDR(
-            png_obj, png_info,
-            &width, &height,
-            &bit_depth, &color_type,
-            &interlace_method, &compression_method, &filter_method
-        );
+        width = __read_uint(&bmp[18], 2, false);
+        height = __read_uint(&bmp[20], 2, false);
+        bit_count = __read_uint(&bmp[24], 2, false);
+        compression = 0;
     }
-
-    // Setup the progress monitor (when on verbose)
-    if (carrier_img->verbose)
+    else if (header_size >= 40 && file_size >= 14 + 40)
     {
-        png_num_passes = (interlace_method == PNG_INTERLACE_ADAM7) ? PNG_INTERLACE_ADAM7_PASSES : 1.0;
-        png_num_rows = height;
-        png_set_read_status_fn(png_obj, &__png_read_callback);
+        width = (int32_t)__read_uint(&bmp[18], 4, false);
+        height = (int32_t)__read_uint(&bmp[22], 4, false);
+        bit_count = __read_uint(&bmp[28], 2, false);
+        compression = __read_uint(&bmp[30], 4, false);
     }
-
-    // Check if the bit depth has a valid value
-    if (bit_depth != 8 && bit_depth != 16)
+    else
     {
-        png_destroy_read_struct(&png_obj, &png_info, NULL);
-        fprintf(stderr, "Error: Failed to read PNG file.\n");
-        exit(EXIT_FAILURE);
+        goto invalid_bmp;
     }
-    /* from this point onwards, this function assumes that the bit depth to be either 8 or 16 */
 
-    // Amount of bytes per row of the image
-    const size_t stride = png_get_rowbytes(png_obj, png_info);
-    
-    // Buffer for storing the image's color values
-    const size_t buffer_size = (height * sizeof(png_bytep)) + (height * stride);
-    png_bytep *row_pointers = imc_malloc(buffer_size);
+    // A negative height means that the rows are stored from top to bottom (instead of from bottom to top)
+    // Since all rows are used as carrier, the order does not matter here.
+    if (height < 0) height = -height;
+    if (width <= 0 || height == 0) goto invalid_bmp;
 
-    // Pointer to the buffer's position where the values of a row begin
-    uintptr_t offset = (uintptr_t)row_pointers + ((size_t)height * sizeof(png_bytep));
-    const carrier_bytes_t initial_offset = (carrier_bytes_t)offset;
-    
-    for (size_t i = 0; i < height; i++)
-    {
-        // Set the pointers to each row of the image
-        row_pointers[i] = (png_bytep)offset;
-        offset += stride;
-    }
-    
-    // Read the image into the buffer
-    png_read_image(png_obj, row_pointers);
-    png_read_end(png_obj, png_info);
-    if (carrier_img->verbose) printf("Reading PNG image... Done!  \n");
+    // On images with 8 bits per pixel or less, the pixels are an index on the color palette,
+    // so changing their last bit would completely change their color.
+    // (only uncompressed images with 24 or 32 bits per pixel are supported)
+    if (compression != 0 || (bit_count != 24 && bit_count != 32)) return IMC_ERR_UNSUPPORTED;
 
-    const bool has_alpha = color_type & PNG_COLOR_MASK_ALPHA;                   // If the image has transparency
-    const png_byte num_channels = png_get_channels(png_obj, png_info);          // Total amount of channels in image
-    const png_byte num_colors = has_alpha ? num_channels - 1 : num_channels;    // Amount of channels excluding the alpha channel
-    const size_t bytes_per_pixel = num_channels * (bit_depth/8);                // Amount of bytes to represent a single pixel
+    // Each row is padded to a multiple of 4 bytes
+    // (the pixel data cannot begin inside the headers, otherwise hiding data would change them)
+    const size_t bytes_per_pixel = bit_count / 8;
+    const size_t stride = (((size_t)width * bit_count + 31) / 32) * 4;
+    if (data_offset < 14 + header_size || data_offset > file_size) goto invalid_bmp;
+    if (stride > (file_size - data_offset) / (size_t)height) goto invalid_bmp;
 
-    // Buffer of pointers to the carrier bytes of the image
-    carrier_bytes_t *carrier = imc_malloc(sizeof(carrier_bytes_t) * width * height * num_colors);
+    // Pointers to the carrier bytes of the image
+    carrier_bytes_t *carrier = imc_malloc(sizeof(carrier_bytes_t) * (size_t)width * (size_t)height * 3);
     size_t pos = 0;
 
     // Loop through all pixels in the image to get the carrier bytes
-    // (we are going to use pixels with alpha > 0, but the alpha channel itself will not be used as carrier)
-    for (size_t y = 0; y < height; y++)
+    // (the blue, green and red values of each pixel; on 32-bit images, the fourth byte is not used as carrier)
+    for (size_t y = 0; y < (size_t)height; y++)
     {
         // Print status message (on verbose)
         if (carrier_img->verbose)
         {
             const double percent = ((double)y / (double)height) * 100.0;
-            printf_prog("Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+            imc_progress_rate(&carrier_img->progress, "Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
         }
         
-        for (size_t x = 0; x < width; x++)
+        uint8_t *const row = &bmp[data_offset + (y * stride)];
+        
+        for (size_t x = 0; x < (size_t)width; x++)
         {
-            uint8_t *const pixel = &row_pointers[y][x * bytes_per_pixel];
-
-            // The bit depths can be either 8 or 16
-            // For the later, each color value is stored in big-endian byte order
-            if (bit_depth == 8)
-            {
-                const uint8_t alpha = has_alpha ? pixel[num_channels-1] : UINT8_MAX;
-                if (alpha > 0)
-                {
-                    for (size_t n = 0; n < num_colors; n++)
-                    {
-                        // Store the pointer to the color value (1 byte)
-                        carrier[pos++] = &pixel[n];
-                    }
-                }
-            }
-            else    // bit_depth == 16
-            {
-                // Cast the value to 16-bit unsigned integer, then convert it to the same byte order as the system
-                // (16-bit PNG uses the big-endian byte order)
-                const uint16_t alpha = has_alpha ? be16toh( *(uint16_t*)(&pixel[(num_channels - 1) * 2]) ) : UINT16_MAX;
-                if (alpha > 0)
-                {
-                    for (size_t n = 0; n < num_colors; n++)
-                    {
-                        // Store the pointer to the least significant byte of the color value
-                        carrier[pos++] = &pixel[1 + (n * 2)];
-                    }
-                }
-            }
+            uint8_t *const pixel = &row[x * bytes_per_pixel];
+            carrier[pos++] = &pixel[0];
+            carrier[pos++] = &pixel[1];
+            carrier[pos++] = &pixel[2];
         }
     }
 
-    // Print status message (on verbose)
-    if (carrier_img->verbose)
+    imc_progress(&carrier_img->progress, "Scanning cover image for suitable carrier bits... Done!  \n");
+
+    // Store the information about the carrier bytes
+    carrier_img->carrier = carrier;
+    carrier_img->carrier_lenght = pos;
+    carrier_img->width = width;
+    carrier_img->height = height;
+    return IMC_SUCCESS;
+
+    invalid_bmp:
+    return IMC_ERR_FILE_INVALID;
+}
+
+// Read the next number from the header of a PNM image, skipping the whitespace and comments before it
+// 'pos' is moved to right after the number. Returns 'false' if there is no valid number at that position.
+static bool __pnm_header_field(const uint8_t *pnm, size_t pnm_size, size_t *pos, uint32_t *out_value)
+{
+    size_t i = *pos;
+
+    // Skip the whitespace and the comments (which go from a '#' to the end of the line)
+    while (i < pnm_size && (isspace(pnm[i]) || pnm[i] == '#'))
     {
-        printf("Scanning cover image for suitable carrier bits... Done!  \n");
+        if (pnm[i] == '#')
+        {
+            while (i < pnm_size && pnm[i] != '\n' && pnm[i] != '\r') i++;
+        }
+        else
+        {
+            i++;
+        }
     }
 
-    // Check for edge case
-    if (pos == 0)
+    // Parse the decimal number
+    uint64_t value = 0;
+    const size_t start = i;
+    
+    while (i < pnm_size && isdigit(pnm[i]))
     {
-        fprintf(stderr, "Error: the PNG image has no suitable bits for hiding the data. "
-            "This may happen if the image is fully transparent.\n");
-        exit(EXIT_FAILURE);
+        value = (value * 10) + (pnm[i++] - '0');
+        if (value > UINT32_MAX) return false;
     }
-    
-    // Free the unused space of the carrier buffer
-    carrier = imc_realloc(carrier, pos * sizeof(carrier_bytes_t));
-    
-    // Store the structures necessary to handle the opened image
-    PngState *state = imc_malloc(sizeof(PngState));
-    *state = (PngState){
-        .object = png_obj,
-        .info = png_info,
-        .row_pointers = row_pointers
-    };
-    carrier_img->object = state;
 
-    // Store the information about the carrier bytes
-    carrier_img->carrier = carrier;
-    carrier_img->carrier_lenght = pos;
-    carrier_img->bytes = initial_offset;
+    // The number must be followed by a whitespace
+    if (i == start || i >= pnm_size || !isspace(pnm[i])) return false;
+
+    *pos = i;
+    *out_value = (uint32_t)value;
+    return true;
 }
 
-// Get the bytes from an WebP image that will carry the hidden data
-void imc_webp_carrier_open(CarrierImage *carrier_img)
+// Get the bytes from a PNM image (binary PGM or PPM) that will carry the hidden data
+// The carrier bytes are the color values on the file's memory mapping, so the image is neither decoded nor encoded.
+int imc_pnm_carrier_open(CarrierImage *carrier_img)
 {
-    // Get the total file size of the WebP image
+    uint8_t *const pnm = carrier_img->mapping;
+    const size_t file_size = carrier_img->mapping_size;
 
-    #ifdef _WIN32   // Windows systems
-    
-    HANDLE file_handle = __win_get_file_handle(carrier_img->file);
-    LARGE_INTEGER file_size_win = {0};
-    GetFileSizeEx(file_handle, &file_size_win);
-    const size_t file_size = file_size_win.QuadPart;
+    // 'P5' is a grayscale image (PGM), and 'P6' is a color image (PPM)
+    const size_t num_colors = (pnm[1] == '6') ? 3 : 1;
 
-    #else   // Linux systems
-    
-    int file_descriptor = fileno(carrier_img->file);
-    struct stat file_stats = {0};
-    fstat(file_descriptor, &file_stats);
-    const size_t file_size = file_stats.st_size;
+    // Header of the image: width, height, and the maximum value of a color
+    size_t pos = 2;
+    uint32_t width;
+    uint32_t height;
+    uint32_t max_value;
 
-    #endif
+    if (
+        !__pnm_header_field(pnm, file_size, &pos, &width) ||
+        !__pnm_header_field(pnm, file_size, &pos, &height) ||
+        !__pnm_header_field(pnm, file_size, &pos, &max_value) ||
+        width == 0 || height == 0
+    )
+    {
+        goto invalid_pnm;
+    }
+
+    // A single whitespace character separates the header from the pixel data
+    const size_t data_offset = pos + 1;
+
+    // If the maximum value is not 255 or 65535, changing the last bit could make a color go over the maximum
+    if (max_value != 255 && max_value != 65535) return IMC_ERR_UNSUPPORTED;
+
+    // Color values of 16 bits are stored in big-endian byte order
+    const size_t value_size = (max_value > 255) ? 2 : 1;
+    const size_t value_count = (size_t)width * (size_t)height * num_colors;
+    if (value_count / num_colors / width != height) goto invalid_pnm;
+    if (value_count > (file_size - data_offset) / value_size) goto invalid_pnm;
+
+    // Pointers to the carrier bytes of the image
+    carrier_bytes_t *carrier = imc_malloc(sizeof(carrier_bytes_t) * value_count);
+    uint8_t *const pixels = &pnm[data_offset];
+
+    // Loop through all color values in the image to get the carrier bytes
+    // (the least significant byte of each value)
+    for (size_t i = 0; i < value_count; i++)
+    {
+        carrier[i] = &pixels[(i * value_size) + (value_size - 1)];
+
+        // Print the progress when on verbose mode
+        if ( carrier_img->verbose && (i % 4096 == 0) )
+        {
+            double percent = ((double)i / (double)value_count) * 100.0;
+            imc_progress_rate(&carrier_img->progress, "Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+        }
+    }
+
+    imc_progress(&carrier_img->progress, "Scanning cover image for suitable carrier bits... Done!  \n");
 
-    if (file_size > UINT32_MAX)
+    // Store the information about the carrier bytes
+    carrier_img->carrier = carrier;
+    carrier_img->carrier_lenght = value_count;
+    carrier_img->width = width;
+    carrier_img->height = height;
+    return IMC_SUCCESS;
+
+    invalid_pnm:
+    return IMC_ERR_FILE_INVALID;
+}
+
+// Read the value of index 'index' of a field from the directory of a TIFF image (the field's type must be BYTE, SHORT or LONG)
+// Returns 'false' if the field does not have that many values, or if its values are out of the bounds of the file.
+static bool __tiff_field_value(const uint8_t *tiff, size_t tiff_size, const uint8_t *entry, bool big_endian, size_t index, uint32_t *out_value)
+{
+    // Each entry of the directory has 12 bytes:
+    // tag (2 bytes), type (2 bytes), amount of values (4 bytes), and the values or their offset (4 bytes)
+    const uint32_t type = __read_uint(&entry[2], 2, big_endian);
+    const size_t count = __read_uint(&entry[4], 4, big_endian);
+    
+    size_t value_size;
+    switch (type)
     {
-        fprintf(stderr, "Error: Maximum size of an WebP image is 4 GB.\n");
-        exit(EXIT_FAILURE);
+        case 1: value_size = 1; break;  // BYTE
+        case 3: value_size = 2; break;  // SHORT
+        case 4: value_size = 4; break;  // LONG
+        default: return false;
     }
 
-    if (carrier_img->verbose)
+    if (index >= count) return false;
+
+    // The values are stored on the entry itself if they fit on 4 bytes,
+    // otherwise the entry has the offset of the values on the file.
+    const uint8_t *values;
+    if (count <= 4 / value_size)
     {
-        printf("Reading WebP image... ");
-        fflush(stdout);
+        values = &entry[8];
     }
-
-    // Input buffer (original image)
-    uint8_t *in_buffer = imc_malloc(file_size);
-    const size_t read_count = fread(in_buffer, 1, file_size, carrier_img->file);
-    if (read_count != file_size)
+    else
     {
-        fprintf(stderr, "Error: WebP file could not be read.\n");
-        exit(EXIT_FAILURE);
+        const size_t offset = __read_uint(&entry[8], 4, big_endian);
+        if (offset > tiff_size || count > (tiff_size - offset) / value_size) return false;
+        values = &tiff[offset];
     }
 
-    // Data of the decoded WebP image (original file)
-    WebPDecoderConfig *webp_obj = imc_calloc(1, sizeof(WebPDecoderConfig));
-    WebPInitDecoderConfig(webp_obj);
-    VP8StatusCode status_vp8 = WebPGetFeatures(in_buffer, file_size, &webp_obj->input);
+    *out_value = __read_uint(&values[index * value_size], value_size, big_endian);
+    return true;
+}
 
-    if (status_vp8 != VP8_STATUS_OK)
-    {
-        if (carrier_img->verbose) fprintf(stderr, "\n");
-        fprintf(stderr, "Error: Could not retrieve the header of the WebP image.\n");
-        exit(EXIT_FAILURE);
-    }
+// Order of the ranges of a TIFF file: by their starting position
+static int __tiff_range_compare(const void *range_a, const void *range_b)
+{
+    const TiffRange *const a = (const TiffRange *)range_a;
+    const TiffRange *const b = (const TiffRange *)range_b;
+    return (a->start > b->start) - (a->start < b->start);
+}
 
-    if (webp_obj->input.has_animation)
+// Size in bytes of a value of a TIFF field, by its type (0 if the type is unknown)
+static size_t __tiff_type_size(uint32_t type)
+{
+    switch (type)
     {
-        if (carrier_img->verbose) fprintf(stderr, "\n");
-        fprintf(stderr, "Error: Animated WebP images are not supported.\n");
-        exit(EXIT_FAILURE);
+        case 1:     // BYTE
+        case 2:     // ASCII
+        case 6:     // SBYTE
+        case 7:     // UNDEFINED
+            return 1;
+        
+        case 3:     // SHORT
+        case 8:     // SSHORT
+            return 2;
+        
+        case 4:     // LONG
+        case 9:     // SLONG
+        case 11:    // FLOAT
+            return 4;
+        
+        case 5:     // RATIONAL
+        case 10:    // SRATIONAL
+        case 12:    // DOUBLE
+            return 8;
+        
+        default:
+            return 0;
     }
+}
+
+// Get the bytes from an uncompressed TIFF image that will carry the hidden data
+// The carrier bytes are the color values on the file's memory mapping, so the image is neither decoded nor encoded.
+// Only the first image on the file is used (any other images are saved without changes).
+int imc_tiff_carrier_open(CarrierImage *carrier_img)
+{
+    uint8_t *const tiff = carrier_img->mapping;
+    const size_t file_size = carrier_img->mapping_size;
     
-    // Set the decoding options
-    webp_obj->options.use_threads = 1;     // Use multithreading
-    #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-    webp_obj->output.colorspace = MODE_ARGB;    // 32-bit color value on big endian byte order
-    #else
-    webp_obj->output.colorspace = MODE_BGRA;    // 32-bit color value on little endian byte order
-    #endif
-    
-    // Decode the original image
-    status_vp8 = WebPDecode(in_buffer, file_size, webp_obj);
-    if (status_vp8 != VP8_STATUS_OK)
+    // The file begins with "MM" for big-endian byte order, or "II" for little-endian
+    const bool big_endian = (tiff[0] == 'M');
+
+    // Directory of the first image on the file: amount of entries (2 bytes), followed by the entries (12 bytes each)
+    if (file_size < 8) goto invalid_tiff;
+    const size_t dir_offset = __read_uint(&tiff[4], 4, big_endian);
+    if (dir_offset > file_size - 2) goto invalid_tiff;
+    const size_t entry_count = __read_uint(&tiff[dir_offset], 2, big_endian);
+    if (entry_count > (file_size - dir_offset - 2) / 12) goto invalid_tiff;
+
+    // Fields of the image (with their default values)
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t compression = 1;           // 1 means uncompressed
+    uint32_t photometric = UINT32_MAX;  // Color space (0 or 1 for grayscale, 2 for RGB)
+    uint32_t samples_per_pixel = 1;
+    uint32_t rows_per_strip = UINT32_MAX;
+    uint32_t planar_config = 1;         // 1 means that the values of each pixel are stored together
+    uint32_t extra_sample = 0;          // Meaning of the first value after the colors (1 or 2 for the alpha channel)
+    const uint8_t *bits_per_sample = NULL;
+    const uint8_t *strip_offsets = NULL;
+    bool is_tiled = false;
+    bool fields_ok = true;
+
+    for (size_t i = 0; i < entry_count; i++)
     {
-        if (carrier_img->verbose) fprintf(stderr, "\n");
-        fprintf(stderr, "Error: Could not decode the WebP image. Reason: ");
-        switch (status_vp8)
+        const uint8_t *const entry = &tiff[dir_offset + 2 + (i * 12)];
+        const uint32_t tag = __read_uint(&entry[0], 2, big_endian);
+
+        switch (tag)
         {
-            case VP8_STATUS_OUT_OF_MEMORY:
-                fprintf(stderr, "no enough memory.\n");
+            case 256:   // ImageWidth
+                fields_ok &= __tiff_field_value(tiff, file_size, entry, big_endian, 0, &width);
                 break;
             
-            case VP8_STATUS_NOT_ENOUGH_DATA:
-                fprintf(stderr, "no enough data, the file appears to be corrupted.\n");
+            case 257:   // ImageLength
+                fields_ok &= __tiff_field_value(tiff, file_size, entry, big_endian, 0, &height);
                 break;
             
-            case VP8_STATUS_UNSUPPORTED_FEATURE:
-                fprintf(stderr, "image uses an unsupported feature.\n");
+            case 258:   // BitsPerSample
+                bits_per_sample = entry;
+                break;
+            
+            case 259:   // Compression
+                fields_ok &= __tiff_field_value(tiff, file_size, entry, big_endian, 0, &compression);
+                break;
+            
+            case 262:   // PhotometricInterpretation
+                fields_ok &= __tiff_field_value(tiff, file_size, entry, big_endian, 0, &photometric);
+                break;
+            
+            case 273:   // StripOffsets
+                strip_offsets = entry;
+                break;
+            
+            case 277:   // SamplesPerPixel
+                fields_ok &= __tiff_field_value(tiff, file_size, entry, big_endian, 0, &samples_per_pixel);
+                break;
+            
+            case 278:   // RowsPerStrip
+                fields_ok &= __tiff_field_value(tiff, file_size, entry, big_endian, 0, &rows_per_strip);
+                break;
+            
+            case 284:   // PlanarConfiguration
+                fields_ok &= __tiff_field_value(tiff, file_size, entry, big_endian, 0, &planar_config);
                 break;
             
-            case VP8_STATUS_BITSTREAM_ERROR:
-                fprintf(stderr, "not a valid WebP image.\n");
+            case 322:   // TileWidth
+            case 324:   // TileOffsets
+                is_tiled = true;
                 break;
             
-            default:
-                fprintf(stderr, "unknown.\n");
+            case 338:   // ExtraSamples
+                fields_ok &= __tiff_field_value(tiff, file_size, entry, big_endian, 0, &extra_sample);
                 break;
         }
-        exit(EXIT_FAILURE);
     }
 
-    if (carrier_img->verbose) printf("Done!  \n");
+    if (!fields_ok || width == 0 || height == 0 || samples_per_pixel == 0 || rows_per_strip == 0 || !strip_offsets)
+    {
+        goto invalid_tiff;
+    }
 
-    // Calculate the total amount of pixels in the image
-    const size_t width = webp_obj->output.width;
-    const size_t height = webp_obj->output.height;
-    const size_t pixel_count = width * height;
+    // Only uncompressed images stored in strips are supported
+    if (compression != 1 || is_tiled) return IMC_ERR_UNSUPPORTED;
+
+    // On palette images the values are an index on the color palette, so changing their last bit would completely change the color
+    // (the other color spaces are not supported either, since they do not use the usual color values)
+    if (photometric > 2) return IMC_ERR_UNSUPPORTED;
+
+    // All values of a pixel must have the same size, either 8 or 16 bits
+    uint32_t bit_depth = 0;
+    for (size_t i = 0; i < samples_per_pixel; i++)
+    {
+        uint32_t bits = 1;
+        if (bits_per_sample && !__tiff_field_value(tiff, file_size, bits_per_sample, big_endian, i, &bits))
+        {
+            // Some images store the bit depth only once for all values
+            if (i == 0 || !__tiff_field_value(tiff, file_size, bits_per_sample, big_endian, 0, &bits)) goto invalid_tiff;
+        }
+        
+        if (i > 0 && bits != bit_depth) bit_depth = 0;
+        else if (i == 0) bit_depth = bits;
+    }
+
+    if (bit_depth != 8 && bit_depth != 16) return IMC_ERR_UNSUPPORTED;
+
+    const size_t num_colors = (photometric == 2) ? 3 : 1;
+    if (samples_per_pixel < num_colors) goto invalid_tiff;
+
+    // Images with each color stored separately are not supported
+    if (planar_config != 1 && samples_per_pixel > 1) return IMC_ERR_UNSUPPORTED;
+
+    // We are going to use pixels with alpha > 0, but the alpha channel itself will not be used as carrier
+    const bool has_alpha = (samples_per_pixel > num_colors) && (extra_sample == 1 || extra_sample == 2);
     
-    // Pointers to the carrier bytes of the image
-    carrier_bytes_t *carrier = imc_malloc(sizeof(carrier_bytes_t) * pixel_count * 3);
-    size_t pos = 0; // Position on the carrier array
+    // Color values of 16 bits are stored in the same byte order as the file
+    const size_t value_size = bit_depth / 8;
+    const size_t lsb_offset = big_endian ? (value_size - 1) : 0;    // Position of the least significant byte of a color value
+    const size_t bytes_per_pixel = samples_per_pixel * value_size;
+    if (width > SIZE_MAX / bytes_per_pixel) goto invalid_tiff;
+    const size_t row_size = width * bytes_per_pixel;
+
+    // The rows of the image are split in strips, each one stored at its own position on the file
+    if (rows_per_strip > height) rows_per_strip = height;
+    const size_t strip_count = ((size_t)height + rows_per_strip - 1) / rows_per_strip;
+
+    // The strips must fit on the file, and they must not overlap each other (otherwise a carrier byte could be used twice),
+    // nor the header, the directory, or the values of its fields (otherwise hiding data would change the file's structure).
+    // The strips can be stored in any order, so all ranges are sorted by their position before being compared.
+    // (each strip has at least one row, so a file cannot fit more strips than rows)
+    if (strip_count > file_size / row_size) goto invalid_tiff;
+    TiffRange *const ranges = imc_malloc(sizeof(TiffRange) * (strip_count + entry_count + 2));
+    size_t range_count = 0;
     
-    // Loop through all pixels in the image to get the carrier bytes
-    // (we are going to use pixels with alpha > 0, but the alpha channel itself will not be used as carrier)
-    for (size_t i = 0; i < pixel_count; i++)
+    ranges[range_count++] = (TiffRange){.start = 0, .end = 8, .is_strip = false};
+    const size_t dir_end = dir_offset + 2 + (entry_count * 12) + 4;  // The directory ends with the offset of the next one
+    ranges[range_count++] = (TiffRange){.start = dir_offset, .end = (dir_end < file_size) ? dir_end : file_size, .is_strip = false};
+
+    for (size_t i = 0; i < entry_count; i++)
     {
-        uint8_t *const pixel = &webp_obj->output.u.RGBA.rgba[i*4];  // Image always is 4 bytes per pixel
+        // Values that do not fit on the entry itself
+        const uint8_t *const entry = &tiff[dir_offset + 2 + (i * 12)];
+        const size_t value_size = __tiff_type_size(__read_uint(&entry[2], 2, big_endian));
+        const size_t count = __read_uint(&entry[4], 4, big_endian);
+        if (value_size == 0 || count <= 4 / value_size) continue;
         
-        // Get the 4 color components of the pixel (alpha, red, green, blue)
-        // Note: the alpha value is the most significant byte of a 32-bit unsigned integer,
-        //       followed by red > green > blue (in decreasing order of significance).
-        #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-        uint8_t *const alpha = &pixel[0];
-        uint8_t *const red   = &pixel[1];
-        uint8_t *const green = &pixel[2];
-        uint8_t *const blue  = &pixel[3];
-        #else // __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-        uint8_t *const alpha = &pixel[3];
-        uint8_t *const red   = &pixel[2];
-        uint8_t *const green = &pixel[1];
-        uint8_t *const blue  = &pixel[0];
-        #endif
+        const size_t offset = __read_uint(&entry[8], 4, big_endian);
+        if (offset >= file_size) continue;
+        const size_t size = (count > (file_size - offset) / value_size) ? (file_size - offset) : (count * value_size);
+        ranges[range_count++] = (TiffRange){.start = offset, .end = offset + size, .is_strip = false};
+    }
+
+    bool strips_ok = true;
+    for (size_t s = 0; s < strip_count && strips_ok; s++)
+    {
+        uint32_t strip_offset;
+        const size_t strip_rows = (s < strip_count - 1) ? rows_per_strip : height - (s * rows_per_strip);
         
-        // Use the RGB bytes as carriers if the pixel is not fully transparent
-        if (*alpha > 0)
+        strips_ok = __tiff_field_value(tiff, file_size, strip_offsets, big_endian, s, &strip_offset)
+            && strip_offset <= file_size
+            && strip_rows <= (file_size - strip_offset) / row_size;
+        
+        if (strips_ok) ranges[range_count++] = (TiffRange){.start = strip_offset, .end = strip_offset + (strip_rows * row_size), .is_strip = true};
+    }
+
+    if (strips_ok)
+    {
+        // Since the ranges are sorted by their start, a range overlaps an earlier one if it starts before the furthest end so far
+        // (the ranges of the file's structure may overlap each other, since they are not changed)
+        qsort(ranges, range_count, sizeof(TiffRange), &__tiff_range_compare);
+        size_t strips_end = 0;
+        size_t others_end = 0;
+
+        for (size_t i = 0; i < range_count && strips_ok; i++)
         {
-            carrier[pos++] = red;
-            carrier[pos++] = green;
-            carrier[pos++] = blue;
+            const TiffRange *const range = &ranges[i];
+            if (range->start == range->end) continue;
+            
+            if (range->is_strip)
+            {
+                if (range->start < strips_end || range->start < others_end) strips_ok = false;
+                if (range->end > strips_end) strips_end = range->end;
+            }
+            else
+            {
+                if (range->start < strips_end) strips_ok = false;
+                if (range->end > others_end) others_end = range->end;
+            }
         }
+    }
 
-        // Print the progress when on verbose mode
-        if ( carrier_img->verbose && (i % 4096 == 0) )
+    imc_free(ranges);
+    if (!strips_ok) goto invalid_tiff;
+
+    // Pointers to the carrier bytes of the image
+    carrier_bytes_t *carrier = imc_malloc(sizeof(carrier_bytes_t) * (size_t)width * (size_t)height * num_colors);
+    size_t pos = 0;
+
+    for (size_t s = 0; s < strip_count; s++)
+    {
+        // Print status message (on verbose)
+        if (carrier_img->verbose)
         {
-            double percent = ((double)i / (double)pixel_count) * 100.0;
-            printf_prog("Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+            const double percent = ((double)s / (double)strip_count) * 100.0;
+            imc_progress_rate(&carrier_img->progress, "Scanning cover image for suitable carrier bits... %.1f %%\r", percent);
+        }
+        
+        // The strips were already checked above
+        uint32_t strip_offset;
+        __tiff_field_value(tiff, file_size, strip_offsets, big_endian, s, &strip_offset);
+        const size_t strip_rows = (s < strip_count - 1) ? rows_per_strip : height - (s * rows_per_strip);
+
+        uint8_t *const strip = &tiff[strip_offset];
+        const size_t pixel_count = strip_rows * width;
+
+        for (size_t i = 0; i < pixel_count; i++)
+        {
+            uint8_t *const pixel = &strip[i * bytes_per_pixel];
+
+            // Check if the pixel is not fully transparent
+            if (has_alpha)
+            {
+                const uint8_t *const alpha = &pixel[num_colors * value_size];
+                if (alpha[0] == 0 && alpha[value_size - 1] == 0) continue;
+            }
+
+            for (size_t n = 0; n < num_colors; n++)
+            {
+                // Store the pointer to the least significant byte of the color value
+                carrier[pos++] = &pixel[(n * value_size) + lsb_offset];
+            }
         }
     }
 
-    printf("Scanning cover image for suitable carrier bits... Done!  \n");
+    imc_progress(&carrier_img->progress, "Scanning cover image for suitable carrier bits... Done!  \n");
 
     // Check for edge case
+    // (this may happen if the image is fully transparent)
     if (pos == 0)
     {
-        fprintf(stderr, "Error: the WebP image has no suitable bits for hiding the data. "
-            "This may happen if the image is fully transparent.\n");
-        exit(EXIT_FAILURE);
+        imc_free(carrier);
+        return IMC_ERR_NO_CARRIER;
     }
-    
+
     // Free the unused space of the carrier buffer
     carrier = imc_realloc(carrier, pos * sizeof(carrier_bytes_t));
-    
-    // Store the structure necessary to handle the opened image
-    carrier_img->object = webp_obj;
 
     // Store the information about the carrier bytes
     carrier_img->carrier = carrier;
     carrier_img->carrier_lenght = pos;
-    carrier_img->bytes = in_buffer;
+    carrier_img->width = width;
+    carrier_img->height = height;
+    return IMC_SUCCESS;
 
-    // Remember the size of the input buffer
-    carrier_img->heap = imc_malloc(sizeof(void *));
-    carrier_img->heap[0] = imc_malloc(sizeof(size_t));
-    *(size_t*)carrier_img->heap[0] = file_size;
-    carrier_img->heap_lenght = 1;
+    invalid_tiff:
+    return IMC_ERR_FILE_INVALID;
 }
 
-// Change a file path in order to make it unique
+// Write to 'path' the name of the 'number'-th copy of a file (for example, 'Image.jpg' might become 'Image (2).jpg')
 // IMPORTANT: Function assumes that the path buffer must be big enough to store the new name.
 // (at most 5 characters are added to the path)
-static bool __resolve_filename_collision(char *path)
+static void __numbered_filename(const char *original, int number, char *path)
 {
-    // Try opening the file for reading to see if it already exists
-    FILE *file = fopen(path, "rb");
-    if (file == NULL) return true;
-    
-    // Sanity check (so we don't risk a stack overflow)
-    const size_t path_len = strlen(path);
-    if (path_len > UINT16_MAX) return false;
-
     // Get the filename without the directories
+    const size_t path_len = strlen(original);
     char path_copy[path_len+1];
     memset(path_copy, 0, sizeof(path_copy));
-    strncpy(path_copy, path, sizeof(path_copy));
+    strncpy(path_copy, original, sizeof(path_copy));
     char *path_base = basename(path_copy);
     
     // Copy the file's extension to a buffer
@@ -1317,23 +4707,44 @@ static bool __resolve_filename_collision(char *path)
     strncpy(extension, dot, sizeof(extension));
 
     // Copy the file's stem to a buffer
-    const size_t s_len = strlen(path) - e_len;
+    const size_t s_len = path_len - e_len;
     char stem[s_len+1];
     memset(stem, 0, sizeof(stem));
-    strncpy(stem, path, s_len);
+    strncpy(stem, original, s_len);
+
+    // Create a 'number of the copy' string
+    char copy_num[6];
+    snprintf(copy_num, sizeof(copy_num), " (%d)", number);
+
+    // Concatenate the stem, number, and extension to form a new filename
+    memcpy(path, stem, sizeof(stem));
+    strcat(path, copy_num);
+    strcat(path, extension);
+}
+
+// Change a file path in order to make it unique
+// IMPORTANT: Function assumes that the path buffer must be big enough to store the new name.
+// (at most 5 characters are added to the path)
+static bool __resolve_filename_collision(char *path)
+{
+    // Try opening the file for reading to see if it already exists
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return true;
+    
+    // Sanity check (so we don't risk a stack overflow)
+    const size_t path_len = strlen(path);
+    if (path_len > UINT16_MAX) return false;
+
+    // Keep a copy of the original path
+    char original[path_len+1];
+    memcpy(original, path, sizeof(original));
     
     for (int i = 1; i <= IMC_MAX_FILENAME_DUPLICATES; i++)
     {
         fclose(file);
 
-        // Create a 'number of the copy' string
-        char copy_num[6];
-        snprintf(copy_num, sizeof(copy_num), " (%d)", i);
-
-        // Concatenate the stem, number, and extension to form a new filename
-        memcpy(path, stem, sizeof(stem));
-        strcat(path, copy_num);
-        strcat(path, extension);
+        // Append the number to the file's stem
+        __numbered_filename(original, i, path);
 
         // Test if the new filename exists
         file = fopen(path, "rb");
@@ -1419,6 +4830,155 @@ static void __copy_file_times(FILE *source_file, const char *dest_path)
     #endif // _WIN32
 }
 
+// Open the file where a new image is saved, and store its path on the 'out_path' of the image
+// If 'save_path' is NULL, the image is written to a memory buffer (see 'imc_steg_save_memory()').
+// If 'save_path' is "-", the image is written to the standard output. Otherwise, 'extension' is appended to the path
+// (unless it already ends in 'extension' or 'alt_extension'), then a number is appended to its stem if the name already exists.
+// Returns NULL on failure, and 'status' receives the reason (IMC_ERR_SAVE_FAIL, IMC_ERR_FILE_EXISTS or IMC_ERR_FILE_NOT_FOUND).
+static FILE *__open_saved_image(CarrierImage *carrier_img, const char *save_path, const char *extension, const char *alt_extension, int *status)
+{
+    carrier_img->to_memory = (save_path == NULL);
+    
+    if (carrier_img->to_memory)
+    {
+        // The image is written to a buffer that grows as needed
+        // (on Windows, to a temporary file that is read back to memory by '__close_saved_image()')
+        imc_free(carrier_img->out_path);
+        carrier_img->out_path = NULL;
+        carrier_img->saved_data = NULL;
+        carrier_img->saved_size = 0;
+        
+        #ifdef _WIN32
+        FILE *out_file = tmpfile();
+        #else
+        FILE *out_file = open_memstream(&carrier_img->saved_data, &carrier_img->saved_size);
+        #endif // _WIN32
+        
+        if (!out_file) *status = IMC_ERR_NO_MEMORY;
+        return out_file;
+    }
+    
+    const size_t p_len = strlen(save_path);
+    if (p_len > UINT16_MAX)
+    {
+        *status = IMC_ERR_SAVE_FAIL;
+        return NULL;
+    }
+    
+    char out_path[p_len+16];
+    strncpy(out_path, save_path, sizeof(out_path));
+    const bool to_stdout = imc_is_stdio_path(save_path);
+
+    if (!to_stdout)
+    {
+        // Append the extension to the path, if it does not already have it
+        const size_t e_len = strlen(extension);
+        const size_t a_len = alt_extension ? strlen(alt_extension) : 0;
+        
+        if (
+            (p_len < e_len || strncmp(&save_path[p_len-e_len], extension, e_len) != 0)
+            &&
+            (!alt_extension || p_len < a_len || strncmp(&save_path[p_len-a_len], alt_extension, a_len) != 0)
+        )
+        {
+            strcat(out_path, extension);
+        }
+
+        // Append a number to the file's stem if the filename already exists
+        // Example: 'Image.jpg' might become 'Image (1).jpg'
+        // Note: The number goes up to 99, in order to avoid creating too many files accidentally
+        bool is_unique = __resolve_filename_collision(out_path);
+        if (!is_unique)
+        {
+            *status = IMC_ERR_FILE_EXISTS;
+            return NULL;
+        }
+    }
+
+    // Store a copy of the resulting path
+    free(carrier_img->out_path);
+    carrier_img->out_path = strdup(out_path);
+
+    // Open the output file for writing
+    if (to_stdout)
+    {
+        __set_binary_mode(stdout);
+        return stdout;
+    }
+    
+    FILE *out_file = fopen(out_path, "wb");
+    if (!out_file) *status = IMC_ERR_FILE_NOT_FOUND;
+    return out_file;
+}
+
+// Finish writing a new image, then copy the "last access" and "last mofified" times from the original image
+// (nothing is copied if either image is on the standard input or output, or on memory)
+// Returns IMC_ERR_WRITE_FAIL if the image could not be written.
+static int __close_saved_image(CarrierImage *carrier_img, FILE *out_file)
+{
+    if (out_file == stdout)
+    {
+        return (fflush(stdout) == 0) ? IMC_SUCCESS : IMC_ERR_WRITE_FAIL;
+    }
+
+    if (carrier_img->to_memory)
+    {
+        #ifdef _WIN32
+        // Read the temporary file back to memory (the file is deleted once it is closed)
+        const long size = (fflush(out_file) == 0) ? ftell(out_file) : -1;
+        if (size >= 0)
+        {
+            carrier_img->saved_data = imc_malloc(size + 1);
+            carrier_img->saved_size = size;
+            rewind(out_file);
+            
+            if (fread(carrier_img->saved_data, 1, size, out_file) != (size_t)size)
+            {
+                imc_free(carrier_img->saved_data);
+                carrier_img->saved_data = NULL;
+            }
+        }
+        fclose(out_file);
+        #else
+        // The buffer is only finalized when the stream is closed
+        if (fclose(out_file) != 0)
+        {
+            imc_free(carrier_img->saved_data);
+            carrier_img->saved_data = NULL;
+        }
+        #endif // _WIN32
+
+        return carrier_img->saved_data ? IMC_SUCCESS : IMC_ERR_WRITE_FAIL;
+    }
+
+    if (fclose(out_file) != 0) return IMC_ERR_WRITE_FAIL;
+    if (carrier_img->file) __copy_file_times(carrier_img->file, carrier_img->out_path);
+    return IMC_SUCCESS;
+}
+
+// Close the file of a new image that could not be written (the standard output is just flushed)
+static void __abort_saved_image(CarrierImage *carrier_img, FILE *out_file)
+{
+    if (out_file == stdout)
+    {
+        fflush(stdout);
+        return;
+    }
+
+    fclose(out_file);
+
+    if (carrier_img->to_memory)
+    {
+        imc_free(carrier_img->saved_data);
+        carrier_img->saved_data = NULL;
+    }
+    else
+    {
+        // Do not leave a truncated image behind
+        remove(carrier_img->out_path);
+    }
+}
+
 // Progress monitor when writing a JPEG image
 static void __jpeg_write_callback(j_common_ptr jpeg_obj)
 {
@@ -1432,49 +4992,39 @@ static void __jpeg_write_callback(j_common_ptr jpeg_obj)
 
     // Percentage completed
     const double percent = ((pass_count + (unit_count / unit_max)) / pass_max) * 100.0;
-    printf_prog("Writing JPEG image... %.1f %%\r", percent);
+    const JpegProgress *const progress = (JpegProgress *)jpeg_obj->progress;
+    imc_progress_rate(progress->progress, "Writing JPEG image... %.1f %%\r", percent);
 }
 
 // Write the carrier bytes back to the JPEG image, and save it as a new file
 int imc_jpeg_carrier_save(CarrierImage *carrier_img, const char *save_path)
 {
-    // Append the '.jpg' extension to the path, if it does not already end in '.jpg' or '.jpeg'
-    const size_t p_len = strlen(save_path);
-    if (p_len > UINT16_MAX) return IMC_ERR_SAVE_FAIL;
-    char jpeg_path[p_len+16];
-    strncpy(jpeg_path, save_path, sizeof(jpeg_path));
-    
-    if (
-        (p_len < 4 || strncmp(&save_path[p_len-4], ".jpg", 4) != 0)
-        &&
-        (p_len < 5 || strncmp(&save_path[p_len-5], ".jpeg", 5) != 0)
-    )
-    {
-        strcat(jpeg_path, ".jpg");
-    }
-
-    // Append a number to the file's stem if the filename already exists
-    // Example: 'Image.jpg' might become 'Image (1).jpg'
-    // Note: The number goes up to 99, in order to avoid creating too many files accidentally
-    bool is_unique = __resolve_filename_collision(jpeg_path);
-    if (!is_unique) return IMC_ERR_FILE_EXISTS;
-
-    // Store a copy of the resulting path
-    free(carrier_img->out_path);
-    carrier_img->out_path = strdup(jpeg_path);
-
-    FILE *jpeg_file = fopen(jpeg_path, "wb");
-    if (!jpeg_file) return IMC_ERR_FILE_NOT_FOUND;
+    // Open the output file
+    // (the '.jpg' extension is appended to the path, if it does not already end in '.jpg' or '.jpeg')
+    int open_status = IMC_SUCCESS;
+    FILE *jpeg_file = __open_saved_image(carrier_img, save_path, ".jpg", ".jpeg", &open_status);
+    if (!jpeg_file) return open_status;
 
     // Create a new JPEG compression object 
-    struct jpeg_compress_struct jpeg_obj_out;
-    struct jpeg_error_mgr jpeg_err;
-    jpeg_obj_out.err = jpeg_std_error(&jpeg_err);   // Use the default error handler
-    jpeg_create_compress(&jpeg_obj_out);
-    jpeg_stdio_dest(&jpeg_obj_out, jpeg_file);
-
+    struct jpeg_compress_struct jpeg_obj_out = {0};
+    JpegError jpeg_err;
+    jpeg_obj_out.err = jpeg_std_error(&jpeg_err.manager);
+    jpeg_err.manager.error_exit = &__jpeg_error_exit;           // Return an error instead of exiting the program
+    jpeg_err.manager.output_message = &__jpeg_output_message;   // Do not print the warnings
+    
     // Get the original image
+    // (its error handler is used when its coefficients are accessed, so it also needs to return here on errors)
     struct jpeg_decompress_struct *jpeg_obj_in = (struct jpeg_decompress_struct *)carrier_img->object;
+    JpegError *const jpeg_err_in = (JpegError *)jpeg_obj_in->err;
+    
+    // Progress monitor for the JPEG's write operation (when on verbose)
+    JpegProgress *const progress = carrier_img->verbose ? imc_calloc(1, sizeof(JpegProgress)) : NULL;
+    
+    if (setjmp(jpeg_err.jump)) goto jpeg_write_error;
+    if (setjmp(jpeg_err_in->jump)) goto jpeg_write_error;
+    
+    jpeg_create_compress(&jpeg_obj_out);
+    jpeg_stdio_dest(&jpeg_obj_out, jpeg_file);
     
     // Get the DCT coefficients from the original image
     jvirt_barray_ptr *jpeg_dct = carrier_img->heap[1];
@@ -1506,7 +5056,7 @@ int imc_jpeg_carrier_save(CarrierImage *carrier_img, const char *save_path)
                 const double row_fraction = ((double)y / row_count) / (double)jpeg_obj_in->num_components;
                 const double comp_fraction = (double)comp / (double)jpeg_obj_in->num_components;
                 const double percent = (comp_fraction + row_fraction) * 100.0;
-                printf_prog("Writing carrier back to the cover image... %.1f %%\r", percent);
+                imc_progress_rate(&carrier_img->progress, "Writing carrier back to the cover image... %.1f %%\r", percent);
             }
 
             // Iterate column by column from left to right
@@ -1536,10 +5086,7 @@ int imc_jpeg_carrier_save(CarrierImage *carrier_img, const char *save_path)
     }
 
     // Print status message (on verbose)
-    if (carrier_img->verbose)
-    {
-        printf("Writing carrier back to the cover image... Done!  \n");
-    }
+    imc_progress(&carrier_img->progress, "Writing carrier back to the cover image... Done!  \n");
 
     // Write the modified DCT coefficients into the new image
     jpeg_copy_critical_parameters(jpeg_obj_in, &jpeg_obj_out);
@@ -1570,89 +5117,326 @@ int imc_jpeg_carrier_save(CarrierImage *carrier_img, const char *save_path)
     }
 
     // Setup the progress monitor for the JPEG's write operation
-    if (carrier_img->verbose)
+    if (progress)
     {
-        jpeg_obj_out.progress = imc_calloc(1, sizeof(struct jpeg_progress_mgr));
-        jpeg_obj_out.progress->progress_monitor = &__jpeg_write_callback;
+        progress->manager.progress_monitor = &__jpeg_write_callback;
+        progress->progress = &carrier_img->progress;
+        jpeg_obj_out.progress = &progress->manager;
     }
 
     // Write the new image to disk
     jpeg_finish_compress(&jpeg_obj_out);
     jpeg_destroy_compress(&jpeg_obj_out);
-    fclose(jpeg_file);
+    imc_free(progress);
+    
+    const int close_status = __close_saved_image(carrier_img, jpeg_file);
+    if (close_status == IMC_SUCCESS) imc_progress(&carrier_img->progress, "Writing JPEG image... Done!  \n");
+    else imc_progress(&carrier_img->progress, "\n");
 
-    // Finish the write's progress monitor
-    if (carrier_img->verbose)
+    return close_status;
+
+    jpeg_write_error:
+    jpeg_destroy_compress(&jpeg_obj_out);
+    imc_free(progress);
+    __abort_saved_image(carrier_img, jpeg_file);
+    imc_progress(&carrier_img->progress, "\n");
+    return IMC_ERR_WRITE_FAIL;
+}
+
+// Progress monitor when writing a PNG image
+static void __png_write_callback(png_structp png_obj, png_uint_32 row, int pass)
+{
+    const PngState *const state = (PngState *)png_get_error_ptr(png_obj);
+    const double percent = (((double)pass + ((double)row / state->num_rows)) / state->num_passes) * 100.0;
+    imc_progress_rate(state->progress, "Writing PNG image... %.1f %%\r", percent);
+}
+
+// Filter a row of a PNG image with the given filter type
+// 'previous' is the unfiltered row above it (all zeroes on the first row). 'out_row' receives the filter type followed by the filtered row.
+// Returns the sum of the absolute values of the filtered bytes (as signed numbers).
+static size_t __png_filter_row(uint8_t type, const uint8_t *row, const uint8_t *previous, size_t stride, size_t pixel_size, uint8_t *out_row)
+{
+    out_row[0] = type;
+    uint8_t *const filtered = &out_row[1];
+    size_t sum = 0;
+
+    for (size_t i = 0; i < stride; i++)
     {
-        imc_free(jpeg_obj_out.progress);
-        jpeg_obj_out.progress = NULL;
-        printf("Writing JPEG image... Done!  \n");
+        // Bytes to the left (a), above (b), and above to the left (c) of the current byte
+        const int a = (i >= pixel_size) ? row[i - pixel_size] : 0;
+        const int b = previous[i];
+        const int c = (i >= pixel_size) ? previous[i - pixel_size] : 0;
+        filtered[i] = (uint8_t)(row[i] - __png_predictor(type, a, b, c));
+
+        // The filtered bytes are summed as signed values, so small negative differences also count as small
+        sum += (filtered[i] < 128) ? filtered[i] : 256 - filtered[i];
     }
 
-    // Copy the "last access" and "last mofified" times from the original image
-    __copy_file_times(carrier_img->file, jpeg_path);
+    return sum;
+}
 
-    return IMC_SUCCESS;
+// Filter a row of a PNG image with the filter type that has the smallest sum of absolute differences (the same heuristic as libpng)
+// 'previous' is the unfiltered row above it (all zeroes on the first row), and 'filters' are the types that are tried (PNG_FILTER_* flags).
+// 'out_row' receives the filter type followed by the filtered row, and 'scratch' is a buffer of the same size that is used for trying the filters.
+static void __png_filter_row_adaptive(const uint8_t *row, const uint8_t *previous, size_t stride, size_t pixel_size, int filters, uint8_t *scratch, uint8_t *out_row)
+{
+    uint8_t *best = out_row;    // Filtered row with the smallest sum so far
+    uint8_t *attempt = scratch; // Filtered row being tried
+    size_t best_sum = SIZE_MAX;
+
+    for (uint8_t type = PNG_FILTER_VALUE_NONE; type < PNG_FILTER_VALUE_LAST; type++)
+    {
+        // The flag of each filter type is the bit after the one of the previous type
+        if (!(filters & (PNG_FILTER_NONE << type))) continue;
+        
+        const size_t sum = __png_filter_row(type, row, previous, stride, pixel_size, attempt);
+        if (sum < best_sum)
+        {
+            best_sum = sum;
+            uint8_t *const swap = best;
+            best = attempt;
+            attempt = swap;
+        }
+    }
+
+    if (best != out_row) memcpy(out_row, best, stride + 1);
 }
 
-// Progress monitor when writing a PNG image
-static void __png_write_callback(png_structp png_obj, png_uint_32 row, int pass)
+// Filter the rows from 'first_row' to 'first_row + row_count - 1' of a PNG image, into 'out_data'
+// The rows get the same filter types as on the original image, if they are known. Otherwise, the filter types are chosen for each row.
+// 'zero_row' should be all zeroes (it is used as the row above the first row of the image).
+static void __png_filter_rows(const PngDeflate *job, size_t first_row, size_t row_count, const uint8_t *zero_row, uint8_t *out_data)
 {
-    const double percent = (((double)pass + ((double)row / png_num_rows)) / png_num_passes) * 100.0;
-    printf_prog("Writing PNG image... %.1f %%\r", percent);
+    uint8_t *const scratch = job->row_filters ? NULL : imc_malloc(job->stride + 1);
+
+    for (size_t i = 0; i < row_count; i++)
+    {
+        const size_t row = first_row + i;
+        const uint8_t *const previous = (row > 0) ? job->row_pointers[row - 1] : zero_row;
+        uint8_t *const out_row = &out_data[i * (job->stride + 1)];
+        
+        if (job->row_filters)
+        {
+            __png_filter_row(job->row_filters[row], job->row_pointers[row], previous, job->stride, job->pixel_size, out_row);
+        }
+        else
+        {
+            __png_filter_row_adaptive(job->row_pointers[row], previous, job->stride, job->pixel_size, job->settings->png_filters, scratch, out_row);
+        }
+    }
+
+    imc_free(scratch);
 }
 
-// Write the carrier bytes back to the PNG image, and save it as a new file
-int imc_png_carrier_save(CarrierImage *carrier_img, const char *save_path)
+// Task of the worker threads: filter and compress one band of rows of a PNG image
+static void __png_deflate_task(void *context, size_t task, size_t worker)
 {
-    // Append the '.png' extension to the path, if it does not already has the extension
-    const size_t p_len = strlen(save_path);
-    if (p_len > UINT16_MAX) return IMC_ERR_SAVE_FAIL;
-    char png_path[p_len+16];
-    strncpy(png_path, save_path, sizeof(png_path));
+    PngDeflate *const job = (PngDeflate *)context;
+    PngBand *const band = &job->band[task];
+    const size_t row_size = job->stride + 1;
+    const bool first_band = (task == 0);
+    const bool last_band = (task == job->band_count - 1);
+
+    uint8_t *const zero_row = imc_calloc(1, job->stride);
+    const size_t filtered_size = band->row_count * row_size;
+    uint8_t *const filtered = imc_malloc(filtered_size);
+    __png_filter_rows(job, band->first_row, band->row_count, zero_row, filtered);
+    band->adler = adler32_z(adler32_z(0L, Z_NULL, 0), filtered, filtered_size);
+
+    // The compressor does not write the zlib header and checksum (they are added to the stream as a whole)
+    z_stream stream = {0};
+    const int level = job->settings->png_level;
+    const int strategy = job->settings->png_strategy;
+    band->status = (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, strategy) == Z_OK) ? IMC_SUCCESS : IMC_ERR_NO_MEMORY;
     
-    if ( p_len < 4 || strncmp(&save_path[p_len-4], ".png", 4) != 0 )
+    if (band->status == IMC_SUCCESS && !first_band)
+    {
+        // Filter again the rows before the band that are within the compressor's window, and use them as the dictionary
+        const size_t dict_rows = (IMC_PNG_WINDOW_SIZE + row_size - 1) / row_size;
+        const size_t dict_first = (band->first_row > dict_rows) ? band->first_row - dict_rows : 0;
+        const size_t dict_size = (band->first_row - dict_first) * row_size;
+        uint8_t *const dict = imc_malloc(dict_size);
+        __png_filter_rows(job, dict_first, band->first_row - dict_first, zero_row, dict);
+        
+        const size_t window_size = (dict_size > IMC_PNG_WINDOW_SIZE) ? IMC_PNG_WINDOW_SIZE : dict_size;
+        if (deflateSetDictionary(&stream, &dict[dict_size - window_size], window_size) != Z_OK) band->status = IMC_ERR_WRITE_FAIL;
+        imc_free(dict);
+    }
+
+    if (band->status == IMC_SUCCESS)
+    {
+        // Room for the compressed rows, plus the zlib header on the first band and the checksum on the last band
+        const size_t header_size = first_band ? 2 : 0;
+        const size_t capacity = deflateBound(&stream, filtered_size) + 16;
+        band->data = imc_malloc(header_size + capacity + 4);
+
+        stream.next_in = filtered;
+        stream.avail_in = filtered_size;
+        stream.next_out = &band->data[header_size];
+        stream.avail_out = capacity;
+        
+        const int flush = last_band ? Z_FINISH : Z_SYNC_FLUSH;
+        const int expected = last_band ? Z_STREAM_END : Z_OK;
+        
+        if (deflate(&stream, flush) == expected && stream.avail_in == 0 && stream.avail_out > 0)
+        {
+            band->size = header_size + stream.total_out;
+        }
+        else
+        {
+            band->status = IMC_ERR_WRITE_FAIL;
+        }
+    }
+
+    deflateEnd(&stream);
+    imc_free(filtered);
+    imc_free(zero_row);
+
+    const size_t done = atomic_fetch_add(&job->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(job->progress, "Writing PNG image... %.1f %%\r", ((double)done / (double)job->band_count) * 100.0);
+}
+
+// Filter and compress the rows of a non-interlaced PNG image, on all logical processors
+// 'out_deflate' receives the compressed bands, which together are the contents of the IDAT chunks (the zlib header is at
+// the start of the first band, and the checksum at the end of the last band). It should be freed with '__png_deflate_free()'.
+// 'row_filters' has the filter type of each row, or it is NULL for the filter types to be chosen by the same heuristic as libpng.
+// 'settings' are the compression level and strategy, and the filter types that can be chosen.
+static int __png_deflate(
+    png_bytep *row_pointers,
+    const uint8_t *row_filters,
+    size_t height,
+    size_t stride,
+    size_t pixel_size,
+    const SaveSettings *settings,
+    const ProgressMonitor *progress,
+    PngDeflate **out_deflate
+)
+{
+    PngDeflate *const job = imc_calloc(1, sizeof(PngDeflate));
+    job->row_pointers = row_pointers;
+    job->row_filters = row_filters;
+    job->settings = settings;
+    job->stride = stride;
+    job->pixel_size = pixel_size;
+    job->progress = progress;
+    atomic_store(&job->done, 0);
+
+    // Split the rows in bands of about the same amount of bytes (at least one row on each)
+    const size_t band_rows = (stride + 1 >= IMC_PNG_BAND_SIZE) ? 1 : IMC_PNG_BAND_SIZE / (stride + 1);
+    job->band_count = (height + band_rows - 1) / band_rows;
+    job->band = imc_calloc(job->band_count, sizeof(PngBand));
+
+    for (size_t i = 0; i < job->band_count; i++)
     {
-        strcat(png_path, ".png");
+        job->band[i].first_row = i * band_rows;
+        job->band[i].row_count = (i == job->band_count - 1) ? height - (i * band_rows) : band_rows;
     }
 
-    // Append a number to the file's stem if the filename already exists
-    // Example: 'Image.png' might become 'Image (1).png'
-    // Note: The number goes up to 99, in order to avoid creating too many files accidentally
-    bool is_unique = __resolve_filename_collision(png_path);
-    if (!is_unique) return IMC_ERR_FILE_EXISTS;
+    imc_parallel_for(job->band_count, 0, &__png_deflate_task, job);
 
-    // Store a copy of the resulting path
-    free(carrier_img->out_path);
-    carrier_img->out_path = strdup(png_path);
-    
-    // Open the output file for writing
-    FILE *png_file = fopen(png_path, "wb");
-    if (!png_file) return IMC_ERR_FILE_NOT_FOUND;
+    // Combine the checksums of the bands, in order
+    uLong adler = adler32_z(0L, Z_NULL, 0);
+    int status = IMC_SUCCESS;
+    for (size_t i = 0; i < job->band_count; i++)
+    {
+        const PngBand *const band = &job->band[i];
+        if (status == IMC_SUCCESS) status = band->status;
+        adler = adler32_combine(adler, band->adler, (z_off_t)(band->row_count * (stride + 1)));
+    }
+
+    if (status != IMC_SUCCESS)
+    {
+        __png_deflate_free(job);
+        *out_deflate = NULL;
+        return status;
+    }
+
+    // zlib header: Deflate with a 32 KB window, the compression level (same values as zlib writes), and no dictionary
+    // (the check bits make the header a multiple of 31)
+    const int level = settings->png_level;
+    const int level_flag = (level < 2 || settings->png_strategy >= Z_HUFFMAN_ONLY) ? 0 : ((level < 6) ? 1 : ((level == 6) ? 2 : 3));
+    uint16_t header = (0x78 << 8) | (level_flag << 6);
+    header += 31 - (header % 31);
+    job->band[0].data[0] = header >> 8;
+    job->band[0].data[1] = header & 0xFF;
+
+    // Checksum of the stream (big-endian)
+    PngBand *const last = &job->band[job->band_count - 1];
+    const uint32_t adler_be = htobe32((uint32_t)adler);
+    memcpy(&last->data[last->size], &adler_be, sizeof(adler_be));
+    last->size += sizeof(adler_be);
+
+    *out_deflate = job;
+    return IMC_SUCCESS;
+}
+
+// Free the compressed bands of a PNG image
+static void __png_deflate_free(PngDeflate *job)
+{
+    if (!job) return;
+    for (size_t i = 0; i < job->band_count; i++) imc_free(job->band[i].data);
+    imc_free(job->band);
+    imc_free(job);
+}
+
+// Write the carrier bytes back to the PNG image, and save it as a new file
+int imc_png_carrier_save(CarrierImage *carrier_img, const char *save_path)
+{
+    // Open the output file
+    // (the '.png' extension is appended to the path, if it does not already has the extension)
+    int open_status = IMC_SUCCESS;
+    FILE *png_file = __open_saved_image(carrier_img, save_path, ".png", NULL, &open_status);
+    if (!png_file) return open_status;
 
     // Retrieve the data from the input PNG file
     PngState *const png_in = (PngState *)carrier_img->object;
     png_structp png_obj_in = png_in->object;
     png_infop png_info_in = png_in->info;
     png_bytep *row_pointers = (png_bytep *)png_in->row_pointers;
+    const SaveSettings *const settings = &imc_save_settings[carrier_img->profile];
+
+    // Filter and compress the color values on many threads, before writing the image
+    // (the interlaced images are still compressed by libpng, since their rows are written in many passes)
+    PngDeflate *png_deflate = NULL;
+    if (png_get_interlace_type(png_obj_in, png_info_in) == PNG_INTERLACE_NONE)
+    {
+        const size_t stride = png_get_rowbytes(png_obj_in, png_info_in);
+        const size_t pixel_size = ((size_t)png_get_channels(png_obj_in, png_info_in) * png_get_bit_depth(png_obj_in, png_info_in) + 7) / 8;
+        const size_t height = png_get_image_height(png_obj_in, png_info_in);
+        
+        imc_progress(&carrier_img->progress, "Writing PNG image... ");
+        const int deflate_status = __png_deflate(row_pointers, png_in->row_filters, height, stride, pixel_size, settings, &carrier_img->progress, &png_deflate);
+        if (deflate_status != IMC_SUCCESS)
+        {
+            __abort_saved_image(carrier_img, png_file);
+            imc_progress(&carrier_img->progress, "\n");
+            return deflate_status;
+        }
+    }
+
+    // State of the write operation (for the progress monitor)
+    PngState png_out = {.progress = &carrier_img->progress};
 
     // Create the structures for writing the output PNG image
-    png_structp png_obj_out = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_structp png_obj_out = png_create_write_struct(PNG_LIBPNG_VER_STRING, &png_out, &__png_error, &__png_warning);
     png_infop png_info_out  = png_create_info_struct(png_obj_out);
     
     if (!png_obj_out || !png_info_out)
     {
-        png_destroy_read_struct(&png_obj_out, &png_info_out, NULL);
-        fprintf(stderr, "Error: No enough memory for writing the PNG file.\n");
-        exit(EXIT_FAILURE);
+        png_destroy_write_struct(&png_obj_out, &png_info_out);
+        __png_deflate_free(png_deflate);
+        __abort_saved_image(carrier_img, png_file);
+        return IMC_ERR_NO_MEMORY;
     }
 
     // Error handling
     if (setjmp(png_jmpbuf(png_obj_out)))
     {
-        png_destroy_read_struct(&png_obj_out, &png_info_out, NULL);
-        fprintf(stderr, "Error: Failed to write PNG file.\n");
-        exit(EXIT_FAILURE);
+        png_destroy_write_struct(&png_obj_out, &png_info_out);
+        __png_deflate_free(png_deflate);
+        __abort_saved_image(carrier_img, png_file);
+        imc_progress(&carrier_img->progress, "\n");
+        return IMC_ERR_WRITE_FAIL;
     }
     
     png_init_io(png_obj_out, png_file);
@@ -1680,6 +5464,9 @@ int imc_png_carrier_save(CarrierImage *carrier_img, const char *save_path)
             bit_depth, color_type,
             interlace_method, compression_method, filter_method
         );
+
+        png_out.num_passes = (interlace_method == PNG_INTERLACE_ADAM7) ? PNG_INTERLACE_ADAM7_PASSES : 1.0;
+        png_out.num_rows = height;
     }
 
     // Copy the text comments from the input
@@ -1851,7 +5638,7 @@ int imc_png_carrier_save(CarrierImage *carrier_img, const char *save_path)
     }
 
     // Setup the progress monitor (when on verbose)
-    if (carrier_img->verbose)
+    if (carrier_img->verbose && !png_deflate)
     {
         png_set_write_status_fn(png_obj_out, &__png_write_callback);
     }
@@ -1859,86 +5646,86 @@ int imc_png_carrier_save(CarrierImage *carrier_img, const char *save_path)
     // Write the copied data to the output image
     png_write_info(png_obj_out, png_info_out);
 
-    // Write the color values to the output image
-    png_write_image(png_obj_out, row_pointers);
-
-    // Finish saving the output image
-    png_write_end(png_obj_out, png_info_out);
+    if (png_deflate)
+    {
+        // Write the compressed color values to the output image (one IDAT chunk for each band of rows),
+        // then finish saving the output image
+        /* Note: 'png_write_end()' can only be used after libpng has written the color values itself,
+           but all the chunks copied from the input were already written by 'png_write_info()'. */
+        for (size_t i = 0; i < png_deflate->band_count; i++)
+        {
+            png_write_chunk(png_obj_out, (png_const_bytep)"IDAT", png_deflate->band[i].data, png_deflate->band[i].size);
+        }
+        
+        png_write_chunk(png_obj_out, (png_const_bytep)"IEND", NULL, 0);
+        __png_deflate_free(png_deflate);
+    }
+    else
+    {
+        // Write the color values to the output image
+        png_set_compression_level(png_obj_out, settings->png_level);
+        png_set_compression_strategy(png_obj_out, settings->png_strategy);
+        png_set_filter(png_obj_out, PNG_FILTER_TYPE_BASE, settings->png_filters);
+        png_write_image(png_obj_out, row_pointers);
+
+        // Finish saving the output image
+        png_write_end(png_obj_out, png_info_out);
+    }
+    
     png_destroy_write_struct(&png_obj_out, &png_info_out);
-    fclose(png_file);
-    if (carrier_img->verbose) printf("Writing PNG image... Done!  \n");
-
-    // Copy the "last access" and "last mofified" times from the original image
-    __copy_file_times(carrier_img->file, png_path);
+    
+    const int close_status = __close_saved_image(carrier_img, png_file);
+    if (close_status == IMC_SUCCESS) imc_progress(&carrier_img->progress, "Writing PNG image... Done!  \n");
+    else imc_progress(&carrier_img->progress, "\n");
 
-    return IMC_SUCCESS;
+    return close_status;
 }
 
 // Progress monitor when writing a PNG image
 static int __webp_write_callback(int percent, const WebPPicture* webp_obj)
 {
     // Note: libwebp has its own timer for controling the progress update frequency,
-    //       so we are not using ours from 'printf_prog()'.
-    printf("Writing WebP image... %d %%\r", percent);
+    //       so we are not using ours from 'imc_progress_rate()'.
+    imc_progress((const ProgressMonitor *)webp_obj->user_data, "Writing WebP image... %d %%\r", percent);
     return true;    // Returning 'true' allows the encoding to continue, 'false' would cancel it
 }
 
 // Write the carrier bytes back to the WebP image, and save it as a new file
 int imc_webp_carrier_save(CarrierImage *carrier_img, const char *save_path)
 {
-    // Append the '.webp' extension to the path, if it does not already has the extension
-    const size_t p_len = strlen(save_path);
-    if (p_len > UINT16_MAX) return IMC_ERR_SAVE_FAIL;
-    char webp_path[p_len+16];
-    strncpy(webp_path, save_path, sizeof(webp_path));
-    
-    if ( p_len < 5 || strncmp(&save_path[p_len-5], ".webp", 5) != 0 )
-    {
-        strcat(webp_path, ".webp");
-    }
-
-    // Append a number to the file's stem if the filename already exists
-    // Example: 'Image.webp' might become 'Image (1).webp'
-    // Note: The number goes up to 99, in order to avoid creating too many files accidentally
-    bool is_unique = __resolve_filename_collision(webp_path);
-    if (!is_unique) return IMC_ERR_FILE_EXISTS;
-
-    // Store a copy of the resulting path
-    free(carrier_img->out_path);
-    carrier_img->out_path = strdup(webp_path);
-    
-    // Open the output file for writing
-    FILE *webp_file = fopen(webp_path, "wb");
-    if (!webp_file) return IMC_ERR_FILE_NOT_FOUND;
+    // Open the output file
+    // (the '.webp' extension is appended to the path, if it does not already has the extension)
+    int open_status = IMC_SUCCESS;
+    FILE *webp_file = __open_saved_image(carrier_img, save_path, ".webp", NULL, &open_status);
+    if (!webp_file) return open_status;
     
     // Decoded original image
     const WebPDecoderConfig *restrict webp_obj_in = carrier_img->object;
 
     // Encoded original image
-    const uint8_t *restrict in_buffer = carrier_img->bytes;
-    const size_t in_buffer_size = *(size_t*)carrier_img->heap[0];
+    const uint8_t *restrict in_buffer = carrier_img->mapping;
+    const size_t in_buffer_size = carrier_img->mapping_size;
 
     // Configurations of the encoder for the output image
     WebPConfig enc_config;
     int enc_status = 0;
-    enc_status = WebPConfigPreset(&enc_config, WEBP_PRESET_DEFAULT, 75.0);
+    const SaveSettings *const settings = &imc_save_settings[carrier_img->profile];
+    enc_status = WebPConfigPreset(&enc_config, WEBP_PRESET_DEFAULT, settings->webp_effort);
     
+    // This fails if the program is using a different version of libwebp than the one used to build it
     if (!enc_status)
     {
-        fclose(webp_file);
-        const int version = WebPGetEncoderVersion();
-        fprintf(stderr,
-            "Error: Using a different version of libwebp than the one used to build this program (%d.%d.%d).\n",
-            (version >> 16) & 0xFF, (version >> 8) & 0xFF, (version >> 0) & 0xFF);
-        exit(EXIT_FAILURE);
+        __abort_saved_image(carrier_img, webp_file);
+        return IMC_ERR_WRITE_FAIL;
     }
     
     enc_config.exact = 1;           // Do not make any changes to the color values
     enc_config.thread_level = 1;    // Use multithreading
     enc_config.lossless = 1;        // Use lossless compression
-    enc_config.method = 3;          // Size/speed tradeoff (0 = bigger but faster; 6 = smaller but slower)
+    enc_config.method = settings->webp_method;  // Size/speed tradeoff (0 = bigger but faster; 6 = smaller but slower)
     /* Note: I haven't noticed a considerable file size change when using method > 3,
-    but the processing time increased considerably. The same goes for quality > 75. */
+    but the processing time increased considerably. The same goes for quality > 75.
+    So those are the values of the balanced profile, and only the small profile goes beyond them. */
 
     // Newly created WebP image with the hidden data
     WebPPicture webp_obj_new;
@@ -1948,6 +5735,7 @@ int imc_webp_carrier_save(CarrierImage *carrier_img, const char *save_path)
     webp_obj_new.use_argb = 1;
     webp_obj_new.argb = (uint32_t*)(webp_obj_in->output.u.RGBA.rgba);
     webp_obj_new.argb_stride = webp_obj_in->output.u.RGBA.stride / 4;
+    webp_obj_new.user_data = &carrier_img->progress;
     if (carrier_img->verbose) webp_obj_new.progress_hook = &__webp_write_callback;
 
     // Object for writing the new WebP image
@@ -1961,9 +5749,11 @@ int imc_webp_carrier_save(CarrierImage *carrier_img, const char *save_path)
 
     if (!enc_status)
     {
-        fclose(webp_file);
-        fprintf(stderr, "Error: Could not encode the new WebP image.\n");
-        exit(EXIT_FAILURE);
+        WebPMemoryWriterClear(&writer);
+        WebPPictureFree(&webp_obj_new);
+        __abort_saved_image(carrier_img, webp_file);
+        imc_progress(&carrier_img->progress, "\n");
+        return IMC_ERR_WRITE_FAIL;
     }
 
     /* Copying the metadata from the original image */
@@ -1981,7 +5771,7 @@ int imc_webp_carrier_save(CarrierImage *carrier_img, const char *save_path)
     // The raw bytes of the new image with the copied chunks
     WebPData out_data = {NULL};
 
-    if (in_mux && out_mux);
+    if (in_mux && out_mux)
     {
         // Chunks to be copied from the original image
         const char *chunk_list[] = {
@@ -2015,29 +5805,322 @@ int imc_webp_carrier_save(CarrierImage *carrier_img, const char *save_path)
     /* End of the metadata copying */
 
     // Save the new image
-    if (copy_success)
+    // (if failed to copy the metadata, just save the image without it)
+    const uint8_t *const out_bytes = copy_success ? out_data.bytes : writer.mem;
+    const size_t out_size = copy_success ? out_data.size : writer.size;
+    int save_status = IMC_SUCCESS;
+    
+    if (fwrite(out_bytes, 1, out_size, webp_file) == out_size)
     {
-        // Save the image with the copied metadata
-        fwrite(out_data.bytes, 1, out_data.size, webp_file);
+        save_status = __close_saved_image(carrier_img, webp_file);
     }
     else
     {
-        // If failed to copy the metadata, just save the image without it
-        fwrite(writer.mem, 1, writer.size, webp_file);
+        __abort_saved_image(carrier_img, webp_file);
+        save_status = IMC_ERR_WRITE_FAIL;
     }
     
-    if (carrier_img->verbose) printf("Writing WebP image... Done!  \n");
-    fclose(webp_file);
-
-    // Copy the "last access" and "last mofified" times from the original image
-    __copy_file_times(carrier_img->file, webp_path);
+    if (save_status == IMC_SUCCESS) imc_progress(&carrier_img->progress, "Writing WebP image... Done!  \n");
+    else imc_progress(&carrier_img->progress, "\n");
 
     // Garbage collection
     WebPDataClear(&out_data);
     WebPMemoryWriterClear(&writer);
     WebPPictureFree(&webp_obj_new);
 
-    return IMC_SUCCESS;
+    return save_status;
+}
+
+// Task of the worker threads: encode one frame of an animated WebP image (lossless, keeping the exact color values)
+static void __webp_frame_encode_task(void *context, size_t task, size_t worker)
+{
+    AnimatedWebP *const anim = (AnimatedWebP *)context;
+    AnimatedFrame *const frame = &anim->frame[task];
+    const WebPDecBuffer *const output = &frame->decoder.output;
+
+    // Each frame is encoded by itself, into its own memory buffer
+    WebPMemoryWriterInit(&frame->writer);
+
+    WebPPicture picture;
+    frame->status = WebPPictureInit(&picture) ? IMC_SUCCESS : IMC_ERR_WRITE_FAIL;
+    if (frame->status == IMC_SUCCESS)
+    {
+        picture.width  = output->width;
+        picture.height = output->height;
+        picture.use_argb = 1;
+        picture.argb = (uint32_t*)(output->u.RGBA.rgba);
+        picture.argb_stride = output->u.RGBA.stride / 4;
+        picture.writer = WebPMemoryWrite;
+        picture.custom_ptr = &frame->writer;
+
+        if (!WebPEncode(&anim->config, &picture)) frame->status = IMC_ERR_WRITE_FAIL;
+        WebPPictureFree(&picture);
+    }
+
+    const size_t done = atomic_fetch_add(&anim->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(anim->progress, "Writing WebP animation... %.1f %%\r", ((double)done / (double)anim->frame_count) * 100.0);
+}
+
+// Write the carrier bytes back to the animated WebP image, and save it as a new file
+// The frames are encoded in parallel, then assembled with the same timing, animation parameters and metadata as the original.
+int imc_webp_anim_carrier_save(CarrierImage *carrier_img, const char *save_path)
+{
+    // Open the output file
+    // (the '.webp' extension is appended to the path, if it does not already has the extension)
+    int open_status = IMC_SUCCESS;
+    FILE *webp_file = __open_saved_image(carrier_img, save_path, ".webp", NULL, &open_status);
+    if (!webp_file) return open_status;
+
+    AnimatedWebP *const anim = carrier_img->object;
+
+    // Same configurations of the encoder as on the still images, except that each frame is encoded on a single thread
+    // (since the frames themselves are encoded in parallel)
+    const SaveSettings *const settings = &imc_save_settings[carrier_img->profile];
+    if (!WebPConfigPreset(&anim->config, WEBP_PRESET_DEFAULT, settings->webp_effort))
+    {
+        __abort_saved_image(carrier_img, webp_file);
+        return IMC_ERR_WRITE_FAIL;
+    }
+    
+    anim->config.exact = 1;
+    anim->config.thread_level = 0;
+    anim->config.lossless = 1;
+    anim->config.method = settings->webp_method;
+
+    // Encode the frames
+    atomic_store(&anim->done, 0);
+    anim->progress = &carrier_img->progress;
+    imc_progress(&carrier_img->progress, "Writing WebP animation... ");
+    imc_parallel_for(anim->frame_count, 0, &__webp_frame_encode_task, anim);
+
+    int save_status = IMC_SUCCESS;
+    for (size_t i = 0; i < anim->frame_count && save_status == IMC_SUCCESS; i++)
+    {
+        save_status = anim->frame[i].status;
+    }
+
+    // Container of the new image
+    WebPMux *out_mux = (save_status == IMC_SUCCESS) ? WebPMuxNew() : NULL;
+    WebPData out_data = {NULL};
+    if (save_status == IMC_SUCCESS && !out_mux) save_status = IMC_ERR_NO_MEMORY;
+
+    if (save_status == IMC_SUCCESS)
+    {
+        const WebPMuxAnimParams params = {anim->bgcolor, (int)anim->loop_count};
+        WebPMuxError mux_status = WebPMuxSetCanvasSize(out_mux, (int)anim->canvas_width, (int)anim->canvas_height);
+        if (mux_status == WEBP_MUX_OK) mux_status = WebPMuxSetAnimationParams(out_mux, &params);
+
+        // Add the frames in their original order
+        // (their data is not copied, because the writers outlive the container)
+        for (size_t i = 0; i < anim->frame_count && mux_status == WEBP_MUX_OK; i++)
+        {
+            const AnimatedFrame *const frame = &anim->frame[i];
+            const WebPMuxFrameInfo info = {
+                .bitstream = {frame->writer.mem, frame->writer.size},
+                .x_offset = frame->x_offset,
+                .y_offset = frame->y_offset,
+                .duration = frame->duration,
+                .id = WEBP_CHUNK_ANMF,
+                .dispose_method = frame->dispose,
+                .blend_method = frame->blend,
+            };
+            mux_status = WebPMuxPushFrame(out_mux, &info, 0);
+        }
+
+        // Copy the metadata chunks from the original image (if any)
+        const WebPData in_data = {carrier_img->mapping, carrier_img->mapping_size};
+        WebPMux *in_mux = (mux_status == WEBP_MUX_OK) ? WebPMuxCreate(&in_data, 0) : NULL;
+        if (in_mux)
+        {
+            const char *chunk_list[] = {"EXIF", "ICCP", "XMP "};
+            const size_t chunk_list_len = sizeof(chunk_list) / sizeof(char *);
+            
+            for (size_t i = 0; i < chunk_list_len; i++)
+            {
+                WebPData chunk = {NULL};
+                if (WebPMuxGetChunk(in_mux, chunk_list[i], &chunk) == WEBP_MUX_OK)
+                {
+                    WebPMuxSetChunk(out_mux, chunk_list[i], &chunk, 1);
+                }
+            }
+            
+            WebPMuxDelete(in_mux);
+        }
+
+        // Assemble the raw bytes of the new image
+        if (mux_status == WEBP_MUX_OK) mux_status = WebPMuxAssemble(out_mux, &out_data);
+        if (mux_status != WEBP_MUX_OK) save_status = (mux_status == WEBP_MUX_MEMORY_ERROR) ? IMC_ERR_NO_MEMORY : IMC_ERR_WRITE_FAIL;
+    }
+
+    // Save the new image
+    if (save_status == IMC_SUCCESS && fwrite(out_data.bytes, 1, out_data.size, webp_file) == out_data.size)
+    {
+        save_status = __close_saved_image(carrier_img, webp_file);
+    }
+    else
+    {
+        __abort_saved_image(carrier_img, webp_file);
+        if (save_status == IMC_SUCCESS) save_status = IMC_ERR_WRITE_FAIL;
+    }
+    
+    if (save_status == IMC_SUCCESS) imc_progress(&carrier_img->progress, "Writing WebP animation... Done!  \n");
+    else imc_progress(&carrier_img->progress, "\n");
+
+    // Garbage collection
+    WebPMuxDelete(out_mux);
+    WebPDataClear(&out_data);
+    for (size_t i = 0; i < anim->frame_count; i++)
+    {
+        WebPMemoryWriterClear(&anim->frame[i].writer);
+    }
+
+    return save_status;
+}
+
+// Write the carrier bytes back to the coefficients of the lossy WebP image, and save it as a new file
+// Only the "VP8 " chunk is replaced, by one with the token partitions encoded again. The other chunks
+// (such as the transparency and the metadata) are copied from the original file.
+int imc_webp_lossy_carrier_save(CarrierImage *carrier_img, const char *save_path)
+{
+    // Open the output file
+    // (the '.webp' extension is appended to the path, if it does not already has the extension)
+    int open_status = IMC_SUCCESS;
+    FILE *webp_file = __open_saved_image(carrier_img, save_path, ".webp", NULL, &open_status);
+    if (!webp_file) return open_status;
+
+    Vp8Image *const vp8 = carrier_img->object;
+    size_t b_pos = 0;   // Current position on the carrier bytes
+
+    imc_progress(&carrier_img->progress, "Writing carrier back to the cover image... ");
+
+    // Same order of the coefficients as on 'imc_webp_lossy_carrier_open()'
+    const size_t mb_count = vp8->mb_width * vp8->mb_height;
+    for (size_t mb = 0; mb < mb_count; mb++)
+    {
+        for (size_t b = 0; b < IMC_VP8_Y2_BLOCK; b++)
+        {
+            int16_t *const coef = &vp8->coef[(mb * IMC_VP8_BLOCKS + b) * 16];
+            
+            for (size_t i = 1; i < 16; i++)
+            {
+                if (IMC_VP8_IS_CARRIER(coef[i]))
+                {
+                    // Store the carrier byte on the magnitude, keeping the sign
+                    int16_t magnitude = (int16_t)abs(coef[i]);
+                    magnitude &= ~(int16_t)1;
+                    magnitude |= carrier_img->bytes[b_pos++] & lsb_get;
+                    coef[i] = (coef[i] < 0) ? -magnitude : magnitude;
+                }
+            }
+        }
+    }
+
+    imc_progress(&carrier_img->progress, "Done!  \n");
+    imc_progress(&carrier_img->progress, "Writing WebP image... ");
+
+    // Encode the token partitions again
+    uint8_t *chunk = NULL;
+    size_t chunk_size = 0;
+    int save_status = imc_vp8_write(vp8, &chunk, &chunk_size);
+
+    if (save_status == IMC_SUCCESS)
+    {
+        const uint8_t *const in_file = carrier_img->mapping;
+        const size_t in_size = carrier_img->mapping_size;
+        
+        // Position of the chunks after the "VP8 " chunk (whose contents are padded to an even size)
+        // Note: when the chunk is the last of the file, some encoders leave out its padding byte,
+        //       so the end is clamped to the file size (the new chunk is still written with its padding).
+        const size_t chunk_end = vp8->chunk_offset + 8 + vp8->chunk_size + (vp8->chunk_size & 1);
+        const size_t old_end = (chunk_end < in_size) ? chunk_end : in_size;
+        const uint8_t padding = 0;
+
+        // The RIFF header has the size of the file (minus 8 bytes)
+        const size_t new_riff_size = (size_t)__read_uint(&in_file[4], 4, false) - (old_end - vp8->chunk_offset) + (8 + chunk_size + (chunk_size & 1));
+        const uint32_t riff_size = htole32((uint32_t)new_riff_size);
+        const uint32_t chunk_size_le = htole32((uint32_t)chunk_size);
+
+        const bool written = (new_riff_size <= UINT32_MAX)
+            && fwrite("RIFF", 1, 4, webp_file) == 4
+            && fwrite(&riff_size, 1, 4, webp_file) == 4
+            && fwrite(&in_file[8], 1, vp8->chunk_offset - 8, webp_file) == vp8->chunk_offset - 8
+            && fwrite("VP8 ", 1, 4, webp_file) == 4
+            && fwrite(&chunk_size_le, 1, 4, webp_file) == 4
+            && fwrite(chunk, 1, chunk_size, webp_file) == chunk_size
+            && fwrite(&padding, 1, chunk_size & 1, webp_file) == (chunk_size & 1)
+            && fwrite(&in_file[old_end], 1, in_size - old_end, webp_file) == in_size - old_end;
+        
+        if (!written) save_status = IMC_ERR_WRITE_FAIL;
+    }
+
+    imc_free(chunk);
+
+    if (save_status == IMC_SUCCESS)
+    {
+        save_status = __close_saved_image(carrier_img, webp_file);
+    }
+    else
+    {
+        __abort_saved_image(carrier_img, webp_file);
+    }
+
+    imc_progress(&carrier_img->progress, (save_status == IMC_SUCCESS) ? "Done!  \n" : "\n");
+
+    return save_status;
+}
+
+// Save an uncompressed image (BMP, PNM or TIFF) with the hidden data as a new file
+// The carrier bytes were changed directly on the file's memory mapping, so the mapping is written as it is.
+int imc_raw_carrier_save(CarrierImage *carrier_img, const char *save_path)
+{
+    // Extension and name of the format
+    const char *extension;
+    const char *alt_extension;
+    const char *format_name;
+    
+    switch (carrier_img->type)
+    {
+        case IMC_BMP:
+            extension = ".bmp";
+            alt_extension = NULL;
+            format_name = "BMP";
+            break;
+        
+        case IMC_PNM:
+            // 'P6' is a color image (PPM), and 'P5' is a grayscale image (PGM)
+            extension = (carrier_img->mapping[1] == '6') ? ".ppm" : ".pgm";
+            alt_extension = ".pnm";
+            format_name = (carrier_img->mapping[1] == '6') ? "PPM" : "PGM";
+            break;
+        
+        case IMC_TIFF:
+        default:
+            extension = ".tiff";
+            alt_extension = ".tif";
+            format_name = "TIFF";
+            break;
+    }
+
+    // Open the output file
+    // (the extension is appended to the path, if it does not already has the extension)
+    int open_status = IMC_SUCCESS;
+    FILE *out_file = __open_saved_image(carrier_img, save_path, extension, alt_extension, &open_status);
+    if (!out_file) return open_status;
+
+    imc_progress(&carrier_img->progress, "Writing %s image... ", format_name);
+
+    /* Note:
+        The shuffling spreads the hidden data over the whole image, so nearly all pages of the mapping
+        have been changed (unless the hidden data is very small). That is why the whole mapping is written,
+        instead of copying the original file and then writing only the changed pages.
+    */
+    const size_t written = fwrite(carrier_img->mapping, 1, carrier_img->mapping_size, out_file);
+    const int save_status = (written == carrier_img->mapping_size) ? __close_saved_image(carrier_img, out_file) : IMC_ERR_WRITE_FAIL;
+    if (written != carrier_img->mapping_size) __abort_saved_image(carrier_img, out_file);
+    
+    imc_progress(&carrier_img->progress, (save_status == IMC_SUCCESS) ? "Done!  \n" : "\n");
+
+    return save_status;
 }
 
 // Free the memory of the array of heap pointers in a CarrierImage struct
@@ -2066,6 +6149,7 @@ void imc_png_carrier_close(CarrierImage *carrier_img)
     PngState *const png = (PngState *)carrier_img->object;
     png_destroy_read_struct(&png->object, &png->info, NULL);
     imc_free(png->row_pointers);
+    imc_free(png->row_filters);
     imc_free(carrier_img->carrier);
     __carrier_heap_free(carrier_img);
     free(png);
@@ -2076,54 +6160,173 @@ void imc_webp_carrier_close(CarrierImage *carrier_img)
 {
     WebPDecoderConfig *restrict webp_obj = carrier_img->object;
     WebPFreeDecBuffer(&webp_obj->output);
-    imc_free(carrier_img->bytes);
     imc_free(carrier_img->carrier);
     imc_free(carrier_img->object);
     __carrier_heap_free(carrier_img);
 }
 
+// Free the decoded frames of an animated WebP image
+void imc_webp_anim_carrier_close(CarrierImage *carrier_img)
+{
+    AnimatedWebP *const anim = carrier_img->object;
+    for (size_t i = 0; i < anim->frame_count; i++)
+    {
+        WebPFreeDecBuffer(&anim->frame[i].decoder.output);
+    }
+    imc_free(anim->frame);
+    imc_free(carrier_img->carrier);
+    imc_free(carrier_img->object);
+    __carrier_heap_free(carrier_img);
+}
+
+// Free the coefficients of a lossy WebP image
+void imc_webp_lossy_carrier_close(CarrierImage *carrier_img)
+{
+    imc_vp8_free((Vp8Image *)carrier_img->object);
+    imc_free(carrier_img->bytes);
+    imc_free(carrier_img->carrier);
+    __carrier_heap_free(carrier_img);
+}
+
+// Free the memory used for the carrier of an uncompressed image (BMP, PNM or TIFF)
+// (the carrier bytes are on the file's memory mapping, which is released by 'imc_steg_finish()')
+void imc_raw_carrier_close(CarrierImage *carrier_img)
+{
+    imc_free(carrier_img->carrier);
+    __carrier_heap_free(carrier_img);
+}
+
 // Save the image with hidden data
 int imc_steg_save(CarrierImage *carrier_img, const char *save_path)
 {
+    if (!save_path) return IMC_ERR_SAVE_FAIL;
     return carrier_img->save(carrier_img, save_path);
 }
 
+// Encode the image with hidden data into a new buffer, instead of a file
+// On success, 'out_data' receives the buffer (which should be freed with 'imc_free()') and 'out_size' its size in bytes.
+int imc_steg_save_memory(CarrierImage *carrier_img, uint8_t **out_data, size_t *out_size)
+{
+    // A NULL path makes the image to be written to the 'saved_data' buffer
+    const int status = carrier_img->save(carrier_img, NULL);
+    carrier_img->to_memory = false;
+    if (status != IMC_SUCCESS) return status;
+
+    *out_data = (uint8_t *)carrier_img->saved_data;
+    *out_size = carrier_img->saved_size;
+    carrier_img->saved_data = NULL;
+    carrier_img->saved_size = 0;
+
+    return IMC_SUCCESS;
+}
+
 // Free the memory of the data structures used for steganography
 void imc_steg_finish(CarrierImage *carrier_img)
 {
     // Close the open files
     carrier_img->close(carrier_img);
-    fclose(carrier_img->file);
+    imc_unmap_file(carrier_img->cache_mapping, carrier_img->cache_mapping_size);
+    __release_input(carrier_img->file, carrier_img->mapping, carrier_img->mapping_size);
 
     // Free the memory used by the steganographic operations
     imc_crypto_context_destroy(carrier_img->crypto);
     imc_free(carrier_img->out_path);
     imc_free(carrier_img->steg_info);
+    imc_free(carrier_img->saved_data);
     imc_free(carrier_img);
 }
 
-// Print text at most once each 1/6 second
-// Note: function intended for the progress monitor, it uses the same format as 'printf()'.
-void printf_prog(const char *format, ...)
+// Send a progress message to a monitor (the message has the same format as 'printf()')
+// Nothing is done if 'monitor' or its function are NULL.
+void imc_progress(const ProgressMonitor *monitor, const char *format, ...)
+{
+    if (!monitor || !monitor->function) return;
+    
+    va_list arguments;
+    va_start(arguments, format);
+    __progress_send(monitor, format, arguments);
+    va_end(arguments);
+}
+
+// Send a progress message to a monitor at most once each 1/6 second (on each thread)
+// Note: function intended for the progress percentages, it uses the same format as 'printf()'.
+void imc_progress_rate(const ProgressMonitor *monitor, const char *format, ...)
 {
-    static const clock_t wait_millis = 166;   // Amount of milliseconds to wait before printing again
-    static _Thread_local clock_t last_time = -wait_millis;  // Timestamp (in milliseconds) when printed for the last time
+    if (!monitor || !monitor->function) return;
+    
+    static const clock_t wait_millis = 166;   // Amount of milliseconds to wait before sending again
+    static _Thread_local clock_t last_time = -wait_millis;  // Timestamp (in milliseconds) when sent for the last time
     
     // Get the current timestamp (in milliseconds)
     clock_t now = (clock() * 1000) / CLOCKS_PER_SEC;
     
-    // Print the formatted text if at least 166 milliseconds have passed
+    // Send the formatted text if at least 166 milliseconds have passed
     if (now - last_time >= wait_millis)
     {
         va_list arguments;
         va_start(arguments, format);
-        vprintf(format, arguments);
-        fflush(stdout);
+        __progress_send(monitor, format, arguments);
         va_end(arguments);
         last_time = now;
     }
 }
 
+// Format a progress message, then send it to the monitor
+static void __progress_send(const ProgressMonitor *monitor, const char *format, va_list arguments)
+{
+    // Get the size of the formatted message
+    va_list arguments_copy;
+    va_copy(arguments_copy, arguments);
+    const int length = vsnprintf(NULL, 0, format, arguments_copy);
+    va_end(arguments_copy);
+    if (length < 0) return;
+
+    char message[length + 1];
+    vsnprintf(message, sizeof(message), format, arguments);
+    monitor->function(monitor->context, message);
+}
+
+// Short description of a status code
+const char *imc_strerror(int status)
+{
+    switch (status)
+    {
+        case IMC_SUCCESS:               return "Operation completed successfully";
+        case IMC_ERR_NO_MEMORY:         return "No enough memory";
+        case IMC_ERR_INVALID_PASS:      return "Password is not valid";
+        case IMC_ERR_FILE_NOT_FOUND:    return "File does not exist or could not be opened";
+        case IMC_ERR_FILE_INVALID:      return "File is not of a supported format";
+        case IMC_ERR_FILE_TOO_BIG:      return "The file to be hidden does not fit in the carrier bits of the image";
+        case IMC_ERR_CRYPTO_FAIL:       return "Failed to encrypt or decrypt the data";
+        case IMC_ERR_FILE_EXISTS:       return "Output file's name already exists";
+        case IMC_ERR_PAYLOAD_OOB:       return "Attempted to read more hidden data than what is left of the image";
+        case IMC_ERR_INVALID_MAGIC:     return "No hidden data was found";
+        case IMC_ERR_NEWER_VERSION:     return "Data was hidden using a newer version of this program";
+        case IMC_ERR_SAVE_FAIL:         return "Failed to save the file";
+        case IMC_ERR_NAME_TOO_LONG:     return "The file name has more characters than the maximum allowed";
+        case IMC_ERR_FILE_CORRUPTED:    return "The file read has a different size than expected";
+        case IMC_ERR_PATH_IS_DIR:       return "The path is of a directory rather than a file";
+        case IMC_ERR_UNSUPPORTED:       return "The image uses a feature that is not supported";
+        case IMC_ERR_NO_CARRIER:        return "The image has no bits suitable for hiding data";
+        case IMC_ERR_WRITE_FAIL:        return "Failed to encode or to write the image";
+        case IMC_ERR_INPUT_TOO_BIG:     return "The file to be hidden is bigger than the maximum size allowed";
+        case IMC_ERR_SHARD_MISSING:     return "The images do not have enough distinct shards of the same file";
+        default:                        return "Unknown error";
+    }
+}
+
+// Name of a save profile (as given to the '--profile' option)
+const char *imc_profile_name(enum SaveProfile profile)
+{
+    switch (profile)
+    {
+        case IMC_PROFILE_BALANCED:  return "balanced";
+        case IMC_PROFILE_FAST:      return "fast";
+        case IMC_PROFILE_SMALL:     return "small";
+        default:                    return "unknown";
+    }
+}
+
 /* Windows compatibility functions */
 #ifdef _WIN32
 
@@ -1,5 +1,5 @@
 /* Functions for reading or writing hidden data into a cover image.
- * Supported cover image's formats: JPEG and PNG.
+ * Supported cover image's formats: JPEG, PNG, WebP, BMP, PNM (PGM and PPM) and TIFF.
  */
 
 #ifndef _IMC_IMAGE_IO_H
@@ -34,18 +34,86 @@
     - (variable): the file itself
 */
 
-// Flags for the 'imc_steg_init()' function
-#define IMC_VERBOSE     (uint64_t)1 // Prints the progress of each step
-#define IMC_JUST_CHECK  (uint64_t)2 // Checks for the hidden file's info without saving the file
+/*  Binary format of a shard (one of the pieces of a file that was split over many images, see 'imc_shard.h')
+    The shard is hidden at the beginning of the carrier, instead of the payload above:
+    - 4 bytes: ASCII characters "imch"
+    - 4 bytes: version number of the shard format
+    - 4 bytes: size in bytes of the rest of the shard (everything after this point)
+    - 16 bytes: random identifier of the set of shards (the same on all shards of a file)
+    - 4 bytes: position of the shard on the set (starting from zero, the parity shards come after the data shards)
+    - 4 bytes: amount of data shards on the set
+    - 4 bytes: amount of parity shards on the set (zero if the set has no parity)
+    - 8 bytes: size in bytes of the decrypted stream
+    - 24 bytes: header used for the decryption (the same on all shards of a file)
+    - (variable): encrypted part of the stream (on a data shard), or parity bytes (on a parity shard)
+
+    The decrypted stream (as described above, with the compressed file) is split into consecutive parts, and each part
+    is encrypted as a message of the same stream: the message of the last data shard is tagged as FINAL, and each message
+    is authenticated along with the 36 bytes from the set's identifier to the size of the stream (as additional data).
+    So the shards can only be decrypted in order, and a missing, repeated or modified shard is detected.
+
+    When the set has parity shards, every part has the same size (except at the end of the stream, where they can be
+    smaller or empty). The encrypted parts, padded with zeros to the size of a full part, are the data shards of a
+    Reed-Solomon code (see 'imc_erasure.h'), whose parity shards are stored without encryption (they are combinations
+    of already encrypted bytes). Any of the images but as many as the parity shards can rebuild the file.
+*/
+
+/*  Binary format of the files on the cover cache (see the 'cache_dir' field of the 'StegOptions' struct)
+    (Note: the numeric values are stored in the byte order of the machine that wrote the file, because
+     the file is mapped to memory and used as it is; a file written on another byte order is just ignored)
+
+    Each file is named after the BLAKE2b hash of the cover image's file, in hexadecimal, with the ".imcc" extension:
+    - 4 bytes: ASCII characters "imcc"
+    - 4 bytes: the value 0x01020304 (used to verify the byte order of the file)
+    - 4 bytes: version number of the cache file
+    - 4 bytes: format of the cover image (same values as the 'ImageType' enum)
+    - 4 bytes: width of the image, in pixels
+    - 4 bytes: height of the image, in pixels
+    - 8 bytes: size in bytes of a row of pixels (the rows have no padding between them)
+    - 8 bytes: size in bytes of the decoded pixels (the height times the size of a row)
+    - 8 bytes: amount of carrier bytes
+    - 32 bytes: BLAKE2b hash of the cover image's file (the same as on the file's name)
+    - (padding up to the byte 128 of the file)
+    - (variable): the decoded pixels, as they were given by the image's decoder
+    - (padding up to a multiple of 64 bytes)
+    - (variable): position of each carrier byte on the decoded pixels (4 bytes each, in the same order as on the image)
+*/
+
+// Identification and version of the cover cache files
+#define IMC_CACHE_MAGIC "imcc"
+#define IMC_CACHE_BYTE_ORDER 0x01020304
+#define IMC_CACHE_VERSION 1
+
+// Position on the cache file where the decoded pixels begin, and the alignment of the carrier positions after them
+#define IMC_CACHE_DATA_OFFSET 128
+#define IMC_CACHE_ALIGN 64
+
+// Identification and version of the shards
+#define IMC_SHARD_MAGIC "imch"
+#define IMC_SHARD_VERSION 1
+
+// Size in bytes of the random identifier of a set of shards
+#define IMC_SHARD_ID_SIZE 16
+
+// Amount of bytes that a shard takes on the carrier besides its part of the stream
+// (magic, version and size, then the set's identifier, position, amounts and stream size, then the decryption header and the authentication bytes)
+#define IMC_SHARD_OVERHEAD (IMC_SEGMENT_META_SIZE + IMC_SHARD_ID_SIZE + 20 \
+    + crypto_secretstream_xchacha20poly1305_HEADERBYTES + crypto_secretstream_xchacha20poly1305_ABYTES)
+
+// Name given to the data hidden from the standard input
+#define IMC_STDIN_NAME "stdin"
+
+// Size in bytes of a block of a tar archive
+#define IMC_TAR_BLOCK_SIZE 512
 
 // Carrier: Array with the bytes that carry the hidden data
 typedef uint8_t *carrier_bytes_t;
 
-enum ImageType {IMC_JPEG, IMC_PNG, IMC_WEBP};
+enum ImageType {IMC_JPEG, IMC_PNG, IMC_WEBP, IMC_BMP, IMC_PNM, IMC_TIFF};
 
 // Pointers to the steganographic functions
 struct CarrierImage;
-typedef void (*carrier_open_func)(struct CarrierImage *);
+typedef int (*carrier_open_func)(struct CarrierImage *);
 typedef int (*carrier_save_func)(struct CarrierImage *, const char *save_path);
 typedef void (*carrier_close_func)(struct CarrierImage *);
 
@@ -53,10 +121,14 @@ typedef void (*carrier_close_func)(struct CarrierImage *);
 typedef struct CarrierImage
 {
     // File parameters
-    FILE *file;             // File ponter of the image
+    FILE *file;             // File ponter of the image (NULL if the image was read from the standard input)
+    uint8_t *mapping;       // Contents of the image file (mapped copy-on-write to memory, so changes never reach the file)
+    size_t mapping_size;    // Size in bytes of the image file
     void *object;           // Pointer to the handler that should be passed to the image processing functions
     CryptoContext *crypto;  // Secret parameters generated from the password
     enum ImageType type;    // Format of the image
+    size_t width;           // Width of the image, in pixels
+    size_t height;          // Height of the image, in pixels
     char *out_path;         // Path where was saved the image with the hidden data
     struct FileMetadata *steg_info; // The metadata of the most recent extracted file
     
@@ -65,28 +137,59 @@ typedef struct CarrierImage
     carrier_bytes_t *carrier;   // Array of pointers to the carrier bytes of the image (array order is shuffled using the password)
     size_t carrier_lenght;      // Amount of carrier bytes
     size_t carrier_pos;         // Current writting position on the 'carrier' array
-    carrier_open_func open;     // Find the carrier bytes
+    carrier_open_func open;     // Find the carrier bytes (returns a status code)
     carrier_save_func save;     // Hide data in the carrier
     carrier_close_func close;   // Free the memory used for the carrier operation
     
     // Operation flags
-    bool verbose;       // Whether to print the progress of each operation
+    bool verbose;       // Whether to report the progress of each operation
     bool just_check;    // Whether to just check for the info of the hidden file instead of saving the file
+    ProgressMonitor progress;   // Receives the progress messages (its function is NULL when not on verbose mode)
+
+    // Saving the image
+    enum SaveProfile profile;   // Settings of the encoder (see the 'SaveSettings' struct)
+    bool to_memory;         // Whether the image is being saved to a memory buffer instead of to a file
+    char *saved_data;       // Buffer with the saved image
+    size_t saved_size;      // Size in bytes of the saved image
     
     // Memory management
     void **heap;            // Array of pointers to other heap allocated memory for this image
     size_t heap_lenght;     // Amount of elements on the 'heap' array
+
+    // Cache of decoded cover images
+    const char *cache_dir;      // Folder of the cover cache (only set while the image is being opened, NULL when not caching)
+    uint8_t cache_hash[crypto_generichash_BYTES];   // Hash of the cover image's file
+    uint8_t *cache_mapping;     // Cache file of the image, mapped copy-on-write (NULL if the image was decoded instead)
+    size_t cache_mapping_size;  // Size in bytes of the cache file
 } CarrierImage;
 
-// Store the metadata of the hidden file
-typedef struct FileMetadata {
-    struct timespec access_time;    // Last access time of the file
-    struct timespec mod_time;       // Last modified time of the file
-    struct timespec steg_time;      // Time when the file was hidden by this program
-    size_t file_size;               // Size in bytes of the hidden file
-    size_t name_size;               // Size in bytes of the file's name (counting the null terminator)
-    char file_name[];               // Name of the file as a C-style string
-} FileMetadata;
+// Settings of the encoders for a save profile (see 'enum SaveProfile')
+/* Note: JPEG images always get Huffman tables optimized for the image, because the default tables of libjpeg-turbo would
+   be the same on every image saved by this program (see 'imc_jpeg_carrier_save()'). So the profiles do not change them. */
+typedef struct SaveSettings {
+    int png_level;          // Compression level of zlib, for PNG images (1 = bigger but faster; 9 = smaller but slower)
+    int png_strategy;       // Compression strategy of zlib, for PNG images
+    int png_filters;        // Filter types tried on each row of a PNG image, when the ones of the original image are not known (PNG_FILTER_* flags)
+    int webp_method;        // Size/speed tradeoff of the WebP encoder (0 = bigger but faster; 6 = smaller but slower)
+    float webp_effort;      // How much the lossless WebP encoder tries to compress the image (its 'quality' setting, from 0 to 100)
+} SaveSettings;
+
+// Amount of times that each profile saves the image, when using '--benchmark'
+#define IMC_BENCHMARK_ROUNDS 3
+
+// Header of a cover cache file (its layout is described at the beginning of this file)
+typedef struct CoverCacheHeader {
+    char magic[4];          // ASCII characters "imcc"
+    uint32_t byte_order;    // IMC_CACHE_BYTE_ORDER, as stored by the machine that wrote the file
+    uint32_t version;       // IMC_CACHE_VERSION
+    uint32_t type;          // Format of the cover image
+    uint32_t width;         // Width of the image, in pixels
+    uint32_t height;        // Height of the image, in pixels
+    uint64_t stride;        // Size in bytes of a row of pixels
+    uint64_t pixels_size;   // Size in bytes of the decoded pixels
+    uint64_t carrier_count; // Amount of carrier bytes
+    uint8_t hash[crypto_generichash_BYTES]; // Hash of the cover image's file
+} CoverCacheHeader;
 
 // Ensure that the values on our 'timespec struct' will be 64-bit, just to be on the safe side
 struct timespec64
@@ -115,15 +218,263 @@ typedef struct __attribute__ ((__packed__)) FileInfo
     uint8_t file_name[];            // Null-terminated string of the file name (with extension, if any)
 } FileInfo;
 
+// File that was read and compressed, but not yet encrypted and written to a carrier
+struct PreparedFile {
+    char *name;             // Name of the file (without the folders)
+    uint8_t *stream;        // Header of the 'FileInfo' struct, followed by the compressed data
+    size_t stream_size;     // Size in bytes of the stream
+};
+
+// Identification of a shard, as stored on the carrier (also used as the additional data of its encrypted part)
+// The numeric values are stored in little-endian byte order.
+typedef struct __attribute__ ((__packed__)) ShardHeader
+{
+    uint8_t set_id[IMC_SHARD_ID_SIZE];  // Random identifier of the set of shards
+    uint32_t index;                     // Position of the shard on the set
+    uint32_t count;                     // Amount of data shards on the set
+    uint32_t parity;                    // Amount of parity shards on the set
+    uint64_t stream_size;               // Size in bytes of the decrypted stream
+} ShardHeader;
+
+// Location of a data segment (the encrypted stream of a hidden file) on the shuffled carrier
+typedef struct CarrierSegment {
+    size_t start;           // Position on the carrier where the segment begins (that is, its magic bytes)
+    size_t end;             // Position on the carrier right after the end of the segment
+    uint32_t crypto_size;   // Size in bytes of the encrypted stream (counting its header)
+} CarrierSegment;
+
+// All data segments found on the carrier, in the same order as they were hidden
+typedef struct SegmentIndex {
+    CarrierSegment *segment;    // Array of data segments
+    size_t count;               // Amount of elements on the 'segment' array
+    size_t end;                 // Position on the carrier right after the end of the last segment
+    int status;                 // Why no more segments could be found (IMC_ERR_INVALID_MAGIC, IMC_ERR_PAYLOAD_OOB, or IMC_ERR_NEWER_VERSION)
+} SegmentIndex;
+
+// Directory where the extracted files are saved
+#ifdef _WIN32
+typedef const char *imc_dir_t;  // Path to the directory (NULL for the current working directory)
+#else
+typedef int imc_dir_t;          // File descriptor of the directory (AT_FDCWD for the current working directory)
+#endif // _WIN32
+
+// Outcome of the extraction of one hidden file
+typedef struct ExtractResult {
+    int status;             // Status code of the extraction
+    int error_number;       // Value of 'errno' if the file could not be saved
+    FileMetadata *info;     // Metadata of the hidden file (NULL if it could not be decrypted)
+} ExtractResult;
+
+// Shared state of the workers that extract the hidden files in parallel
+typedef struct ExtractJob {
+    const CarrierImage *carrier_img;    // Image with the hidden data
+    const SegmentIndex *index;          // Data segments of the hidden files
+    ExtractResult *results;             // Outcome of each extraction (same order as 'index')
+    const imc_dir_t *dirs;              // Output directory of each worker
+    bool verbose;                       // Whether to print the progress of each step
+    pthread_mutex_t lock;               // Lock for taking the turn to create an output file
+    pthread_cond_t turn;                // Signals that a worker has finished its turn
+    size_t next_turn;                   // Index of the hidden file whose output file can be created now
+    /* Note:
+        The decryption and decompression run fully in parallel, but the output files are created
+        in the same order as the files were hidden. This way, if two hidden files have the same name,
+        they always get renamed the same way as when they are extracted one at a time.
+    */
+} ExtractJob;
+
+// Shared state of the workers that try a list of passwords on the same image
+typedef struct PasswordJob {
+    const CarrierImage *carrier_img;    // Image being checked (its carrier is not shuffled)
+    const PassBuff *const *passwords;   // Candidate passwords
+    atomic_size_t match;                // Index of the first password that worked so far (the amount of passwords if none)
+    pthread_mutex_t lock;               // Lock for storing the carrier and context of a password that worked
+    carrier_bytes_t *carrier;           // Carrier shuffled with the password on 'match'
+    CryptoContext *crypto;              // Cryptographic context generated from the password on 'match'
+} PasswordJob;
+
 // Internal state of the PNG manipulation functions
 typedef struct PngState {
     png_structp object;
     png_infop info;
     png_bytep *row_pointers;
+    uint8_t *row_filters;   // Filter type of each row on the original image (NULL if they are not known)
+    const uint8_t *input;   // Contents of the PNG file
+    size_t input_size;      // Size in bytes of the PNG file
+    size_t input_pos;       // Position of the next byte to be read from the PNG file
+    const ProgressMonitor *progress;    // Receives the progress of reading or writing the image
+    double num_passes;      // How many passes for reading or writing the image
+    double num_rows;        // Image's height
 } PngState;
 
+// Amount of bytes of filtered rows that each worker thread compresses at once, when saving a PNG image
+#define IMC_PNG_BAND_SIZE (1024 * 1024)
+
+// Size of the window of the Deflate algorithm (how far back the compressor looks for repeated bytes)
+#define IMC_PNG_WINDOW_SIZE 32768
+
+// Consecutive rows of a PNG image that are compressed by the same worker thread
+typedef struct PngBand {
+    size_t first_row;       // Index of the first row of the band
+    size_t row_count;       // Amount of rows on the band
+    uint8_t *data;          // Compressed rows (raw Deflate data, ending on a byte boundary)
+    size_t size;            // Size in bytes of 'data'
+    uLong adler;            // Adler-32 checksum of the filtered rows (before compression)
+    int status;             // Result of compressing the band
+} PngBand;
+
+// Compression of the pixels of a PNG image on many threads
+/* Note: the rows are split in bands, and each band is filtered and compressed by itself. All bands but the last end
+   with a flush of the compressor (which aligns them to a byte boundary, without ending the stream), so they can be
+   concatenated into a single zlib stream. In order to compress about as well as a single compressor, each band starts
+   with the last bytes of the previous band as the dictionary (those bytes are filtered again by the thread, since the
+   filters only depend on the unfiltered rows). The checksums of the bands are then combined into the checksum of the stream. */
+typedef struct PngDeflate {
+    png_bytep *row_pointers;    // Unfiltered rows of the image
+    const uint8_t *row_filters; // Filter type of each row (NULL to choose the filter types)
+    const SaveSettings *settings;   // Settings of the compressor, and the filter types that can be chosen
+    size_t stride;              // Size in bytes of each unfiltered row
+    size_t pixel_size;          // Size in bytes of a pixel (the distance between the bytes compared by the filters)
+    PngBand *band;              // Bands of rows, from top to bottom
+    size_t band_count;          // Amount of bands
+    const ProgressMonitor *progress;    // Receives the percentage of bands that were compressed
+    atomic_size_t done;         // Amount of bands that were already compressed
+} PngDeflate;
+
+// Frame of an animated WebP image
+typedef struct AnimatedFrame {
+    WebPData fragment;          // Encoded frame, as stored on the original file (it points to the file's memory mapping)
+    int x_offset;               // Horizontal position of the frame on the canvas, in pixels
+    int y_offset;               // Vertical position of the frame on the canvas, in pixels
+    int duration;               // Time that the frame is displayed, in milliseconds
+    WebPMuxAnimDispose dispose; // Whether the frame's area is cleared to the background color after it is displayed
+    WebPMuxAnimBlend blend;     // Whether the frame is blended with the previous canvas, using its transparency
+    WebPDecoderConfig decoder;  // Decoded frame (its pixels are 32-bit color values)
+    WebPMemoryWriter writer;    // Frame encoded again with the hidden data (when saving the image)
+    int status;                 // Result of decoding or encoding the frame
+} AnimatedFrame;
+
+// Internal state of the animated WebP manipulation functions
+/* Note: the frames are decoded and encoded independently from each other, on their own rectangles of the canvas.
+   So the frames can be processed in parallel, and their offsets, durations, disposal and blending are kept as they are. */
+typedef struct AnimatedWebP {
+    AnimatedFrame *frame;       // Frames of the animation, in the order that they are displayed
+    size_t frame_count;         // Amount of frames
+    uint32_t canvas_width;      // Width of the animation, in pixels
+    uint32_t canvas_height;     // Height of the animation, in pixels
+    uint32_t loop_count;        // How many times the animation is played (0 means forever)
+    uint32_t bgcolor;           // Background color of the canvas
+    WebPConfig config;          // Settings of the encoder (when saving the image)
+    const ProgressMonitor *progress;    // Receives the percentage of frames that were processed
+    atomic_size_t done;         // Amount of frames that were already processed
+} AnimatedWebP;
+
+// Error handler of libjpeg-turbo that returns to the function that was using the library, instead of exiting the program
+typedef struct JpegError {
+    struct jpeg_error_mgr manager;  // Error handler of the library (must be the first member)
+    jmp_buf jump;                   // Where to return on errors
+} JpegError;
+
+// Progress monitor of libjpeg-turbo that also knows where to send the messages
+typedef struct JpegProgress {
+    struct jpeg_progress_mgr manager;   // Progress monitor of the library (must be the first member)
+    const ProgressMonitor *progress;    // Receives the progress messages
+} JpegProgress;
+
 // Initialize an image for hiding data in it
-int imc_steg_init(const char *path, const PassBuff *password, CarrierImage **output, uint64_t flags);
+// The image is read from 'path', or from the buffer on 'options' (see the 'StegOptions' struct). 'options' can be NULL.
+int imc_steg_init(const char *path, const PassBuff *password, CarrierImage **output, const StegOptions *options);
+
+// Initialize an image for hiding data in it, using an existing cryptographic context
+// (the image gets its own copy of the context, so the same context can be used to initialize other images)
+int imc_steg_init_context(const char *path, const CryptoContext *crypto, CarrierImage **output, const StegOptions *options);
+
+// Open an image and find its carrier bytes, without generating a cryptographic context or shuffling the carrier
+// A context can be added later with 'imc_steg_try_passwords()'.
+int imc_steg_open(const char *path, CarrierImage **output, const StegOptions *options);
+
+// Try a list of passwords on an image opened by 'imc_steg_open()'
+// The image is decoded only once: for each password, only the hashing and the reading of the magic bytes of the hidden data
+// are done (on up to 'thread_count' threads, 0 for all processors). The carrier is shuffled, and the first hidden file decrypted,
+// only for the passwords whose magic bytes match. The first hidden file is decompressed later, for the password that is used.
+// The first password on the list whose hidden data could be decrypted is used for the image, and its index is stored on 'match'.
+// Returns IMC_ERR_INVALID_PASS if none of the passwords worked.
+int imc_steg_try_passwords(
+    CarrierImage *carrier_img,
+    const PassBuff *const *passwords,
+    size_t password_count,
+    size_t thread_count,
+    size_t *match
+);
+
+// Task of the workers of 'imc_steg_try_passwords()': check if the hidden data can be decrypted with one of the passwords
+static void __password_task(void *context, size_t task, size_t worker);
+
+// Initialize an image for hiding data to the owner of a X25519 public key (recipient mode)
+// A new ephemeral key pair is generated, and the representative of its public key is written to the carrier.
+int imc_steg_init_recipient(const char *path, const uint8_t *recipient_pk, CarrierImage **output, const StegOptions *options);
+
+// Initialize an image for extracting the data that was hidden to the owner of a X25519 secret key (recipient mode)
+int imc_steg_init_secret_key(const char *path, const uint8_t *secret_key, CarrierImage **output, const StegOptions *options);
+
+// Helper function for the recipient mode: choose the carrier positions of the ephemeral public key,
+// then write its representative ('write_key' is true) or read it ('write_key' is false). Those positions are removed
+// from the carrier afterwards. When writing, the rest of the carrier is also shuffled with the session secrets.
+static int __recipient_carrier(CarrierImage *carrier_img, const uint8_t *recipient_pk, uint8_t *representative, bool write_key);
+
+// Find the format of an image from the signature at the beginning of its file
+// Returns IMC_ERR_FILE_INVALID if the format is not one of the supported ones.
+static int __image_type(const uint8_t *image_data, size_t image_size, enum ImageType *out_type);
+
+// Helper function for initializing an image
+// The cryptographic context is either generated from 'password' or copied from 'crypto' (the other one should be NULL).
+// If both are NULL, the image is opened without a cryptographic context, and its carrier is not shuffled.
+static int __steg_init(
+    const char *path,
+    const PassBuff *password,
+    const CryptoContext *crypto,
+    CarrierImage **output,
+    const StegOptions *options
+);
+
+// Upper bound of the carrier bytes of a PNG image, read from its 'IHDR' chunk (and from a 'tRNS' chunk before the pixels)
+// The bound is exact if the image has no transparency, since only the fully transparent pixels are not used as carriers.
+static int __png_capacity_bound(const uint8_t *data, size_t size, size_t *out_bits, bool *out_exact);
+
+// Upper bound of the carrier bytes of a WebP image, read from its header with 'WebPGetFeatures()'
+// For a lossless image, the bound is exact if the image has no transparency, since only the fully transparent pixels
+// are not used as carriers. For a lossy image, it is the bound of the coefficients that can be carriers.
+static int __webp_capacity_bound(const uint8_t *data, size_t size, size_t *out_bits, bool *out_exact);
+
+// Count the carrier bytes of a JPEG image, by reading its DCT coefficients (without decoding the pixels)
+// This only undoes the entropy coding, and counts the same AC coefficients that 'imc_jpeg_carrier_open()' uses.
+static int __jpeg_capacity_scan(const uint8_t *data, size_t size, size_t *out_bits);
+
+// Count the carrier bytes of a lossy WebP image, by reading the coefficients of its VP8 bitstream (without decoding the pixels)
+// This counts the same coefficients that 'imc_webp_lossy_carrier_open()' uses.
+static int __webp_lossy_capacity_scan(const uint8_t *data, size_t size, size_t *out_bits);
+
+// Map an image file to memory and find its format (the file is closed afterwards)
+// This is a helper for the capacity functions. The mapping should be released with 'imc_unmap_file()'.
+static int __map_image(const char *path, uint8_t **out_data, size_t *out_size, enum ImageType *out_type);
+
+// Upper bound of the carrier bytes of an image, read only from its header (nothing is decoded, and no password is needed)
+// 'out_exact' receives whether the bound is also the exact amount (PNG and WebP images without transparency).
+// Returns IMC_ERR_UNSUPPORTED for the formats whose header does not tell the amount (JPEG, BMP, PNM and TIFF).
+int imc_steg_capacity_bound(const char *path, size_t *out_bits, bool *out_exact);
+
+// Amount of carrier bytes of an image (each one can hold one bit of hidden data), found without a password
+// The cheapest exact method for the image is used, and 'out_source' (which can be NULL) receives which one:
+// the header of PNG and lossless WebP images without transparency, a scan of the coefficients of JPEG and lossy WebP images,
+// or else opening the image (BMP, PNM and TIFF images are not decoded, but transparent PNG and WebP images are).
+int imc_steg_capacity(const char *path, size_t *out_bits, enum CapacitySource *out_source);
+
+// Seconds elapsed since an arbitrary point in time (monotonic clock)
+static double __seconds();
+
+// Save an image with each save profile (to memory, without hiding anything), measuring the time taken and the size of the image
+// The image is opened once, then saved 'rounds' times with each profile. 'out_results' receives IMC_PROFILE_COUNT results,
+// in the same order as 'enum SaveProfile'. 'progress' (can be NULL) receives the profile being measured.
+int imc_steg_benchmark(const char *path, size_t rounds, const ProgressMonitor *progress, ProfileResult *out_results);
 
 // Convenience function for converting the bytes from a timespec struct into
 // the byte layout used by this program: 64-bit little endian (each value)
@@ -137,11 +488,110 @@ static inline struct timespec __timespec_from_64le(struct timespec64 time);
 // Note: function can be called multiple times in order to hide more files in the same image.
 int imc_steg_insert(CarrierImage *carrier_img, const char *file_path);
 
+// Hide in an image a file stored on a memory buffer (the file is hidden with the name 'file_name')
+// The "last access" time of the hidden file is the same as 'mod_time'.
+int imc_steg_insert_memory(
+    CarrierImage *carrier_img,
+    const char *file_name,
+    const uint8_t *data,
+    size_t data_size,
+    struct timespec mod_time
+);
+
+// Read and compress a file, so it can be hidden later (its name is the last component of the path)
+// The size that the file takes on the carrier is known at this point, before any image is opened.
+// 'progress' can be NULL. The prepared file should be freed with 'imc_steg_prepared_free()'.
+int imc_steg_prepare(const char *file_path, const ProgressMonitor *progress, PreparedFile **output);
+
+// Hide a prepared file in an image, at the current position of the carrier
+// The same prepared file can be hidden in any amount of images.
+int imc_steg_insert_prepared(CarrierImage *carrier_img, const PreparedFile *file);
+
+// Amount of carrier bytes that a prepared file takes when hidden (each carrier byte holds one bit)
+size_t imc_steg_prepared_bits(const PreparedFile *file);
+
+// Clear and free a prepared file
+void imc_steg_prepared_free(PreparedFile *file);
+
+// Compress a file whose contents are already on 'raw_buffer', after the space for its 'FileInfo' struct
+// The buffer is cleared and freed by this function (its size is 'sizeof(FileInfo)' plus the sizes of the name and of the file).
+static int __prepare_buffer(
+    const ProgressMonitor *progress,
+    const char *file_name,
+    uint8_t *raw_buffer,
+    size_t file_size,
+    struct timespec access_time,
+    struct timespec mod_time,
+    PreparedFile **output
+);
+
+// Encrypt a stream (the header of the 'FileInfo' struct, followed by the compressed data),
+// then write it to the carrier at the current position. The 'file_name' is used for the status messages.
+static int __segment_pack(CarrierImage *carrier_img, const uint8_t *stream, size_t stream_size, const char *file_name);
+
+// Helper function for writing a given amount of bytes (the payload) starting from a given position of the carrier
+// Returns 'false' if the write would go out of bounds (no write is done in this case).
+static bool __write_payload_at(CarrierImage *carrier_img, size_t pos, size_t num_bytes, const uint8_t *data);
+
 // Helper function for reading a given amount of bytes (the payload) from the carrier of an image
 // Returns 'false' if the read would go out of bounds (no read is done in this case).
 // Returns 'true' if the read could be made (the bytes are stored of the provided buffer).
 static bool __read_payload(CarrierImage *carrier_img, size_t num_bytes, uint8_t *out_buffer);
 
+// Helper function for reading a given amount of bytes (the payload) starting from a given position of the carrier
+// Unlike '__read_payload()', the read position of the image is not changed, so this can be used by many threads at once.
+// Returns 'false' if the read would go out of bounds (no read is done in this case).
+static bool __read_payload_at(const CarrierImage *carrier_img, size_t pos, size_t num_bytes, uint8_t *out_buffer);
+
+// Read the metadata of the data segment that begins at the carrier position 'pos'
+// Returns IMC_SUCCESS if the segment is valid, and stores on 'crypto_size' the size of its encrypted stream.
+// Otherwise, returns IMC_ERR_PAYLOAD_OOB, IMC_ERR_INVALID_MAGIC or IMC_ERR_NEWER_VERSION.
+static int __read_segment_meta(const CarrierImage *carrier_img, size_t pos, uint32_t *crypto_size);
+
+// Find where each data segment begins and ends on the carrier
+// The returned struct should be freed with 'imc_steg_index_free()'.
+SegmentIndex *imc_steg_index(const CarrierImage *carrier_img);
+
+// Free the memory used by a 'SegmentIndex' struct
+void imc_steg_index_free(SegmentIndex *index);
+
+// Read, decrypt and decompress the data segment that begins at the carrier position 'pos'
+// On success, 'out_stream' receives the decompressed stream (the 'FileInfo' struct, followed by the file),
+// 'out_size' receives its size in bytes, and 'pos' is moved to right after the end of the segment.
+static int __segment_unpack(const CarrierImage *carrier_img, size_t *pos, bool verbose, uint8_t **out_stream, size_t *out_size);
+
+// Decompress a decrypted stream (the header of the 'FileInfo' struct, followed by the compressed data)
+// On success, 'out_stream' receives the decompressed stream (the 'FileInfo' struct, followed by the file),
+// and 'out_size' receives its size in bytes. The progress is sent to 'progress' (which can be NULL).
+static int __stream_decompress(const uint8_t *stream, size_t stream_size, const ProgressMonitor *progress, uint8_t **out_stream, size_t *out_size);
+
+// Read and decrypt the data segment that begins at the carrier position 'pos' (without decompressing it)
+// On success, 'out_stream' receives the decrypted stream (the header of the 'FileInfo' struct, followed by the compressed data),
+// 'out_size' receives its size in bytes, and 'pos' is moved to right after the end of the segment.
+static int __segment_decrypt(const CarrierImage *carrier_img, size_t *pos, bool verbose, uint8_t **out_stream, size_t *out_size);
+
+// Decompress only the name of a hidden file from its decrypted stream (the header of the 'FileInfo' struct, followed by the compressed data)
+// The name is stored on a newly allocated string, and the rest of the compressed data is left untouched.
+static int __segment_file_name(const uint8_t *stream, size_t stream_size, char **out_name);
+
+// Get the metadata of a hidden file from its decompressed stream
+// The metadata is stored on a newly allocated struct, and 'file_start' receives the offset of the file on the stream.
+static int __file_metadata(const uint8_t *stream, size_t stream_size, FileMetadata **out_info, size_t *file_start);
+
+// Create the output file for an extracted file (the file is never overwritten if it already exists)
+// If the name already exists on the directory, a number is appended to its stem (the name on 'file_name' is updated).
+// IMPORTANT: 'file_name' must have at least 16 more bytes than the size of the name.
+// Returns NULL on failure, and 'status' receives the reason (IMC_ERR_FILE_EXISTS or IMC_ERR_SAVE_FAIL).
+static FILE *__create_output_at(imc_dir_t dir, char *file_name, int *status);
+
+// Write the contents of an extracted file, then restore its "last access" and "last modified" times
+// The progress messages are sent to 'progress' (NULL for no messages).
+static void __write_extracted(FILE *out_file, imc_dir_t dir, const char *file_name, const FileMetadata *info, const uint8_t *data, const ProgressMonitor *progress);
+
+// Copy the name of a hidden file to a buffer, replacing the characters that the system does not allow in filenames
+// IMPORTANT: 'out_name' must have at least 16 more bytes than the size of the name.
+static void __extracted_filename(const FileMetadata *info, char *out_name);
+
 // Read the hidden data from the carrier bytes, and save it
 // The function extracts and save one file each time it is called.
 // So in order to extract all the hidden files, it should be called
@@ -149,24 +599,261 @@ static bool __read_payload(CarrierImage *carrier_img, size_t num_bytes, uint8_t
 // Note: The filename is stored with the hidden data
 int imc_steg_extract(CarrierImage *carrier_img);
 
+// Read the next hidden file into memory, instead of saving it
+// On success, 'out_info' receives the metadata of the file and 'out_data' its contents (both should be freed with 'imc_free()').
+// Returns the same status codes as 'imc_steg_extract()' (IMC_ERR_INVALID_MAGIC or IMC_ERR_PAYLOAD_OOB when there are no more hidden files).
+int imc_steg_extract_memory(CarrierImage *carrier_img, FileMetadata **out_info, uint8_t **out_data);
+
+// Amount of bytes of a stream that fit on a shard hidden in an image (0 if not even the shard's overhead fits)
+size_t imc_steg_shard_capacity(const CarrierImage *carrier_img);
+
+// Write a shard to the beginning of the carrier (the existing hidden data is overwritten)
+// 'data' is the part of the stream that was encrypted for this shard by 'imc_crypto_encrypt_parts()',
+// and 'crypto_header' the decryption header of the whole stream (the same on all shards of a set).
+int imc_steg_insert_shard(
+    CarrierImage *carrier_img,
+    const ShardHeader *shard,
+    const uint8_t *crypto_header,
+    const uint8_t *data,
+    size_t data_size
+);
+
+// Read the shard at the beginning of the carrier (its data is still encrypted)
+// On success, 'out_shard' receives the shard's header, 'crypto_header' the decryption header of the stream,
+// and 'out_data' the encrypted part of the stream (to be freed with 'imc_free()'), whose size goes to 'out_size'.
+// Returns IMC_ERR_INVALID_MAGIC if there is no shard on the image (or the password is incorrect).
+int imc_steg_read_shard(
+    const CarrierImage *carrier_img,
+    ShardHeader *out_shard,
+    uint8_t *crypto_header,
+    uint8_t **out_data,
+    size_t *out_size
+);
+
+// Decompress a stream that was reassembled from its shards, then save its file to 'out_dir' (or the current working directory, if NULL)
+// 'stream' is the decrypted stream (the header of the 'FileInfo' struct, followed by the compressed data), and 'progress' can be NULL.
+// On success, 'out_info' receives the metadata of the file (to be freed with 'imc_free()').
+// Returns IMC_ERR_SAVE_FAIL if the file could not be created (and 'errno' has the reason).
+int imc_steg_extract_buffer(
+    const uint8_t *stream,
+    size_t stream_size,
+    const char *out_dir,
+    const ProgressMonitor *progress,
+    FileMetadata **out_info
+);
+
+// Worker function for extracting the hidden file of index 'task'
+static void __extract_task(void *context, size_t task, size_t worker);
+
+// Extract all the hidden files at once, with up to 'thread_count' files being processed in parallel
+// The files are saved to 'out_dir' (or the current working directory, if NULL), each worker using its own handle of the directory.
+// On 'results' is stored a newly allocated array with the outcome for each hidden file (in the same order as they were hidden),
+// and on 'result_count' the amount of hidden files found. The array should be freed with 'imc_steg_results_free()'.
+// The returned status code is the reason why there are no more hidden files after the last one
+// (IMC_ERR_INVALID_MAGIC, IMC_ERR_PAYLOAD_OOB or IMC_ERR_NEWER_VERSION), or IMC_ERR_SAVE_FAIL if 'out_dir' could not be opened.
+int imc_steg_extract_all(CarrierImage *carrier_img, const char *out_dir, size_t thread_count, ExtractResult **results, size_t *result_count);
+
+// Write the header block of a tar archive's entry (POSIX ustar format)
+static void __tar_header(uint8_t *block, const char *name, size_t size, int64_t mod_time, char type);
+
+// Write data to a tar archive, followed by the zeros that pad it to a whole amount of blocks
+// Returns 'false' if the data could not be written.
+static bool __tar_write_data(FILE *out_stream, const uint8_t *data, size_t size);
+
+// Write an extracted file to a tar archive
+// The entry has the name and modified time of the file. If the name does not fit on the ustar header,
+// it is stored on a PAX extended header before the entry.
+static int __tar_write_file(FILE *out_stream, const FileMetadata *info, const uint8_t *data);
+
+// Extract the hidden files to an open stream (such as the standard output), in the same order as they were hidden
+// If 'tar' is true, the files are written as a tar archive (with their names and modified times).
+// Otherwise, only the first hidden file is written to the stream (as it is).
+// The results are returned in the same way as 'imc_steg_extract_all()', and the returned status code is also the same,
+// except that IMC_ERR_SAVE_FAIL means that a file could not be written to the stream (and 'errno' has the reason).
+int imc_steg_extract_stream(CarrierImage *carrier_img, FILE *out_stream, bool tar, ExtractResult **results, size_t *result_count);
+
+// Free the memory used by the array of results of 'imc_steg_extract_all()'
+void imc_steg_results_free(ExtractResult *results, size_t result_count);
+
+// Change the password of the data hidden on an image opened by 'imc_steg_open()'
+// The carrier is shuffled with both the old and the new secrets. The hidden files are decrypted with 'old_crypto',
+// then encrypted again with 'new_crypto' (they are not decompressed, so they are not compressed again either).
+// The old positions of the hidden data get random bits before the data is written to its new positions.
+// On success, 'file_count' receives the amount of hidden files. Nothing is changed on the image if any file fails to decrypt.
+int imc_steg_rekey(CarrierImage *carrier_img, const CryptoContext *old_crypto, const CryptoContext *new_crypto, size_t *file_count);
+
+// Copy the data hidden on an image to another image, without decrypting it
+// Both images must have been initialized with the same secrets, so the encrypted hidden files are valid on either of them.
+// The hidden files are written to the beginning of the destination's carrier (overwriting the data previously hidden there).
+// On success, 'file_count' receives the amount of hidden files that were copied. Nothing is changed on the source image.
+int imc_steg_transplant(const CarrierImage *source, CarrierImage *destination, size_t *file_count);
+
+// Remove from the image the first hidden file named 'file_name'
+// The hidden files are decrypted in order until the file is found, but only their names are decompressed.
+// The encrypted hidden files after it are moved back (without decrypting them) to where the removed file began,
+// and the space freed at the end of the hidden data gets random bits. Returns IMC_ERR_FILE_NOT_FOUND if no hidden file has that name.
+int imc_steg_remove(CarrierImage *carrier_img, const char *file_name);
+
 // Move the read position of the carrier bytes to right after the end of the last hidden file
 // Note: this function is intended to be used when in "append mode" while hiding a file.
 void imc_steg_seek_to_end(CarrierImage *carrier_img);
 
+// Map the contents of an open file to memory (copy-on-write)
+// The memory can be changed, but the changes are private to this program (they are never written back to the file).
+// The mapping should be released with 'imc_unmap_file()'. The file can be closed after that.
+int imc_map_file(FILE *file, uint8_t **out_data, size_t *out_size);
+
+// Release the memory mapping of a file
+void imc_unmap_file(const uint8_t *data, size_t size);
+
+// Release the contents of a cover image, then close its file
+// (if 'file' is NULL, the image was read from the standard input into a heap buffer)
+static void __release_input(FILE *file, const uint8_t *data, size_t size);
+
+// Read all the remaining data from a stream (such as the standard input) into a newly allocated buffer
+// Returns IMC_ERR_FILE_TOO_BIG if the stream has more than 'max_size' bytes, or IMC_ERR_FILE_INVALID if the stream could not be read.
+static int __read_stream(FILE *stream, size_t max_size, uint8_t **out_data, size_t *out_size);
+
+// Hash the cover image, then map its file on the cover cache to 'cache_mapping' (if the file exists and is valid)
+// This is done only for the formats whose decoded pixels can be cached (PNG and WebP).
+static void __cover_cache_load(CarrierImage *carrier_img, const char *cache_dir);
+
+// Path of the cover cache file of an image, with 'suffix' added to its end (the path should be freed with 'imc_free()')
+static char *__cover_cache_path(const char *cache_dir, const uint8_t *hash, const char *suffix);
+
+// Get the carrier from the cached image, after checking that its dimensions match the ones of the cover image
+// Returns the cached pixels, or NULL if the cache file cannot be used (the file is unmapped in this case, so the image is decoded instead).
+static uint8_t *__cover_cache_carrier(CarrierImage *carrier_img, uint32_t width, uint32_t height, size_t stride);
+
+// Write the decoded pixels and the (not shuffled yet) carrier of an image to the cover cache
+// The file is written under a temporary name, then renamed, so other processes never map a partial file.
+// Failing to write it is not an error, since the cache only makes the next openings faster.
+static void __cover_cache_store(CarrierImage *carrier_img, uint32_t width, uint32_t height, size_t stride, const uint8_t *pixels);
+
+// Whether a path means the standard input or the standard output (that is, the path is "-")
+bool imc_is_stdio_path(const char *path);
+
+// Rename a file or a folder, failing with 'errno' set to EEXIST if something already has the new name
+// Returns false if it could not be renamed ('errno' receives the reason).
+bool imc_rename_noreplace(const char *old_path, const char *new_path);
+
+// Move a finished file from 'temp_path' to 'path', without replacing an existing file
+// If the name already exists, a number is appended to the file's stem (in the same way as when saving an image).
+// On success, 'out_path' receives the new path (to be freed with 'imc_free()').
+// Returns IMC_ERR_FILE_EXISTS if no free name was found, or IMC_ERR_SAVE_FAIL if the file could not be moved.
+int imc_move_file(const char *temp_path, const char *path, char **out_path);
+
+// Stop the system from converting the line breaks of a standard stream (on Windows), so binary data can go through it
+static void __set_binary_mode(FILE *stream);
+
+// Error handler of libjpeg-turbo: return to where 'setjmp()' was called with the 'JpegError' struct
+static void __jpeg_error_exit(j_common_ptr jpeg_obj);
+
+// Message handler of libjpeg-turbo: the warnings are ignored, since the library should not print anything
+static void __jpeg_output_message(j_common_ptr jpeg_obj);
+
 // Progress monitor when reading a JPEG image
 static void __jpeg_read_callback(j_common_ptr jpeg_obj);
 
 // Get the bytes from a JPEG image that will carry the hidden data
-void imc_jpeg_carrier_open(CarrierImage *carrier_img);
+int imc_jpeg_carrier_open(CarrierImage *carrier_img);
+
+// Error handler of libpng: return to where 'setjmp()' was called (without printing the error)
+static void __png_error(png_structp png_obj, png_const_charp message);
+
+// Warning handler of libpng: the warnings are ignored, since the library should not print anything
+static void __png_warning(png_structp png_obj, png_const_charp message);
 
 // Progress monitor when reading a PNG image
 static void __png_read_callback(png_structp png_obj, png_uint_32 row, int pass);
 
+// Read function for libpng: copy the next bytes of the PNG file from its memory mapping
+static void __png_read_mapping(png_structp png_obj, png_bytep out_data, size_t length);
+
+// Value that a filter of a PNG image subtracts from a byte, given the bytes to its left (a), above (b), and above to the left (c)
+static inline int __png_predictor(uint8_t type, int a, int b, int c);
+
+// Reverse the filter of a row of a PNG image
+// 'previous' is the unfiltered row above it (all zeroes on the first row).
+static void __png_unfilter_row(uint8_t type, const uint8_t *filtered, const uint8_t *previous, size_t stride, size_t pixel_size, uint8_t *out_row);
+
+// Decode the rows of a non-interlaced PNG image directly from its file, keeping the filter type of each row
+// 'out_filters' receives the filter type of each row. Returns IMC_ERR_UNSUPPORTED if there are other chunks after the
+// image's data (besides IEND), in which case the image should be decoded by libpng (so those chunks are also read).
+// Returns IMC_ERR_FILE_INVALID if the image's data is damaged.
+static int __png_decode_rows(
+    const uint8_t *file,
+    size_t file_size,
+    png_bytep *row_pointers,
+    size_t height,
+    size_t stride,
+    size_t pixel_size,
+    const ProgressMonitor *progress,
+    uint8_t *out_filters
+);
+
 // Get the bytes from a PNG image that will carry the hidden data
-void imc_png_carrier_open(CarrierImage *carrier_img);
+int imc_png_carrier_open(CarrierImage *carrier_img);
 
 // Get the bytes from an WebP image that will carry the hidden data
-void imc_webp_carrier_open(CarrierImage *carrier_img);
+int imc_webp_carrier_open(CarrierImage *carrier_img);
+
+// Whether a WebP image is animated
+static bool __webp_is_animated(const uint8_t *data, size_t size);
+
+// Task of the worker threads: decode one frame of an animated WebP image
+static void __webp_frame_decode_task(void *context, size_t task, size_t worker);
+
+// Get the bytes from an animated WebP image that will carry the hidden data
+// The frames are decoded in parallel, and their carrier bytes are put together (in the order of the frames),
+// so the hidden data is shuffled over all frames as a single space.
+int imc_webp_anim_carrier_open(CarrierImage *carrier_img);
+
+// Get the bytes from a lossy WebP image that will carry the hidden data
+// Like on JPEG images, the carriers are the quantized coefficients of the VP8 bitstream, so the pixels are never decoded.
+int imc_webp_lossy_carrier_open(CarrierImage *carrier_img);
+
+// Read an unsigned integer of 'num_bytes' bytes (at most 4) from a buffer, in the given byte order
+static inline uint32_t __read_uint(const uint8_t *data, size_t num_bytes, bool big_endian);
+
+// Get the bytes from a BMP image that will carry the hidden data
+// The carrier bytes are the color values on the file's memory mapping, so the image is neither decoded nor encoded.
+int imc_bmp_carrier_open(CarrierImage *carrier_img);
+
+// Read the next number from the header of a PNM image, skipping the whitespace and comments before it
+// 'pos' is moved to right after the number. Returns 'false' if there is no valid number at that position.
+static bool __pnm_header_field(const uint8_t *pnm, size_t pnm_size, size_t *pos, uint32_t *out_value);
+
+// Get the bytes from a PNM image (binary PGM or PPM) that will carry the hidden data
+// The carrier bytes are the color values on the file's memory mapping, so the image is neither decoded nor encoded.
+int imc_pnm_carrier_open(CarrierImage *carrier_img);
+
+// Range of bytes on a TIFF file: either a strip of the image, or part of the file's structure (header, directory, or values of a field)
+typedef struct TiffRange {
+    size_t start;   // Position of the first byte
+    size_t end;     // Position right after the last byte
+    bool is_strip;  // Whether the range has pixels (which are going to be changed)
+} TiffRange;
+
+// Order of the ranges of a TIFF file: by their starting position
+static int __tiff_range_compare(const void *range_a, const void *range_b);
+
+// Size in bytes of a value of a TIFF field, by its type (0 if the type is unknown)
+static size_t __tiff_type_size(uint32_t type);
+
+// Read the value of index 'index' of a field from the directory of a TIFF image (the field's type must be BYTE, SHORT or LONG)
+// Returns 'false' if the field does not have that many values, or if its values are out of the bounds of the file.
+static bool __tiff_field_value(const uint8_t *tiff, size_t tiff_size, const uint8_t *entry, bool big_endian, size_t index, uint32_t *out_value);
+
+// Get the bytes from an uncompressed TIFF image that will carry the hidden data
+// The carrier bytes are the color values on the file's memory mapping, so the image is neither decoded nor encoded.
+// Only the first image on the file is used (any other images are saved without changes).
+int imc_tiff_carrier_open(CarrierImage *carrier_img);
+
+// Write to 'path' the name of the 'number'-th copy of a file (for example, 'Image.jpg' might become 'Image (2).jpg')
+// IMPORTANT: Function assumes that the path buffer must be big enough to store the new name.
+// (at most 5 characters are added to the path)
+static void __numbered_filename(const char *original, int number, char *path);
 
 // Change a file path in order to make it unique
 // IMPORTANT: Function assumes that the path buffer must be big enough to store the new name.
@@ -179,6 +866,21 @@ static bool __is_directory(const char *path);
 // Copy the "last access" and "last mofified" times from the one file (source) to the other (dest)
 static void __copy_file_times(FILE *source_file, const char *dest_path);
 
+// Open the file where a new image is saved, and store its path on the 'out_path' of the image
+// If 'save_path' is NULL, the image is written to a memory buffer (see 'imc_steg_save_memory()').
+// If 'save_path' is "-", the image is written to the standard output. Otherwise, 'extension' is appended to the path
+// (unless it already ends in 'extension' or 'alt_extension'), then a number is appended to its stem if the name already exists.
+// Returns NULL on failure, and 'status' receives the reason (IMC_ERR_SAVE_FAIL, IMC_ERR_FILE_EXISTS or IMC_ERR_FILE_NOT_FOUND).
+static FILE *__open_saved_image(CarrierImage *carrier_img, const char *save_path, const char *extension, const char *alt_extension, int *status);
+
+// Finish writing a new image, then copy the "last access" and "last mofified" times from the original image
+// (nothing is copied if either image is on the standard input or output, or on memory)
+// Returns IMC_ERR_WRITE_FAIL if the image could not be written.
+static int __close_saved_image(CarrierImage *carrier_img, FILE *out_file);
+
+// Close the file of a new image that could not be written (the standard output is just flushed)
+static void __abort_saved_image(CarrierImage *carrier_img, FILE *out_file);
+
 // Progress monitor when writing a JPEG image
 static void __jpeg_write_callback(j_common_ptr jpeg_obj);
 
@@ -188,6 +890,43 @@ int imc_jpeg_carrier_save(CarrierImage *carrier_img, const char *save_path);
 // Progress monitor when writing a PNG image
 static void __png_write_callback(png_structp png_obj, png_uint_32 row, int pass);
 
+// Filter a row of a PNG image with the given filter type
+// 'previous' is the unfiltered row above it (all zeroes on the first row). 'out_row' receives the filter type followed by the filtered row.
+// Returns the sum of the absolute values of the filtered bytes (as signed numbers).
+static size_t __png_filter_row(uint8_t type, const uint8_t *row, const uint8_t *previous, size_t stride, size_t pixel_size, uint8_t *out_row);
+
+// Filter a row of a PNG image with the filter type that has the smallest sum of absolute differences (the same heuristic as libpng)
+// 'previous' is the unfiltered row above it (all zeroes on the first row), and 'filters' are the types that are tried (PNG_FILTER_* flags).
+// 'out_row' receives the filter type followed by the filtered row, and 'scratch' is a buffer of the same size that is used for trying the filters.
+static void __png_filter_row_adaptive(const uint8_t *row, const uint8_t *previous, size_t stride, size_t pixel_size, int filters, uint8_t *scratch, uint8_t *out_row);
+
+// Filter the rows from 'first_row' to 'first_row + row_count - 1' of a PNG image, into 'out_data'
+// The rows get the same filter types as on the original image, if they are known. Otherwise, the filter types are chosen for each row.
+// 'zero_row' should be all zeroes (it is used as the row above the first row of the image).
+static void __png_filter_rows(const PngDeflate *job, size_t first_row, size_t row_count, const uint8_t *zero_row, uint8_t *out_data);
+
+// Task of the worker threads: filter and compress one band of rows of a PNG image
+static void __png_deflate_task(void *context, size_t task, size_t worker);
+
+// Filter and compress the rows of a non-interlaced PNG image, on all logical processors
+// 'out_deflate' receives the compressed bands, which together are the contents of the IDAT chunks (the zlib header is at
+// the start of the first band, and the checksum at the end of the last band). It should be freed with '__png_deflate_free()'.
+// 'row_filters' has the filter type of each row, or it is NULL for the filter types to be chosen by the same heuristic as libpng.
+// 'settings' are the compression level and strategy, and the filter types that can be chosen.
+static int __png_deflate(
+    png_bytep *row_pointers,
+    const uint8_t *row_filters,
+    size_t height,
+    size_t stride,
+    size_t pixel_size,
+    const SaveSettings *settings,
+    const ProgressMonitor *progress,
+    PngDeflate **out_deflate
+);
+
+// Free the compressed bands of a PNG image
+static void __png_deflate_free(PngDeflate *job);
+
 // Write the carrier bytes back to the PNG image, and save it as a new file
 int imc_png_carrier_save(CarrierImage *carrier_img, const char *save_path);
 
@@ -197,6 +936,22 @@ static int __webp_write_callback(int percent, const WebPPicture* webp_obj);
 // Write the carrier bytes back to the WebP image, and save it as a new file
 int imc_webp_carrier_save(CarrierImage *carrier_img, const char *save_path);
 
+// Task of the worker threads: encode one frame of an animated WebP image (lossless, keeping the exact color values)
+static void __webp_frame_encode_task(void *context, size_t task, size_t worker);
+
+// Write the carrier bytes back to the animated WebP image, and save it as a new file
+// The frames are encoded in parallel, then assembled with the same timing, animation parameters and metadata as the original.
+int imc_webp_anim_carrier_save(CarrierImage *carrier_img, const char *save_path);
+
+// Write the carrier bytes back to the coefficients of the lossy WebP image, and save it as a new file
+// Only the "VP8 " chunk is replaced, by one with the token partitions encoded again. The other chunks
+// (such as the transparency and the metadata) are copied from the original file.
+int imc_webp_lossy_carrier_save(CarrierImage *carrier_img, const char *save_path);
+
+// Save an uncompressed image (BMP, PNM or TIFF) with the hidden data as a new file
+// The carrier bytes were changed directly on the file's memory mapping, so the mapping is written as it is.
+int imc_raw_carrier_save(CarrierImage *carrier_img, const char *save_path);
+
 // Free the memory of the array of heap pointers in a CarrierImage struct
 static void __carrier_heap_free(CarrierImage *carrier_img);
 
@@ -209,15 +964,42 @@ void imc_png_carrier_close(CarrierImage *carrier_img);
 // Close the WebP object and free the memory associated to it
 void imc_webp_carrier_close(CarrierImage *carrier_img);
 
+// Free the decoded frames of an animated WebP image
+void imc_webp_anim_carrier_close(CarrierImage *carrier_img);
+
+// Free the coefficients of a lossy WebP image
+void imc_webp_lossy_carrier_close(CarrierImage *carrier_img);
+
+// Free the memory used for the carrier of an uncompressed image (BMP, PNM or TIFF)
+// (the carrier bytes are on the file's memory mapping, which is released by 'imc_steg_finish()')
+void imc_raw_carrier_close(CarrierImage *carrier_img);
+
 // Save the image with hidden data
 int imc_steg_save(CarrierImage *carrier_img, const char *save_path);
 
+// Encode the image with hidden data into a new buffer, instead of a file
+// On success, 'out_data' receives the buffer (which should be freed with 'imc_free()') and 'out_size' its size in bytes.
+int imc_steg_save_memory(CarrierImage *carrier_img, uint8_t **out_data, size_t *out_size);
+
 // Free the memory of the data structures used for steganography
 void imc_steg_finish(CarrierImage *carrier_img);
 
-// Print text at most once each 1/6 second
-// Note: function intended for the progress monitor, it uses the same format as 'printf()'.
-void printf_prog(const char *format, ...);
+// Send a progress message to a monitor (the message has the same format as 'printf()')
+// Nothing is done if 'monitor' or its function are NULL.
+void imc_progress(const ProgressMonitor *monitor, const char *format, ...);
+
+// Send a progress message to a monitor at most once each 1/6 second (on each thread)
+// Note: function intended for the progress percentages, it uses the same format as 'printf()'.
+void imc_progress_rate(const ProgressMonitor *monitor, const char *format, ...);
+
+// Format a progress message, then send it to the monitor
+static void __progress_send(const ProgressMonitor *monitor, const char *format, va_list arguments);
+
+// Short description of a status code
+const char *imc_strerror(int status);
+
+// Name of a save profile (as given to the '--profile' option)
+const char *imc_profile_name(enum SaveProfile profile);
 
 /* Windows compatibility functions */
 #ifdef _WIN32
@@ -3,6 +3,10 @@
 #ifndef _IMC_INCLUDES_H
 #define _IMC_INCLUDES_H
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // For the 'renameat2()' function (renaming without replacing)
+#endif // __linux__
+
 #ifdef _WIN32
 #include <winsock2.h>   // Needed by 'endian.h'
 /* Note: this is included before anything else because otherwise there would be
@@ -21,20 +25,36 @@ some conflicts with the symbols defined by `windows.h` or the standard libraries
 #include <time.h>
 #include <ctype.h>
 #include <errno.h>
+#include <setjmp.h>     // Error handling of libjpeg-turbo and libpng
+#include <stdatomic.h>
+#include <pthread.h>    // POSIX threads (on Windows, provided by winpthreads)
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // SSSE3 and AVX2 intrinsics (erasure code)
+#endif // x86
 
 // System libraries
 #ifdef _WIN32
 #include <windows.h>    // Microsoft Windows API
+#include <sddl.h>       // Security descriptors (for the permissions of the key files)
 #include <io.h>         // For the _get_osfhandle() function
 #include <direct.h>     // _getcwd(), _mkdir(), _chdir(), _rmdir()
+#include <fcntl.h>      // For the _O_BINARY macro
 #else // Linux / Unix
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>   // For mapping the cover image to memory
 #include <libgen.h>     // For the basename() function
 #include <fcntl.h>      // For the AT_FDCWD macro
 #include <termios.h>    // For temporarily turning off input echoing in the terminal
 #include <iconv.h>      // For encoding text to UTF-8
+#include <signal.h>     // For stopping the server on Ctrl+C
+#include <poll.h>       // For waiting for connections on the server's socket
+#include <sys/socket.h> // Unix-domain sockets (for the server mode)
+#include <sys/un.h>
+#include <sys/inotify.h>    // For watching a folder for new images
+#include <limits.h>     // For the NAME_MAX macro
+#include <dirent.h>     // For listing the images of a folder (when indexing it)
 #endif // _WIN32
 #include <endian.h>     // Converting between different byte orders
 #include <argp.h>       // Command line interface
@@ -46,14 +66,25 @@ some conflicts with the symbols defined by `windows.h` or the standard libraries
 #include <webp/decode.h>    // libwebp (WebP images - decoding)
 #include <webp/encode.h>    // libwebp (WebP images - encoding)
 #include <webp/mux.h>       // libwebp (WebP images - container manipulation)
+#include <webp/demux.h>     // libwebp (WebP images - frames of animated images)
 #include <zlib.h>       // data compression
 #include "../lib/shishua-sse2.h"    // Psueudo-random number generator
 
 // First party libraries
+#include "imgconceal.h"
 #include "globals.h"
 #include "imc_cli.h"
 #include "imc_crypto.h"
+#include "imc_elligator.h"
 #include "imc_image_io.h"
 #include "imc_memory.h"
+#include "imc_threads.h"
+#include "imc_server.h"
+#include "imc_watch.h"
+#include "imc_index.h"
+#include "imc_plan.h"
+#include "imc_erasure.h"
+#include "imc_vp8.h"
+#include "imc_shard.h"
 
 #endif  // _IMC_INCLUDES_H
\ No newline at end of file
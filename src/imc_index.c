@@ -0,0 +1,382 @@
+/* Index of a library of cover images, for choosing the smallest cover where the hidden files fit. */
+
+#include "imc_includes.h"
+
+// List the regular files of a folder (files whose name begins with a dot are skipped)
+// The paths are absolute. Each one should be freed with 'imc_free()', then the array.
+static int __index_list_folder(const char *folder, char ***out_paths, size_t *out_count)
+{
+    // The index stores absolute paths, so it can be used from any working directory
+    #ifdef _WIN32
+    char *const folder_path = _fullpath(NULL, folder, 0);
+    static const char separator = '\\';
+    #else
+    char *const folder_path = realpath(folder, NULL);
+    static const char separator = '/';
+    #endif // _WIN32
+
+    if (!folder_path) return IMC_ERR_FILE_NOT_FOUND;
+
+    size_t capacity = 64;
+    size_t count = 0;
+    char **paths = imc_malloc(capacity * sizeof(char *));
+
+    #ifdef _WIN32   // Windows systems
+
+    char pattern[strlen(folder_path) + 3];
+    snprintf(pattern, sizeof(pattern), "%s\\*", folder_path);
+
+    WIN32_FIND_DATAA entry;
+    HANDLE search = FindFirstFileA(pattern, &entry);
+    if (search == INVALID_HANDLE_VALUE)
+    {
+        free(folder_path);
+        imc_free(paths);
+        return IMC_ERR_FILE_NOT_FOUND;
+    }
+
+    do
+    {
+        const char *const name = entry.cFileName;
+        if (name[0] == '.' || (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) continue;
+
+    #else   // Linux systems
+
+    DIR *dir = opendir(folder_path);
+    if (!dir)
+    {
+        free(folder_path);
+        imc_free(paths);
+        return IMC_ERR_FILE_NOT_FOUND;
+    }
+
+    struct dirent *entry;
+    while ( (entry = readdir(dir)) )
+    {
+        const char *const name = entry->d_name;
+        if (name[0] == '.') continue;
+
+    #endif // _WIN32
+
+        const size_t path_size = strlen(folder_path) + strlen(name) + 2;
+        char *const path = imc_malloc(path_size);
+        snprintf(path, path_size, "%s%c%s", folder_path, separator, name);
+
+        #ifndef _WIN32
+        // Only regular files are indexed (the links are followed)
+        struct stat path_stat;
+        if (stat(path, &path_stat) != 0 || !S_ISREG(path_stat.st_mode))
+        {
+            imc_free(path);
+            continue;
+        }
+        #endif // _WIN32
+
+        if (count == capacity)
+        {
+            capacity *= 2;
+            paths = imc_realloc(paths, capacity * sizeof(char *));
+        }
+        paths[count++] = path;
+
+    #ifdef _WIN32
+    } while (FindNextFileA(search, &entry));
+    FindClose(search);
+    #else
+    }
+    closedir(dir);
+    #endif // _WIN32
+
+    free(folder_path);
+    *out_paths = paths;
+    *out_count = count;
+    return IMC_SUCCESS;
+}
+
+// Task of the worker threads: open one image (without a password), then record its parameters
+static void __index_task(void *context, size_t task, size_t worker)
+{
+    IndexJob *const job = (IndexJob *)context;
+
+    const StegOptions options = {.cache_dir = job->cache_dir};
+    CarrierImage *carrier_img = NULL;
+    const int status = imc_steg_open(job->paths[task], &carrier_img, &options);
+
+    if (status == IMC_SUCCESS)
+    {
+        IndexEntry *const entry = &job->entry[task];
+        entry->carrier_count = carrier_img->carrier_lenght;
+        entry->file_size = carrier_img->mapping_size;
+        entry->type = carrier_img->type;
+        entry->width = carrier_img->width;
+        entry->height = carrier_img->height;
+        crypto_generichash(entry->hash, sizeof(entry->hash), carrier_img->mapping, carrier_img->mapping_size, NULL, 0);
+        imc_steg_finish(carrier_img);
+    }
+
+    const size_t done = atomic_fetch_add(&job->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(job->progress, "Indexing images... %.1f %%\r", ((double)done / (double)job->count) * 100.0);
+}
+
+// Order of the entries on the index: by increasing amount of carrier bytes, then by increasing file size
+static int __index_compare(const void *entry_a, const void *entry_b)
+{
+    const IndexEntry *const a = (const IndexEntry *)entry_a;
+    const IndexEntry *const b = (const IndexEntry *)entry_b;
+
+    if (a->carrier_count != b->carrier_count) return (a->carrier_count < b->carrier_count) ? -1 : 1;
+    if (a->file_size != b->file_size) return (a->file_size < b->file_size) ? -1 : 1;
+
+    // The position of the path on the folder's listing (the entries are sorted before the paths section is built)
+    return (a->path_offset > b->path_offset) - (a->path_offset < b->path_offset);
+}
+
+// Open every image on 'folder' (on up to 'thread_count' threads), then save their parameters to the index file at 'index_path'
+// Files that are not supported images are skipped. 'cache_dir' can be NULL, otherwise the decoded images are also added to the cover cache.
+// On success, 'out_count' receives the amount of indexed images, and 'out_skipped' the amount of skipped files.
+// Returns IMC_ERR_FILE_NOT_FOUND if the folder could not be read, or IMC_ERR_SAVE_FAIL if the index could not be written (and 'errno' has the reason).
+int imc_index_build(
+    const char *folder,
+    const char *index_path,
+    size_t thread_count,
+    const char *cache_dir,
+    const ProgressMonitor *progress,
+    size_t *out_count,
+    size_t *out_skipped
+)
+{
+    char **paths = NULL;
+    size_t path_count = 0;
+    const int list_status = __index_list_folder(folder, &paths, &path_count);
+    if (list_status != IMC_SUCCESS) return list_status;
+
+    // Open the images in parallel
+    IndexJob job = {
+        .paths = paths,
+        .entry = imc_calloc(path_count + 1, sizeof(IndexEntry)),
+        .count = path_count,
+        .cache_dir = cache_dir,
+        .progress = progress,
+        .done = 0,
+    };
+
+    imc_parallel_for(path_count, thread_count, &__index_task, &job);
+    imc_progress(progress, "Indexing images... Done!  \n");
+
+    // Keep only the supported images (the position on the listing is kept on 'path_offset' until the sorting)
+    size_t count = 0;
+    for (size_t i = 0; i < path_count; i++)
+    {
+        if (job.entry[i].carrier_count == 0) continue;
+        job.entry[count] = job.entry[i];
+        job.entry[count].path_offset = i;
+        count++;
+    }
+
+    qsort(job.entry, count, sizeof(IndexEntry), &__index_compare);
+
+    // Size of the paths section
+    size_t paths_size = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        paths_size += strlen(paths[job.entry[i].path_offset]) + 1;
+    }
+
+    int status = IMC_SUCCESS;
+    if (paths_size > UINT32_MAX)
+    {
+        errno = EFBIG;
+        status = IMC_ERR_SAVE_FAIL;
+    }
+
+    // The index is written under a temporary name, then renamed (so a partial index is never used)
+    const size_t temp_size = strlen(index_path) + 5;
+    char temp_path[temp_size];
+    snprintf(temp_path, temp_size, "%s.tmp", index_path);
+    FILE *index_file = (status == IMC_SUCCESS) ? fopen(temp_path, "wb") : NULL;
+    if (!index_file) status = IMC_ERR_SAVE_FAIL;
+
+    if (index_file)
+    {
+        const IndexHeader header = {
+            .magic = IMC_INDEX_MAGIC,
+            .byte_order = IMC_INDEX_BYTE_ORDER,
+            .version = IMC_INDEX_VERSION,
+            .reserved = 0,
+            .entry_count = count,
+            .paths_size = paths_size,
+        };
+
+        // Replace the position on the listing by the position on the paths section
+        const char **sorted_paths = imc_malloc((count + 1) * sizeof(char *));
+        uint32_t offset = 0;
+        
+        for (size_t i = 0; i < count; i++)
+        {
+            sorted_paths[i] = paths[job.entry[i].path_offset];
+            job.entry[i].path_offset = offset;
+            offset += strlen(sorted_paths[i]) + 1;
+        }
+
+        bool success = (
+            fwrite(&header, sizeof(header), 1, index_file) == 1 &&
+            fwrite(job.entry, sizeof(IndexEntry), count, index_file) == count
+        );
+
+        for (size_t i = 0; success && i < count; i++)
+        {
+            const size_t path_size = strlen(sorted_paths[i]) + 1;
+            success = fwrite(sorted_paths[i], 1, path_size, index_file) == path_size;
+        }
+
+        imc_free(sorted_paths);
+
+        if (fclose(index_file) != 0) success = false;
+
+        #ifdef _WIN32
+        // On Windows, renaming does not replace an existing file
+        if (success) remove(index_path);
+        #endif // _WIN32
+
+        if (!success || rename(temp_path, index_path) != 0)
+        {
+            const int error = errno;
+            remove(temp_path);
+            errno = error;
+            status = IMC_ERR_SAVE_FAIL;
+        }
+    }
+
+    for (size_t i = 0; i < path_count; i++) imc_free(paths[i]);
+    imc_free(paths);
+    imc_free(job.entry);
+
+    if (status == IMC_SUCCESS)
+    {
+        *out_count = count;
+        *out_skipped = path_count - count;
+    }
+
+    return status;
+}
+
+// Map an index file to memory, and check whether it is valid
+// Only the pages of the index that are used are read from the disk. The mapping should be released with 'imc_index_unmap()'.
+// Returns IMC_ERR_FILE_NOT_FOUND if the index could not be opened, or IMC_ERR_FILE_INVALID if it is not valid.
+int imc_index_map(const char *index_path, IndexMap *out)
+{
+    FILE *index_file = fopen(index_path, "rb");
+    if (!index_file) return IMC_ERR_FILE_NOT_FOUND;
+
+    uint8_t *data = NULL;
+    size_t size = 0;
+    const int map_status = imc_map_file(index_file, &data, &size);
+    fclose(index_file);
+    if (map_status != IMC_SUCCESS) return map_status;
+
+    const IndexHeader *const header = (const IndexHeader *)data;
+
+    const bool valid = (
+        size >= sizeof(IndexHeader) &&
+        memcmp(header->magic, IMC_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+        header->byte_order == IMC_INDEX_BYTE_ORDER &&
+        header->version == IMC_INDEX_VERSION &&
+        header->entry_count <= (size - sizeof(IndexHeader)) / sizeof(IndexEntry) &&
+        header->paths_size == size - sizeof(IndexHeader) - (header->entry_count * sizeof(IndexEntry))
+    );
+
+    if (!valid)
+    {
+        imc_unmap_file(data, size);
+        return IMC_ERR_FILE_INVALID;
+    }
+
+    const IndexEntry *const entry = (const IndexEntry *)&data[sizeof(IndexHeader)];
+
+    *out = (IndexMap){
+        .data = data,
+        .size = size,
+        .count = header->entry_count,
+        .entry = entry,
+        .paths = (const char *)&entry[header->entry_count],
+        .paths_size = header->paths_size,
+    };
+
+    return IMC_SUCCESS;
+}
+
+// Path of the image at a position of a mapped index (NULL if the path does not end within the paths section)
+const char *imc_index_path(const IndexMap *index, size_t position)
+{
+    const size_t path_offset = index->entry[position].path_offset;
+    if (path_offset >= index->paths_size) return NULL;
+
+    const char *const path = &index->paths[path_offset];
+    return memchr(path, '\0', index->paths_size - path_offset) ? path : NULL;
+}
+
+// Position of the first image of a mapped index that has at least 'carrier_bits' carrier bytes
+// (the amount of images on the index if none of them is big enough)
+size_t imc_index_lower_bound(const IndexMap *index, size_t carrier_bits)
+{
+    size_t low = 0;
+    size_t high = index->count;
+
+    while (low < high)
+    {
+        const size_t middle = low + (high - low) / 2;
+        if (index->entry[middle].carrier_count < carrier_bits) low = middle + 1;
+        else high = middle;
+    }
+
+    return low;
+}
+
+// Release an index mapped by 'imc_index_map()'
+void imc_index_unmap(IndexMap *index)
+{
+    imc_unmap_file(index->data, index->size);
+    *index = (IndexMap){0};
+}
+
+// Find on an index the image with the least carrier bytes that still has at least 'carrier_bits' of them
+// Only the index is read (with a binary search), none of the images is opened. On success, 'out_path' receives
+// the image's path (to be freed with 'imc_free()'), and 'out_entry' a copy of its parameters.
+// Returns IMC_ERR_FILE_TOO_BIG if no image is big enough, or IMC_ERR_FILE_INVALID if the index is not valid.
+int imc_index_pick(const char *index_path, size_t carrier_bits, char **out_path, IndexEntry *out_entry)
+{
+    IndexMap index;
+    const int map_status = imc_index_map(index_path, &index);
+    if (map_status != IMC_SUCCESS) return map_status;
+
+    const size_t position = imc_index_lower_bound(&index, carrier_bits);
+    if (position == index.count)
+    {
+        imc_index_unmap(&index);
+        return IMC_ERR_FILE_TOO_BIG;
+    }
+
+    const char *const path = imc_index_path(&index, position);
+    if (!path)
+    {
+        imc_index_unmap(&index);
+        return IMC_ERR_FILE_INVALID;
+    }
+
+    *out_path = strdup(path);
+    *out_entry = index.entry[position];
+
+    imc_index_unmap(&index);
+    return IMC_SUCCESS;
+}
+
+// Whether an open image is still the same as when it was indexed (the hash of its file is compared)
+bool imc_index_matches(const CarrierImage *carrier_img, const IndexEntry *entry)
+{
+    if (carrier_img->mapping_size != entry->file_size) return false;
+
+    uint8_t hash[crypto_generichash_BYTES];
+    crypto_generichash(hash, sizeof(hash), carrier_img->mapping, carrier_img->mapping_size, NULL, 0);
+
+    return sodium_memcmp(hash, entry->hash, sizeof(hash)) == 0;
+}
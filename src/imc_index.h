@@ -0,0 +1,126 @@
+/* Index of a library of cover images, for choosing the smallest cover where the hidden files fit. */
+
+#ifndef _IMC_INDEX_H
+#define _IMC_INDEX_H
+
+#include "imc_includes.h"
+
+/*  Binary format of the index file
+    (Note: the numeric values are stored in the byte order of the machine that wrote the file, because
+     the file is mapped to memory and used as it is; an index written on another byte order is refused)
+
+    - 4 bytes: ASCII characters "imci"
+    - 4 bytes: the value 0x01020304 (used to verify the byte order of the file)
+    - 4 bytes: version number of the index
+    - 4 bytes: (reserved, always zero)
+    - 8 bytes: amount of indexed images
+    - 8 bytes: size in bytes of the paths section (at the end of the file)
+    - For each image (64 bytes each, sorted by increasing amount of carrier bytes):
+        - 8 bytes: amount of carrier bytes (each carrier byte can store one bit of hidden data)
+        - 8 bytes: size in bytes of the image's file
+        - 4 bytes: format of the image (same values as the 'ImageType' enum)
+        - 4 bytes: width of the image, in pixels
+        - 4 bytes: height of the image, in pixels
+        - 4 bytes: position of the image's path on the paths section
+        - 32 bytes: BLAKE2b hash of the image's file
+    - (variable): paths section, with the absolute path of each image (null-terminated strings encoded in UTF-8)
+*/
+
+// Identification and version of the index files
+#define IMC_INDEX_MAGIC "imci"
+#define IMC_INDEX_BYTE_ORDER 0x01020304
+#define IMC_INDEX_VERSION 1
+
+// Name of the index file when no path is given for it (the file is created inside the indexed folder)
+#define IMC_INDEX_NAME "imgconceal.index"
+
+// Header of an index file
+typedef struct IndexHeader {
+    char magic[4];          // ASCII characters "imci"
+    uint32_t byte_order;    // IMC_INDEX_BYTE_ORDER, as stored by the machine that wrote the file
+    uint32_t version;       // IMC_INDEX_VERSION
+    uint32_t reserved;      // Always zero
+    uint64_t entry_count;   // Amount of indexed images
+    uint64_t paths_size;    // Size in bytes of the paths section
+} IndexHeader;
+
+// Parameters of an indexed image
+typedef struct IndexEntry {
+    uint64_t carrier_count; // Amount of carrier bytes
+    uint64_t file_size;     // Size in bytes of the image's file
+    uint32_t type;          // Format of the image
+    uint32_t width;         // Width of the image, in pixels
+    uint32_t height;        // Height of the image, in pixels
+    uint32_t path_offset;   // Position of the image's path on the paths section
+    uint8_t hash[crypto_generichash_BYTES]; // Hash of the image's file
+} IndexEntry;
+
+// Index file mapped to memory
+typedef struct IndexMap {
+    uint8_t *data;              // Contents of the index file
+    size_t size;                // Size in bytes of the index file
+    size_t count;               // Amount of indexed images
+    const IndexEntry *entry;    // Parameters of each image (sorted by increasing amount of carrier bytes)
+    const char *paths;          // Paths section of the index
+    size_t paths_size;          // Size in bytes of the paths section
+} IndexMap;
+
+// Images being indexed by the worker threads
+typedef struct IndexJob {
+    char **paths;               // Paths of the files on the folder
+    IndexEntry *entry;          // Parameters of each file ('carrier_count' stays 0 if the file is not a supported image)
+    size_t count;               // Amount of files
+    const char *cache_dir;      // Folder of the cover cache (NULL if not caching the decoded images)
+    const ProgressMonitor *progress;    // Receives the percentage of files that were indexed
+    atomic_size_t done;         // Amount of files that were already opened
+} IndexJob;
+
+// List the regular files of a folder (files whose name begins with a dot are skipped)
+// The paths are absolute. Each one should be freed with 'imc_free()', then the array.
+static int __index_list_folder(const char *folder, char ***out_paths, size_t *out_count);
+
+// Task of the worker threads: open one image (without a password), then record its parameters
+static void __index_task(void *context, size_t task, size_t worker);
+
+// Order of the entries on the index: by increasing amount of carrier bytes, then by increasing file size
+static int __index_compare(const void *entry_a, const void *entry_b);
+
+// Open every image on 'folder' (on up to 'thread_count' threads), then save their parameters to the index file at 'index_path'
+// Files that are not supported images are skipped. 'cache_dir' can be NULL, otherwise the decoded images are also added to the cover cache.
+// On success, 'out_count' receives the amount of indexed images, and 'out_skipped' the amount of skipped files.
+// Returns IMC_ERR_FILE_NOT_FOUND if the folder could not be read, or IMC_ERR_SAVE_FAIL if the index could not be written (and 'errno' has the reason).
+int imc_index_build(
+    const char *folder,
+    const char *index_path,
+    size_t thread_count,
+    const char *cache_dir,
+    const ProgressMonitor *progress,
+    size_t *out_count,
+    size_t *out_skipped
+);
+
+// Map an index file to memory, and check whether it is valid
+// Only the pages of the index that are used are read from the disk. The mapping should be released with 'imc_index_unmap()'.
+// Returns IMC_ERR_FILE_NOT_FOUND if the index could not be opened, or IMC_ERR_FILE_INVALID if it is not valid.
+int imc_index_map(const char *index_path, IndexMap *out);
+
+// Path of the image at a position of a mapped index (NULL if the path does not end within the paths section)
+const char *imc_index_path(const IndexMap *index, size_t position);
+
+// Position of the first image of a mapped index that has at least 'carrier_bits' carrier bytes
+// (the amount of images on the index if none of them is big enough)
+size_t imc_index_lower_bound(const IndexMap *index, size_t carrier_bits);
+
+// Release an index mapped by 'imc_index_map()'
+void imc_index_unmap(IndexMap *index);
+
+// Find on an index the image with the least carrier bytes that still has at least 'carrier_bits' of them
+// Only the index is read (with a binary search), none of the images is opened. On success, 'out_path' receives
+// the image's path (to be freed with 'imc_free()'), and 'out_entry' a copy of its parameters.
+// Returns IMC_ERR_FILE_TOO_BIG if no image is big enough, or IMC_ERR_FILE_INVALID if the index is not valid.
+int imc_index_pick(const char *index_path, size_t carrier_bits, char **out_path, IndexEntry *out_entry);
+
+// Whether an open image is still the same as when it was indexed (the hash of its file is compared)
+bool imc_index_matches(const CarrierImage *carrier_img, const IndexEntry *entry);
+
+#endif  // _IMC_INDEX_H
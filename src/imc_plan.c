@@ -0,0 +1,425 @@
+/* Distribution of many files over the cover images of an index, and the parallel hiding of the files as planned. */
+
+#include "imc_includes.h"
+
+// Task of the worker threads when planning: compress one file, then record how many carrier bytes it takes
+static void __plan_compress_task(void *context, size_t task, size_t worker)
+{
+    PlanJob *const job = (PlanJob *)context;
+    PlanFile *const file = &job->plan->file[task];
+
+    // The plan stores absolute paths, so it can be run from any working directory
+    #ifdef _WIN32
+    char *const full_path = _fullpath(NULL, file->path, 0);
+    #else
+    char *const full_path = realpath(file->path, NULL);
+    #endif // _WIN32
+
+    if (full_path)
+    {
+        imc_free(file->path);
+        file->path = full_path;
+
+        // The plan file has one item per line
+        if (strpbrk(full_path, "\r\n"))
+        {
+            file->status = IMC_ERR_FILE_INVALID;
+        }
+        else
+        {
+            PreparedFile *prepared = NULL;
+            file->status = imc_steg_prepare(full_path, NULL, &prepared);
+            if (file->status == IMC_SUCCESS)
+            {
+                file->bits = imc_steg_prepared_bits(prepared) + IMC_PLAN_MARGIN_BITS;
+                imc_steg_prepared_free(prepared);
+            }
+        }
+    }
+    else
+    {
+        file->status = IMC_ERR_FILE_NOT_FOUND;
+    }
+
+    if (file->status != IMC_SUCCESS) file->error = errno;
+
+    const size_t done = atomic_fetch_add(&job->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(job->progress, "Compressing files... %.1f %%\r", ((double)done / (double)job->count) * 100.0);
+}
+
+// Order of the files when planning: by decreasing amount of carrier bytes, then by their original order
+static int __plan_compare(const void *file_a, const void *file_b)
+{
+    const PlanFile *const a = *(const PlanFile *const *)file_a;
+    const PlanFile *const b = *(const PlanFile *const *)file_b;
+
+    if (a->bits != b->bits) return (a->bits > b->bits) ? -1 : 1;
+    return (a > b) - (a < b);
+}
+
+// Add a file to an image of a plan
+static void __plan_cover_add(PlanCover *cover, const char *path)
+{
+    cover->files = imc_realloc(cover->files, (cover->file_count + 1) * sizeof(char *));
+    cover->files[cover->file_count++] = strdup(path);
+}
+
+// Compress the files on 'paths' (on up to 'thread_count' threads), then assign them to images of the index at 'index_path'
+// The assignment is "first-fit decreasing": from the biggest to the smallest file, each file goes to the first
+// chosen image where it still fits; if none, the smallest unused image where it fits is chosen.
+// The files that could not be read, or that do not fit on any image, are left out of the plan (see 'PlanFile').
+// On success, 'out' receives the plan (to be freed with 'imc_plan_free()').
+// Returns IMC_ERR_FILE_NOT_FOUND or IMC_ERR_FILE_INVALID if the index could not be used.
+int imc_plan_build(
+    const char *index_path,
+    const char *const *paths,
+    size_t path_count,
+    size_t thread_count,
+    const ProgressMonitor *progress,
+    Plan **out
+)
+{
+    IndexMap index;
+    const int map_status = imc_index_map(index_path, &index);
+    if (map_status != IMC_SUCCESS) return map_status;
+
+    Plan *const plan = imc_calloc(1, sizeof(Plan));
+    plan->file = imc_calloc(path_count + 1, sizeof(PlanFile));
+    plan->file_count = path_count;
+
+    for (size_t i = 0; i < path_count; i++)
+    {
+        plan->file[i] = (PlanFile){.path = strdup(paths[i]), .cover = SIZE_MAX};
+    }
+
+    // Compress the files in parallel (only their final size is kept)
+    PlanJob job = {
+        .plan = plan,
+        .progress = progress,
+        .count = path_count,
+        .done = 0,
+    };
+
+    imc_parallel_for(path_count, thread_count, &__plan_compress_task, &job);
+    imc_progress(progress, "Compressing files... Done!  \n");
+
+    // Files that can be planned, from the biggest to the smallest
+    PlanFile **order = imc_malloc((path_count + 1) * sizeof(PlanFile *));
+    size_t order_count = 0;
+    for (size_t i = 0; i < path_count; i++)
+    {
+        if (plan->file[i].status == IMC_SUCCESS) order[order_count++] = &plan->file[i];
+    }
+
+    qsort(order, order_count, sizeof(PlanFile *), &__plan_compare);
+
+    // Which images of the index were already chosen
+    bool *used = imc_calloc(index.count + 1, sizeof(bool));
+    plan->cover = imc_calloc(order_count + 1, sizeof(PlanCover));
+    int status = IMC_SUCCESS;
+
+    for (size_t i = 0; i < order_count; i++)
+    {
+        PlanFile *const file = order[i];
+
+        // First chosen image where the file still fits
+        size_t c = 0;
+        while (c < plan->cover_count && plan->cover[c].capacity - plan->cover[c].used_bits < file->bits) c++;
+
+        if (c == plan->cover_count)
+        {
+            // Smallest unused image where the file fits (the index is sorted by capacity)
+            size_t position = imc_index_lower_bound(&index, file->bits);
+            while (position < index.count && used[position]) position++;
+            if (position == index.count) continue;
+
+            const char *const cover_path = imc_index_path(&index, position);
+            if (!cover_path || strpbrk(cover_path, "\r\n"))
+            {
+                status = IMC_ERR_FILE_INVALID;
+                break;
+            }
+
+            const IndexEntry *const entry = &index.entry[position];
+            used[position] = true;
+
+            PlanCover *const cover = &plan->cover[plan->cover_count++];
+            *cover = (PlanCover){
+                .path = strdup(cover_path),
+                .file_size = entry->file_size,
+                .capacity = entry->carrier_count,
+            };
+            memcpy(cover->hash, entry->hash, sizeof(cover->hash));
+        }
+
+        plan->cover[c].used_bits += file->bits;
+        __plan_cover_add(&plan->cover[c], file->path);
+        file->cover = c;
+    }
+
+    imc_free(used);
+    imc_free(order);
+    imc_index_unmap(&index);
+
+    if (status != IMC_SUCCESS)
+    {
+        imc_plan_free(plan);
+        return status;
+    }
+
+    *out = plan;
+    return IMC_SUCCESS;
+}
+
+// Save a plan to a text file (written under a temporary name, then renamed)
+// Returns IMC_ERR_SAVE_FAIL if the file could not be written (and 'errno' has the reason).
+int imc_plan_save(const Plan *plan, const char *plan_path)
+{
+    const size_t temp_size = strlen(plan_path) + 5;
+    char temp_path[temp_size];
+    snprintf(temp_path, temp_size, "%s.tmp", plan_path);
+
+    FILE *plan_file = fopen(temp_path, "wb");
+    if (!plan_file) return IMC_ERR_SAVE_FAIL;
+
+    bool success = fprintf(plan_file, "%s\n", IMC_PLAN_HEADER) > 0;
+
+    for (size_t c = 0; success && c < plan->cover_count; c++)
+    {
+        const PlanCover *const cover = &plan->cover[c];
+        char hash_hex[sizeof(cover->hash) * 2 + 1];
+        sodium_bin2hex(hash_hex, sizeof(hash_hex), cover->hash, sizeof(cover->hash));
+
+        success = fprintf(plan_file, "cover %llu %s %s\n", (unsigned long long)cover->file_size, hash_hex, cover->path) > 0;
+
+        for (size_t i = 0; success && i < cover->file_count; i++)
+        {
+            success = fprintf(plan_file, "hide %s\n", cover->files[i]) > 0;
+        }
+    }
+
+    if (fclose(plan_file) != 0) success = false;
+
+    #ifdef _WIN32
+    // On Windows, renaming does not replace an existing file
+    if (success) remove(plan_path);
+    #endif // _WIN32
+
+    if (!success || rename(temp_path, plan_path) != 0)
+    {
+        const int error = errno;
+        remove(temp_path);
+        errno = error;
+        return IMC_ERR_SAVE_FAIL;
+    }
+
+    return IMC_SUCCESS;
+}
+
+// Read a plan from a text file
+// On success, 'out' receives the plan (to be freed with 'imc_plan_free()').
+// Returns IMC_ERR_FILE_NOT_FOUND if the file could not be opened, or IMC_ERR_FILE_INVALID if it is not a valid plan.
+int imc_plan_load(const char *plan_path, Plan **out)
+{
+    FILE *plan_file = fopen(plan_path, "rb");
+    if (!plan_file) return IMC_ERR_FILE_NOT_FOUND;
+
+    uint8_t *data = NULL;
+    size_t size = 0;
+    const int map_status = imc_map_file(plan_file, &data, &size);
+    fclose(plan_file);
+    if (map_status != IMC_SUCCESS) return map_status;
+
+    Plan *const plan = imc_calloc(1, sizeof(Plan));
+    size_t capacity = 0;
+    bool valid = true;
+    size_t line_number = 0;
+    size_t pos = 0;
+
+    while (valid && pos < size)
+    {
+        // Copy the line to a null-terminated buffer (without the line break)
+        const uint8_t *const line_end = memchr(&data[pos], '\n', size - pos);
+        size_t line_len = line_end ? (size_t)(line_end - &data[pos]) : (size - pos);
+        const size_t next_pos = pos + line_len + 1;
+        if (line_len > 0 && data[pos + line_len - 1] == '\r') line_len--;
+
+        char *const line = imc_malloc(line_len + 1);
+        memcpy(line, &data[pos], line_len);
+        line[line_len] = '\0';
+        pos = next_pos;
+
+        if (line_number++ == 0)
+        {
+            valid = (strcmp(line, IMC_PLAN_HEADER) == 0);
+        }
+        else if (strncmp(line, "cover ", 6) == 0)
+        {
+            // cover <file size> <hash> <path>
+            static const size_t hex_len = crypto_generichash_BYTES * 2;
+            char *size_end = NULL;
+            const unsigned long long file_size = strtoull(&line[6], &size_end, 10);
+            valid = (isdigit((unsigned char)line[6]) && *size_end == ' ' && strlen(size_end) > hex_len + 2);
+
+            uint8_t hash[crypto_generichash_BYTES];
+            size_t hash_len = 0;
+            const char *const hash_hex = size_end + 1;
+
+            valid = valid && (
+                hash_hex[hex_len] == ' ' &&
+                sodium_hex2bin(hash, sizeof(hash), hash_hex, hex_len, NULL, &hash_len, NULL) == 0 &&
+                hash_len == sizeof(hash)
+            );
+
+            if (valid)
+            {
+                const char *const cover_path = &hash_hex[hex_len + 1];
+
+                if (plan->cover_count == capacity)
+                {
+                    capacity = capacity ? capacity * 2 : 16;
+                    plan->cover = imc_realloc(plan->cover, capacity * sizeof(PlanCover));
+                }
+
+                PlanCover *const cover = &plan->cover[plan->cover_count++];
+                *cover = (PlanCover){
+                    .path = strdup(cover_path),
+                    .file_size = file_size,
+                };
+                memcpy(cover->hash, hash, sizeof(hash));
+            }
+        }
+        else if (strncmp(line, "hide ", 5) == 0)
+        {
+            // hide <path> (the file belongs to the last image)
+            valid = (plan->cover_count > 0 && line[5] != '\0');
+            if (valid) __plan_cover_add(&plan->cover[plan->cover_count - 1], &line[5]);
+        }
+        else
+        {
+            // Only empty lines are allowed besides the items
+            valid = (line_len == 0);
+        }
+
+        imc_free(line);
+    }
+
+    imc_unmap_file(data, size);
+
+    if (!valid || line_number == 0)
+    {
+        imc_plan_free(plan);
+        return IMC_ERR_FILE_INVALID;
+    }
+
+    *out = plan;
+    return IMC_SUCCESS;
+}
+
+// Task of the worker threads when running a plan: hide the files of one image, then save the image
+static void __plan_run_task(void *context, size_t task, size_t worker)
+{
+    PlanJob *const job = (PlanJob *)context;
+    PlanCover *const cover = &job->plan->cover[task];
+
+    const StegOptions options = {.cache_dir = job->cache_dir, .profile = job->profile};
+    CarrierImage *carrier_img = NULL;
+    int status = imc_steg_init_context(cover->path, job->crypto, &carrier_img, &options);
+    cover->failed_file = SIZE_MAX;
+
+    if (status == IMC_SUCCESS)
+    {
+        // The capacity of the image was planned from its indexed version
+        IndexEntry indexed = {.file_size = cover->file_size};
+        memcpy(indexed.hash, cover->hash, sizeof(indexed.hash));
+        if (!imc_index_matches(carrier_img, &indexed)) status = IMC_ERR_FILE_CORRUPTED;
+
+        for (size_t i = 0; status == IMC_SUCCESS && i < cover->file_count; i++)
+        {
+            status = imc_steg_insert(carrier_img, cover->files[i]);
+            if (status != IMC_SUCCESS) cover->failed_file = i;
+        }
+
+        // The image is saved to the output folder with the same name
+        // ('basename()' may change its argument, so it gets a copy of the path)
+        if (status == IMC_SUCCESS)
+        {
+            char path_copy[strlen(cover->path) + 1];
+            strcpy(path_copy, cover->path);
+            const char *const name = basename(path_copy);
+
+            const size_t save_size = strlen(job->out_dir) + strlen(name) + 2;
+            char save_path[save_size];
+            snprintf(save_path, save_size, "%s/%s", job->out_dir, name);
+
+            status = imc_steg_save(carrier_img, save_path);
+            if (status == IMC_SUCCESS) cover->out_path = strdup(carrier_img->out_path);
+        }
+
+        imc_steg_finish(carrier_img);
+    }
+
+    cover->status = status;
+
+    const size_t done = atomic_fetch_add(&job->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(job->progress, "Hiding files... %.1f %%\r", ((double)done / (double)job->count) * 100.0);
+}
+
+// Hide the files of a plan on their images (on up to 'thread_count' threads), then save the images to 'out_dir'
+// Each image gets its own copy of 'crypto'. The result of each image is stored on its 'status' (an image whose file
+// has changed since it was indexed gets IMC_ERR_FILE_CORRUPTED, and nothing is hidden on it).
+// An image is saved only if all of its files could be hidden, with the encoder settings of 'profile'.
+// Returns the amount of images that were saved.
+size_t imc_plan_run(
+    Plan *plan,
+    const CryptoContext *crypto,
+    const char *out_dir,
+    const char *cache_dir,
+    enum SaveProfile profile,
+    size_t thread_count,
+    const ProgressMonitor *progress
+)
+{
+    PlanJob job = {
+        .plan = plan,
+        .crypto = crypto,
+        .out_dir = out_dir,
+        .cache_dir = cache_dir,
+        .profile = profile,
+        .progress = progress,
+        .count = plan->cover_count,
+        .done = 0,
+    };
+
+    imc_parallel_for(plan->cover_count, thread_count, &__plan_run_task, &job);
+    imc_progress(progress, "Hiding files... Done!  \n");
+
+    size_t saved = 0;
+    for (size_t c = 0; c < plan->cover_count; c++)
+    {
+        if (plan->cover[c].status == IMC_SUCCESS) saved++;
+    }
+
+    return saved;
+}
+
+// Free the memory of a plan
+void imc_plan_free(Plan *plan)
+{
+    if (!plan) return;
+
+    for (size_t c = 0; c < plan->cover_count; c++)
+    {
+        PlanCover *const cover = &plan->cover[c];
+        for (size_t i = 0; i < cover->file_count; i++) imc_free(cover->files[i]);
+        imc_free(cover->files);
+        imc_free(cover->path);
+        imc_free(cover->out_path);
+    }
+
+    for (size_t i = 0; i < plan->file_count; i++) imc_free(plan->file[i].path);
+
+    imc_free(plan->cover);
+    imc_free(plan->file);
+    imc_free(plan);
+}
@@ -0,0 +1,129 @@
+/* Distribution of many files over the cover images of an index, and the parallel hiding of the files as planned. */
+
+#ifndef _IMC_PLAN_H
+#define _IMC_PLAN_H
+
+#include "imc_includes.h"
+
+/*  Text format of the plan file (one item per line, the paths are absolute and encoded in UTF-8)
+
+    imgconceal plan 1
+    cover <size of the image's file> <BLAKE2b hash of the image's file, in hexadecimal> <path of the image>
+    hide <path of a file hidden on the image above>
+    hide <path of another file hidden on the image above>
+    cover ...
+
+    (Note: the files of each image are listed in the order they are hidden, and the images
+     are independent from each other, so each image can be processed by a different thread)
+*/
+
+// First line of the plan files
+#define IMC_PLAN_HEADER "imgconceal plan 1"
+
+// Name of the plan file when no path is given for it (the file is created on the current working directory)
+#define IMC_PLAN_NAME "imgconceal.plan"
+
+// Extra carrier bytes reserved for each file when planning
+/* Note: the timestamps of a file are compressed along with its contents, and reading the file while
+   planning may update its "last access" time. So the compressed size can change by a few bytes
+   until the plan is run, and this margin keeps a fully planned image from overflowing. */
+#define IMC_PLAN_MARGIN_BITS (32 * 8)
+
+// File distributed by the planner
+typedef struct PlanFile {
+    char *path;         // Absolute path of the file (or the path as given, if it could not be resolved)
+    size_t bits;        // Amount of carrier bytes taken by the file, once compressed and encrypted (plus the planning margin)
+    int status;         // Result of reading and compressing the file (IMC_ERR_FILE_INVALID if its path has a line break)
+    int error;          // Value of 'errno' when the file could not be read
+    size_t cover;       // Position of the file's image on the plan (SIZE_MAX if the file did not fit on any image)
+} PlanFile;
+
+// Cover image of a plan
+typedef struct PlanCover {
+    char *path;         // Absolute path of the image
+    uint64_t file_size; // Size in bytes of the image's file, when it was indexed
+    uint8_t hash[crypto_generichash_BYTES]; // Hash of the image's file, when it was indexed
+    size_t capacity;    // Amount of carrier bytes of the image (unknown on a loaded plan)
+    size_t used_bits;   // Amount of carrier bytes taken by the files assigned to the image
+    char **files;       // Paths of the files hidden on the image
+    size_t file_count;  // Amount of files on 'files'
+    int status;         // Result of hiding the files on the image (when running the plan)
+    size_t failed_file; // Position on 'files' of the file that could not be hidden (SIZE_MAX if the image itself failed)
+    char *out_path;     // Path where the modified image was saved (when running the plan)
+} PlanCover;
+
+// Assignment of files to cover images
+typedef struct Plan {
+    PlanCover *cover;   // Images used by the plan (in the order they were chosen)
+    size_t cover_count; // Amount of images on 'cover'
+    PlanFile *file;     // Files given to the planner, in their original order (none on a loaded plan)
+    size_t file_count;  // Amount of files on 'file'
+} Plan;
+
+// Files being compressed, or images being processed, by the worker threads
+typedef struct PlanJob {
+    Plan *plan;
+    const CryptoContext *crypto;    // Secrets used on every image (when running the plan)
+    const char *out_dir;            // Folder where the modified images are saved (when running the plan)
+    const char *cache_dir;          // Folder of the cover cache (NULL if not caching the decoded images)
+    enum SaveProfile profile;       // Settings of the encoder when saving the images
+    const ProgressMonitor *progress;    // Receives the percentage of tasks that were done
+    size_t count;                   // Amount of tasks
+    atomic_size_t done;             // Amount of tasks that were already done
+} PlanJob;
+
+// Task of the worker threads when planning: compress one file, then record how many carrier bytes it takes
+static void __plan_compress_task(void *context, size_t task, size_t worker);
+
+// Order of the files when planning: by decreasing amount of carrier bytes, then by their original order
+static int __plan_compare(const void *file_a, const void *file_b);
+
+// Add a file to an image of a plan
+static void __plan_cover_add(PlanCover *cover, const char *path);
+
+// Task of the worker threads when running a plan: hide the files of one image, then save the image
+static void __plan_run_task(void *context, size_t task, size_t worker);
+
+// Compress the files on 'paths' (on up to 'thread_count' threads), then assign them to images of the index at 'index_path'
+// The assignment is "first-fit decreasing": from the biggest to the smallest file, each file goes to the first
+// chosen image where it still fits; if none, the smallest unused image where it fits is chosen.
+// The files that could not be read, or that do not fit on any image, are left out of the plan (see 'PlanFile').
+// On success, 'out' receives the plan (to be freed with 'imc_plan_free()').
+// Returns IMC_ERR_FILE_NOT_FOUND or IMC_ERR_FILE_INVALID if the index could not be used.
+int imc_plan_build(
+    const char *index_path,
+    const char *const *paths,
+    size_t path_count,
+    size_t thread_count,
+    const ProgressMonitor *progress,
+    Plan **out
+);
+
+// Save a plan to a text file (written under a temporary name, then renamed)
+// Returns IMC_ERR_SAVE_FAIL if the file could not be written (and 'errno' has the reason).
+int imc_plan_save(const Plan *plan, const char *plan_path);
+
+// Read a plan from a text file
+// On success, 'out' receives the plan (to be freed with 'imc_plan_free()').
+// Returns IMC_ERR_FILE_NOT_FOUND if the file could not be opened, or IMC_ERR_FILE_INVALID if it is not a valid plan.
+int imc_plan_load(const char *plan_path, Plan **out);
+
+// Hide the files of a plan on their images (on up to 'thread_count' threads), then save the images to 'out_dir'
+// Each image gets its own copy of 'crypto'. The result of each image is stored on its 'status' (an image whose file
+// has changed since it was indexed gets IMC_ERR_FILE_CORRUPTED, and nothing is hidden on it).
+// An image is saved only if all of its files could be hidden, with the encoder settings of 'profile'.
+// Returns the amount of images that were saved.
+size_t imc_plan_run(
+    Plan *plan,
+    const CryptoContext *crypto,
+    const char *out_dir,
+    const char *cache_dir,
+    enum SaveProfile profile,
+    size_t thread_count,
+    const ProgressMonitor *progress
+);
+
+// Free the memory of a plan
+void imc_plan_free(Plan *plan);
+
+#endif  // _IMC_PLAN_H
@@ -0,0 +1,890 @@
+/* Long-running daemon that hides, extracts and checks files for the clients of a Unix-domain socket. */
+
+#include "imc_includes.h"
+
+#ifndef _WIN32
+
+// Set when the server receives SIGINT or SIGTERM
+static volatile sig_atomic_t server_stop = 0;
+
+// Signal handler for SIGINT and SIGTERM: ask the server to stop
+static void __server_signal(int signal_number)
+{
+    (void)signal_number;
+    server_stop = 1;
+}
+
+// Get the cryptographic context of a password from the cache, hashing the password only if it is not there
+// The context is shared with the cache and with other requests, so it should only be copied (as 'imc_steg_init_context()' does).
+// It should be given back with '__key_cache_release()'.
+static int __key_cache_get(KeyCache *cache, const PassBuff *password, CachedKey **out)
+{
+    uint8_t hash[crypto_generichash_BYTES];
+    crypto_generichash(hash, sizeof(hash), password->buffer, password->length, cache->hash_key, sizeof(cache->hash_key));
+
+    // Look for the password on the cache
+    pthread_mutex_lock(&cache->lock);
+    for (size_t i = 0; i < IMC_SERVER_CACHE_SIZE; i++)
+    {
+        KeyCacheEntry *const entry = &cache->entry[i];
+        if (entry->key && sodium_memcmp(entry->hash, hash, sizeof(hash)) == 0)
+        {
+            entry->last_use = ++cache->clock;
+            cache->hits++;
+            entry->key->refs++;
+            *out = entry->key;
+            pthread_mutex_unlock(&cache->lock);
+            sodium_memzero(hash, sizeof(hash));
+            return IMC_SUCCESS;
+        }
+    }
+    cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    /* Note: the password is hashed without holding the lock, because the hashing is slow on purpose.
+       If two requests with the same new password arrive at the same time, both are going to hash it. */
+    CachedKey *key = imc_malloc(sizeof(CachedKey));
+    key->refs = 1;  // Held by the request
+    const int status = imc_crypto_context_create(password, &key->crypto);
+    if (status != IMC_SUCCESS)
+    {
+        imc_free(key);
+        sodium_memzero(hash, sizeof(hash));
+        return status;
+    }
+
+    // Store the new context on the cache, replacing the least recently used one
+    pthread_mutex_lock(&cache->lock);
+    KeyCacheEntry *oldest = &cache->entry[0];
+    for (size_t i = 0; i < IMC_SERVER_CACHE_SIZE; i++)
+    {
+        KeyCacheEntry *const entry = &cache->entry[i];
+
+        if (entry->key && sodium_memcmp(entry->hash, hash, sizeof(hash)) == 0)
+        {
+            // Another request has already stored the same password
+            oldest = NULL;
+            break;
+        }
+
+        if (!entry->key || (oldest->key && entry->last_use < oldest->last_use)) oldest = entry;
+    }
+
+    if (oldest)
+    {
+        if (oldest->key) __key_unref(oldest->key);
+        memcpy(oldest->hash, hash, sizeof(hash));
+        oldest->key = key;
+        oldest->last_use = ++cache->clock;
+        key->refs++;    // Held by the cache
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    sodium_memzero(hash, sizeof(hash));
+    *out = key;
+    return IMC_SUCCESS;
+}
+
+// Give back a context obtained from '__key_cache_get()'
+static void __key_cache_release(KeyCache *cache, CachedKey *key)
+{
+    pthread_mutex_lock(&cache->lock);
+    __key_unref(key);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Remove one holder of a cached context, and free the context if it was the last one (the cache's lock should be held)
+static void __key_unref(CachedKey *key)
+{
+    if (--key->refs > 0) return;
+    imc_crypto_context_destroy(key->crypto);
+    imc_free(key);
+}
+
+// Add the time that a request took to the histogram of its operation
+static void __latency_record(LatencyHistogram *histogram, uint64_t microseconds)
+{
+    // Index of the highest bit set
+    size_t bucket = 0;
+    uint64_t value = microseconds;
+    while (value > 1 && bucket < IMC_SERVER_LATENCY_BUCKETS - 1)
+    {
+        value >>= 1;
+        bucket++;
+    }
+
+    atomic_fetch_add(&histogram->bucket[bucket], 1);
+    atomic_fetch_add(&histogram->count, 1);
+    atomic_fetch_add(&histogram->total_us, microseconds);
+}
+
+// Approximate percentile (from 0 to 100) of the latency of an operation, in microseconds
+// It returns the upper bound of the bucket where the percentile falls.
+static uint64_t __latency_percentile(const LatencyHistogram *histogram, double percentile)
+{
+    const uint64_t count = atomic_load(&histogram->count);
+    if (count == 0) return 0;
+
+    // Amount of requests that should be at or below the percentile
+    uint64_t target = (uint64_t)ceil((double)count * percentile / 100.0);
+    if (target == 0) target = 1;
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < IMC_SERVER_LATENCY_BUCKETS; i++)
+    {
+        total += atomic_load(&histogram->bucket[i]);
+        if (total >= target) return ((uint64_t)1 << (i + 1)) - 1;
+    }
+
+    return ((uint64_t)1 << IMC_SERVER_LATENCY_BUCKETS) - 1;
+}
+
+// Microseconds elapsed since an arbitrary point in time (monotonic clock)
+static inline uint64_t __time_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+// Make sure that a buffer can store at least 'capacity' bytes
+static void __buffer_reserve(ServerBuffer *buffer, size_t capacity)
+{
+    if (capacity <= buffer->capacity) return;
+
+    // Grow the buffer geometrically, so appending many small values does not reallocate it every time
+    size_t new_capacity = (buffer->capacity > 0) ? buffer->capacity : 4096;
+    while (new_capacity < capacity) new_capacity *= 2;
+
+    buffer->data = imc_realloc(buffer->data, new_capacity);
+    buffer->capacity = new_capacity;
+}
+
+// Add bytes to the end of a buffer
+static void __buffer_append(ServerBuffer *buffer, const void *data, size_t size)
+{
+    __buffer_reserve(buffer, buffer->length + size);
+    if (size > 0) memcpy(&buffer->data[buffer->length], data, size);
+    buffer->length += size;
+}
+
+// Add a little-endian integer of 2, 4 or 8 bytes to the end of a buffer
+static void __buffer_u16(ServerBuffer *buffer, uint16_t value)
+{
+    const uint16_t value_le = htole16(value);
+    __buffer_append(buffer, &value_le, sizeof(value_le));
+}
+
+static void __buffer_u32(ServerBuffer *buffer, uint32_t value)
+{
+    const uint32_t value_le = htole32(value);
+    __buffer_append(buffer, &value_le, sizeof(value_le));
+}
+
+static void __buffer_u64(ServerBuffer *buffer, uint64_t value)
+{
+    const uint64_t value_le = htole64(value);
+    __buffer_append(buffer, &value_le, sizeof(value_le));
+}
+
+// Add a timestamp (seconds and nanoseconds, 8 bytes each) to the end of a buffer
+static void __buffer_time(ServerBuffer *buffer, struct timespec time)
+{
+    __buffer_u64(buffer, (uint64_t)(int64_t)time.tv_sec);
+    __buffer_u64(buffer, (uint64_t)(int64_t)time.tv_nsec);
+}
+
+// Add text to the end of a buffer (the text has the same format as 'printf()')
+static void __buffer_printf(ServerBuffer *buffer, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int size = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (size <= 0) return;
+
+    // One extra byte for the null terminator written by 'vsnprintf()' (it is not counted on the length)
+    __buffer_reserve(buffer, buffer->length + size + 1);
+    va_start(args, format);
+    vsnprintf((char *)&buffer->data[buffer->length], size + 1, format, args);
+    va_end(args);
+    buffer->length += size;
+}
+
+// Read a little-endian integer of 1, 2, 4 or 8 bytes from a request
+// The functions return 'false' if the request has no enough bytes left.
+static bool __read_u8(RequestReader *reader, uint8_t *out)
+{
+    if (reader->left < 1) return false;
+    *out = *reader->pos++;
+    reader->left--;
+    return true;
+}
+
+static bool __read_u16(RequestReader *reader, uint16_t *out)
+{
+    uint16_t value;
+    if (reader->left < sizeof(value)) return false;
+    memcpy(&value, reader->pos, sizeof(value));
+    reader->pos += sizeof(value);
+    reader->left -= sizeof(value);
+    *out = le16toh(value);
+    return true;
+}
+
+static bool __read_u32(RequestReader *reader, uint32_t *out)
+{
+    uint32_t value;
+    if (reader->left < sizeof(value)) return false;
+    memcpy(&value, reader->pos, sizeof(value));
+    reader->pos += sizeof(value);
+    reader->left -= sizeof(value);
+    *out = le32toh(value);
+    return true;
+}
+
+static bool __read_u64(RequestReader *reader, uint64_t *out)
+{
+    uint64_t value;
+    if (reader->left < sizeof(value)) return false;
+    memcpy(&value, reader->pos, sizeof(value));
+    reader->pos += sizeof(value);
+    reader->left -= sizeof(value);
+    *out = le64toh(value);
+    return true;
+}
+
+// Get a pointer to the next 'size' bytes of a request (returns 'false' if the request has no enough bytes left)
+static bool __read_bytes(RequestReader *reader, size_t size, const uint8_t **out)
+{
+    if (reader->left < size) return false;
+    *out = reader->pos;
+    reader->pos += size;
+    reader->left -= size;
+    return true;
+}
+
+// Read a timestamp (seconds and nanoseconds, 8 bytes each) from a request
+static bool __read_time(RequestReader *reader, struct timespec *out)
+{
+    uint64_t seconds, nanoseconds;
+    if (!__read_u64(reader, &seconds) || !__read_u64(reader, &nanoseconds)) return false;
+    if (nanoseconds >= 1000000000) return false;
+    out->tv_sec = (time_t)(int64_t)seconds;
+    out->tv_nsec = (long)nanoseconds;
+    return true;
+}
+
+// Receive exactly 'size' bytes from a connection
+// While waiting for data, the function gives up if the server is asked to stop, or once the time reaches 'deadline' (from '__time_us()').
+// Returns 'false' if the connection was closed, failed, timed out, or if the server is stopping.
+static bool __receive_all(int socket_fd, uint8_t *buffer, size_t size, uint64_t deadline)
+{
+    size_t received = 0;
+
+    while (received < size)
+    {
+        const ssize_t count = recv(socket_fd, &buffer[received], size - received, 0);
+
+        if (count > 0)
+        {
+            received += count;
+        }
+        else if (count == 0)
+        {
+            return false;   // The client has closed the connection
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            // The receive timeout has expired: check whether the server should stop, or the client took too long
+            if (server_stop || __time_us() >= deadline) return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Send exactly 'size' bytes through a connection
+// Returns 'false' if the connection was closed, failed, or if the client did not read it before 'deadline' (from '__time_us()').
+static bool __send_all(int socket_fd, const uint8_t *buffer, size_t size, uint64_t deadline)
+{
+    size_t sent = 0;
+
+    while (sent < size)
+    {
+        // The MSG_NOSIGNAL flag prevents the program from being killed by SIGPIPE if the client has gone away
+        const ssize_t count = send(socket_fd, &buffer[sent], size - sent, MSG_NOSIGNAL);
+        if (count > 0) sent += count;
+        else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            if (server_stop || __time_us() >= deadline) return false;
+        }
+        else return false;
+    }
+
+    return true;
+}
+
+// Hide a file on the image of a request, then write the image to the response
+static int __serve_hide(CarrierImage *carrier_img, RequestReader *reader, uint8_t flags, ServerBuffer *output)
+{
+    uint16_t name_size;
+    uint32_t file_size;
+    const uint8_t *name_bytes, *file_data;
+    struct timespec mod_time;
+
+    if ( !__read_u16(reader, &name_size) ||
+         !__read_bytes(reader, name_size, &name_bytes) ||
+         !__read_u32(reader, &file_size) ||
+         !__read_bytes(reader, file_size, &file_data) ||
+         !__read_time(reader, &mod_time) )
+    {
+        return IMC_ERR_FILE_CORRUPTED;
+    }
+
+    // The name is not null-terminated on the request
+    char file_name[name_size + 1];
+    memcpy(file_name, name_bytes, name_size);
+    file_name[name_size] = '\0';
+    if (name_size == 0 || memchr(file_name, '\0', name_size)) return IMC_ERR_FILE_INVALID;
+
+    if (flags & IMC_REQUEST_APPEND) imc_steg_seek_to_end(carrier_img);
+
+    const int insert_status = imc_steg_insert_memory(carrier_img, file_name, file_data, file_size, mod_time);
+    if (insert_status != IMC_SUCCESS) return insert_status;
+
+    uint8_t *image = NULL;
+    size_t image_size = 0;
+    const int save_status = imc_steg_save_memory(carrier_img, &image, &image_size);
+    if (save_status != IMC_SUCCESS) return save_status;
+
+    if (image_size > UINT32_MAX)
+    {
+        imc_free(image);
+        return IMC_ERR_INPUT_TOO_BIG;
+    }
+
+    __buffer_u32(output, (uint32_t)image_size);
+    __buffer_append(output, image, image_size);
+    imc_free(image);
+
+    return IMC_SUCCESS;
+}
+
+// Extract (or check for) the hidden files on the image of a request, then write them to the response
+static int __serve_extract(CarrierImage *carrier_img, bool just_check, ServerBuffer *output)
+{
+    // The amount of files is only known at the end, so its position on the response is reserved
+    const size_t count_pos = output->length;
+    __buffer_u32(output, 0);
+    uint32_t file_count = 0;
+
+    while (true)
+    {
+        FileMetadata *info = NULL;
+        uint8_t *data = NULL;
+        const int status = imc_steg_extract_memory(carrier_img, &info, &data);
+
+        // There are no more hidden files
+        if (status == IMC_ERR_INVALID_MAGIC || status == IMC_ERR_PAYLOAD_OOB) break;
+
+        if (status != IMC_SUCCESS)
+        {
+            // An error on the first file is reported, otherwise the files found so far are sent
+            if (file_count == 0) return status;
+            break;
+        }
+
+        const size_t name_length = info->name_size - 1;
+        if (name_length > UINT16_MAX || info->file_size > UINT32_MAX)
+        {
+            imc_clear_free(data, info->file_size + 1);
+            imc_free(info);
+            return (file_count == 0) ? IMC_ERR_FILE_CORRUPTED : IMC_SUCCESS;
+        }
+
+        __buffer_u16(output, (uint16_t)name_length);
+        __buffer_append(output, info->file_name, name_length);
+        __buffer_time(output, info->mod_time);
+        __buffer_time(output, info->steg_time);
+        __buffer_u32(output, (uint32_t)info->file_size);
+        if (!just_check) __buffer_append(output, data, info->file_size);
+        file_count++;
+
+        imc_clear_free(data, info->file_size + 1);
+        imc_free(info);
+    }
+
+    const uint32_t count_le = htole32(file_count);
+    memcpy(&output->data[count_pos], &count_le, sizeof(count_le));
+
+    if (just_check)
+    {
+        __buffer_u64(output, (carrier_img->carrier_lenght - carrier_img->carrier_pos) / 8);
+    }
+
+    return IMC_SUCCESS;
+}
+
+// Write to the response the latency of each operation and the usage of the caches
+static void __serve_stats(ServerState *server, ServerBuffer *output)
+{
+    static const char *const op_name[IMC_SERVER_OP_COUNT] = {"hide", "extract", "check", "stats"};
+
+    for (size_t i = 0; i < IMC_SERVER_OP_COUNT; i++)
+    {
+        const LatencyHistogram *const histogram = &server->latency[i];
+        const uint64_t count = atomic_load(&histogram->count);
+        const double mean = (count > 0) ? (double)atomic_load(&histogram->total_us) / count / 1000.0 : 0.0;
+
+        __buffer_printf(output,
+            "%-8s %10llu requests, mean %.2f ms, p50 <= %.2f ms, p90 <= %.2f ms, p99 <= %.2f ms\n",
+            op_name[i], (unsigned long long)count, mean,
+            __latency_percentile(histogram, 50.0) / 1000.0,
+            __latency_percentile(histogram, 90.0) / 1000.0,
+            __latency_percentile(histogram, 99.0) / 1000.0
+        );
+    }
+
+    KeyCache *const cache = &server->cache;
+    pthread_mutex_lock(&cache->lock);
+    size_t cache_used = 0;
+    for (size_t i = 0; i < IMC_SERVER_CACHE_SIZE; i++) cache_used += (cache->entry[i].key != NULL);
+    const uint64_t hits = cache->hits;
+    const uint64_t misses = cache->misses;
+    pthread_mutex_unlock(&cache->lock);
+
+    __buffer_printf(output, "key cache: %llu hits, %llu misses, %zu of %d entries in use\n",
+        (unsigned long long)hits, (unsigned long long)misses, cache_used, IMC_SERVER_CACHE_SIZE
+    );
+
+    // The queue no longer exists after the server has stopped
+    if (!server->queue) return;
+    
+    QueueStats queue;
+    imc_queue_stats(server->queue, &queue);
+    __buffer_printf(output,
+        "requests: %zu being served, %zu waiting (peak %zu of %zu), %llu finished, %llu waits for a free slot\n",
+        queue.busy, queue.depth, queue.peak, queue.capacity,
+        (unsigned long long)queue.processed, (unsigned long long)queue.full_waits
+    );
+}
+
+// Process the request on the worker's input buffer, and write the response on the worker's output buffer
+// Returns the operation that was requested (0 if the request was not valid).
+static uint8_t __serve_request(ServerState *server, size_t worker)
+{
+    const ServerBuffer *const input = &server->input[worker];
+    ServerBuffer *const output = &server->output[worker];
+    RequestReader reader = {.pos = input->data, .left = input->length};
+
+    // Space for the response's size and status (they are filled at the end)
+    output->length = 0;
+    __buffer_reserve(output, 8);
+    output->length = 8;
+
+    uint8_t op = 0;
+    uint8_t flags = 0;
+    uint16_t pass_size = 0;
+    uint32_t image_size = 0;
+    const uint8_t *pass_bytes = NULL;
+    const uint8_t *image_data = NULL;
+    int status = IMC_SUCCESS;
+
+    if ( !__read_u8(&reader, &op) ||
+         !__read_u8(&reader, &flags) ||
+         !__read_u16(&reader, &pass_size) ||
+         !__read_bytes(&reader, pass_size, &pass_bytes) ||
+         !__read_u32(&reader, &image_size) ||
+         !__read_bytes(&reader, image_size, &image_data) )
+    {
+        status = IMC_ERR_FILE_CORRUPTED;
+        op = 0;
+    }
+    else if (op < IMC_OP_HIDE || op > IMC_OP_STATS)
+    {
+        status = IMC_ERR_UNSUPPORTED;
+        op = 0;
+    }
+    else if (op == IMC_OP_STATS)
+    {
+        __serve_stats(server, output);
+    }
+    else if (image_size == 0)
+    {
+        status = IMC_ERR_FILE_INVALID;
+    }
+    else
+    {
+        PassBuff *password = NULL;
+        CachedKey *key = NULL;
+        CarrierImage *carrier_img = NULL;
+        const StegOptions options = {
+            .flags = (op == IMC_OP_CHECK) ? IMC_JUST_CHECK : 0,
+            .image_data = image_data,
+            .image_size = image_size,
+        };
+
+        status = imc_crypto_password_create(pass_bytes, pass_size, &password);
+        sodium_memzero((uint8_t *)pass_bytes, pass_size);   // The input buffer is reused by the next requests
+        if (status == IMC_SUCCESS) status = __key_cache_get(&server->cache, password, &key);
+        if (status == IMC_SUCCESS) status = imc_steg_init_context(NULL, key->crypto, &carrier_img, &options);
+        if (key) __key_cache_release(&server->cache, key);
+
+        if (status == IMC_SUCCESS)
+        {
+            if (op == IMC_OP_HIDE) status = __serve_hide(carrier_img, &reader, flags, output);
+            else status = __serve_extract(carrier_img, (op == IMC_OP_CHECK), output);
+            imc_steg_finish(carrier_img);
+        }
+
+        if (password) imc_crypto_password_free(password);
+    }
+
+    // On failure, the response has only the status
+    if (status != IMC_SUCCESS) output->length = 8;
+
+    const uint32_t size_le = htole32((uint32_t)(output->length - 4));
+    const uint32_t status_le = htole32((uint32_t)(int32_t)status);
+    memcpy(&output->data[0], &size_le, sizeof(size_le));
+    memcpy(&output->data[4], &status_le, sizeof(status_le));
+
+    return op;
+}
+
+// Task of the worker threads: serve one request of a connection, then give the connection back to the main thread
+// (so a worker is not held by a client that stays connected without sending requests)
+static void __serve_connection(void *context, void *item, size_t worker)
+{
+    ServerState *const server = (ServerState *)context;
+    const int client_fd = *(int *)item;
+    imc_free(item);
+
+    ServerBuffer *const input = &server->input[worker];
+    ServerBuffer *const output = &server->output[worker];
+    bool keep = false;
+
+    // The whole request must arrive before the deadline, and so must the response be read after it is ready
+    // (otherwise a client that stops halfway would hold the worker indefinitely)
+    const uint64_t start = __time_us();
+    const uint64_t timeout = (uint64_t)IMC_SERVER_REQUEST_TIMEOUT * 1000000;
+    const uint64_t deadline = start + timeout;
+
+    do {
+        // Size of the request
+        uint32_t size_le;
+        if (!__receive_all(client_fd, (uint8_t *)&size_le, sizeof(size_le), deadline)) break;
+        const uint32_t size = le32toh(size_le);
+
+        if (size > IMC_SERVER_MAX_MESSAGE)
+        {
+            // The rest of the request is not read, so the connection cannot be used anymore
+            const uint32_t refusal[2] = {htole32(4), htole32((uint32_t)(int32_t)IMC_ERR_INPUT_TOO_BIG)};
+            __send_all(client_fd, (const uint8_t *)refusal, sizeof(refusal), deadline);
+            break;
+        }
+
+        __buffer_reserve(input, size);
+        input->length = size;
+        if (!__receive_all(client_fd, input->data, size, deadline)) break;
+
+        const uint8_t op = __serve_request(server, worker);
+        keep = __send_all(client_fd, output->data, output->length, __time_us() + timeout);
+
+        const uint64_t elapsed = __time_us() - start;
+        if (op > 0) __latency_record(&server->latency[op - 1], elapsed);
+
+        if (server->verbose)
+        {
+            static const char *const op_name[IMC_SERVER_OP_COUNT + 1] = {"invalid", "hide", "extract", "check", "stats"};
+            int32_t status;
+            memcpy(&status, &output->data[4], sizeof(status));
+            status = (int32_t)le32toh((uint32_t)status);
+            printf("Worker %zu: %s request of %zu bytes, %s (%.2f ms).\n",
+                worker, op_name[op], (size_t)size, imc_strerror(status), elapsed / 1000.0
+            );
+            fflush(stdout);
+        }
+    } while (false);
+
+    if (keep)
+    {
+        __connection_return(server, client_fd);
+    }
+    else
+    {
+        close(client_fd);
+        atomic_fetch_sub(&server->connection_count, 1);
+    }
+}
+
+// Give a connection back to the main thread, which waits for its next request
+static void __connection_return(ServerState *server, int client_fd)
+{
+    pthread_mutex_lock(&server->returned_lock);
+    if (server->returned_count == server->returned_capacity)
+    {
+        server->returned_capacity = server->returned_capacity ? server->returned_capacity * 2 : 16;
+        server->returned = imc_realloc(server->returned, server->returned_capacity * sizeof(int));
+    }
+    server->returned[server->returned_count++] = client_fd;
+    pthread_mutex_unlock(&server->returned_lock);
+
+    // Wake up the main thread, if it is waiting
+    // (the pipe does not block: if it is full, the main thread is going to wake up anyway)
+    const uint8_t signal_byte = 1;
+    ssize_t written = write(server->wake_fd[1], &signal_byte, 1);
+    (void)written;
+}
+
+// Create the socket at 'socket_path' and start listening on it
+// A socket left on the path by a server that is no longer running is replaced.
+static int __server_listen(const char *socket_path, int *out_fd)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path)) return IMC_ERR_NAME_TOO_LONG;
+    strcpy(address.sun_path, socket_path);
+
+    // Check whether something already exists on the path
+    struct stat path_stat;
+    if (lstat(socket_path, &path_stat) == 0)
+    {
+        if (!S_ISSOCK(path_stat.st_mode)) return IMC_ERR_FILE_EXISTS;
+
+        // Only a socket that is not accepting connections is removed
+        const int probe_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe_fd < 0) return IMC_ERR_SAVE_FAIL;
+        const int probe = connect(probe_fd, (struct sockaddr *)&address, sizeof(address));
+        const int probe_errno = errno;
+        close(probe_fd);
+
+        if (probe == 0 || probe_errno != ECONNREFUSED)
+        {
+            errno = EADDRINUSE;
+            return IMC_ERR_FILE_EXISTS;
+        }
+
+        unlink(socket_path);
+    }
+
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) return IMC_ERR_SAVE_FAIL;
+
+    // Only the user running the server can connect to it
+    if ( bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+         chmod(socket_path, S_IRUSR | S_IWUSR) != 0 ||
+         listen(listen_fd, SOMAXCONN) != 0 )
+    {
+        const int listen_errno = errno;
+        close(listen_fd);
+        unlink(socket_path);
+        errno = listen_errno;
+        return IMC_ERR_SAVE_FAIL;
+    }
+
+    *out_fd = listen_fd;
+    return IMC_SUCCESS;
+}
+
+#endif  // _WIN32
+
+// Listen on the Unix-domain socket at 'socket_path', and serve the requests of its clients until SIGINT or SIGTERM is received
+// The requests are processed by 'thread_count' worker threads (0 for the amount of logical processors), one request per thread.
+// When 'verbose' is true, a line is printed for each request. Unless 'silent' is true, the statistics are printed when stopping.
+// Returns IMC_ERR_UNSUPPORTED on systems without Unix-domain sockets.
+int imc_server_run(const char *socket_path, size_t thread_count, bool verbose, bool silent)
+{
+    #ifdef _WIN32
+    (void)socket_path;
+    (void)thread_count;
+    (void)verbose;
+    (void)silent;
+    return IMC_ERR_UNSUPPORTED;
+
+    #else   // Linux systems
+    if (sodium_init() < 0) return IMC_ERR_CRYPTO_FAIL;
+    if (thread_count == 0) thread_count = imc_cpu_count();
+
+    int listen_fd = -1;
+    const int listen_status = __server_listen(socket_path, &listen_fd);
+    if (listen_status != IMC_SUCCESS) return listen_status;
+
+    // Stop on Ctrl+C or on a termination request
+    // (SA_RESTART is not used, so the waiting for connections is interrupted by the signal)
+    server_stop = 0;
+    struct sigaction action = {.sa_handler = &__server_signal};
+    sigemptyset(&action.sa_mask);
+    struct sigaction old_int, old_term;
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    ServerState *const server = imc_calloc(1, sizeof(ServerState));
+    server->verbose = verbose;
+    server->worker_count = thread_count;
+    server->input = imc_calloc(thread_count, sizeof(ServerBuffer));
+    server->output = imc_calloc(thread_count, sizeof(ServerBuffer));
+    randombytes_buf(server->cache.hash_key, sizeof(server->cache.hash_key));
+    pthread_mutex_init(&server->cache.lock, NULL);
+
+    pthread_mutex_init(&server->returned_lock, NULL);
+    atomic_init(&server->connection_count, 0);
+    if (pipe(server->wake_fd) == 0)
+    {
+        fcntl(server->wake_fd[0], F_SETFL, O_NONBLOCK);
+        fcntl(server->wake_fd[1], F_SETFL, O_NONBLOCK);
+    }
+    else
+    {
+        // Without the pipe, the returned connections are only noticed on the next poll interval
+        server->wake_fd[0] = server->wake_fd[1] = -1;
+    }
+
+    /* Note: the main thread waits for the requests on all open connections, and a connection goes to a worker only when it has
+       a request. After the response, the worker gives the connection back to the main thread, so clients that stay connected
+       without sending requests do not hold any worker. The connections with a request wait on the queue, and when the queue is full
+       the main thread waits until a worker is free. Beyond 'IMC_SERVER_MAX_CONNECTIONS' open connections, no more connections
+       are accepted until some are closed (the operating system then holds them on its backlog). */
+    server->queue = imc_queue_create(thread_count * IMC_SERVER_BACKLOG, thread_count, &__serve_connection, server);
+
+    if (!silent)
+    {
+        printf("Listening on '%s' with %zu worker thread%s (press Ctrl+C to stop)...\n",
+            socket_path, thread_count, (thread_count == 1) ? "" : "s"
+        );
+        fflush(stdout);
+    }
+
+    // Connections waiting for their next request (the first two watched descriptors are the socket and the pipe)
+    int *idle = NULL;
+    size_t idle_count = 0;
+    size_t idle_capacity = 0;
+    struct pollfd *watch = imc_malloc(2 * sizeof(struct pollfd));
+
+    while (!server_stop)
+    {
+        // Take the connections that the workers gave back
+        pthread_mutex_lock(&server->returned_lock);
+        if (idle_count + server->returned_count > idle_capacity)
+        {
+            idle_capacity = (idle_count + server->returned_count) * 2;
+            idle = imc_realloc(idle, idle_capacity * sizeof(int));
+            watch = imc_realloc(watch, (idle_capacity + 2) * sizeof(struct pollfd));
+        }
+        for (size_t i = 0; i < server->returned_count; i++) idle[idle_count++] = server->returned[i];
+        server->returned_count = 0;
+        pthread_mutex_unlock(&server->returned_lock);
+
+        const bool accepting = atomic_load(&server->connection_count) < IMC_SERVER_MAX_CONNECTIONS;
+        watch[0] = (struct pollfd){.fd = accepting ? listen_fd : -1, .events = POLLIN};
+        watch[1] = (struct pollfd){.fd = server->wake_fd[0], .events = POLLIN};
+        for (size_t i = 0; i < idle_count; i++) watch[i + 2] = (struct pollfd){.fd = idle[i], .events = POLLIN};
+
+        const int ready = poll(watch, idle_count + 2, IMC_SERVER_POLL_INTERVAL);
+        if (ready <= 0) continue;
+
+        // Empty the pipe (the connections it signals are taken on the next iteration)
+        if (watch[1].revents & POLLIN)
+        {
+            uint8_t drain[64];
+            while (read(server->wake_fd[0], drain, sizeof(drain)) > 0);
+        }
+
+        // Send to the workers the connections that have a request (or that were closed by the client)
+        size_t kept = 0;
+        for (size_t i = 0; i < idle_count; i++)
+        {
+            if (watch[i + 2].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                int *const item = imc_malloc(sizeof(int));
+                *item = idle[i];
+                if (!imc_queue_push(server->queue, item))
+                {
+                    close(idle[i]);
+                    imc_free(item);
+                    atomic_fetch_sub(&server->connection_count, 1);
+                }
+            }
+            else
+            {
+                idle[kept++] = idle[i];
+            }
+        }
+        idle_count = kept;
+
+        // Accept a new connection
+        if (!(watch[0].revents & POLLIN)) continue;
+        const int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0) continue;
+
+        // Receiving and sending time out periodically, so a request that stops halfway can notice
+        // when the server is stopping or when the request is past its deadline
+        const struct timeval timeout = {.tv_sec = 1, .tv_usec = 0};
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        if (idle_count == idle_capacity)
+        {
+            idle_capacity = idle_capacity ? idle_capacity * 2 : 16;
+            idle = imc_realloc(idle, idle_capacity * sizeof(int));
+            watch = imc_realloc(watch, (idle_capacity + 2) * sizeof(struct pollfd));
+        }
+        idle[idle_count++] = client_fd;
+        atomic_fetch_add(&server->connection_count, 1);
+    }
+
+    // Stop accepting connections, then wait for the requests being processed
+    close(listen_fd);
+    unlink(socket_path);
+    imc_queue_finish(server->queue);
+    server->queue = NULL;
+
+    // Close the connections that were waiting for a request
+    for (size_t i = 0; i < idle_count; i++) close(idle[i]);
+    for (size_t i = 0; i < server->returned_count; i++) close(server->returned[i]);
+    imc_free(idle);
+    imc_free(watch);
+    imc_free(server->returned);
+    pthread_mutex_destroy(&server->returned_lock);
+    if (server->wake_fd[0] >= 0)
+    {
+        close(server->wake_fd[0]);
+        close(server->wake_fd[1]);
+    }
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+
+    if (!silent)
+    {
+        ServerBuffer stats = {0};
+        __serve_stats(server, &stats);
+        printf("\nServer stopped.\n");
+        fwrite(stats.data, 1, stats.length, stdout);
+        imc_free(stats.data);
+    }
+
+    // Free the server's memory
+    for (size_t i = 0; i < IMC_SERVER_CACHE_SIZE; i++)
+    {
+        if (server->cache.entry[i].key) __key_unref(server->cache.entry[i].key);
+    }
+    sodium_memzero(server->cache.hash_key, sizeof(server->cache.hash_key));
+    pthread_mutex_destroy(&server->cache.lock);
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        imc_free(server->input[i].data);
+        imc_free(server->output[i].data);
+    }
+    imc_free(server->input);
+    imc_free(server->output);
+    imc_free(server);
+
+    return IMC_SUCCESS;
+
+    #endif  // _WIN32
+}
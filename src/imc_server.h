@@ -0,0 +1,241 @@
+/* Long-running daemon that hides, extracts and checks files for the clients of a Unix-domain socket. */
+
+#ifndef _IMC_SERVER_H
+#define _IMC_SERVER_H
+
+#include "imc_includes.h"
+
+/*  Binary format of the messages exchanged with the server
+    (Note: all numeric values are stored in little-endian byte order, and the timestamps
+     are two signed 8-byte values: the seconds since the Unix epoch, then the nanoseconds in the current second)
+
+    The client can send any number of requests over the same connection, and each request gets one response
+    (in the same order). Each request and each response is prefixed by its size, so one message can be read
+    without having to parse it.
+
+    Request:
+    - 4 bytes: size in bytes of the rest of the request
+    - 1 byte: operation (1 = hide, 2 = extract, 3 = check, 4 = statistics of the server)
+    - 1 byte: flags (bit 0 = append the hidden file to the existing ones, when hiding)
+    - 2 bytes: size in bytes of the password (0 means no password)
+    - (variable): password (encoded in UTF-8, without a null terminator)
+    - 4 bytes: size in bytes of the cover image
+    - (variable): cover image (JPEG, PNG, WebP, BMP, PNM or TIFF)
+    When hiding a file, the request continues with:
+    - 2 bytes: size in bytes of the file's name (without a null terminator)
+    - (variable): file's name (encoded in UTF-8)
+    - 4 bytes: size in bytes of the file
+    - (variable): the file itself
+    - 16 bytes: timestamp of the file's last modified time
+    (the statistics request should have empty password and image, the other operations require an image)
+
+    Response:
+    - 4 bytes: size in bytes of the rest of the response
+    - 4 bytes: status code (signed 32-bit, one of the IMC_SUCCESS or IMC_ERR_* values on 'imgconceal.h')
+    If the status is IMC_SUCCESS, the response continues according to the operation:
+    - Hide:
+        - 4 bytes: size in bytes of the image with the hidden file
+        - (variable): the image with the hidden file (same format as the cover image)
+    - Extract or check:
+        - 4 bytes: amount of hidden files found (0 if the image has no data hidden with that password)
+        - For each hidden file:
+            - 2 bytes: size in bytes of the file's name
+            - (variable): file's name (encoded in UTF-8, without a null terminator)
+            - 16 bytes: timestamp of the file's last modified time
+            - 16 bytes: timestamp of when the file was hidden
+            - 4 bytes: size in bytes of the file
+            - (variable): the file itself (only on extract, the check operation omits the file's contents)
+        - 8 bytes: how many bytes can still be hidden after the last hidden file (only on check)
+    - Statistics:
+        - (variable): text (encoded in UTF-8) with the latency of each operation and the usage of the caches
+*/
+
+// Operations that a client can request
+enum ServerOperation {IMC_OP_HIDE = 1, IMC_OP_EXTRACT = 2, IMC_OP_CHECK = 3, IMC_OP_STATS = 4};
+
+// Amount of different operations (for indexing arrays by operation)
+#define IMC_SERVER_OP_COUNT 4
+
+// Flags of a request
+#define IMC_REQUEST_APPEND (uint8_t)1   // Append the hidden file instead of overwriting the existing ones
+
+// Maximum size in bytes of a request (larger requests are refused, and their connection is closed)
+#define IMC_SERVER_MAX_MESSAGE 1000000000
+
+// Maximum amount of cryptographic contexts kept in memory (the least recently used one is discarded when it is full)
+#define IMC_SERVER_CACHE_SIZE 32
+
+// Amount of buckets on the latency histograms (the bucket 'n' counts the requests that took from 2^n to 2^(n+1) - 1 microseconds)
+#define IMC_SERVER_LATENCY_BUCKETS 32
+
+// How often (in milliseconds) the server checks whether it should stop
+#define IMC_SERVER_POLL_INTERVAL 500
+
+// Maximum time (in seconds) that a client has to send a request (counted from when a worker takes it), and to read its response
+#define IMC_SERVER_REQUEST_TIMEOUT 60
+
+// Maximum amount of connections with a request waiting for a worker thread, per worker
+#define IMC_SERVER_BACKLOG 4
+
+// Maximum amount of open connections (beyond that, the new connections wait on the backlog of the operating system)
+#define IMC_SERVER_MAX_CONNECTIONS 1024
+
+#ifndef _WIN32
+
+// Cryptographic context derived from a password, shared by the cache and by the requests using it
+typedef struct CachedKey {
+    CryptoContext *crypto;  // Context before any use (it is never changed, only copied to the images)
+    size_t refs;            // Amount of holders: the cache (while the key is on it) and the requests using the key
+} CachedKey;
+
+// Context of a password, stored for reuse by the next requests with the same password
+typedef struct KeyCacheEntry {
+    uint8_t hash[crypto_generichash_BYTES]; // Keyed hash of the password
+    CachedKey *key;         // Context derived from the password (NULL if the entry is empty)
+    uint64_t last_use;      // Value of the cache's clock when the entry was last used
+} KeyCacheEntry;
+
+// Least recently used cache of cryptographic contexts, indexed by the keyed hash of their passwords
+typedef struct KeyCache {
+    KeyCacheEntry entry[IMC_SERVER_CACHE_SIZE];
+    uint8_t hash_key[crypto_generichash_KEYBYTES];  // Random key for hashing the passwords (new for each run of the server)
+    uint64_t clock;         // Increases with each use of the cache
+    uint64_t hits;          // Amount of passwords found on the cache
+    uint64_t misses;        // Amount of passwords that had to be hashed
+    pthread_mutex_t lock;   // Lock for accessing the cache
+} KeyCache;
+
+// Histogram of how long the requests of an operation took to be served
+typedef struct LatencyHistogram {
+    atomic_uint_fast64_t bucket[IMC_SERVER_LATENCY_BUCKETS];    // Amount of requests, by power of 2 of the microseconds they took
+    atomic_uint_fast64_t count;     // Total amount of requests
+    atomic_uint_fast64_t total_us;  // Sum of the microseconds that all requests took
+} LatencyHistogram;
+
+// Buffer that is reused between requests (it only grows)
+// Note: only the requests and the responses use it, the images are decoded to their own buffers on each request.
+typedef struct ServerBuffer {
+    uint8_t *data;
+    size_t capacity;    // Amount of bytes allocated
+    size_t length;      // Amount of bytes in use
+} ServerBuffer;
+
+// Position on a request being parsed
+typedef struct RequestReader {
+    const uint8_t *pos; // Next byte to be read
+    size_t left;        // Amount of bytes remaining on the request
+} RequestReader;
+
+// State shared by all worker threads of the server
+typedef struct ServerState {
+    KeyCache cache;                 // Cryptographic contexts of the recent passwords
+    LatencyHistogram latency[IMC_SERVER_OP_COUNT];  // Latency of each operation (indexed by the operation minus 1)
+    ServerBuffer *input;            // Buffer where each worker receives its requests
+    ServerBuffer *output;           // Buffer where each worker builds its responses
+    size_t worker_count;            // Amount of worker threads
+    WorkQueue *queue;               // Connections with a request waiting for a worker thread
+    pthread_mutex_t returned_lock;  // Lock for the connections given back by the workers
+    int *returned;                  // Connections whose request was served, to be watched again by the main thread
+    size_t returned_count;          // Amount of connections on 'returned'
+    size_t returned_capacity;       // Amount of connections that fit on 'returned'
+    int wake_fd[2];                 // Pipe that wakes up the main thread when a connection is given back
+    atomic_size_t connection_count; // Amount of open connections
+    bool verbose;                   // Print a line for each request
+} ServerState;
+
+// Signal handler for SIGINT and SIGTERM: ask the server to stop
+static void __server_signal(int signal_number);
+
+// Get the cryptographic context of a password from the cache, hashing the password only if it is not there
+// The context is shared with the cache and with other requests, so it should only be copied (as 'imc_steg_init_context()' does).
+// It should be given back with '__key_cache_release()'.
+static int __key_cache_get(KeyCache *cache, const PassBuff *password, CachedKey **out);
+
+// Give back a context obtained from '__key_cache_get()'
+static void __key_cache_release(KeyCache *cache, CachedKey *key);
+
+// Remove one holder of a cached context, and free the context if it was the last one (the cache's lock should be held)
+static void __key_unref(CachedKey *key);
+
+// Add the time that a request took to the histogram of its operation
+static void __latency_record(LatencyHistogram *histogram, uint64_t microseconds);
+
+// Approximate percentile (from 0 to 100) of the latency of an operation, in microseconds
+// It returns the upper bound of the bucket where the percentile falls.
+static uint64_t __latency_percentile(const LatencyHistogram *histogram, double percentile);
+
+// Microseconds elapsed since an arbitrary point in time (monotonic clock)
+static inline uint64_t __time_us();
+
+// Make sure that a buffer can store at least 'capacity' bytes
+static void __buffer_reserve(ServerBuffer *buffer, size_t capacity);
+
+// Add bytes to the end of a buffer
+static void __buffer_append(ServerBuffer *buffer, const void *data, size_t size);
+
+// Add a little-endian integer of 2, 4 or 8 bytes to the end of a buffer
+static void __buffer_u16(ServerBuffer *buffer, uint16_t value);
+static void __buffer_u32(ServerBuffer *buffer, uint32_t value);
+static void __buffer_u64(ServerBuffer *buffer, uint64_t value);
+
+// Add a timestamp (seconds and nanoseconds, 8 bytes each) to the end of a buffer
+static void __buffer_time(ServerBuffer *buffer, struct timespec time);
+
+// Add text to the end of a buffer (the text has the same format as 'printf()')
+static void __buffer_printf(ServerBuffer *buffer, const char *format, ...);
+
+// Read a little-endian integer of 1, 2, 4 or 8 bytes from a request
+// The functions return 'false' if the request has no enough bytes left.
+static bool __read_u8(RequestReader *reader, uint8_t *out);
+static bool __read_u16(RequestReader *reader, uint16_t *out);
+static bool __read_u32(RequestReader *reader, uint32_t *out);
+static bool __read_u64(RequestReader *reader, uint64_t *out);
+
+// Get a pointer to the next 'size' bytes of a request (returns 'false' if the request has no enough bytes left)
+static bool __read_bytes(RequestReader *reader, size_t size, const uint8_t **out);
+
+// Read a timestamp (seconds and nanoseconds, 8 bytes each) from a request
+static bool __read_time(RequestReader *reader, struct timespec *out);
+
+// Receive exactly 'size' bytes from a connection
+// While waiting for data, the function gives up if the server is asked to stop, or once the time reaches 'deadline' (from '__time_us()').
+// Returns 'false' if the connection was closed, failed, timed out, or if the server is stopping.
+static bool __receive_all(int socket_fd, uint8_t *buffer, size_t size, uint64_t deadline);
+
+// Send exactly 'size' bytes through a connection
+// Returns 'false' if the connection was closed, failed, or if the client did not read it before 'deadline' (from '__time_us()').
+static bool __send_all(int socket_fd, const uint8_t *buffer, size_t size, uint64_t deadline);
+
+// Hide a file on the image of a request, then write the image to the response
+static int __serve_hide(CarrierImage *carrier_img, RequestReader *reader, uint8_t flags, ServerBuffer *output);
+
+// Extract (or check for) the hidden files on the image of a request, then write them to the response
+static int __serve_extract(CarrierImage *carrier_img, bool just_check, ServerBuffer *output);
+
+// Write to the response the latency of each operation and the usage of the caches
+static void __serve_stats(ServerState *server, ServerBuffer *output);
+
+// Process the request on the worker's input buffer, and write the response on the worker's output buffer
+// Returns the operation that was requested (0 if the request was not valid).
+static uint8_t __serve_request(ServerState *server, size_t worker);
+
+// Task of the worker threads: serve one request of a connection, then give the connection back to the main thread
+// (so a worker is not held by a client that stays connected without sending requests)
+static void __serve_connection(void *context, void *item, size_t worker);
+
+// Give a connection back to the main thread, which waits for its next request
+static void __connection_return(ServerState *server, int client_fd);
+
+// Create the socket at 'socket_path' and start listening on it
+// A socket left on the path by a server that is no longer running is replaced.
+static int __server_listen(const char *socket_path, int *out_fd);
+
+#endif  // _WIN32
+
+// Listen on the Unix-domain socket at 'socket_path', and serve the requests of its clients until SIGINT or SIGTERM is received
+// The requests are processed by 'thread_count' worker threads (0 for the amount of logical processors), one request per thread.
+// When 'verbose' is true, a line is printed for each request. Unless 'silent' is true, the statistics are printed when stopping.
+// Returns IMC_ERR_UNSUPPORTED on systems without Unix-domain sockets.
+int imc_server_run(const char *socket_path, size_t thread_count, bool verbose, bool silent);
+
+#endif  // _IMC_SERVER_H
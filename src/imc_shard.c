@@ -0,0 +1,574 @@
+/* Splitting of a file into shards hidden on many images (processed in parallel), and joining the shards back into the file. */
+
+#include "imc_includes.h"
+
+// Task of the worker threads when hiding: open one image with the secrets, then find how much of the stream fits on it
+static void __shard_open_task(void *context, size_t task, size_t worker)
+{
+    ShardJob *const job = (ShardJob *)context;
+    ShardCover *const cover = &job->cover[task];
+
+    const StegOptions options = {.cache_dir = job->cache_dir, .profile = job->profile};
+    cover->status = imc_steg_init_context(cover->path, job->crypto, &cover->carrier_img, &options);
+    if (cover->status == IMC_SUCCESS) cover->capacity = imc_steg_shard_capacity(cover->carrier_img);
+
+    const size_t done = atomic_fetch_add(&job->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(job->progress, "Opening images... %.1f %%\r", ((double)done / (double)job->count) * 100.0);
+}
+
+// Task of the worker threads when hiding: write the shard of one image, then save and close the image
+static void __shard_save_task(void *context, size_t task, size_t worker)
+{
+    ShardJob *const job = (ShardJob *)context;
+    ShardCover *const cover = &job->cover[task];
+
+    cover->status = imc_steg_insert_shard(cover->carrier_img, &cover->header, cover->crypto_header, cover->data, cover->data_size);
+
+    // The image is saved to the output folder under a temporary name, which is its name with a prefix
+    // ('basename()' may change its argument, so it gets a copy of the path)
+    if (cover->status == IMC_SUCCESS)
+    {
+        char path_copy[strlen(cover->path) + 1];
+        strcpy(path_copy, cover->path);
+        const char *const name = basename(path_copy);
+
+        const size_t save_size = strlen(job->out_dir) + strlen(name) + 64;
+        char save_path[save_size];
+        snprintf(save_path, save_size, "%s/" IMC_SHARD_TEMP_PREFIX "%zu-%s", job->out_dir, task, name);
+
+        cover->status = imc_steg_save(cover->carrier_img, save_path);
+        if (cover->status == IMC_SUCCESS) cover->out_path = strdup(cover->carrier_img->out_path);
+    }
+
+    imc_steg_finish(cover->carrier_img);
+    cover->carrier_img = NULL;
+
+    const size_t done = atomic_fetch_add(&job->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(job->progress, "Saving images... %.1f %%\r", ((double)done / (double)job->count) * 100.0);
+}
+
+// Remove the images that were saved for a set that failed, so no partial set is left on the output folder
+static void __shard_discard(ShardCover *covers, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!covers[i].out_path) continue;
+        remove(covers[i].out_path);
+        imc_free(covers[i].out_path);
+        covers[i].out_path = NULL;
+    }
+}
+
+// Move the saved images from their temporary names to their final names (without replacing existing files)
+// If any of them cannot be moved, all images of the set are removed, and the status of that image is returned.
+static int __shard_publish(ShardCover *covers, size_t count)
+{
+    const size_t prefix_len = strlen(IMC_SHARD_TEMP_PREFIX);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ShardCover *const cover = &covers[i];
+        char *const temp_path = cover->out_path;
+
+        // The final name is the temporary one without its prefix (the image's name, with any extension added when saving)
+        const char *name = strrchr(temp_path, '/');
+        name = name ? name + 1 : temp_path;
+        const size_t folder_len = (size_t)(name - temp_path);
+        const char *const final_name = &name[prefix_len + strspn(&name[prefix_len], "0123456789") + 1];
+
+        const size_t final_size = folder_len + strlen(final_name) + 1;
+        char final_path[final_size];
+        snprintf(final_path, final_size, "%.*s%s", (int)folder_len, temp_path, final_name);
+
+        cover->out_path = NULL;
+        cover->status = imc_move_file(temp_path, final_path, &cover->out_path);
+
+        if (cover->status != IMC_SUCCESS)
+        {
+            // Remove the images already moved, and the ones still under their temporary names
+            remove(temp_path);
+            imc_free(temp_path);
+            __shard_discard(covers, count);
+            return cover->status;
+        }
+
+        imc_free(temp_path);
+    }
+
+    return IMC_SUCCESS;
+}
+
+// Task of the worker threads when joining: open one image with the secrets, then read its shard
+static void __shard_read_task(void *context, size_t task, size_t worker)
+{
+    ShardJob *const job = (ShardJob *)context;
+    ShardCover *const cover = &job->cover[task];
+
+    const StegOptions options = {.cache_dir = job->cache_dir};
+    CarrierImage *carrier_img = NULL;
+    cover->status = imc_steg_init_context(cover->path, job->crypto, &carrier_img, &options);
+
+    if (cover->status == IMC_SUCCESS)
+    {
+        cover->status = imc_steg_read_shard(carrier_img, &cover->header, cover->crypto_header, &cover->data, &cover->data_size);
+        if (cover->status == IMC_SUCCESS) cover->part_size = cover->data_size - crypto_secretstream_xchacha20poly1305_ABYTES;
+        imc_steg_finish(carrier_img);
+    }
+
+    const size_t done = atomic_fetch_add(&job->done, 1) + 1;
+    if (worker == 0) imc_progress_rate(job->progress, "Reading shards... %.1f %%\r", ((double)done / (double)job->count) * 100.0);
+}
+
+// Order of the shards when joining: by their position on the set
+static int __shard_compare(const void *cover_a, const void *cover_b)
+{
+    const ShardCover *const a = *(const ShardCover *const *)cover_a;
+    const ShardCover *const b = *(const ShardCover *const *)cover_b;
+
+    const uint32_t index_a = le32toh(a->header.index);
+    const uint32_t index_b = le32toh(b->header.index);
+    if (index_a != index_b) return (index_a < index_b) ? -1 : 1;
+    return (a > b) - (a < b);
+}
+
+// Split the file at 'file_path' into one shard for each image on 'paths' (in that order), then save the images to 'out_dir'
+// The images are opened, and later saved, on up to 'thread_count' threads. Each image gets its own copy of 'crypto'.
+// Without parity, the stream is split in proportion to the capacity of each image, so all of them are filled by about the same fraction.
+// With 'parity_count' greater than zero, the last 'parity_count' images get parity shards, and the stream is split in equal parts
+// over the other images (so it must fit on the smallest image times the amount of data shards).
+// The images are saved with the encoder settings of 'profile'.
+// 'out_covers' receives the outcome of each image (to be freed with 'imc_shard_free()'), or NULL if the file could not be read.
+// Returns IMC_ERR_FILE_TOO_BIG if the file does not fit on the images, otherwise the status of the first image that
+// failed (or the status of reading the file). Nothing is saved unless all images could be opened, and the images keep
+// their final names only if all of them were saved (otherwise, the ones already saved are removed).
+int imc_shard_hide(
+    const char *file_path,
+    const char *const *paths,
+    size_t count,
+    size_t parity_count,
+    const CryptoContext *crypto,
+    const char *out_dir,
+    const char *cache_dir,
+    enum SaveProfile profile,
+    size_t thread_count,
+    const ProgressMonitor *progress,
+    ShardCover **out_covers
+)
+{
+    *out_covers = NULL;
+    if (count == 0 || count > UINT32_MAX || parity_count >= count) return IMC_ERR_FILE_TOO_BIG;
+    if (parity_count > 0 && count > IMC_ERASURE_MAX_SHARDS) return IMC_ERR_FILE_TOO_BIG;
+    const size_t data_count = count - parity_count;
+
+    // The file is compressed only once, for all the images
+    PreparedFile *prepared = NULL;
+    int status = imc_steg_prepare(file_path, progress, &prepared);
+    if (status != IMC_SUCCESS) return status;
+
+    ShardCover *const covers = imc_calloc(count, sizeof(ShardCover));
+    for (size_t i = 0; i < count; i++) covers[i].path = paths[i];
+    *out_covers = covers;
+
+    ShardJob job = {
+        .cover = covers,
+        .count = count,
+        .crypto = crypto,
+        .out_dir = out_dir,
+        .cache_dir = cache_dir,
+        .profile = profile,
+        .progress = progress,
+        .done = 0,
+    };
+
+    imc_parallel_for(count, thread_count, &__shard_open_task, &job);
+    imc_progress(progress, "Opening images... Done!  \n");
+
+    size_t total_capacity = 0;
+    size_t min_capacity = SIZE_MAX;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (covers[i].status != IMC_SUCCESS && status == IMC_SUCCESS) status = covers[i].status;
+        total_capacity += covers[i].capacity;
+        if (covers[i].capacity < min_capacity) min_capacity = covers[i].capacity;
+    }
+
+    // With parity, all shards have the size of the biggest part (a parity shard cannot be smaller than any data shard)
+    const size_t stream_size = prepared->stream_size;
+    const size_t full_part = (stream_size + data_count - 1) / data_count;
+
+    if (status == IMC_SUCCESS)
+    {
+        if (parity_count == 0 && total_capacity < stream_size) status = IMC_ERR_FILE_TOO_BIG;
+        if (parity_count > 0 && min_capacity < full_part) status = IMC_ERR_FILE_TOO_BIG;
+    }
+
+    if (status == IMC_SUCCESS && parity_count > 0)
+    {
+        // Equal parts, in order, until the stream ends (the last data shards may be left with a smaller or empty part)
+        size_t remaining = stream_size;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (i < data_count)
+            {
+                covers[i].part_size = (remaining < full_part) ? remaining : full_part;
+                remaining -= covers[i].part_size;
+            }
+            else
+            {
+                covers[i].part_size = full_part;
+            }
+        }
+    }
+    else if (status == IMC_SUCCESS)
+    {
+        // Split the stream in proportion to the capacity of each image (rounded down),
+        // then give the remaining bytes to the images that still have room for them
+        size_t remaining = stream_size;
+        for (size_t i = 0; i < count; i++)
+        {
+            covers[i].part_size = (size_t)(((uint64_t)stream_size * covers[i].capacity) / total_capacity);
+            remaining -= covers[i].part_size;
+        }
+
+        for (size_t i = 0; remaining > 0 && i < count; i++)
+        {
+            if (covers[i].part_size < covers[i].capacity)
+            {
+                covers[i].part_size++;
+                remaining--;
+            }
+        }
+        /* Note:
+            Each rounded down part is at most the image's capacity (since the stream fits on the images together),
+            and less than one byte is missing from each of them. So the second loop always places all remaining bytes.
+        */
+    }
+
+    if (status == IMC_SUCCESS)
+    {
+        // All shards get the same random identifier, and they are numbered in the order that the images were given
+        uint8_t set_id[IMC_SHARD_ID_SIZE];
+        randombytes_buf(set_id, sizeof(set_id));
+
+        size_t part_size[count];
+        const uint8_t *ad[count];
+        uint8_t *output[count];
+
+        // With parity, the buffers have the size of a full part, so the shorter encrypted parts are padded with zeros
+        const size_t shard_size = full_part + crypto_secretstream_xchacha20poly1305_ABYTES;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            ShardCover *const cover = &covers[i];
+            memcpy(cover->header.set_id, set_id, sizeof(set_id));
+            cover->header.index = htole32((uint32_t)i);
+            cover->header.count = htole32((uint32_t)data_count);
+            cover->header.parity = htole32((uint32_t)parity_count);
+            cover->header.stream_size = htole64((uint64_t)stream_size);
+            cover->data_size = cover->part_size + crypto_secretstream_xchacha20poly1305_ABYTES;
+            cover->data = (parity_count > 0) ? imc_calloc(shard_size, 1) : imc_malloc(cover->data_size);
+
+            part_size[i] = cover->part_size;
+            ad[i] = (const uint8_t *)&cover->header;
+            output[i] = cover->data;
+        }
+
+        // The parts are encrypted in order as the messages of a single stream (which cannot be done in parallel)
+        imc_progress(progress, "Encrypting '%s'... ", prepared->name);
+        uint8_t crypto_header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];
+        const int crypto_status = imc_crypto_encrypt_parts(
+            crypto, prepared->stream, part_size, data_count, ad, sizeof(ShardHeader), crypto_header, output
+        );
+
+        if (crypto_status < 0)
+        {
+            imc_progress(progress, "\n");
+            status = IMC_ERR_CRYPTO_FAIL;
+        }
+        else
+        {
+            imc_progress(progress, "Done!\n");
+            for (size_t i = 0; i < count; i++) memcpy(covers[i].crypto_header, crypto_header, sizeof(crypto_header));
+        }
+
+        // The parity shards are computed from the encrypted data shards (padded to the same size)
+        if (status == IMC_SUCCESS && parity_count > 0)
+        {
+            imc_progress(progress, "Computing %zu parity shard(s)... ", parity_count);
+            status = imc_erasure_encode(
+                (const uint8_t *const *)output, data_count, &output[data_count], parity_count, shard_size, thread_count
+            );
+            imc_progress(progress, (status == IMC_SUCCESS) ? "Done!\n" : "\n");
+        }
+    }
+
+    imc_steg_prepared_free(prepared);
+
+    if (status == IMC_SUCCESS)
+    {
+        // Write the shards to the images, then save the images
+        atomic_store(&job.done, 0);
+        imc_parallel_for(count, thread_count, &__shard_save_task, &job);
+        imc_progress(progress, "Saving images... Done!  \n");
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (covers[i].status != IMC_SUCCESS)
+            {
+                status = covers[i].status;
+                break;
+            }
+        }
+
+        // The images get their final names only once all of them were saved
+        if (status == IMC_SUCCESS) status = __shard_publish(covers, count);
+        else __shard_discard(covers, count);
+    }
+    else
+    {
+        // Nothing is saved if any image failed
+        for (size_t i = 0; i < count; i++)
+        {
+            if (covers[i].carrier_img) imc_steg_finish(covers[i].carrier_img);
+            covers[i].carrier_img = NULL;
+        }
+    }
+
+    return status;
+}
+
+// Read the shards from the images on 'paths' (given in any order, on up to 'thread_count' threads), then decrypt them
+// in order and save the reassembled file to 'out_dir' (or the current working directory, if NULL).
+// 'out_covers' receives the outcome of each image (to be freed with 'imc_shard_free()'), and 'out_info' the metadata
+// of the file (to be freed with 'imc_free()'). If the set has parity shards, images that could not be read are skipped, and
+// the missing data shards are rebuilt from the parity shards. Returns IMC_ERR_SHARD_MISSING if the images do not have
+// all shards of the same set (or, with parity, at least as many as its data shards), or if a shard is repeated.
+// Otherwise, returns the status of the first image that failed (when the set has no parity), or of decrypting and saving the file.
+int imc_shard_join(
+    const char *const *paths,
+    size_t count,
+    const CryptoContext *crypto,
+    const char *out_dir,
+    const char *cache_dir,
+    size_t thread_count,
+    const ProgressMonitor *progress,
+    ShardCover **out_covers,
+    FileMetadata **out_info
+)
+{
+    ShardCover *const covers = imc_calloc(count, sizeof(ShardCover));
+    for (size_t i = 0; i < count; i++) covers[i].path = paths[i];
+    *out_covers = covers;
+    if (count == 0) return IMC_ERR_SHARD_MISSING;
+
+    ShardJob job = {
+        .cover = covers,
+        .count = count,
+        .crypto = crypto,
+        .cache_dir = cache_dir,
+        .progress = progress,
+        .done = 0,
+    };
+
+    imc_parallel_for(count, thread_count, &__shard_read_task, &job);
+    imc_progress(progress, "Reading shards... Done!  \n");
+
+    // The first shard that could be read gives the parameters of the set
+    const ShardCover *first = NULL;
+    int failed_status = IMC_SUCCESS;
+    size_t read_count = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (covers[i].status == IMC_SUCCESS)
+        {
+            if (!first) first = &covers[i];
+            read_count++;
+        }
+        else if (failed_status == IMC_SUCCESS)
+        {
+            failed_status = covers[i].status;
+        }
+    }
+
+    if (!first) return failed_status;
+
+    const size_t data_count = le32toh(first->header.count);
+    const size_t parity_count = le32toh(first->header.parity);
+    const uint64_t stream_size = le64toh(first->header.stream_size);
+
+    // Without parity, every shard is needed (and the amount of images tells how many shards there are)
+    if (parity_count == 0 && failed_status != IMC_SUCCESS) return failed_status;
+    if (data_count == 0 || (parity_count == 0 && data_count != count)) return IMC_ERR_SHARD_MISSING;
+    if (parity_count > 0 && data_count + parity_count > IMC_ERASURE_MAX_SHARDS) return IMC_ERR_SHARD_MISSING;
+    const size_t total = data_count + parity_count;
+
+    // Put the shards in order, then check that there is at most one of each shard of the same set
+    ShardCover *order[read_count];
+    size_t pos = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (covers[i].status == IMC_SUCCESS) order[pos++] = &covers[i];
+    }
+    qsort(order, read_count, sizeof(*order), &__shard_compare);
+
+    ShardCover *slot[total];
+    for (size_t i = 0; i < total; i++) slot[i] = NULL;
+
+    for (size_t i = 0; i < read_count; i++)
+    {
+        ShardCover *const cover = order[i];
+        const size_t index = le32toh(cover->header.index);
+        if (
+            index >= total ||
+            slot[index] ||
+            le32toh(cover->header.count) != data_count ||
+            le32toh(cover->header.parity) != parity_count ||
+            le64toh(cover->header.stream_size) != stream_size ||
+            memcmp(cover->header.set_id, first->header.set_id, IMC_SHARD_ID_SIZE) != 0 ||
+            memcmp(cover->crypto_header, first->crypto_header, sizeof(cover->crypto_header)) != 0
+        )
+        {
+            return IMC_ERR_SHARD_MISSING;
+        }
+
+        slot[index] = cover;
+    }
+    /* Note:
+        The identification of the shards is not secret, but it is authenticated when decrypting.
+        So these checks only tell apart a missing shard from a modified one, the decryption would fail anyway.
+    */
+
+    if (read_count < data_count) return IMC_ERR_SHARD_MISSING;
+
+    // Size of the part of the stream on each data shard
+    size_t part_size[data_count];
+    const size_t full_part = (size_t)((stream_size + data_count - 1) / data_count);
+
+    if (parity_count == 0)
+    {
+        uint64_t parts_total = 0;
+        for (size_t i = 0; i < data_count; i++)
+        {
+            part_size[i] = slot[i]->part_size;
+            parts_total += part_size[i];
+        }
+
+        if (parts_total != stream_size) return IMC_ERR_CRYPTO_FAIL;
+    }
+    else
+    {
+        // Every part is full until the stream ends, and the shards read must have the expected sizes
+        uint64_t remaining = stream_size;
+        for (size_t i = 0; i < data_count; i++)
+        {
+            part_size[i] = (remaining < full_part) ? (size_t)remaining : full_part;
+            remaining -= part_size[i];
+        }
+
+        if (remaining > 0) return IMC_ERR_CRYPTO_FAIL;
+
+        for (size_t i = 0; i < total; i++)
+        {
+            if (slot[i] && slot[i]->part_size != ((i < data_count) ? part_size[i] : full_part)) return IMC_ERR_CRYPTO_FAIL;
+        }
+    }
+
+    // Rebuild the missing data shards from the parity shards
+    // (all shards are padded with zeros to the size of a full part, as they were when the parity was computed)
+    uint8_t *rebuilt[data_count];
+    for (size_t i = 0; i < data_count; i++) rebuilt[i] = NULL;
+
+    bool complete = true;
+    for (size_t i = 0; i < data_count; i++) complete = complete && slot[i];
+
+    int status = IMC_SUCCESS;
+
+    if (!complete)
+    {
+        const size_t shard_size = full_part + crypto_secretstream_xchacha20poly1305_ABYTES;
+        uint8_t *shards[total];
+        bool present[total];
+
+        for (size_t i = 0; i < total; i++)
+        {
+            present[i] = (slot[i] != NULL);
+
+            if (present[i])
+            {
+                ShardCover *const cover = slot[i];
+                cover->data = imc_realloc(cover->data, shard_size);
+                memset(&cover->data[cover->data_size], 0, shard_size - cover->data_size);
+                shards[i] = cover->data;
+            }
+            else if (i < data_count)
+            {
+                rebuilt[i] = imc_calloc(shard_size, 1);
+                shards[i] = rebuilt[i];
+            }
+            else
+            {
+                shards[i] = NULL;
+            }
+        }
+
+        imc_progress(progress, "Rebuilding the missing shards... ");
+        status = imc_erasure_reconstruct(shards, present, data_count, parity_count, shard_size, thread_count);
+        imc_progress(progress, (status == IMC_SUCCESS) ? "Done!\n" : "\n");
+    }
+
+    // The additional data of each part is the header of its shard (which is the same on all shards, but for the position)
+    ShardHeader header[data_count];
+    const uint8_t *data[data_count];
+    size_t data_len[data_count];
+    const uint8_t *ad[data_count];
+    for (size_t i = 0; i < data_count; i++)
+    {
+        header[i] = first->header;
+        header[i].index = htole32((uint32_t)i);
+        data[i] = slot[i] ? slot[i]->data : rebuilt[i];
+        data_len[i] = part_size[i] + crypto_secretstream_xchacha20poly1305_ABYTES;
+        ad[i] = (const uint8_t *)&header[i];
+    }
+
+    if (status == IMC_SUCCESS)
+    {
+        // Decrypt the parts of the stream in order, one after another on the same buffer
+        // (one extra byte is allocated, so an empty stream still gets a buffer)
+        uint8_t *const stream = imc_malloc(stream_size + 1);
+        imc_progress(progress, "Decrypting shards... ");
+        const int crypto_status = imc_crypto_decrypt_parts(
+            crypto, first->crypto_header, data, data_len, data_count, ad, sizeof(ShardHeader), stream
+        );
+
+        if (crypto_status < 0)
+        {
+            imc_progress(progress, "\n");
+            status = IMC_ERR_CRYPTO_FAIL;
+        }
+        else
+        {
+            imc_progress(progress, "Done!\n");
+            status = imc_steg_extract_buffer(stream, stream_size, out_dir, progress, out_info);
+        }
+
+        imc_clear_free(stream, stream_size + 1);
+    }
+
+    for (size_t i = 0; i < data_count; i++) imc_free(rebuilt[i]);
+    return status;
+}
+
+// Free the outcome of 'imc_shard_hide()' or of 'imc_shard_join()'
+void imc_shard_free(ShardCover *covers, size_t count)
+{
+    if (!covers) return;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (covers[i].carrier_img) imc_steg_finish(covers[i].carrier_img);
+        imc_free(covers[i].data);
+        imc_free(covers[i].out_path);
+    }
+
+    imc_free(covers);
+}
@@ -0,0 +1,111 @@
+/* Splitting of a file into shards hidden on many images (processed in parallel), and joining the shards back into the file. */
+
+#ifndef _IMC_SHARD_H
+#define _IMC_SHARD_H
+
+#include "imc_includes.h"
+
+/*  The file is read and compressed once, then the compressed stream is split into consecutive parts, one for each image
+    (in proportion to how much each image can hold). The parts are encrypted as the messages of a single encrypted stream,
+    so they can only be decrypted in their original order, and a missing or repeated shard is detected.
+    Optionally, some of the images get parity shards instead (see 'imc_erasure.h'), and then the file can still
+    be joined when as many images as the parity shards are missing.
+    See 'imc_image_io.h' for how each shard is stored on its image.
+*/
+
+// Prefix of the temporary names of the images until the whole set is saved (followed by the image's position and a dash)
+// The name begins with a dot, so the partial images are hidden from a folder being watched (see 'imc_watch.h').
+#define IMC_SHARD_TEMP_PREFIX ".partial-shard-"
+
+// Image that holds one shard of a file
+typedef struct ShardCover {
+    const char *path;           // Path of the image
+    CarrierImage *carrier_img;  // Image opened with the secrets (when hiding, until it is saved)
+    ShardHeader header;         // Identification of the image's shard
+    uint8_t crypto_header[crypto_secretstream_xchacha20poly1305_HEADERBYTES];  // Decryption header of the stream (when joining)
+    uint8_t *data;              // Encrypted part of the stream
+    size_t data_size;           // Size in bytes of 'data'
+    size_t capacity;            // Amount of bytes of the stream that fit on the image (when hiding)
+    size_t part_size;           // Amount of bytes of the stream on the shard (or of a full part, on a parity shard)
+    int status;                 // Result of processing the image
+    char *out_path;             // Path where the modified image was saved (when hiding)
+} ShardCover;
+
+// Images being processed by the worker threads
+typedef struct ShardJob {
+    ShardCover *cover;                  // Images of the set, in the order they were given
+    size_t count;                       // Amount of images
+    const CryptoContext *crypto;        // Secrets used on every image
+    const char *out_dir;                // Folder where the modified images are saved (when hiding)
+    const char *cache_dir;              // Folder of the cover cache (NULL if not caching the decoded images)
+    enum SaveProfile profile;           // Settings of the encoder when saving the images (when hiding)
+    const ProgressMonitor *progress;    // Receives the percentage of images that were processed
+    atomic_size_t done;                 // Amount of images that were already processed
+} ShardJob;
+
+// Task of the worker threads when hiding: open one image with the secrets, then find how much of the stream fits on it
+static void __shard_open_task(void *context, size_t task, size_t worker);
+
+// Task of the worker threads when hiding: write the shard of one image, then save and close the image
+static void __shard_save_task(void *context, size_t task, size_t worker);
+
+// Remove the images that were saved for a set that failed, so no partial set is left on the output folder
+static void __shard_discard(ShardCover *covers, size_t count);
+
+// Move the saved images from their temporary names to their final names (without replacing existing files)
+// If any of them cannot be moved, all images of the set are removed, and the status of that image is returned.
+static int __shard_publish(ShardCover *covers, size_t count);
+
+// Task of the worker threads when joining: open one image with the secrets, then read its shard
+static void __shard_read_task(void *context, size_t task, size_t worker);
+
+// Order of the shards when joining: by their position on the set
+static int __shard_compare(const void *cover_a, const void *cover_b);
+
+// Split the file at 'file_path' into one shard for each image on 'paths' (in that order), then save the images to 'out_dir'
+// The images are opened, and later saved, on up to 'thread_count' threads. Each image gets its own copy of 'crypto'.
+// Without parity, the stream is split in proportion to the capacity of each image, so all of them are filled by about the same fraction.
+// With 'parity_count' greater than zero, the last 'parity_count' images get parity shards, and the stream is split in equal parts
+// over the other images (so it must fit on the smallest image times the amount of data shards).
+// The images are saved with the encoder settings of 'profile'.
+// 'out_covers' receives the outcome of each image (to be freed with 'imc_shard_free()'), or NULL if the file could not be read.
+// Returns IMC_ERR_FILE_TOO_BIG if the file does not fit on the images, otherwise the status of the first image that
+// failed (or the status of reading the file). Nothing is saved unless all images could be opened, and the images keep
+// their final names only if all of them were saved (otherwise, the ones already saved are removed).
+int imc_shard_hide(
+    const char *file_path,
+    const char *const *paths,
+    size_t count,
+    size_t parity_count,
+    const CryptoContext *crypto,
+    const char *out_dir,
+    const char *cache_dir,
+    enum SaveProfile profile,
+    size_t thread_count,
+    const ProgressMonitor *progress,
+    ShardCover **out_covers
+);
+
+// Read the shards from the images on 'paths' (given in any order, on up to 'thread_count' threads), then decrypt them
+// in order and save the reassembled file to 'out_dir' (or the current working directory, if NULL).
+// 'out_covers' receives the outcome of each image (to be freed with 'imc_shard_free()'), and 'out_info' the metadata
+// of the file (to be freed with 'imc_free()'). If the set has parity shards, images that could not be read are skipped, and
+// the missing data shards are rebuilt from the parity shards. Returns IMC_ERR_SHARD_MISSING if the images do not have
+// all shards of the same set (or, with parity, at least as many as its data shards), or if a shard is repeated.
+// Otherwise, returns the status of the first image that failed (when the set has no parity), or of decrypting and saving the file.
+int imc_shard_join(
+    const char *const *paths,
+    size_t count,
+    const CryptoContext *crypto,
+    const char *out_dir,
+    const char *cache_dir,
+    size_t thread_count,
+    const ProgressMonitor *progress,
+    ShardCover **out_covers,
+    FileMetadata **out_info
+);
+
+// Free the outcome of 'imc_shard_hide()' or of 'imc_shard_join()'
+void imc_shard_free(ShardCover *covers, size_t count);
+
+#endif  // _IMC_SHARD_H
@@ -0,0 +1,219 @@
+/* Running independent tasks on multiple threads. */
+
+#include "imc_includes.h"
+
+// Amount of logical processors available to this program
+size_t imc_cpu_count()
+{
+    #ifdef _WIN32   // Windows systems
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    const long cpu_count = sys_info.dwNumberOfProcessors;
+
+    #else   // Linux systems
+    const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    #endif  // _WIN32
+
+    return (cpu_count > 0) ? (size_t)cpu_count : 1;
+}
+
+// Worker thread: keep taking tasks (in increasing order) until there are no more tasks left
+static void *__worker_loop(void *args)
+{
+    const WorkerArgs *const worker = (WorkerArgs *)args;
+
+    while (true)
+    {
+        const size_t task = atomic_fetch_add(worker->next_task, 1);
+        if (task >= worker->task_count) break;
+        worker->function(worker->context, task, worker->worker);
+    }
+
+    return NULL;
+}
+
+// Run 'task_count' tasks on up to 'thread_count' threads, and return once all tasks have finished
+// The tasks are handed to the workers in increasing order of index, and the calling thread also works on them (as worker 0).
+// If 'thread_count' is 0, then the amount of logical processors is used.
+void imc_parallel_for(size_t task_count, size_t thread_count, imc_task_func function, void *context)
+{
+    if (task_count == 0) return;
+    if (thread_count == 0) thread_count = imc_cpu_count();
+    if (thread_count > task_count) thread_count = task_count;
+
+    atomic_size_t next_task = 0;
+    WorkerArgs args[thread_count];
+    pthread_t threads[thread_count];
+    bool started[thread_count];
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        args[i] = (WorkerArgs){
+            .function = function,
+            .context = context,
+            .task_count = task_count,
+            .next_task = &next_task,
+            .worker = i,
+        };
+        started[i] = false;
+    }
+
+    // Spawn the additional workers
+    // (if a thread fails to be created, the remaining workers just take its share of the tasks)
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        started[i] = (pthread_create(&threads[i], NULL, &__worker_loop, &args[i]) == 0);
+    }
+
+    // The calling thread is the worker 0
+    __worker_loop(&args[0]);
+
+    // Wait for the other workers to finish
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+}
+
+// Create a queue of up to 'capacity' items, processed by 'thread_count' worker threads (0 for the amount of logical processors)
+// The queue should be closed with 'imc_queue_finish()'.
+WorkQueue *imc_queue_create(size_t capacity, size_t thread_count, imc_item_func function, void *context)
+{
+    if (capacity == 0) capacity = 1;
+    if (thread_count == 0) thread_count = imc_cpu_count();
+    
+    WorkQueue *queue = imc_calloc(1, sizeof(WorkQueue));
+    queue->function = function;
+    queue->context = context;
+    queue->item = imc_calloc(capacity, sizeof(void *));
+    queue->capacity = capacity;
+    queue->thread_count = thread_count;
+    queue->threads = imc_calloc(thread_count, sizeof(pthread_t));
+    queue->workers = imc_calloc(thread_count, sizeof(struct QueueWorker));
+    queue->started = imc_calloc(thread_count, sizeof(bool));
+    
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        queue->workers[i] = (struct QueueWorker){.queue = queue, .worker = i};
+        queue->started[i] = (pthread_create(&queue->threads[i], NULL, &__queue_worker_loop, &queue->workers[i]) == 0);
+    }
+
+    return queue;
+}
+
+// Worker thread of a queue: keep taking items until the queue is closed and empty
+static void *__queue_worker_loop(void *args)
+{
+    const struct QueueWorker *const worker = (struct QueueWorker *)args;
+    WorkQueue *const queue = worker->queue;
+
+    pthread_mutex_lock(&queue->lock);
+    
+    while (true)
+    {
+        while (queue->count == 0 && !queue->closed) pthread_cond_wait(&queue->not_empty, &queue->lock);
+        if (queue->count == 0) break;   // The queue is closed and there are no more items
+
+        // Take the oldest item
+        void *const item = queue->item[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        queue->busy++;
+        pthread_cond_signal(&queue->not_full);
+        pthread_mutex_unlock(&queue->lock);
+
+        queue->function(queue->context, item, worker->worker);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->busy--;
+        queue->processed++;
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+// Add an item to the queue, waiting for a free space if the queue is full
+// Returns 'false' if the queue has been closed (the item is not added in this case).
+// If no worker thread could be created, the item is processed right away by the calling thread.
+bool imc_queue_push(WorkQueue *queue, void *item)
+{
+    bool has_workers = false;
+    for (size_t i = 0; i < queue->thread_count; i++) has_workers |= queue->started[i];
+    
+    if (!has_workers)
+    {
+        if (queue->closed) return false;
+        queue->function(queue->context, item, 0);
+        queue->processed++;
+        return true;
+    }
+    
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->count == queue->capacity && !queue->closed)
+    {
+        queue->full_waits++;
+        while (queue->count == queue->capacity && !queue->closed) pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+
+    if (queue->closed)
+    {
+        pthread_mutex_unlock(&queue->lock);
+        return false;
+    }
+
+    // Add the item to the end of the ring buffer
+    queue->item[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    if (queue->count > queue->peak) queue->peak = queue->count;
+    
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    
+    return true;
+}
+
+// Get the current counters of the queue
+void imc_queue_stats(WorkQueue *queue, QueueStats *out)
+{
+    pthread_mutex_lock(&queue->lock);
+    *out = (QueueStats){
+        .depth = queue->count,
+        .busy = queue->busy,
+        .peak = queue->peak,
+        .capacity = queue->capacity,
+        .processed = queue->processed,
+        .full_waits = queue->full_waits,
+    };
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Stop accepting new items, wait for the workers to process the items already on the queue, then free the queue
+void imc_queue_finish(WorkQueue *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+
+    for (size_t i = 0; i < queue->thread_count; i++)
+    {
+        if (queue->started[i]) pthread_join(queue->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    imc_free(queue->item);
+    imc_free(queue->threads);
+    imc_free(queue->workers);
+    imc_free(queue->started);
+    imc_free(queue);
+}
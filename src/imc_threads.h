@@ -0,0 +1,92 @@
+/* Running independent tasks on multiple threads. */
+
+#ifndef _IMC_THREADS_H
+#define _IMC_THREADS_H
+
+#include "imc_includes.h"
+
+// Function that performs a single task
+// It receives the shared context, the index of the task, and the index of the worker thread running it.
+// (the worker's index goes from 0 to the amount of workers minus 1, so it can be used to access per-worker resources)
+// On 'imc_parallel_for()', worker 0 is the calling thread, so only its tasks should send progress messages.
+typedef void (*imc_task_func)(void *context, size_t task, size_t worker);
+
+// Arguments passed to each worker thread
+typedef struct WorkerArgs {
+    imc_task_func function;     // Function that performs the tasks
+    void *context;              // Data shared by all tasks
+    size_t task_count;          // Total amount of tasks
+    atomic_size_t *next_task;   // Index of the next task to be taken by a worker
+    size_t worker;              // Index of this worker
+} WorkerArgs;
+
+// Function that processes one item taken from a work queue
+// It receives the shared context, the item, and the index of the worker thread running it.
+typedef void (*imc_item_func)(void *context, void *item, size_t worker);
+
+// Queue of items processed by a pool of worker threads, in the same order as they were added
+// The queue has a maximum capacity: adding an item to a full queue waits until a worker takes an item (backpressure).
+typedef struct WorkQueue {
+    imc_item_func function;     // Function that processes the items
+    void *context;              // Data shared by all items
+    void **item;                // Ring buffer with the items waiting to be processed
+    size_t capacity;            // Maximum amount of items waiting
+    size_t head;                // Position on the ring buffer of the next item to be taken
+    size_t count;               // Amount of items waiting
+    size_t busy;                // Amount of items being processed
+    size_t peak;                // Highest amount of items that were waiting at the same time
+    uint64_t processed;         // Total amount of items that were processed
+    uint64_t full_waits;        // How many times an item had to wait for the queue to have space
+    bool closed;                // Whether the queue stopped accepting items
+    pthread_mutex_t lock;       // Lock for changing the queue
+    pthread_cond_t not_empty;   // Signals that an item was added (or that the queue was closed)
+    pthread_cond_t not_full;    // Signals that an item was taken
+    pthread_t *threads;         // Worker threads
+    struct QueueWorker {
+        struct WorkQueue *queue;
+        size_t worker;
+    } *workers;                 // Arguments of each worker thread
+    bool *started;              // Whether each worker thread was created
+    size_t thread_count;        // Amount of worker threads
+} WorkQueue;
+
+// Snapshot of the counters of a work queue
+typedef struct QueueStats {
+    size_t depth;           // Amount of items waiting
+    size_t busy;            // Amount of items being processed
+    size_t peak;            // Highest amount of items that were waiting at the same time
+    size_t capacity;        // Maximum amount of items waiting
+    uint64_t processed;     // Total amount of items that were processed
+    uint64_t full_waits;    // How many times an item had to wait for the queue to have space
+} QueueStats;
+
+// Amount of logical processors available to this program
+size_t imc_cpu_count();
+
+// Worker thread: keep taking tasks (in increasing order) until there are no more tasks left
+static void *__worker_loop(void *args);
+
+// Run 'task_count' tasks on up to 'thread_count' threads, and return once all tasks have finished
+// The tasks are handed to the workers in increasing order of index, and the calling thread also works on them (as worker 0).
+// If 'thread_count' is 0, then the amount of logical processors is used.
+void imc_parallel_for(size_t task_count, size_t thread_count, imc_task_func function, void *context);
+
+// Create a queue of up to 'capacity' items, processed by 'thread_count' worker threads (0 for the amount of logical processors)
+// The queue should be closed with 'imc_queue_finish()'.
+WorkQueue *imc_queue_create(size_t capacity, size_t thread_count, imc_item_func function, void *context);
+
+// Worker thread of a queue: keep taking items until the queue is closed and empty
+static void *__queue_worker_loop(void *args);
+
+// Add an item to the queue, waiting for a free space if the queue is full
+// Returns 'false' if the queue has been closed (the item is not added in this case).
+// If no worker thread could be created, the item is processed right away by the calling thread.
+bool imc_queue_push(WorkQueue *queue, void *item);
+
+// Get the current counters of the queue
+void imc_queue_stats(WorkQueue *queue, QueueStats *out);
+
+// Stop accepting new items, wait for the workers to process the items already on the queue, then free the queue
+void imc_queue_finish(WorkQueue *queue);
+
+#endif  // _IMC_THREADS_H
@@ -0,0 +1,1098 @@
+/* Reading and writing the quantized DCT coefficients of lossy WebP images (VP8 bitstream), without decoding the pixels. */
+
+#include "imc_includes.h"
+
+/* Note:
+    The probability tables below are the ones from the VP8 specification (RFC 6386, sections 11.5 and 13),
+    which every decoder uses. The prediction modes of the 4x4 luma blocks are numbered as:
+    0 = DC, 1 = TM, 2 = VE, 3 = HE, 4 = RD, 5 = VR, 6 = LD, 7 = VL, 8 = HD, 9 = HU.
+    The modes of the 16x16 luma blocks (DC, TM, V, H) use the same numbers as the first four 4x4 modes,
+    since that is the mode assumed for their 4x4 blocks when predicting the modes of the neighboring blocks.
+*/
+
+// Probabilities of each default token probability being replaced by the frame header
+static const uint8_t vp8_coef_update_proba[4][8][3][11] = {
+    {
+        {{255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{176, 246, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {223, 241, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+         {249, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 244, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+         {234, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {253, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 246, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {239, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {254, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 248, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {251, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {251, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {254, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 254, 253, 255, 254, 255, 255, 255, 255, 255, 255},
+         {250, 255, 254, 255, 254, 255, 255, 255, 255, 255, 255},
+         {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}}
+    },
+    {
+        {{217, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {225, 252, 241, 253, 255, 255, 254, 255, 255, 255, 255},
+         {234, 250, 241, 250, 253, 255, 253, 254, 255, 255, 255}},
+        {{255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {223, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {238, 253, 254, 254, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 248, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {249, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 253, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {247, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {252, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {253, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 254, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+         {250, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}}
+    },
+    {
+        {{186, 251, 250, 255, 255, 255, 255, 255, 255, 255, 255},
+         {234, 251, 244, 254, 255, 255, 255, 255, 255, 255, 255},
+         {251, 251, 243, 253, 254, 255, 254, 255, 255, 255, 255}},
+        {{255, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {236, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {251, 253, 253, 254, 254, 255, 255, 255, 255, 255, 255}},
+        {{255, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {254, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {254, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}}
+    },
+    {
+        {{248, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {250, 254, 252, 254, 255, 255, 255, 255, 255, 255, 255},
+         {248, 254, 249, 253, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+         {246, 253, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+         {252, 254, 251, 254, 254, 255, 255, 255, 255, 255, 255}},
+        {{255, 254, 252, 255, 255, 255, 255, 255, 255, 255, 255},
+         {248, 254, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+         {253, 255, 254, 254, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 251, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {245, 251, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {253, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 251, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+         {252, 253, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 254, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 252, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {249, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 254, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 255, 253, 255, 255, 255, 255, 255, 255, 255, 255},
+         {250, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}},
+        {{255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {254, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255},
+         {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255}}
+    }
+};
+
+// Default probabilities of the coefficient tokens
+static const uint8_t vp8_coef_proba[4][8][3][11] = {
+    {
+        {{128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+         {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+         {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}},
+        {{253, 136, 254, 255, 228, 219, 128, 128, 128, 128, 128},
+         {189, 129, 242, 255, 227, 213, 255, 219, 128, 128, 128},
+         {106, 126, 227, 252, 214, 209, 255, 255, 128, 128, 128}},
+        {{  1,  98, 248, 255, 236, 226, 255, 255, 128, 128, 128},
+         {181, 133, 238, 254, 221, 234, 255, 154, 128, 128, 128},
+         { 78, 134, 202, 247, 198, 180, 255, 219, 128, 128, 128}},
+        {{  1, 185, 249, 255, 243, 255, 128, 128, 128, 128, 128},
+         {184, 150, 247, 255, 236, 224, 128, 128, 128, 128, 128},
+         { 77, 110, 216, 255, 236, 230, 128, 128, 128, 128, 128}},
+        {{  1, 101, 251, 255, 241, 255, 128, 128, 128, 128, 128},
+         {170, 139, 241, 252, 236, 209, 255, 255, 128, 128, 128},
+         { 37, 116, 196, 243, 228, 255, 255, 255, 128, 128, 128}},
+        {{  1, 204, 254, 255, 245, 255, 128, 128, 128, 128, 128},
+         {207, 160, 250, 255, 238, 128, 128, 128, 128, 128, 128},
+         {102, 103, 231, 255, 211, 171, 128, 128, 128, 128, 128}},
+        {{  1, 152, 252, 255, 240, 255, 128, 128, 128, 128, 128},
+         {177, 135, 243, 255, 234, 225, 128, 128, 128, 128, 128},
+         { 80, 129, 211, 255, 194, 224, 128, 128, 128, 128, 128}},
+        {{  1,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+         {246,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+         {255, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}}
+    },
+    {
+        {{198,  35, 237, 223, 193, 187, 162, 160, 145, 155,  62},
+         {131,  45, 198, 221, 172, 176, 220, 157, 252, 221,   1},
+         { 68,  47, 146, 208, 149, 167, 221, 162, 255, 223, 128}},
+        {{  1, 149, 241, 255, 221, 224, 255, 255, 128, 128, 128},
+         {184, 141, 234, 253, 222, 220, 255, 199, 128, 128, 128},
+         { 81,  99, 181, 242, 176, 190, 249, 202, 255, 255, 128}},
+        {{  1, 129, 232, 253, 214, 197, 242, 196, 255, 255, 128},
+         { 99, 121, 210, 250, 201, 198, 255, 202, 128, 128, 128},
+         { 23,  91, 163, 242, 170, 187, 247, 210, 255, 255, 128}},
+        {{  1, 200, 246, 255, 234, 255, 128, 128, 128, 128, 128},
+         {109, 178, 241, 255, 231, 245, 255, 255, 128, 128, 128},
+         { 44, 130, 201, 253, 205, 192, 255, 255, 128, 128, 128}},
+        {{  1, 132, 239, 251, 219, 209, 255, 165, 128, 128, 128},
+         { 94, 136, 225, 251, 218, 190, 255, 255, 128, 128, 128},
+         { 22, 100, 174, 245, 186, 161, 255, 199, 128, 128, 128}},
+        {{  1, 182, 249, 255, 232, 235, 128, 128, 128, 128, 128},
+         {124, 143, 241, 255, 227, 234, 128, 128, 128, 128, 128},
+         { 35,  77, 181, 251, 193, 211, 255, 205, 128, 128, 128}},
+        {{  1, 157, 247, 255, 236, 231, 255, 255, 128, 128, 128},
+         {121, 141, 235, 255, 225, 227, 255, 255, 128, 128, 128},
+         { 45,  99, 188, 251, 195, 217, 255, 224, 128, 128, 128}},
+        {{  1,   1, 251, 255, 213, 255, 128, 128, 128, 128, 128},
+         {203,   1, 248, 255, 255, 128, 128, 128, 128, 128, 128},
+         {137,   1, 177, 255, 224, 255, 128, 128, 128, 128, 128}}
+    },
+    {
+        {{253,   9, 248, 251, 207, 208, 255, 192, 128, 128, 128},
+         {175,  13, 224, 243, 193, 185, 249, 198, 255, 255, 128},
+         { 73,  17, 171, 221, 161, 179, 236, 167, 255, 234, 128}},
+        {{  1,  95, 247, 253, 212, 183, 255, 255, 128, 128, 128},
+         {239,  90, 244, 250, 211, 209, 255, 255, 128, 128, 128},
+         {155,  77, 195, 248, 188, 195, 255, 255, 128, 128, 128}},
+        {{  1,  24, 239, 251, 218, 219, 255, 205, 128, 128, 128},
+         {201,  51, 219, 255, 196, 186, 128, 128, 128, 128, 128},
+         { 69,  46, 190, 239, 201, 218, 255, 228, 128, 128, 128}},
+        {{  1, 191, 251, 255, 255, 128, 128, 128, 128, 128, 128},
+         {223, 165, 249, 255, 213, 255, 128, 128, 128, 128, 128},
+         {141, 124, 248, 255, 255, 128, 128, 128, 128, 128, 128}},
+        {{  1,  16, 248, 255, 255, 128, 128, 128, 128, 128, 128},
+         {190,  36, 230, 255, 236, 255, 128, 128, 128, 128, 128},
+         {149,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128}},
+        {{  1, 226, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+         {247, 192, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+         {240, 128, 255, 128, 128, 128, 128, 128, 128, 128, 128}},
+        {{  1, 134, 252, 255, 255, 128, 128, 128, 128, 128, 128},
+         {213,  62, 250, 255, 255, 128, 128, 128, 128, 128, 128},
+         { 55,  93, 255, 128, 128, 128, 128, 128, 128, 128, 128}},
+        {{128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+         {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128},
+         {128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128}}
+    },
+    {
+        {{202,  24, 213, 235, 186, 191, 220, 160, 240, 175, 255},
+         {126,  38, 182, 232, 169, 184, 228, 174, 255, 187, 128},
+         { 61,  46, 138, 219, 151, 178, 240, 170, 255, 216, 128}},
+        {{  1, 112, 230, 250, 199, 191, 247, 159, 255, 255, 128},
+         {166, 109, 228, 252, 211, 215, 255, 174, 128, 128, 128},
+         { 39,  77, 162, 232, 172, 180, 245, 178, 255, 255, 128}},
+        {{  1,  52, 220, 246, 198, 199, 249, 220, 255, 255, 128},
+         {124,  74, 191, 243, 183, 193, 250, 221, 255, 255, 128},
+         { 24,  71, 130, 219, 154, 170, 243, 182, 255, 255, 128}},
+        {{  1, 182, 225, 249, 219, 240, 255, 224, 128, 128, 128},
+         {149, 150, 226, 252, 216, 205, 255, 171, 128, 128, 128},
+         { 28, 108, 170, 242, 183, 194, 254, 223, 255, 255, 128}},
+        {{  1,  81, 230, 252, 204, 203, 255, 192, 128, 128, 128},
+         {123, 102, 209, 247, 188, 196, 255, 233, 128, 128, 128},
+         { 20,  95, 153, 243, 164, 173, 255, 203, 128, 128, 128}},
+        {{  1, 222, 248, 255, 216, 213, 128, 128, 128, 128, 128},
+         {168, 175, 246, 252, 235, 205, 255, 255, 128, 128, 128},
+         { 47, 116, 215, 255, 211, 212, 255, 255, 128, 128, 128}},
+        {{  1, 121, 236, 253, 212, 214, 255, 255, 128, 128, 128},
+         {141,  84, 213, 252, 201, 202, 255, 219, 128, 128, 128},
+         { 42,  80, 160, 240, 162, 185, 255, 205, 128, 128, 128}},
+        {{  1,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+         {244,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128},
+         {238,   1, 255, 128, 128, 128, 128, 128, 128, 128, 128}}
+    }
+};
+
+// Probabilities of the 4x4 luma prediction modes on key frames, given the modes of the blocks above and to the left
+static const uint8_t vp8_bmode_proba[10][10][9] = {
+    {{231, 120,  48,  89, 115, 113, 120, 152, 112},
+     {152, 179,  64, 126, 170, 118,  46,  70,  95},
+     {175,  69, 143,  80,  85,  82,  72, 155, 103},
+     { 56,  58,  10, 171, 218, 189,  17,  13, 152},
+     {114,  26,  17, 163,  44, 195,  21,  10, 173},
+     {121,  24,  80, 195,  26,  62,  44,  64,  85},
+     {144,  71,  10,  38, 171, 213, 144,  34,  26},
+     {170,  46,  55,  19, 136, 160,  33, 206,  71},
+     { 63,  20,   8, 114, 114, 208,  12,   9, 226},
+     { 81,  40,  11,  96, 182,  84,  29,  16,  36}},
+    {{134, 183,  89, 137,  98, 101, 106, 165, 148},
+     { 72, 187, 100, 130, 157, 111,  32,  75,  80},
+     { 66, 102, 167,  99,  74,  62,  40, 234, 128},
+     { 41,  53,   9, 178, 241, 141,  26,   8, 107},
+     { 74,  43,  26, 146,  73, 166,  49,  23, 157},
+     { 65,  38, 105, 160,  51,  52,  31, 115, 128},
+     {104,  79,  12,  27, 217, 255,  87,  17,   7},
+     { 87,  68,  71,  44, 114,  51,  15, 186,  23},
+     { 47,  41,  14, 110, 182, 183,  21,  17, 194},
+     { 66,  45,  25, 102, 197, 189,  23,  18,  22}},
+    {{ 88,  88, 147, 150,  42,  46,  45, 196, 205},
+     { 43,  97, 183, 117,  85,  38,  35, 179,  61},
+     { 39,  53, 200,  87,  26,  21,  43, 232, 171},
+     { 56,  34,  51, 104, 114, 102,  29,  93,  77},
+     { 39,  28,  85, 171,  58, 165,  90,  98,  64},
+     { 34,  22, 116, 206,  23,  34,  43, 166,  73},
+     {107,  54,  32,  26,  51,   1,  81,  43,  31},
+     { 68,  25, 106,  22,  64, 171,  36, 225, 114},
+     { 34,  19,  21, 102, 132, 188,  16,  76, 124},
+     { 62,  18,  78,  95,  85,  57,  50,  48,  51}},
+    {{193, 101,  35, 159, 215, 111,  89,  46, 111},
+     { 60, 148,  31, 172, 219, 228,  21,  18, 111},
+     {112, 113,  77,  85, 179, 255,  38, 120, 114},
+     { 40,  42,   1, 196, 245, 209,  10,  25, 109},
+     { 88,  43,  29, 140, 166, 213,  37,  43, 154},
+     { 61,  63,  30, 155,  67,  45,  68,   1, 209},
+     {100,  80,   8,  43, 154,   1,  51,  26,  71},
+     {142,  78,  78,  16, 255, 128,  34, 197, 171},
+     { 41,  40,   5, 102, 211, 183,   4,   1, 221},
+     { 51,  50,  17, 168, 209, 192,  23,  25,  82}},
+    {{138,  31,  36, 171,  27, 166,  38,  44, 229},
+     { 67,  87,  58, 169,  82, 115,  26,  59, 179},
+     { 63,  59,  90, 180,  59, 166,  93,  73, 154},
+     { 40,  40,  21, 116, 143, 209,  34,  39, 175},
+     { 47,  15,  16, 183,  34, 223,  49,  45, 183},
+     { 46,  17,  33, 183,   6,  98,  15,  32, 183},
+     { 57,  46,  22,  24, 128,   1,  54,  17,  37},
+     { 65,  32,  73, 115,  28, 128,  23, 128, 205},
+     { 40,   3,   9, 115,  51, 192,  18,   6, 223},
+     { 87,  37,   9, 115,  59,  77,  64,  21,  47}},
+    {{104,  55,  44, 218,   9,  54,  53, 130, 226},
+     { 64,  90,  70, 205,  40,  41,  23,  26,  57},
+     { 54,  57, 112, 184,   5,  41,  38, 166, 213},
+     { 30,  34,  26, 133, 152, 116,  10,  32, 134},
+     { 39,  19,  53, 221,  26, 114,  32,  73, 255},
+     { 31,   9,  65, 234,   2,  15,   1, 118,  73},
+     { 75,  32,  12,  51, 192, 255, 160,  43,  51},
+     { 88,  31,  35,  67, 102,  85,  55, 186,  85},
+     { 56,  21,  23, 111,  59, 205,  45,  37, 192},
+     { 55,  38,  70, 124,  73, 102,   1,  34,  98}},
+    {{125,  98,  42,  88, 104,  85, 117, 175,  82},
+     { 95,  84,  53,  89, 128, 100, 113, 101,  45},
+     { 75,  79, 123,  47,  51, 128,  81, 171,   1},
+     { 57,  17,   5,  71, 102,  57,  53,  41,  49},
+     { 38,  33,  13, 121,  57,  73,  26,   1,  85},
+     { 41,  10,  67, 138,  77, 110,  90,  47, 114},
+     {115,  21,   2,  10, 102, 255, 166,  23,   6},
+     {101,  29,  16,  10,  85, 128, 101, 196,  26},
+     { 57,  18,  10, 102, 102, 213,  34,  20,  43},
+     {117,  20,  15,  36, 163, 128,  68,   1,  26}},
+    {{102,  61,  71,  37,  34,  53,  31, 243, 192},
+     { 69,  60,  71,  38,  73, 119,  28, 222,  37},
+     { 68,  45, 128,  34,   1,  47,  11, 245, 171},
+     { 62,  17,  19,  70, 146,  85,  55,  62,  70},
+     { 37,  43,  37, 154, 100, 163,  85, 160,   1},
+     { 63,   9,  92, 136,  28,  64,  32, 201,  85},
+     { 75,  15,   9,   9,  64, 255, 184, 119,  16},
+     { 86,   6,  28,   5,  64, 255,  25, 248,   1},
+     { 56,   8,  17, 132, 137, 255,  55, 116, 128},
+     { 58,  15,  20,  82, 135,  57,  26, 121,  40}},
+    {{164,  50,  31, 137, 154, 133,  25,  35, 218},
+     { 51, 103,  44, 131, 131, 123,  31,   6, 158},
+     { 86,  40,  64, 135, 148, 224,  45, 183, 128},
+     { 22,  26,  17, 131, 240, 154,  14,   1, 209},
+     { 45,  16,  21,  91,  64, 222,   7,   1, 197},
+     { 56,  21,  39, 155,  60, 138,  23, 102, 213},
+     { 83,  12,  13,  54, 192, 255,  68,  47,  28},
+     { 85,  26,  85,  85, 128, 128,  32, 146, 171},
+     { 18,  11,   7,  63, 144, 171,   4,   4, 246},
+     { 35,  27,  10, 146, 174, 171,  12,  26, 128}},
+    {{190,  80,  35,  99, 180,  80, 126,  54,  45},
+     { 85, 126,  47,  87, 176,  51,  41,  20,  32},
+     {101,  75, 128, 139, 118, 146, 116, 128,  85},
+     { 56,  41,  15, 176, 236,  85,  37,   9,  62},
+     { 71,  30,  17, 119, 118, 255,  17,  18, 138},
+     {101,  38,  60, 138,  55,  70,  43,  26, 142},
+     {146,  36,  19,  30, 171, 255,  97,  27,  20},
+     {138,  45,  61,  62, 219,   1,  81, 188,  64},
+     { 32,  41,  20, 117, 151, 142,  20,  21, 163},
+     {112,  19,  12,  61, 195, 128,  48,   4,  24}}
+};
+
+// Tree of the 4x4 luma prediction modes: a positive value is the next branch, the others are minus the mode
+static const int8_t vp8_bmode_tree[18] = {0, 1, -1, 2, -2, 3, 4, 6, -3, 5, -4, -5, -6, 7, -7, 8, -8, -9};
+
+// Band of each position of a block of coefficients (the token probabilities are the same within a band)
+// (the position 16 is used only for the probabilities after the last coefficient, which are never read)
+static const uint8_t vp8_bands[17] = {0, 1, 2, 3, 6, 4, 5, 6, 6, 6, 6, 6, 6, 6, 6, 7, 0};
+
+// Probabilities of the extra bits of the tokens for coefficients from 11 to 18, 19 to 34, 35 to 66, and 67 to 2114
+static const uint8_t vp8_cat3[] = {173, 148, 140, 0};
+static const uint8_t vp8_cat4[] = {176, 155, 140, 135, 0};
+static const uint8_t vp8_cat5[] = {180, 157, 141, 134, 130, 0};
+static const uint8_t vp8_cat6[] = {254, 254, 243, 230, 196, 177, 153, 140, 133, 130, 129, 0};
+static const uint8_t *const vp8_cat_proba[4] = {vp8_cat3, vp8_cat4, vp8_cat5, vp8_cat6};
+
+// Start decoding a partition
+static void __bool_decoder_init(Vp8BoolDecoder *decoder, const uint8_t *data, size_t size)
+{
+    decoder->input = data;
+    decoder->end = data + size;
+    decoder->value = 0;
+    decoder->range = 255;
+    decoder->bit_count = 0;
+    decoder->overrun = 0;
+
+    // The decoder keeps two bytes of the stream
+    for (int i = 0; i < 2; i++)
+    {
+        decoder->value <<= 8;
+        if (decoder->input < decoder->end) decoder->value |= *decoder->input++;
+        else decoder->overrun++;
+    }
+}
+
+// Read a boolean, that is 0 with a probability of 'prob / 256'
+static inline int __bool_read(Vp8BoolDecoder *decoder, uint8_t prob)
+{
+    const uint32_t split = 1 + (((decoder->range - 1) * prob) >> 8);
+    const uint32_t big_split = split << 8;
+    int bit;
+
+    if (decoder->value >= big_split)
+    {
+        bit = 1;
+        decoder->range -= split;
+        decoder->value -= big_split;
+    }
+    else
+    {
+        bit = 0;
+        decoder->range = split;
+    }
+
+    // Shift the interval until it has at least 128 values again, reading a new byte after every 8 bits
+    while (decoder->range < 128)
+    {
+        decoder->value <<= 1;
+        decoder->range <<= 1;
+        
+        if (++decoder->bit_count == 8)
+        {
+            decoder->bit_count = 0;
+            if (decoder->input < decoder->end) decoder->value |= *decoder->input++;
+            else decoder->overrun++;
+        }
+    }
+
+    return bit;
+}
+
+// Read an unsigned number of 'bits' bits (the most significant first), each of them with even probability
+static uint32_t __bool_read_literal(Vp8BoolDecoder *decoder, int bits)
+{
+    uint32_t value = 0;
+    while (bits-- > 0) value = (value << 1) | __bool_read(decoder, 128);
+    return value;
+}
+
+// Read a number of 'bits' bits, followed by its sign
+static int32_t __bool_read_signed(Vp8BoolDecoder *decoder, int bits)
+{
+    const int32_t value = (int32_t)__bool_read_literal(decoder, bits);
+    return __bool_read(decoder, 128) ? -value : value;
+}
+
+// Start encoding a partition, with room for about 'size' bytes
+static void __bool_encoder_init(Vp8BoolEncoder *encoder, size_t size)
+{
+    encoder->capacity = (size > 16) ? size : 16;
+    encoder->output = imc_malloc(encoder->capacity);
+    encoder->size = 0;
+    encoder->range = 255;
+    encoder->bottom = 0;
+    encoder->bit_count = 24;
+}
+
+// Add 1 to the bytes already written (the carry of the interval's start)
+static void __bool_carry(Vp8BoolEncoder *encoder)
+{
+    size_t pos = encoder->size;
+    while (pos > 0 && encoder->output[pos - 1] == 255)
+    {
+        encoder->output[--pos] = 0;
+    }
+    if (pos > 0) encoder->output[pos - 1]++;
+}
+
+// Append a byte to the partition being encoded
+static inline void __bool_put(Vp8BoolEncoder *encoder, uint8_t byte)
+{
+    if (encoder->size == encoder->capacity)
+    {
+        encoder->capacity *= 2;
+        encoder->output = imc_realloc(encoder->output, encoder->capacity);
+    }
+    encoder->output[encoder->size++] = byte;
+}
+
+// Write a boolean, that is 0 with a probability of 'prob / 256'
+static inline void __bool_write(Vp8BoolEncoder *encoder, uint8_t prob, int bit)
+{
+    const uint32_t split = 1 + (((encoder->range - 1) * prob) >> 8);
+
+    if (bit)
+    {
+        encoder->bottom += split;
+        encoder->range -= split;
+    }
+    else
+    {
+        encoder->range = split;
+    }
+
+    // Shift the interval until it has at least 128 values again, writing a new byte after every 8 bits
+    while (encoder->range < 128)
+    {
+        encoder->range <<= 1;
+        if (encoder->bottom & ((uint32_t)1 << 31)) __bool_carry(encoder);
+        encoder->bottom <<= 1;
+        
+        if (--encoder->bit_count == 0)
+        {
+            __bool_put(encoder, (uint8_t)(encoder->bottom >> 24));
+            encoder->bottom &= (1 << 24) - 1;
+            encoder->bit_count = 8;
+        }
+    }
+}
+
+// Write the last bytes of the partition
+static void __bool_encoder_flush(Vp8BoolEncoder *encoder)
+{
+    int count = encoder->bit_count;
+    uint32_t value = encoder->bottom;
+    
+    if (value & ((uint32_t)1 << (32 - count))) __bool_carry(encoder);
+    
+    // Move the bits that were not written yet to the top of the value, then write them padded with zeroes
+    value <<= count & 7;
+    for (count >>= 3; count > 0; count--) value <<= 8;
+    
+    for (int i = 0; i < 4; i++)
+    {
+        __bool_put(encoder, (uint8_t)(value >> 24));
+        value <<= 8;
+    }
+}
+
+// Read the magnitude of a coefficient that is bigger than 1
+static int __read_large(Vp8BoolDecoder *decoder, const uint8_t *p)
+{
+    if (!__bool_read(decoder, p[3]))
+    {
+        // 2, 3, or 4
+        if (!__bool_read(decoder, p[4])) return 2;
+        return 3 + __bool_read(decoder, p[5]);
+    }
+    
+    if (!__bool_read(decoder, p[6]))
+    {
+        // 5 to 6, or 7 to 10
+        if (!__bool_read(decoder, p[7])) return 5 + __bool_read(decoder, 159);
+        const int value = 7 + 2 * __bool_read(decoder, 165);
+        return value + __bool_read(decoder, 145);
+    }
+
+    // 11 to 18, 19 to 34, 35 to 66, or 67 to 2114 (an offset from the start of the category, given by its extra bits)
+    const int bit_1 = __bool_read(decoder, p[8]);
+    const int bit_0 = __bool_read(decoder, p[9 + bit_1]);
+    const int category = 2 * bit_1 + bit_0;
+    
+    int value = 0;
+    for (const uint8_t *prob = vp8_cat_proba[category]; *prob; prob++)
+    {
+        value = 2 * value + __bool_read(decoder, *prob);
+    }
+
+    return value + 3 + (8 << category);
+}
+
+// Write the magnitude of a coefficient that is bigger than 1
+static void __write_large(Vp8BoolEncoder *encoder, const uint8_t *p, int value)
+{
+    if (value <= 4)
+    {
+        __bool_write(encoder, p[3], 0);
+        __bool_write(encoder, p[4], value != 2);
+        if (value != 2) __bool_write(encoder, p[5], value == 4);
+        return;
+    }
+
+    __bool_write(encoder, p[3], 1);
+
+    if (value <= 10)
+    {
+        __bool_write(encoder, p[6], 0);
+        __bool_write(encoder, p[7], value >= 7);
+        
+        if (value <= 6)
+        {
+            __bool_write(encoder, 159, value == 6);
+        }
+        else
+        {
+            __bool_write(encoder, 165, (value - 7) >> 1);
+            __bool_write(encoder, 145, (value - 7) & 1);
+        }
+        
+        return;
+    }
+
+    __bool_write(encoder, p[6], 1);
+    
+    const int category = (value < 19) ? 0 : (value < 35) ? 1 : (value < 67) ? 2 : 3;
+    __bool_write(encoder, p[8], category >> 1);
+    __bool_write(encoder, p[9 + (category >> 1)], category & 1);
+
+    const uint8_t *const prob = vp8_cat_proba[category];
+    const int extra = value - (3 + (8 << category));
+    const int bits = (int)strlen((const char *)prob);
+    
+    for (int i = 0; i < bits; i++)
+    {
+        __bool_write(encoder, prob[i], (extra >> (bits - 1 - i)) & 1);
+    }
+}
+
+// Read the tokens of a block of coefficients, starting from position 'first' (0 or 1)
+// Returns the position after the last token (where the "end of block" token is, or 16 if there is none).
+static int __read_tokens(Vp8BoolDecoder *decoder, const uint8_t (*proba)[3][11], int ctx, int first, int16_t *coef)
+{
+    const uint8_t *p = proba[vp8_bands[first]][ctx];
+    int n = first;
+
+    while (n < 16)
+    {
+        // End of block
+        if (!__bool_read(decoder, p[0])) return n;
+
+        // Zeroes before the next nonzero coefficient
+        while (!__bool_read(decoder, p[1]))
+        {
+            if (++n == 16) return 16;
+            p = proba[vp8_bands[n]][0];
+        }
+
+        // The context of the next token is whether this coefficient is 1 or bigger
+        const uint8_t (*const next)[11] = proba[vp8_bands[n + 1]];
+        int value;
+        
+        if (!__bool_read(decoder, p[2]))
+        {
+            value = 1;
+            p = next[1];
+        }
+        else
+        {
+            value = __read_large(decoder, p);
+            p = next[2];
+        }
+
+        coef[n++] = __bool_read(decoder, 128) ? -value : value;
+    }
+
+    return 16;
+}
+
+// Write the tokens of a block of coefficients, ending them at the position 'end' that was read by '__read_tokens()'
+static void __write_tokens(Vp8BoolEncoder *encoder, const uint8_t (*proba)[3][11], int ctx, int first, int end, const int16_t *coef)
+{
+    const uint8_t *p = proba[vp8_bands[first]][ctx];
+    int n = first;
+
+    while (n < 16)
+    {
+        __bool_write(encoder, p[0], n != end);
+        if (n == end) return;
+
+        while (coef[n] == 0)
+        {
+            __bool_write(encoder, p[1], 0);
+            if (++n == 16) return;
+            p = proba[vp8_bands[n]][0];
+        }
+
+        __bool_write(encoder, p[1], 1);
+
+        const uint8_t (*const next)[11] = proba[vp8_bands[n + 1]];
+        const int value = abs(coef[n]);
+
+        if (value == 1)
+        {
+            __bool_write(encoder, p[2], 0);
+            p = next[1];
+        }
+        else
+        {
+            __bool_write(encoder, p[2], 1);
+            __write_large(encoder, p, value);
+            p = next[2];
+        }
+
+        __bool_write(encoder, 128, coef[n++] < 0);
+    }
+}
+
+// Read or write the tokens of a block (whichever of 'decoder' and 'encoder' is not NULL), and return where the block ends
+static inline int __block_tokens(
+    Vp8BoolDecoder *decoder,
+    Vp8BoolEncoder *encoder,
+    const uint8_t (*proba)[3][11],
+    int ctx,
+    int first,
+    int16_t *coef,
+    uint8_t *end
+)
+{
+    if (decoder) *end = (uint8_t)__read_tokens(decoder, proba, ctx, first, coef);
+    else __write_tokens(encoder, proba, ctx, first, *end, coef);
+    return *end;
+}
+
+// Read the segment, skip flag and prediction modes of every macroblock from the first partition
+// (only the flags are kept, the modes are read because each one changes the probabilities of the next ones)
+static int __read_modes(Vp8Image *image, Vp8BoolDecoder *decoder, const uint8_t *segment_proba, uint8_t skip_proba)
+{
+    // Prediction modes of the 4x4 luma blocks on the bottom of the previous row, and on the right of the previous macroblock
+    // (the modes outside of the image are DC)
+    uint8_t *const mode_top = imc_calloc(image->mb_width * 4, sizeof(uint8_t));
+    uint8_t mode_left[4];
+    size_t mb_index = 0;
+
+    for (size_t mb_y = 0; mb_y < image->mb_height; mb_y++)
+    {
+        memset(mode_left, 0, sizeof(mode_left));
+
+        for (size_t mb_x = 0; mb_x < image->mb_width; mb_x++)
+        {
+            uint8_t flags = 0;
+            uint8_t *const top = &mode_top[mb_x * 4];
+
+            // Segment of the macroblock
+            if (segment_proba)
+            {
+                if (!__bool_read(decoder, segment_proba[0])) __bool_read(decoder, segment_proba[1]);
+                else __bool_read(decoder, segment_proba[2]);
+            }
+
+            if (image->use_skip && __bool_read(decoder, skip_proba)) flags |= IMC_VP8_MB_SKIP;
+
+            if (!__bool_read(decoder, 145))
+            {
+                // Each 4x4 luma block has its own prediction mode, which depends on the modes above and to the left of it
+                flags |= IMC_VP8_MB_I4X4;
+                
+                for (int y = 0; y < 4; y++)
+                {
+                    int mode = mode_left[y];
+                    
+                    for (int x = 0; x < 4; x++)
+                    {
+                        const uint8_t *const prob = vp8_bmode_proba[top[x]][mode];
+                        int branch = vp8_bmode_tree[__bool_read(decoder, prob[0])];
+                        while (branch > 0)
+                        {
+                            branch = vp8_bmode_tree[2 * branch + __bool_read(decoder, prob[branch])];
+                        }
+                        mode = -branch;
+                        top[x] = (uint8_t)mode;
+                    }
+                    
+                    mode_left[y] = (uint8_t)mode;
+                }
+            }
+            else
+            {
+                // A single prediction mode for the 16x16 luma block (DC = 0, TM = 1, V = 2, H = 3)
+                int mode;
+                if (__bool_read(decoder, 156)) mode = __bool_read(decoder, 128) ? 1 : 3;
+                else mode = __bool_read(decoder, 163) ? 2 : 0;
+                
+                memset(top, mode, 4);
+                memset(mode_left, mode, 4);
+            }
+
+            // Prediction mode of the chroma blocks
+            if (__bool_read(decoder, 142) && __bool_read(decoder, 114)) __bool_read(decoder, 183);
+
+            image->mb_flags[mb_index++] = flags;
+        }
+    }
+
+    imc_free(mode_top);
+    return (decoder->overrun > 2) ? IMC_ERR_FILE_INVALID : IMC_SUCCESS;
+}
+
+// Read or write the coefficient tokens of a macroblock, on the column 'mb_x'
+// Exactly one of 'decoder' and 'encoder' is not NULL. When reading, the coefficients and the positions where their blocks
+// end are stored on the image. When writing, the tokens are made from them. The context is updated the same way on both cases.
+static void __macroblock_tokens(const Vp8Image *image, size_t mb_index, size_t mb_x, Vp8Context *context, Vp8BoolDecoder *decoder, Vp8BoolEncoder *encoder)
+{
+    const uint8_t flags = image->mb_flags[mb_index];
+    int16_t *const coef = &image->coef[mb_index * IMC_VP8_BLOCKS * 16];
+    uint8_t *const block_end = &image->block_end[mb_index * IMC_VP8_BLOCKS];
+    uint8_t *const top = &context->top[mb_x * 9];
+    uint8_t *const left = context->left;
+
+    // A macroblock without tokens clears the context of its blocks (of the Y2 block only if the macroblock has one)
+    if (flags & IMC_VP8_MB_SKIP)
+    {
+        memset(top, 0, 8);
+        memset(left, 0, 8);
+        if (!(flags & IMC_VP8_MB_I4X4)) top[8] = left[8] = 0;
+        return;
+    }
+
+    // Block types: 0 = luma without DC, 1 = Y2, 2 = chroma, 3 = luma with DC
+    int first = 0;
+    int luma_type = 3;
+
+    // The Y2 block has the DC coefficients of the luma blocks
+    if (!(flags & IMC_VP8_MB_I4X4))
+    {
+        const int end = __block_tokens(
+            decoder, encoder, image->proba[1], top[8] + left[8], 0, &coef[IMC_VP8_Y2_BLOCK * 16], &block_end[IMC_VP8_Y2_BLOCK]
+        );
+        top[8] = left[8] = (end > 0);
+        first = 1;
+        luma_type = 0;
+    }
+
+    // Luma blocks
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            const int block = y * 4 + x;
+            const int end = __block_tokens(
+                decoder, encoder, image->proba[luma_type], top[x] + left[y], first, &coef[block * 16], &block_end[block]
+            );
+            top[x] = left[y] = (end > first);
+        }
+    }
+
+    // Chroma blocks (blue, then red)
+    for (int ch = 0; ch < 2; ch++)
+    {
+        for (int y = 0; y < 2; y++)
+        {
+            for (int x = 0; x < 2; x++)
+            {
+                const int block = 16 + ch * 4 + y * 2 + x;
+                uint8_t *const above = &top[4 + ch * 2 + x];
+                uint8_t *const beside = &left[4 + ch * 2 + y];
+                const int end = __block_tokens(
+                    decoder, encoder, image->proba[2], *above + *beside, 0, &coef[block * 16], &block_end[block]
+                );
+                *above = *beside = (end > 0);
+            }
+        }
+    }
+}
+
+// Read a little-endian 32-bit integer
+static inline uint32_t __read_le32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// Find the "VP8 " chunk of a still lossy WebP image
+// Returns false for lossless and animated images, or if the file is not a valid WebP image.
+bool imc_vp8_find(const uint8_t *file, size_t file_size, size_t *out_offset, size_t *out_size)
+{
+    if (file_size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(&file[8], "WEBP", 4) != 0) return false;
+
+    const size_t riff_end = (size_t)__read_le32(&file[4]) + 8;
+    const size_t end = (riff_end < file_size) ? riff_end : file_size;
+    bool found = false;
+
+    // Chunks of the file: a 4 character name, the size of the contents, then the contents (padded to an even size)
+    for (size_t pos = 12; pos + 8 <= end; )
+    {
+        const uint8_t *const name = &file[pos];
+        const size_t size = __read_le32(&file[pos + 4]);
+        if (size > end - pos - 8) return false;
+
+        if (memcmp(name, "VP8L", 4) == 0 || memcmp(name, "ANIM", 4) == 0 || memcmp(name, "ANMF", 4) == 0) return false;
+        
+        if (!found && memcmp(name, "VP8 ", 4) == 0)
+        {
+            *out_offset = pos;
+            *out_size = size;
+            found = true;
+        }
+
+        pos += 8 + size + (size & 1);
+    }
+
+    return found;
+}
+
+// Read the coefficients of a lossy WebP image (the file should remain mapped while the image is being used)
+// Returns IMC_ERR_UNSUPPORTED if the image is not a still lossy image, or IMC_ERR_FILE_INVALID if its bitstream is damaged.
+// The image should be freed with 'imc_vp8_free()'.
+int imc_vp8_read(const uint8_t *file, size_t file_size, Vp8Image **out_image)
+{
+    size_t chunk_offset = 0;
+    size_t chunk_size = 0;
+    if (!imc_vp8_find(file, file_size, &chunk_offset, &chunk_size)) return IMC_ERR_UNSUPPORTED;
+    
+    const uint8_t *const data = &file[chunk_offset + 8];
+    if (chunk_size < 10) return IMC_ERR_FILE_INVALID;
+
+    // Frame header: key frame flag, version, visibility, and size of the first partition, followed by the start code and the dimensions
+    // (every WebP image is a single key frame)
+    const uint32_t frame_tag = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+    if (frame_tag & 1) return IMC_ERR_UNSUPPORTED;
+    if (data[3] != 0x9D || data[4] != 0x01 || data[5] != 0x2A) return IMC_ERR_FILE_INVALID;
+
+    const size_t first_size = frame_tag >> 5;
+    const uint32_t width = ((uint32_t)data[6] | ((uint32_t)data[7] << 8)) & 0x3FFF;
+    const uint32_t height = ((uint32_t)data[8] | ((uint32_t)data[9] << 8)) & 0x3FFF;
+    if (width == 0 || height == 0 || first_size > chunk_size - 10) return IMC_ERR_FILE_INVALID;
+
+    Vp8Image *image = imc_calloc(1, sizeof(Vp8Image));
+    image->chunk = data;
+    image->chunk_size = chunk_size;
+    image->chunk_offset = chunk_offset;
+    image->header_size = 10 + first_size;
+    image->width = width;
+    image->height = height;
+    image->mb_width = (width + 15) / 16;
+    image->mb_height = (height + 15) / 16;
+
+    Vp8BoolDecoder decoder;
+    __bool_decoder_init(&decoder, &data[10], first_size);
+
+    // Color space and clamping type
+    __bool_read_literal(&decoder, 2);
+
+    // Segments of the image, and their quantizers and filter strengths
+    bool update_map = false;
+    uint8_t segment_proba[3] = {255, 255, 255};
+    
+    if (__bool_read(&decoder, 128))
+    {
+        update_map = __bool_read(&decoder, 128);
+        if (__bool_read(&decoder, 128))
+        {
+            __bool_read(&decoder, 128);     // Whether the values are absolute or relative
+            for (int i = 0; i < 4; i++) if (__bool_read(&decoder, 128)) __bool_read_signed(&decoder, 7);
+            for (int i = 0; i < 4; i++) if (__bool_read(&decoder, 128)) __bool_read_signed(&decoder, 6);
+        }
+        if (update_map)
+        {
+            for (int i = 0; i < 3; i++) if (__bool_read(&decoder, 128)) segment_proba[i] = (uint8_t)__bool_read_literal(&decoder, 8);
+        }
+    }
+
+    // Loop filter: type, level, sharpness, and the optional adjustments
+    __bool_read_literal(&decoder, 1 + 6 + 3);
+    if (__bool_read(&decoder, 128) && __bool_read(&decoder, 128))
+    {
+        for (int i = 0; i < 8; i++) if (__bool_read(&decoder, 128)) __bool_read_signed(&decoder, 6);
+    }
+
+    // Token partitions: the size of each one (except the last) comes after the first partition, as a 24-bit little-endian number
+    image->partition_count = (size_t)1 << __bool_read_literal(&decoder, 2);
+    const uint8_t *const sizes = &data[image->header_size];
+    const uint8_t *const chunk_end = &data[chunk_size];
+    const uint8_t *part = &sizes[3 * (image->partition_count - 1)];
+    int status = (part <= chunk_end) ? IMC_SUCCESS : IMC_ERR_FILE_INVALID;
+
+    for (size_t i = 0; i < image->partition_count && status == IMC_SUCCESS; i++)
+    {
+        const size_t available = (size_t)(chunk_end - part);
+        const size_t size = (i + 1 < image->partition_count)
+            ? ((size_t)sizes[3*i] | ((size_t)sizes[3*i + 1] << 8) | ((size_t)sizes[3*i + 2] << 16))
+            : available;
+        
+        if (size > available)
+        {
+            status = IMC_ERR_FILE_INVALID;
+            break;
+        }
+        
+        image->partition[i] = part;
+        image->partition_size[i] = size;
+        part += size;
+    }
+
+    // Quantizers: the base index, then the optional deltas of the DC and AC coefficients of each block type
+    __bool_read_literal(&decoder, 7);
+    for (int i = 0; i < 5; i++) if (__bool_read(&decoder, 128)) __bool_read_signed(&decoder, 4);
+
+    // Whether the probabilities are kept for the next frame (which does not exist on WebP)
+    __bool_read(&decoder, 128);
+
+    // Probabilities of the coefficient tokens (each one can be replaced by the frame)
+    for (int t = 0; t < 4; t++)
+    {
+        for (int b = 0; b < 8; b++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                for (int p = 0; p < 11; p++)
+                {
+                    image->proba[t][b][c][p] = __bool_read(&decoder, vp8_coef_update_proba[t][b][c][p])
+                        ? (uint8_t)__bool_read_literal(&decoder, 8)
+                        : vp8_coef_proba[t][b][c][p];
+                }
+            }
+        }
+    }
+
+    // Probability of a macroblock having no tokens
+    image->use_skip = __bool_read(&decoder, 128);
+    const uint8_t skip_proba = image->use_skip ? (uint8_t)__bool_read_literal(&decoder, 8) : 0;
+
+    const size_t mb_count = image->mb_width * image->mb_height;
+    image->mb_flags = imc_calloc(mb_count, sizeof(uint8_t));
+    image->coef = imc_calloc(mb_count * IMC_VP8_BLOCKS * 16, sizeof(int16_t));
+    image->block_end = imc_calloc(mb_count * IMC_VP8_BLOCKS, sizeof(uint8_t));
+
+    if (status == IMC_SUCCESS) status = __read_modes(image, &decoder, update_map ? segment_proba : NULL, skip_proba);
+
+    // Coefficients of each macroblock (the rows of macroblocks take turns on the token partitions)
+    if (status == IMC_SUCCESS)
+    {
+        Vp8BoolDecoder part_decoder[8];
+        for (size_t i = 0; i < image->partition_count; i++)
+        {
+            __bool_decoder_init(&part_decoder[i], image->partition[i], image->partition_size[i]);
+        }
+        
+        Vp8Context context = {.top = imc_calloc(image->mb_width * 9, sizeof(uint8_t))};
+        size_t mb_index = 0;
+        
+        for (size_t mb_y = 0; mb_y < image->mb_height; mb_y++)
+        {
+            memset(context.left, 0, sizeof(context.left));
+            Vp8BoolDecoder *const row_decoder = &part_decoder[mb_y & (image->partition_count - 1)];
+            
+            for (size_t mb_x = 0; mb_x < image->mb_width; mb_x++)
+            {
+                __macroblock_tokens(image, mb_index++, mb_x, &context, row_decoder, NULL);
+            }
+        }
+        
+        imc_free(context.top);
+
+        // A partition that ended before its tokens is damaged
+        for (size_t i = 0; i < image->partition_count; i++)
+        {
+            if (part_decoder[i].overrun > 2) status = IMC_ERR_FILE_INVALID;
+        }
+    }
+
+    if (status != IMC_SUCCESS)
+    {
+        imc_vp8_free(image);
+        return status;
+    }
+
+    *out_image = image;
+    return IMC_SUCCESS;
+}
+
+// Encode the coefficients of the image into a new "VP8 " chunk (without the chunk's header)
+// 'out_chunk' receives the contents of the chunk, which should be freed with 'imc_free()'.
+// Returns IMC_ERR_WRITE_FAIL if a token partition became too big for the size field of the bitstream.
+int imc_vp8_write(const Vp8Image *image, uint8_t **out_chunk, size_t *out_size)
+{
+    // Encode the token partitions with the same probabilities as the original image
+    Vp8BoolEncoder encoder[8];
+    for (size_t i = 0; i < image->partition_count; i++)
+    {
+        __bool_encoder_init(&encoder[i], image->partition_size[i] + 64);
+    }
+
+    Vp8Context context = {.top = imc_calloc(image->mb_width * 9, sizeof(uint8_t))};
+    size_t mb_index = 0;
+
+    for (size_t mb_y = 0; mb_y < image->mb_height; mb_y++)
+    {
+        memset(context.left, 0, sizeof(context.left));
+        Vp8BoolEncoder *const row_encoder = &encoder[mb_y & (image->partition_count - 1)];
+        
+        for (size_t mb_x = 0; mb_x < image->mb_width; mb_x++)
+        {
+            __macroblock_tokens(image, mb_index++, mb_x, &context, NULL, row_encoder);
+        }
+    }
+
+    imc_free(context.top);
+
+    // The header and the first partition are copied as they are, followed by the sizes of the new partitions, then the partitions
+    int status = IMC_SUCCESS;
+    size_t size = image->header_size + 3 * (image->partition_count - 1);
+    
+    for (size_t i = 0; i < image->partition_count; i++)
+    {
+        __bool_encoder_flush(&encoder[i]);
+        if (i + 1 < image->partition_count && encoder[i].size > 0xFFFFFF) status = IMC_ERR_WRITE_FAIL;
+        size += encoder[i].size;
+    }
+
+    uint8_t *chunk = NULL;
+    if (status == IMC_SUCCESS)
+    {
+        chunk = imc_malloc(size);
+        memcpy(chunk, image->chunk, image->header_size);
+        
+        uint8_t *pos = &chunk[image->header_size];
+        for (size_t i = 0; i + 1 < image->partition_count; i++)
+        {
+            *pos++ = (uint8_t)(encoder[i].size & 0xFF);
+            *pos++ = (uint8_t)((encoder[i].size >> 8) & 0xFF);
+            *pos++ = (uint8_t)((encoder[i].size >> 16) & 0xFF);
+        }
+        
+        for (size_t i = 0; i < image->partition_count; i++)
+        {
+            memcpy(pos, encoder[i].output, encoder[i].size);
+            pos += encoder[i].size;
+        }
+    }
+
+    for (size_t i = 0; i < image->partition_count; i++)
+    {
+        imc_free(encoder[i].output);
+    }
+
+    *out_chunk = chunk;
+    *out_size = (status == IMC_SUCCESS) ? size : 0;
+    return status;
+}
+
+// Free the memory used by the coefficients of an image
+void imc_vp8_free(Vp8Image *image)
+{
+    if (!image) return;
+    imc_free(image->mb_flags);
+    imc_free(image->coef);
+    imc_free(image->block_end);
+    imc_free(image);
+}
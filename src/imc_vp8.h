@@ -0,0 +1,165 @@
+/* Reading and writing the quantized DCT coefficients of lossy WebP images (VP8 bitstream), without decoding the pixels. */
+
+#ifndef _IMC_VP8_H
+#define _IMC_VP8_H
+
+#include "imc_includes.h"
+
+/*  A VP8 key frame has a header, followed by the first partition (the probabilities and the prediction modes of every
+    macroblock), then by one or more partitions with the coefficient tokens. All of them are compressed with a boolean
+    entropy coder (RFC 6386), so changing a single coefficient changes the bytes of the whole partition after it.
+
+    The coefficients are read from the token partitions and stored as they are (before the dequantization). When they
+    are written back, only the token partitions are encoded again, with the same probabilities, while the header and
+    the first partition are copied byte by byte. That works as long as no coefficient changes from or to zero: the
+    macroblocks flagged as having no coefficients stay that way, and so does where each block of coefficients ends
+    (which is also the context of the tokens of the neighboring blocks).
+
+    The context of each token also depends on whether the coefficient before it is 0, has a magnitude of 1, or has
+    a bigger magnitude. So, unlike on JPEG images, the hidden bits go into the lowest bit of the magnitude (not of
+    the two's complement value, which would turn -2 into -1), and only magnitudes of 2 or more are used as carriers.
+    Their magnitudes then stay at 2 or more, with the same sign, and no context changes.
+*/
+
+// Blocks of 16 coefficients on each macroblock: 16 luma blocks, 4 blue and 4 red chroma blocks, then the luma DC block (Y2)
+#define IMC_VP8_BLOCKS 25
+#define IMC_VP8_Y2_BLOCK 24
+
+// Largest magnitude that a coefficient token can encode
+// (the only carrier that could go past it, 2114, is never used)
+#define IMC_VP8_MAX_COEF 2114
+
+// Whether a coefficient is used as a carrier (its magnitude is from 2 to 2113)
+#define IMC_VP8_IS_CARRIER(coef) (abs(coef) >= 2 && abs(coef) < IMC_VP8_MAX_COEF)
+
+// Boolean entropy decoder
+typedef struct Vp8BoolDecoder {
+    const uint8_t *input;   // Next byte to be read
+    const uint8_t *end;     // End of the partition
+    uint32_t value;         // Two bytes of the stream, shifted as the bits are read
+    uint32_t range;         // Size of the current interval (128 to 255)
+    int bit_count;          // Amount of bits shifted since the last byte was read
+    size_t overrun;         // Amount of bytes read past the end of the partition (as zeroes)
+} Vp8BoolDecoder;
+
+// Boolean entropy encoder
+typedef struct Vp8BoolEncoder {
+    uint8_t *output;        // Encoded bytes
+    size_t size;            // Amount of bytes on 'output'
+    size_t capacity;        // Amount of bytes allocated for 'output'
+    uint32_t range;         // Size of the current interval (128 to 255)
+    uint32_t bottom;        // Start of the current interval (its top byte is the next one to be written)
+    int bit_count;          // Amount of bits to be shifted until the next byte is written
+} Vp8BoolEncoder;
+
+// Whether a block of coefficients had any token on the previous blocks (the context of the tokens of the next blocks)
+typedef struct Vp8Context {
+    uint8_t *top;           // Blocks above the current macroblock: 4 luma, 2 blue, 2 red, and the Y2 block (for each column of macroblocks)
+    uint8_t left[9];        // Blocks to the left of the current macroblock (same order)
+} Vp8Context;
+
+// Coefficients of a lossy WebP image
+typedef struct Vp8Image {
+    const uint8_t *chunk;       // Contents of the image's "VP8 " chunk (on the file's memory mapping)
+    size_t chunk_size;          // Size in bytes of 'chunk'
+    size_t chunk_offset;        // Position of the chunk's header on the file
+    size_t header_size;         // Size in bytes of the frame header plus the first partition (which are never changed)
+    uint32_t width;             // Width of the image, in pixels
+    uint32_t height;            // Height of the image, in pixels
+    size_t mb_width;            // Amount of macroblocks on each row
+    size_t mb_height;           // Amount of rows of macroblocks
+    size_t partition_count;     // Amount of token partitions (1, 2, 4, or 8)
+    const uint8_t *partition[8];    // Token partitions of the original image
+    size_t partition_size[8];       // Size in bytes of each token partition
+    bool use_skip;              // Whether the macroblocks without coefficients are flagged as such (and have no tokens)
+    uint8_t proba[4][8][3][11]; // Probabilities of the coefficient tokens: [block type][band][context][branch of the token tree]
+    uint8_t *mb_flags;          // For each macroblock: whether it has no tokens (bit 0), and whether it has no Y2 block (bit 1)
+    int16_t *coef;              // Coefficients of all macroblocks ('IMC_VP8_BLOCKS' blocks of 16 each), in the zigzag order
+    uint8_t *block_end;         // Position after the last token of each block
+} Vp8Image;
+
+// Flags of a macroblock on 'Vp8Image.mb_flags'
+#define IMC_VP8_MB_SKIP 1   // The macroblock has no coefficient tokens
+#define IMC_VP8_MB_I4X4 2   // The luma blocks have their own DC coefficients (there is no Y2 block)
+
+// Start decoding a partition
+static void __bool_decoder_init(Vp8BoolDecoder *decoder, const uint8_t *data, size_t size);
+
+// Read a boolean, that is 0 with a probability of 'prob / 256'
+static inline int __bool_read(Vp8BoolDecoder *decoder, uint8_t prob);
+
+// Read an unsigned number of 'bits' bits (the most significant first), each of them with even probability
+static uint32_t __bool_read_literal(Vp8BoolDecoder *decoder, int bits);
+
+// Read a number of 'bits' bits, followed by its sign
+static int32_t __bool_read_signed(Vp8BoolDecoder *decoder, int bits);
+
+// Start encoding a partition, with room for about 'size' bytes
+static void __bool_encoder_init(Vp8BoolEncoder *encoder, size_t size);
+
+// Add 1 to the bytes already written (the carry of the interval's start)
+static void __bool_carry(Vp8BoolEncoder *encoder);
+
+// Append a byte to the partition being encoded
+static inline void __bool_put(Vp8BoolEncoder *encoder, uint8_t byte);
+
+// Write a boolean, that is 0 with a probability of 'prob / 256'
+static inline void __bool_write(Vp8BoolEncoder *encoder, uint8_t prob, int bit);
+
+// Write the last bytes of the partition
+static void __bool_encoder_flush(Vp8BoolEncoder *encoder);
+
+// Read the magnitude of a coefficient that is bigger than 1
+static int __read_large(Vp8BoolDecoder *decoder, const uint8_t *p);
+
+// Write the magnitude of a coefficient that is bigger than 1
+static void __write_large(Vp8BoolEncoder *encoder, const uint8_t *p, int value);
+
+// Read the tokens of a block of coefficients, starting from position 'first' (0 or 1)
+// Returns the position after the last token (where the "end of block" token is, or 16 if there is none).
+static int __read_tokens(Vp8BoolDecoder *decoder, const uint8_t (*proba)[3][11], int ctx, int first, int16_t *coef);
+
+// Write the tokens of a block of coefficients, ending them at the position 'end' that was read by '__read_tokens()'
+static void __write_tokens(Vp8BoolEncoder *encoder, const uint8_t (*proba)[3][11], int ctx, int first, int end, const int16_t *coef);
+
+// Read or write the tokens of a block (whichever of 'decoder' and 'encoder' is not NULL), and return where the block ends
+static inline int __block_tokens(
+    Vp8BoolDecoder *decoder,
+    Vp8BoolEncoder *encoder,
+    const uint8_t (*proba)[3][11],
+    int ctx,
+    int first,
+    int16_t *coef,
+    uint8_t *end
+);
+
+// Read the segment, skip flag and prediction modes of every macroblock from the first partition
+// (only the flags are kept, the modes are read because each one changes the probabilities of the next ones)
+static int __read_modes(Vp8Image *image, Vp8BoolDecoder *decoder, const uint8_t *segment_proba, uint8_t skip_proba);
+
+// Read or write the coefficient tokens of a macroblock, on the column 'mb_x'
+// Exactly one of 'decoder' and 'encoder' is not NULL. When reading, the coefficients and the positions where their blocks
+// end are stored on the image. When writing, the tokens are made from them. The context is updated the same way on both cases.
+static void __macroblock_tokens(const Vp8Image *image, size_t mb_index, size_t mb_x, Vp8Context *context, Vp8BoolDecoder *decoder, Vp8BoolEncoder *encoder);
+
+// Read a little-endian 32-bit integer
+static inline uint32_t __read_le32(const uint8_t *data);
+
+// Find the "VP8 " chunk of a still lossy WebP image
+// Returns false for lossless and animated images, or if the file is not a valid WebP image.
+bool imc_vp8_find(const uint8_t *file, size_t file_size, size_t *out_offset, size_t *out_size);
+
+// Read the coefficients of a lossy WebP image (the file should remain mapped while the image is being used)
+// Returns IMC_ERR_UNSUPPORTED if the image is not a still lossy image, or IMC_ERR_FILE_INVALID if its bitstream is damaged.
+// The image should be freed with 'imc_vp8_free()'.
+int imc_vp8_read(const uint8_t *file, size_t file_size, Vp8Image **out_image);
+
+// Encode the coefficients of the image into a new "VP8 " chunk (without the chunk's header)
+// 'out_chunk' receives the contents of the chunk, which should be freed with 'imc_free()'.
+// Returns IMC_ERR_WRITE_FAIL if a token partition became too big for the size field of the bitstream.
+int imc_vp8_write(const Vp8Image *image, uint8_t **out_chunk, size_t *out_size);
+
+// Free the memory used by the coefficients of an image
+void imc_vp8_free(Vp8Image *image);
+
+#endif  // _IMC_VP8_H
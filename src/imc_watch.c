@@ -0,0 +1,463 @@
+/* Watching a folder for new cover images, and hiding or extracting files on each of them as they arrive. */
+
+#include "imc_includes.h"
+
+#ifndef _WIN32
+
+// Set when the program receives SIGINT or SIGTERM
+static volatile sig_atomic_t watch_stop = 0;
+
+// Signal handler for SIGINT and SIGTERM: ask the watching to stop
+static void __watch_signal(int signal_number)
+{
+    (void)signal_number;
+    watch_stop = 1;
+}
+
+// Read a file to be hidden on the new images
+static int __payload_load(const char *path, WatchPayload *out)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) return IMC_ERR_FILE_NOT_FOUND;
+
+    struct stat file_stat;
+    if (fstat(fileno(file), &file_stat) != 0)
+    {
+        fclose(file);
+        return IMC_ERR_FILE_NOT_FOUND;
+    }
+
+    if (S_ISDIR(file_stat.st_mode))
+    {
+        fclose(file);
+        return IMC_ERR_PATH_IS_DIR;
+    }
+
+    if (file_stat.st_size > IMC_MAX_INPUT_SIZE)
+    {
+        fclose(file);
+        return IMC_ERR_INPUT_TOO_BIG;
+    }
+
+    // One extra byte is allocated, so an empty file still gets a buffer
+    const size_t size = file_stat.st_size;
+    uint8_t *data = imc_malloc(size + 1);
+    const size_t read_size = fread(data, 1, size, file);
+    fclose(file);
+
+    if (read_size != size)
+    {
+        imc_clear_free(data, size + 1);
+        return IMC_ERR_FILE_CORRUPTED;
+    }
+
+    // 'basename()' may change its argument, so it gets a copy of the path
+    char path_copy[strlen(path) + 1];
+    strcpy(path_copy, path);
+
+    *out = (WatchPayload){
+        .name = strdup(basename(path_copy)),
+        .data = data,
+        .size = size,
+        .mod_time = file_stat.st_mtim,
+    };
+
+    return IMC_SUCCESS;
+}
+
+// Name of a file with a number added to its stem, like "name (1).ext" (the number 0 gives the name unchanged)
+// The returned string should be freed with 'imc_free()'.
+static char *__numbered_name(const char *name, int number)
+{
+    const size_t name_len = strlen(name);
+    char *const out = imc_malloc(name_len + 8);
+
+    if (number == 0)
+    {
+        memcpy(out, name, name_len + 1);
+        return out;
+    }
+
+    // The extension begins at the last dot (a dot at the beginning of the name does not count)
+    const char *extension = strrchr(name, '.');
+    if (!extension || extension == name) extension = &name[name_len];
+    const int stem_len = (int)(extension - name);
+
+    snprintf(out, name_len + 8, "%.*s (%d)%s", stem_len, name, number, extension);
+    return out;
+}
+
+// Move a finished result (a file or a folder) from its temporary path to the output folder, without replacing anything there
+// If 'name' is already taken, a number is added to it. On success, 'final_path' receives the new path (to be freed with 'imc_free()').
+static int __publish_result(const char *temp_path, const char *out_dir, const char *name, char **final_path)
+{
+    for (int i = 0; i <= IMC_MAX_FILENAME_DUPLICATES; i++)
+    {
+        char *const numbered = __numbered_name(name, i);
+        const size_t path_size = strlen(out_dir) + strlen(numbered) + 2;
+        char *const path = imc_malloc(path_size);
+        snprintf(path, path_size, "%s/%s", out_dir, numbered);
+        imc_free(numbered);
+
+        // Nothing that already has the name is replaced, even if it was created just now by another program
+        if (imc_rename_noreplace(temp_path, path))
+        {
+            *final_path = path;
+            return IMC_SUCCESS;
+        }
+
+        imc_free(path);
+        if (errno != EEXIST && errno != ENOTEMPTY) return IMC_ERR_SAVE_FAIL;
+    }
+
+    // The amount of tries is limited to 99
+    errno = EEXIST;
+    return IMC_ERR_FILE_EXISTS;
+}
+
+// Hide the payload on an image, then move the modified image to the output folder
+static int __watch_hide(WatchState *watch, CarrierImage *carrier_img, const char *name, size_t worker, char **final_path)
+{
+    if (watch->options->append)
+    {
+        // Safeguard to prevent overwriting the hidden files if the password is wrong
+        imc_steg_seek_to_end(carrier_img);
+        if (carrier_img->carrier_pos == 0) return IMC_ERR_INVALID_MAGIC;
+    }
+
+    for (size_t i = 0; i < watch->payload_count; i++)
+    {
+        const WatchPayload *const payload = &watch->payload[i];
+        const int status = imc_steg_insert_memory(carrier_img, payload->name, payload->data, payload->size, payload->mod_time);
+        if (status != IMC_SUCCESS) return status;
+    }
+
+    uint8_t *image = NULL;
+    size_t image_size = 0;
+    const int save_status = imc_steg_save_memory(carrier_img, &image, &image_size);
+    if (save_status != IMC_SUCCESS) return save_status;
+
+    // Write the image to a temporary file on the output folder (its name begins with a dot, so it is ignored if watched)
+    const size_t temp_size = strlen(watch->out_dir) + strlen(name) + 32;
+    char temp_path[temp_size];
+    snprintf(temp_path, temp_size, "%s/.%s.%zu.partial", watch->out_dir, name, worker);
+
+    FILE *temp_file = fopen(temp_path, "wb");
+    if (!temp_file)
+    {
+        imc_free(image);
+        return IMC_ERR_SAVE_FAIL;
+    }
+
+    const bool written = (fwrite(image, 1, image_size, temp_file) == image_size);
+    imc_free(image);
+
+    if (fclose(temp_file) != 0 || !written)
+    {
+        unlink(temp_path);
+        return IMC_ERR_SAVE_FAIL;
+    }
+
+    const int publish_status = __publish_result(temp_path, watch->out_dir, name, final_path);
+    if (publish_status != IMC_SUCCESS) unlink(temp_path);
+
+    return publish_status;
+}
+
+// Extract the hidden files of an image to a new folder named after the image, on the output folder
+// The files are extracted to a temporary folder, which is renamed once all files were written.
+static int __watch_extract(WatchState *watch, CarrierImage *carrier_img, const char *name, size_t worker, char **final_path)
+{
+    // The folder is named after the image's stem
+    const char *extension = strrchr(name, '.');
+    if (!extension || extension == name) extension = &name[strlen(name)];
+    const int stem_len = (int)(extension - name);
+    char stem[stem_len + 1];
+    memcpy(stem, name, stem_len);
+    stem[stem_len] = '\0';
+
+    const size_t temp_size = strlen(watch->out_dir) + strlen(name) + 32;
+    char temp_path[temp_size];
+    snprintf(temp_path, temp_size, "%s/.%s.%zu.partial", watch->out_dir, stem, worker);
+    if (mkdir(temp_path, 0700) != 0) return IMC_ERR_SAVE_FAIL;
+
+    // The parallelism is already among the images, so each image is extracted on a single thread
+    ExtractResult *results = NULL;
+    size_t result_count = 0;
+    const int end_status = imc_steg_extract_all(carrier_img, temp_path, 1, &results, &result_count);
+
+    size_t saved_count = 0;
+    for (size_t i = 0; i < result_count; i++) saved_count += (results[i].status == IMC_SUCCESS);
+    imc_steg_results_free(results, result_count);
+
+    if (saved_count == 0)
+    {
+        rmdir(temp_path);
+        if (end_status == IMC_ERR_SAVE_FAIL) return IMC_ERR_SAVE_FAIL;
+        return (result_count == 0) ? IMC_ERR_INVALID_MAGIC : IMC_ERR_CRYPTO_FAIL;
+    }
+
+    const int publish_status = __publish_result(temp_path, watch->out_dir, stem, final_path);
+    if (publish_status != IMC_SUCCESS) return publish_status;
+
+    // Some of the hidden files could not be extracted
+    if (saved_count < result_count) return IMC_ERR_FILE_CORRUPTED;
+
+    return IMC_SUCCESS;
+}
+
+// Task of the worker threads: process one new image
+static void __watch_task(void *context, void *item, size_t worker)
+{
+    WatchState *const watch = (WatchState *)context;
+    const WatchOptions *const options = watch->options;
+    char *const path = (char *)item;
+    const bool hiding = (watch->payload_count > 0);
+
+    // Name of the image (without the folders)
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+
+    CarrierImage *carrier_img = NULL;
+    char *final_path = NULL;
+    const StegOptions steg_options = {.profile = options->profile};
+    int status = imc_steg_init_context(path, options->crypto, &carrier_img, &steg_options);
+
+    if (status == IMC_SUCCESS)
+    {
+        if (hiding) status = __watch_hide(watch, carrier_img, name, worker, &final_path);
+        else status = __watch_extract(watch, carrier_img, name, worker, &final_path);
+        imc_steg_finish(carrier_img);
+    }
+
+    // Images without hidden data are not errors when extracting
+    if (!hiding && status == IMC_ERR_INVALID_MAGIC)
+    {
+        atomic_fetch_add(&watch->empty, 1);
+        if (!options->silent) printf("No hidden data found on '%s'.\n", name);
+    }
+    else if (status == IMC_SUCCESS || (!hiding && status == IMC_ERR_FILE_CORRUPTED && final_path))
+    {
+        atomic_fetch_add(&watch->succeeded, 1);
+        if (!options->silent)
+        {
+            printf("SUCCESS: %s '%s' to '%s'%s.\n",
+                hiding ? "hid the files on" : "extracted the files hidden on", name, final_path,
+                (status == IMC_SUCCESS) ? "" : " (some hidden files could not be extracted)"
+            );
+        }
+    }
+    else
+    {
+        atomic_fetch_add(&watch->failed, 1);
+        if (hiding && options->append && status == IMC_ERR_INVALID_MAGIC)
+        {
+            fprintf(stderr, "FAIL: image '%s' contains no hidden data or the password is incorrect (nothing was appended).\n", name);
+        }
+        else if (status == IMC_ERR_SAVE_FAIL)
+        {
+            fprintf(stderr, "FAIL: could not save the result of '%s' to '%s'. Reason: %s.\n", name, watch->out_dir, strerror(errno));
+        }
+        else
+        {
+            fprintf(stderr, "FAIL: could not process '%s'. Reason: %s.\n", name, imc_strerror(status));
+        }
+    }
+
+    if (options->verbose)
+    {
+        QueueStats queue;
+        imc_queue_stats(watch->queue, &queue);
+        printf("Queue: %zu waiting (peak %zu of %zu), %zu being processed.\n", queue.depth, queue.peak, queue.capacity, queue.busy);
+    }
+
+    fflush(stdout);
+    imc_free(final_path);
+    imc_free(path);
+}
+
+#endif  // _WIN32
+
+// Watch a folder for new images (files closed after being written, or moved into the folder), until SIGINT or SIGTERM is received
+// Each new image gets the files on 'hide_paths' hidden on it, or gets its hidden files extracted (if there are no files to hide).
+// The results are moved to the output folder only after they are complete. Files whose name begins with a dot are ignored.
+// If a file to be hidden could not be read, its path is stored on 'failed_path'.
+// Returns IMC_ERR_UNSUPPORTED on systems without inotify.
+int imc_watch_run(const WatchOptions *options, const char **failed_path)
+{
+    #ifdef _WIN32
+    (void)options;
+    (void)failed_path;
+    return IMC_ERR_UNSUPPORTED;
+
+    #else   // Linux systems
+    if (sodium_init() < 0) return IMC_ERR_CRYPTO_FAIL;
+    const size_t thread_count = (options->thread_count > 0) ? options->thread_count : imc_cpu_count();
+
+    WatchState watch = {
+        .options = options,
+        .out_dir = options->out_dir ? options->out_dir : ".",
+    };
+
+    // The results are moved to an existing folder
+    struct stat out_stat;
+    const bool out_exists = (stat(watch.out_dir, &out_stat) == 0);
+    if (!out_exists || !S_ISDIR(out_stat.st_mode))
+    {
+        if (out_exists) errno = ENOTDIR;
+        *failed_path = watch.out_dir;
+        return IMC_ERR_SAVE_FAIL;
+    }
+
+    // The files to be hidden are read only once
+    watch.payload = imc_calloc(options->hide_count + 1, sizeof(WatchPayload));
+    int status = IMC_SUCCESS;
+
+    for (size_t i = 0; i < options->hide_count; i++)
+    {
+        status = __payload_load(options->hide_paths[i], &watch.payload[i]);
+        if (status != IMC_SUCCESS)
+        {
+            *failed_path = options->hide_paths[i];
+            break;
+        }
+        watch.payload_count++;
+    }
+
+    // Start watching the folder
+    int notify_fd = -1;
+    if (status == IMC_SUCCESS)
+    {
+        notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if ( notify_fd < 0 ||
+             inotify_add_watch(notify_fd, options->watch_dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) < 0 )
+        {
+            *failed_path = options->watch_dir;
+            status = IMC_ERR_FILE_NOT_FOUND;
+        }
+    }
+
+    if (status != IMC_SUCCESS)
+    {
+        const int status_errno = errno;
+        if (notify_fd >= 0) close(notify_fd);
+        for (size_t i = 0; i < watch.payload_count; i++)
+        {
+            imc_free(watch.payload[i].name);
+            imc_clear_free(watch.payload[i].data, watch.payload[i].size + 1);
+        }
+        imc_free(watch.payload);
+        errno = status_errno;
+        return status;
+    }
+
+    // Stop on Ctrl+C or on a termination request
+    watch_stop = 0;
+    struct sigaction action = {.sa_handler = &__watch_signal};
+    sigemptyset(&action.sa_mask);
+    struct sigaction old_int, old_term;
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    /* Note: the queue has a limited size, so a burst of new images cannot make the program use more memory or threads.
+       While the queue is full, the events are left on the system's queue of events, and the time spent waiting is measured. */
+    watch.queue = imc_queue_create(thread_count * IMC_WATCH_BACKLOG, thread_count, &__watch_task, &watch);
+
+    if (!options->silent)
+    {
+        printf("Watching '%s' for new images, %s, with %zu worker thread%s (press Ctrl+C to stop)...\n",
+            options->watch_dir, (watch.payload_count > 0) ? "hiding files on them" : "extracting their hidden files",
+            thread_count, (thread_count == 1) ? "" : "s"
+        );
+        fflush(stdout);
+    }
+
+    // The events have variable size, and the buffer should be aligned for reading them
+    uint8_t event_buffer[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const size_t dir_len = strlen(options->watch_dir);
+    bool watched_dir_gone = false;
+
+    while (!watch_stop && !watched_dir_gone)
+    {
+        struct pollfd notify_poll = {.fd = notify_fd, .events = POLLIN};
+        if (poll(&notify_poll, 1, IMC_WATCH_POLL_INTERVAL) <= 0) continue;
+
+        const ssize_t length = read(notify_fd, event_buffer, sizeof(event_buffer));
+        if (length <= 0) continue;
+
+        for (ssize_t pos = 0; pos < length; )
+        {
+            const struct inotify_event *const event = (struct inotify_event *)&event_buffer[pos];
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                watch.lost_events++;
+                fprintf(stderr, "Warning: too many new files at once, some of them were missed (they can be moved out and back in).\n");
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                watched_dir_gone = true;
+                continue;
+            }
+
+            // Skip folders and hidden or temporary files
+            if (event->len == 0 || (event->mask & IN_ISDIR) || event->name[0] == '.') continue;
+
+            const size_t path_size = dir_len + strlen(event->name) + 2;
+            char *const path = imc_malloc(path_size);
+            snprintf(path, path_size, "%s/%s", options->watch_dir, event->name);
+
+            // Wait for a free space on the queue (backpressure)
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            const bool queued = imc_queue_push(watch.queue, path);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            watch.wait_us += (uint64_t)(end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+            if (queued) watch.events++;
+            else imc_free(path);
+        }
+    }
+
+    // Wait for the images already on the queue
+    close(notify_fd);
+    QueueStats queue;
+    imc_queue_stats(watch.queue, &queue);
+    imc_queue_finish(watch.queue);
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+
+    if (watched_dir_gone)
+    {
+        fprintf(stderr, "The folder '%s' was removed or moved, so it is no longer being watched.\n", options->watch_dir);
+    }
+
+    if (!options->silent)
+    {
+        printf("\nStopped watching '%s'.\n", options->watch_dir);
+        printf("Images: %zu received, %zu succeeded, %zu failed",
+            watch.events, atomic_load(&watch.succeeded), atomic_load(&watch.failed)
+        );
+        if (watch.payload_count == 0) printf(", %zu without hidden data", atomic_load(&watch.empty));
+        printf(".\n");
+        printf("Queue: peak of %zu waiting (out of %zu), full %llu times (%.2f seconds waiting for a free space in total).\n",
+            queue.peak, queue.capacity, (unsigned long long)queue.full_waits, watch.wait_us / 1000000.0
+        );
+        if (watch.lost_events > 0) printf("The system's event queue overflowed %zu times.\n", watch.lost_events);
+    }
+
+    for (size_t i = 0; i < watch.payload_count; i++)
+    {
+        imc_free(watch.payload[i].name);
+        imc_clear_free(watch.payload[i].data, watch.payload[i].size + 1);
+    }
+    imc_free(watch.payload);
+
+    return IMC_SUCCESS;
+
+    #endif  // _WIN32
+}
@@ -0,0 +1,87 @@
+/* Watching a folder for new cover images, and hiding or extracting files on each of them as they arrive. */
+
+#ifndef _IMC_WATCH_H
+#define _IMC_WATCH_H
+
+#include "imc_includes.h"
+
+// Maximum amount of new images waiting for a worker thread, per worker
+// (when the queue is full, the reading of new events waits, and the system holds them meanwhile)
+#define IMC_WATCH_BACKLOG 4
+
+// How often (in milliseconds) the watching checks whether it should stop
+#define IMC_WATCH_POLL_INTERVAL 500
+
+// Settings of the watch mode
+typedef struct WatchOptions {
+    const char *watch_dir;          // Folder where the new images arrive
+    const char *out_dir;            // Folder where the results are moved to (NULL for the current working directory)
+    const CryptoContext *crypto;    // Secrets used on every image (each image gets its own copy)
+    const char *const *hide_paths;  // Files to be hidden on each new image (if none, the hidden files are extracted instead)
+    size_t hide_count;              // Amount of files on 'hide_paths'
+    bool append;                    // Whether to append the files to the ones already hidden on the image
+    enum SaveProfile profile;       // Settings of the encoder when saving the images
+    size_t thread_count;            // Amount of worker threads (0 for the amount of logical processors)
+    bool verbose;                   // Print the queue depth with each processed image
+    bool silent;                    // Print only the errors
+} WatchOptions;
+
+#ifndef _WIN32
+
+// File hidden on each new image (read once, when the watching begins)
+typedef struct WatchPayload {
+    char *name;                 // Name of the file (without the folders)
+    uint8_t *data;              // Contents of the file
+    size_t size;                // Size in bytes of the file
+    struct timespec mod_time;   // Last modified time of the file
+} WatchPayload;
+
+// State shared by the worker threads of the watch mode
+typedef struct WatchState {
+    const WatchOptions *options;
+    const char *out_dir;        // Folder where the results are moved to
+    WatchPayload *payload;      // Files being hidden on each image
+    size_t payload_count;       // Amount of files on 'payload'
+    WorkQueue *queue;           // Paths of the new images waiting for a worker thread
+    atomic_size_t succeeded;    // Amount of images whose result was moved to the output folder
+    atomic_size_t failed;       // Amount of images that could not be processed
+    atomic_size_t empty;        // Amount of images without hidden data (when extracting)
+    size_t events;              // Amount of new images that were queued
+    size_t lost_events;         // How many times the system's event queue has overflowed
+    uint64_t wait_us;           // Total time (in microseconds) that the new images waited for space on the queue
+} WatchState;
+
+// Signal handler for SIGINT and SIGTERM: ask the watching to stop
+static void __watch_signal(int signal_number);
+
+// Read a file to be hidden on the new images
+static int __payload_load(const char *path, WatchPayload *out);
+
+// Name of a file with a number added to its stem, like "name (1).ext" (the number 0 gives the name unchanged)
+// The returned string should be freed with 'imc_free()'.
+static char *__numbered_name(const char *name, int number);
+
+// Move a finished result (a file or a folder) from its temporary path to the output folder, without replacing anything there
+// If 'name' is already taken, a number is added to it. On success, 'final_path' receives the new path (to be freed with 'imc_free()').
+static int __publish_result(const char *temp_path, const char *out_dir, const char *name, char **final_path);
+
+// Hide the payload on an image, then move the modified image to the output folder
+static int __watch_hide(WatchState *watch, CarrierImage *carrier_img, const char *name, size_t worker, char **final_path);
+
+// Extract the hidden files of an image to a new folder named after the image, on the output folder
+// The files are extracted to a temporary folder, which is renamed once all files were written.
+static int __watch_extract(WatchState *watch, CarrierImage *carrier_img, const char *name, size_t worker, char **final_path);
+
+// Task of the worker threads: process one new image
+static void __watch_task(void *context, void *item, size_t worker);
+
+#endif  // _WIN32
+
+// Watch a folder for new images (files closed after being written, or moved into the folder), until SIGINT or SIGTERM is received
+// Each new image gets the files on 'hide_paths' hidden on it, or gets its hidden files extracted (if there are no files to hide).
+// The results are moved to the output folder only after they are complete. Files whose name begins with a dot are ignored.
+// If a file to be hidden could not be read, its path is stored on 'failed_path'.
+// Returns IMC_ERR_UNSUPPORTED on systems without inotify.
+int imc_watch_run(const WatchOptions *options, const char **failed_path);
+
+#endif  // _IMC_WATCH_H
@@ -0,0 +1,185 @@
+/* Public interface of libimgconceal, the library behind the imgconceal program.
+ *
+ * The images can be read from a file or from a memory buffer, and they can be saved to a file or to a new memory buffer.
+ * The library does not exit the program on errors (they are reported through the status codes below),
+ * and the progress messages are sent to a callback (nothing is printed by the library).
+ * The only exception is when memory cannot be allocated, which aborts the program.
+ * Different images can be processed concurrently on different threads, but each image should be used by one thread at a time.
+ */
+
+#ifndef _IMGCONCEAL_H
+#define _IMGCONCEAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Function return codes
+#define IMC_SUCCESS             0   // Operation completed successfully
+#define IMC_ERR_NO_MEMORY      -1   // No enough memory
+#define IMC_ERR_INVALID_PASS   -2   // Password is not valid
+#define IMC_ERR_FILE_NOT_FOUND -3   // File does not exist or could not be opened
+#define IMC_ERR_FILE_INVALID   -4   // File is not of a supported format
+#define IMC_ERR_FILE_TOO_BIG   -5   // The file to be hidden does not fit in the carrier bits of the image
+#define IMC_ERR_CRYPTO_FAIL    -6   // Failed to encrypt or decrypt the data
+#define IMC_ERR_FILE_EXISTS    -7   // Output file's name already exists
+#define IMC_ERR_PAYLOAD_OOB    -8   // Out-of-bounds: attempted to read more hidden data than what is left of the image
+#define IMC_ERR_INVALID_MAGIC  -9   // The "magic bytes" of the hidden data did not match what were expected
+#define IMC_ERR_NEWER_VERSION  -10  // Data was hidden using a newer version of this program
+#define IMC_ERR_SAVE_FAIL      -11  // Failed to save the extracted file
+#define IMC_ERR_NAME_TOO_LONG  -12  // The file name has more characters than the maximum allowed
+#define IMC_ERR_FILE_CORRUPTED -13  // The file read has a different size than expected
+#define IMC_ERR_PATH_IS_DIR    -14  // The path is of a directory rather than a file
+#define IMC_ERR_UNSUPPORTED    -15  // The image uses a feature that is not supported (for example, a compressed TIFF image)
+#define IMC_ERR_NO_CARRIER     -16  // The image has no bits suitable for hiding data (for example, it is fully transparent)
+#define IMC_ERR_WRITE_FAIL     -17  // Failed to encode or to write the image with the hidden data
+#define IMC_ERR_INPUT_TOO_BIG  -18  // The file to be hidden is bigger than the maximum size allowed
+#define IMC_ERR_SHARD_MISSING  -19  // The images do not have enough distinct shards of the same file
+
+// Flags for the 'flags' field of the 'StegOptions' struct
+#define IMC_VERBOSE     (uint64_t)1 // Sends the progress of each step to the progress monitor
+#define IMC_JUST_CHECK  (uint64_t)2 // Checks for the hidden file's info without saving the file
+
+// Image that carries the hidden data (its contents are private to the library)
+typedef struct CarrierImage CarrierImage;
+
+// Secrets derived from a password, or from a key (its contents are private to the library)
+typedef struct CryptoContext CryptoContext;
+
+// Buffer for the plaintext password (create it with 'imc_crypto_password_create()')
+typedef struct PassBuff PassBuff;
+
+// File that was read and compressed, so it can be hidden later (its contents are private to the library)
+typedef struct PreparedFile PreparedFile;
+
+// Function that receives the progress messages of an operation
+// The messages are text in the same format as printed by imgconceal when on verbose mode
+// (a message ending in '\r' is a progress update, which is going to be replaced by the next message).
+// The function is only called from the thread that called the library, even when the work is done on multiple threads.
+typedef void (*imc_progress_func)(void *context, const char *message);
+
+// Receiver of the progress messages of an operation
+typedef struct ProgressMonitor {
+    imc_progress_func function; // Function called for each message (NULL to ignore the messages)
+    void *context;              // Passed as-is to the function
+} ProgressMonitor;
+
+// Speed and size tradeoff of the encoder when an image is saved
+// (BMP, PNM, uncompressed TIFF, JPEG and lossy WebP images are saved the same way with every profile)
+enum SaveProfile {
+    IMC_PROFILE_BALANCED,   // Settings used when no profile is chosen
+    IMC_PROFILE_FAST,       // Faster to save, but the image may get bigger
+    IMC_PROFILE_SMALL,      // Smaller image, but slower to save
+};
+
+// Amount of save profiles
+#define IMC_PROFILE_COUNT 3
+
+// How an image is opened by the 'imc_steg_init()' family of functions
+typedef struct StegOptions {
+    uint64_t flags;             // IMC_VERBOSE and IMC_JUST_CHECK flags
+    ProgressMonitor progress;   // Receives the progress messages of the image when the IMC_VERBOSE flag is set
+    const uint8_t *image_data;  // If not NULL, the image is read from this buffer instead of from the path (which should be NULL)
+    size_t image_size;          // Size in bytes of the 'image_data' buffer
+    const char *cache_dir;      // If not NULL, folder where the decoded PNG and WebP images are cached (to skip decoding them again)
+    enum SaveProfile profile;   // Settings of the encoder when the image is saved (IMC_PROFILE_BALANCED if the options are zeroed)
+} StegOptions;
+
+// Time and size of saving an image with one of the save profiles (see 'imc_steg_benchmark()')
+typedef struct ProfileResult {
+    enum SaveProfile profile;   // Profile used for saving the image
+    int status;                 // Result of saving the image
+    double seconds;             // Time taken to save the image (the fastest of the rounds)
+    size_t size;                // Size in bytes of the saved image
+} ProfileResult;
+
+// How the capacity of an image was found by 'imc_steg_capacity()'
+enum CapacitySource {
+    IMC_CAPACITY_HEADER,    // Read from the header (PNG and WebP images without transparency)
+    IMC_CAPACITY_SCAN,      // Counted on the DCT coefficients, without decoding the pixels (JPEG images)
+    IMC_CAPACITY_OPEN,      // The image was opened (and decoded, if it is a PNG or WebP image with transparency)
+};
+
+// Metadata of a hidden file
+typedef struct FileMetadata {
+    struct timespec access_time;    // Last access time of the file
+    struct timespec mod_time;       // Last modified time of the file
+    struct timespec steg_time;      // Time when the file was hidden by this program
+    size_t file_size;               // Size in bytes of the hidden file
+    size_t name_size;               // Size in bytes of the file's name (counting the null terminator)
+    char file_name[];               // Name of the file as a C-style string
+} FileMetadata;
+
+// Copy a plaintext password of 'length' bytes to a new password buffer (in locked memory)
+// The buffer should be freed with 'imc_crypto_password_free()'.
+int imc_crypto_password_create(const uint8_t *text, size_t length, PassBuff **out);
+
+// Clear and free a password buffer
+void imc_crypto_password_free(PassBuff *password);
+
+// Open an image, then generate the secrets from a password and shuffle the carrier with them
+// 'options' can be NULL (the image is then read from 'path', with no flags).
+int imc_steg_init(const char *path, const PassBuff *password, CarrierImage **output, const StegOptions *options);
+
+// Hide a file in an image (its name is the last component of the path)
+int imc_steg_insert(CarrierImage *carrier_img, const char *file_path);
+
+// Hide in an image a file stored on a memory buffer
+int imc_steg_insert_memory(
+    CarrierImage *carrier_img,
+    const char *file_name,
+    const uint8_t *data,
+    size_t data_size,
+    struct timespec mod_time
+);
+
+// Amount of carrier bytes of an image (each one holds one bit of hidden data), found without a password
+// 'out_source' (can be NULL) receives how the amount was found.
+int imc_steg_capacity(const char *path, size_t *out_bits, enum CapacitySource *out_source);
+
+// Upper bound of the carrier bytes of an image, read only from its header ('out_exact' receives whether it is exact)
+// Returns IMC_ERR_UNSUPPORTED for the formats whose header does not tell the amount.
+int imc_steg_capacity_bound(const char *path, size_t *out_bits, bool *out_exact);
+
+// Save an image with each save profile (to memory, without hiding anything), measuring the time taken and the size of the image
+// The image is opened once, then saved 'rounds' times with each profile. 'out_results' receives IMC_PROFILE_COUNT results,
+// in the same order as 'enum SaveProfile'. 'progress' (can be NULL) receives the profile being measured.
+int imc_steg_benchmark(const char *path, size_t rounds, const ProgressMonitor *progress, ProfileResult *out_results);
+
+// Read and compress a file, so it can be hidden later in any amount of images
+// 'progress' can be NULL. The prepared file should be freed with 'imc_steg_prepared_free()'.
+int imc_steg_prepare(const char *file_path, const ProgressMonitor *progress, PreparedFile **output);
+
+// Amount of carrier bytes that a prepared file takes when hidden
+size_t imc_steg_prepared_bits(const PreparedFile *file);
+
+// Hide a prepared file in an image
+int imc_steg_insert_prepared(CarrierImage *carrier_img, const PreparedFile *file);
+
+// Clear and free a prepared file
+void imc_steg_prepared_free(PreparedFile *file);
+
+// Read the next hidden file into a new buffer
+// Returns IMC_ERR_INVALID_MAGIC or IMC_ERR_PAYLOAD_OOB when there are no more hidden files.
+int imc_steg_extract_memory(CarrierImage *carrier_img, FileMetadata **out_info, uint8_t **out_data);
+
+// Save the image with hidden data to a file
+int imc_steg_save(CarrierImage *carrier_img, const char *save_path);
+
+// Encode the image with hidden data into a new buffer
+int imc_steg_save_memory(CarrierImage *carrier_img, uint8_t **out_data, size_t *out_size);
+
+// Free a buffer or metadata returned by the library
+void imc_free(void *ptr);
+
+// Free the memory used by an image
+void imc_steg_finish(CarrierImage *carrier_img);
+
+// Short description of a status code
+const char *imc_strerror(int status);
+
+// Name of a save profile ("balanced", "fast" or "small")
+const char *imc_profile_name(enum SaveProfile profile);
+
+#endif  // _IMGCONCEAL_H
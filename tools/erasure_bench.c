@@ -0,0 +1,121 @@
+/* Throughput benchmark of the Reed-Solomon erasure code used by the parity shards.
+ * A payload of random bytes is split into data shards, then the parity shards are computed (encode),
+ * and as many data shards as there are parity shards are dropped and rebuilt (reconstruct).
+ * The rebuilt shards are compared with the originals, and the speed of both steps is printed.
+ *
+ * Usage: erasure_bench [DATA_SHARDS] [PARITY_SHARDS] [PAYLOAD_MB] [THREADS]
+ * (defaults: 10 data shards, 4 parity shards, 256 MB, and the amount of logical processors)
+ */
+
+#include "../src/imc_includes.h"
+
+// Amount of times each step is repeated (the fastest run is reported)
+#define BENCH_ROUNDS 5
+
+// Seconds elapsed since an arbitrary point in time
+static double __seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Read a positive number from the command line, or use the default if the argument was not given
+static size_t __argument(int argc, char **argv, int position, size_t fallback)
+{
+    if (argc <= position) return fallback;
+
+    char *end = NULL;
+    const unsigned long long value = strtoull(argv[position], &end, 10);
+    if (!isdigit(argv[position][0]) || *end != '\0')
+    {
+        fprintf(stderr, "erasure_bench: '%s' is not a number.\n", argv[position]);
+        exit(EXIT_FAILURE);
+    }
+
+    return (size_t)value;
+}
+
+int main(int argc, char **argv)
+{
+    if (sodium_init() < 0)
+    {
+        fprintf(stderr, "erasure_bench: could not initialize libsodium.\n");
+        return EXIT_FAILURE;
+    }
+
+    const size_t data_count = __argument(argc, argv, 1, 10);
+    const size_t parity_count = __argument(argc, argv, 2, 4);
+    const size_t payload_mb = __argument(argc, argv, 3, 256);
+    const size_t threads = __argument(argc, argv, 4, 0);
+
+    if (data_count == 0 || parity_count == 0 || parity_count > data_count || data_count + parity_count > IMC_ERASURE_MAX_SHARDS || payload_mb == 0)
+    {
+        fprintf(stderr, "erasure_bench: use from 1 to %d shards, with no more parity shards than data shards.\n", IMC_ERASURE_MAX_SHARDS);
+        return EXIT_FAILURE;
+    }
+
+    const size_t total = data_count + parity_count;
+    const size_t payload_size = payload_mb * 1024 * 1024;
+    const size_t shard_size = (payload_size + data_count - 1) / data_count;
+
+    uint8_t *shards[total];
+    uint8_t *originals[parity_count];
+    for (size_t i = 0; i < total; i++)
+    {
+        shards[i] = imc_malloc(shard_size);
+        if (i < data_count) randombytes_buf(shards[i], shard_size);
+    }
+
+    printf("Kernel: %s\n", imc_erasure_kernel());
+    printf("Shards: %zu data + %zu parity, %.1f MB each (payload of %zu MB)\n",
+        data_count, parity_count, (double)shard_size / (1024.0 * 1024.0), payload_mb);
+    printf("Threads: %zu\n\n", threads ? threads : imc_cpu_count());
+
+    // Encode: compute the parity shards from the data shards
+    double best_encode = INFINITY;
+    for (size_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        const double start = __seconds();
+        imc_erasure_encode((const uint8_t *const *)shards, data_count, &shards[data_count], parity_count, shard_size, threads);
+        const double elapsed = __seconds() - start;
+        if (elapsed < best_encode) best_encode = elapsed;
+    }
+
+    // Reconstruct: drop the first data shards (as many as the parity shards), then rebuild them
+    // (this is the worst case, since every parity shard is needed)
+    bool present[total];
+    for (size_t i = 0; i < total; i++) present[i] = (i >= parity_count);
+    for (size_t i = 0; i < parity_count; i++)
+    {
+        originals[i] = shards[i];
+        shards[i] = imc_malloc(shard_size);
+    }
+
+    double best_rebuild = INFINITY;
+    for (size_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < parity_count; i++) memset(shards[i], 0, shard_size);
+
+        const double start = __seconds();
+        imc_erasure_reconstruct(shards, present, data_count, parity_count, shard_size, threads);
+        const double elapsed = __seconds() - start;
+        if (elapsed < best_rebuild) best_rebuild = elapsed;
+    }
+
+    bool valid = true;
+    for (size_t i = 0; i < parity_count; i++)
+    {
+        valid = valid && (memcmp(shards[i], originals[i], shard_size) == 0);
+        imc_free(originals[i]);
+    }
+
+    // The speed is given in bytes of payload per second
+    const double payload_mib = (double)(shard_size * data_count) / (1024.0 * 1024.0);
+    printf("Encode:      %8.1f MB/s (%.3f s)\n", payload_mib / best_encode, best_encode);
+    printf("Reconstruct: %8.1f MB/s (%.3f s, %zu shard(s) rebuilt)\n", payload_mib / best_rebuild, best_rebuild, parity_count);
+    printf("Rebuilt shards: %s\n", valid ? "match the originals" : "DO NOT MATCH");
+
+    for (size_t i = 0; i < total; i++) imc_free(shards[i]);
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+/* Build-time generator of the secrets derived from an empty password.
+ * Since the salt and the hashing parameters are constant, hashing an empty password
+ * always gives the same result. This program hashes it with libsodium and prints a
+ * header with the result, so '--no-password' operations can skip the password hashing.
+ *
+ * The result is checked against a known answer, computed once with libsodium 1.0.18 for the salt
+ * and parameters below. If any of them is changed on 'imc_crypto.h', the known answer must be updated too.
+ *
+ * Usage: gen_nopass_key > src/imc_nopass_key.h
+ */
+
+#include "../src/imc_includes.h"
+
+// Salt and hashing parameters of the known answer
+#define KNOWN_SALT "imageconceal2023"
+#define KNOWN_OPSLIMIT 3
+#define KNOWN_MEMLIMIT 4096000
+
+// Secrets derived from an empty password, with the salt and parameters above
+static const uint8_t KNOWN_SECRET[64] = {
+    0xc9, 0xee, 0xf2, 0xae, 0x14, 0x6c, 0x6d, 0x67,
+    0x97, 0x40, 0x66, 0x20, 0x1a, 0x0b, 0xb1, 0x0d,
+    0x17, 0x0d, 0xd9, 0x46, 0x20, 0x3e, 0xa0, 0x29,
+    0x5b, 0xd0, 0x34, 0xea, 0x80, 0x55, 0x2a, 0x6e,
+    0x2f, 0xac, 0x0d, 0x97, 0x23, 0xed, 0x55, 0x60,
+    0xfc, 0xeb, 0xf8, 0x16, 0x94, 0xb3, 0x9a, 0xeb,
+    0x6c, 0xed, 0x88, 0x80, 0x02, 0x79, 0x53, 0x01,
+    0xac, 0x7b, 0x93, 0x62, 0x4b, 0x71, 0xde, 0x57,
+};
+
+// Hash an empty password with the same salt and parameters used by 'imc_crypto_derive_secret()'
+// Note: that function cannot be used here, because it takes its result for empty passwords from the generated header.
+static int __hash_empty_password(uint8_t *secret)
+{
+    uint8_t salt[crypto_pwhash_SALTBYTES];
+    memset(salt, 0, sizeof(salt));
+    size_t salt_len = strlen(IMC_SALT);
+    if (salt_len > crypto_pwhash_SALTBYTES) salt_len = crypto_pwhash_SALTBYTES;
+    memcpy(salt, IMC_SALT, salt_len);
+
+    return crypto_pwhash(
+        secret, IMC_SECRET_SIZE, "", 0, salt, IMC_OPSLIMIT, IMC_MEMLIMIT, crypto_pwhash_ALG_ARGON2ID13
+    );
+}
+
+int main()
+{
+    if (sodium_init() < 0)
+    {
+        fprintf(stderr, "gen_nopass_key: could not initialize libsodium.\n");
+        return EXIT_FAILURE;
+    }
+    
+    // Hash the empty password
+    uint8_t secret[IMC_SECRET_SIZE];
+    if (__hash_empty_password(secret) < 0)
+    {
+        fprintf(stderr, "gen_nopass_key: could not hash the empty password.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Verify the result against the known answer
+    if (strcmp(IMC_SALT, KNOWN_SALT) != 0 || IMC_OPSLIMIT != KNOWN_OPSLIMIT || IMC_MEMLIMIT != KNOWN_MEMLIMIT
+        || IMC_SECRET_SIZE != sizeof(KNOWN_SECRET))
+    {
+        fprintf(stderr, "gen_nopass_key: the salt or the hashing parameters have changed, update the known answer on 'tools/gen_nopass_key.c'.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (sodium_memcmp(secret, KNOWN_SECRET, sizeof(secret)) != 0)
+    {
+        fprintf(stderr, "gen_nopass_key: hashing the empty password did not give the known answer.\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("/* Secrets derived from an empty password (generated by 'tools/gen_nopass_key.c', do not edit). */\n\n");
+    printf("#ifndef _IMC_NOPASS_KEY_H\n");
+    printf("#define _IMC_NOPASS_KEY_H\n\n");
+    printf("// Salt: \"%s\", operations: %d, memory: %d, libsodium %s\n", IMC_SALT, IMC_OPSLIMIT, IMC_MEMLIMIT, sodium_version_string());
+    printf("static const uint8_t IMC_NOPASS_SECRET[%d] = {", IMC_SECRET_SIZE);
+    
+    for (size_t i = 0; i < sizeof(secret); i++)
+    {
+        if (i % 8 == 0) printf("\n   ");
+        printf(" 0x%02x,", secret[i]);
+    }
+    
+    printf("\n};\n\n");
+    printf("#endif  // _IMC_NOPASS_KEY_H\n");
+
+    return EXIT_SUCCESS;
+}